@@ -0,0 +1,214 @@
+#include "atomic.h"
+
+#include "platform_definitions.h"
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
+#if defined(COMPILER_GCC)
+
+int atomic_int_load(volatile int* x)
+{
+    return __atomic_load_n(x, __ATOMIC_SEQ_CST);
+}
+
+void atomic_int_store(volatile int* x, int value)
+{
+    __atomic_store_n(x, value, __ATOMIC_SEQ_CST);
+}
+
+int atomic_int_add(volatile int* augend, int addend)
+{
+    return __atomic_fetch_add(augend, addend, __ATOMIC_SEQ_CST);
+}
+
+bool atomic_int_compare_exchange(volatile int* x, int* expected, int desired)
+{
+    return __atomic_compare_exchange_n(x, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+uint64_t atomic_uint64_load(volatile uint64_t* x)
+{
+    return __atomic_load_n(x, __ATOMIC_SEQ_CST);
+}
+
+void atomic_uint64_store(volatile uint64_t* x, uint64_t value)
+{
+    __atomic_store_n(x, value, __ATOMIC_SEQ_CST);
+}
+
+uint64_t atomic_uint64_add(volatile uint64_t* augend, uint64_t addend)
+{
+    return __atomic_fetch_add(augend, addend, __ATOMIC_SEQ_CST);
+}
+
+uint64_t atomic_uint64_subtract(volatile uint64_t* minuend, uint64_t subtrahend)
+{
+    return __atomic_fetch_sub(minuend, subtrahend, __ATOMIC_SEQ_CST);
+}
+
+bool atomic_uint64_compare_exchange(volatile uint64_t* x, uint64_t* expected, uint64_t desired)
+{
+    return __atomic_compare_exchange_n(x, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void* atomic_pointer_load(void* volatile* x)
+{
+    return __atomic_load_n(x, __ATOMIC_SEQ_CST);
+}
+
+void atomic_pointer_store(void* volatile* x, void* value)
+{
+    __atomic_store_n(x, value, __ATOMIC_SEQ_CST);
+}
+
+void* atomic_pointer_exchange(void* volatile* x, void* value)
+{
+    return __atomic_exchange_n(x, value, __ATOMIC_SEQ_CST);
+}
+
+bool atomic_pointer_compare_exchange(void* volatile* x, void** expected, void* desired)
+{
+    return __atomic_compare_exchange_n(x, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+bool atomic_flag_test_and_set(AtomicFlag* flag)
+{
+    return __atomic_exchange_n(&flag->value, 1, __ATOMIC_ACQUIRE);
+}
+
+void atomic_flag_clear(AtomicFlag* flag)
+{
+    __atomic_store_n(&flag->value, 0, __ATOMIC_RELEASE);
+}
+
+static bool is_set(AtomicFlag* flag)
+{
+    return __atomic_load_n(&flag->value, __ATOMIC_RELAXED);
+}
+
+static void pause()
+{
+#if defined(INSTRUCTION_SET_X86) || defined(INSTRUCTION_SET_X64)
+    __builtin_ia32_pause();
+#endif
+}
+
+#elif defined(COMPILER_MSVC)
+
+int atomic_int_load(volatile int* x)
+{
+    return _InterlockedOr((volatile long*) x, 0);
+}
+
+void atomic_int_store(volatile int* x, int value)
+{
+    _InterlockedExchange((volatile long*) x, value);
+}
+
+int atomic_int_add(volatile int* augend, int addend)
+{
+    return _InterlockedExchangeAdd((volatile long*) augend, addend);
+}
+
+bool atomic_int_compare_exchange(volatile int* x, int* expected, int desired)
+{
+    long prior = _InterlockedCompareExchange((volatile long*) x, desired, *expected);
+    bool exchanged = prior == *expected;
+    *expected = prior;
+    return exchanged;
+}
+
+uint64_t atomic_uint64_load(volatile uint64_t* x)
+{
+    return _InterlockedOr64((volatile __int64*) x, 0);
+}
+
+void atomic_uint64_store(volatile uint64_t* x, uint64_t value)
+{
+    _InterlockedExchange64((volatile __int64*) x, value);
+}
+
+uint64_t atomic_uint64_add(volatile uint64_t* augend, uint64_t addend)
+{
+    return _InterlockedExchangeAdd64((volatile __int64*) augend, addend);
+}
+
+uint64_t atomic_uint64_subtract(volatile uint64_t* minuend, uint64_t subtrahend)
+{
+    return _InterlockedExchangeAdd64((volatile __int64*) minuend, -((__int64) subtrahend));
+}
+
+bool atomic_uint64_compare_exchange(volatile uint64_t* x, uint64_t* expected, uint64_t desired)
+{
+    __int64 prior = _InterlockedCompareExchange64((volatile __int64*) x, desired, *expected);
+    bool exchanged = (uint64_t) prior == *expected;
+    *expected = prior;
+    return exchanged;
+}
+
+void* atomic_pointer_load(void* volatile* x)
+{
+    return _InterlockedCompareExchangePointer(x, NULL, NULL);
+}
+
+void atomic_pointer_store(void* volatile* x, void* value)
+{
+    _InterlockedExchangePointer(x, value);
+}
+
+void* atomic_pointer_exchange(void* volatile* x, void* value)
+{
+    return _InterlockedExchangePointer(x, value);
+}
+
+bool atomic_pointer_compare_exchange(void* volatile* x, void** expected, void* desired)
+{
+    void* prior = _InterlockedCompareExchangePointer(x, desired, *expected);
+    bool exchanged = prior == *expected;
+    *expected = prior;
+    return exchanged;
+}
+
+bool atomic_flag_test_and_set(AtomicFlag* flag)
+{
+    return _InterlockedExchange(&flag->value, 1);
+}
+
+void atomic_flag_clear(AtomicFlag* flag)
+{
+    _InterlockedExchange(&flag->value, 0);
+}
+
+static bool is_set(AtomicFlag* flag)
+{
+    return flag->value;
+}
+
+static void pause()
+{
+#if defined(INSTRUCTION_SET_X86) || defined(INSTRUCTION_SET_X64)
+    _mm_pause();
+#endif
+}
+
+#endif // defined(COMPILER_MSVC)
+
+void spin_lock_acquire(SpinLock* lock)
+{
+    while(atomic_flag_test_and_set(&lock->flag))
+    {
+        // Wait without writing, so the cache line isn't fought over while the
+        // lock is held.
+        while(is_set(&lock->flag))
+        {
+            pause();
+        }
+    }
+}
+
+void spin_lock_release(SpinLock* lock)
+{
+    atomic_flag_clear(&lock->flag);
+}
@@ -0,0 +1,44 @@
+// Atomic Operations
+//
+// Every operation here is sequentially consistent, so they can be used
+// without having to think about memory ordering.
+
+#ifndef ATOMIC_H_
+#define ATOMIC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct AtomicFlag
+{
+    volatile long value;
+} AtomicFlag;
+
+typedef struct SpinLock
+{
+    AtomicFlag flag;
+} SpinLock;
+
+int atomic_int_load(volatile int* x);
+void atomic_int_store(volatile int* x, int value);
+int atomic_int_add(volatile int* augend, int addend);
+bool atomic_int_compare_exchange(volatile int* x, int* expected, int desired);
+
+uint64_t atomic_uint64_load(volatile uint64_t* x);
+void atomic_uint64_store(volatile uint64_t* x, uint64_t value);
+uint64_t atomic_uint64_add(volatile uint64_t* augend, uint64_t addend);
+uint64_t atomic_uint64_subtract(volatile uint64_t* minuend, uint64_t subtrahend);
+bool atomic_uint64_compare_exchange(volatile uint64_t* x, uint64_t* expected, uint64_t desired);
+
+void* atomic_pointer_load(void* volatile* x);
+void atomic_pointer_store(void* volatile* x, void* value);
+void* atomic_pointer_exchange(void* volatile* x, void* value);
+bool atomic_pointer_compare_exchange(void* volatile* x, void** expected, void* desired);
+
+bool atomic_flag_test_and_set(AtomicFlag* flag);
+void atomic_flag_clear(AtomicFlag* flag);
+
+void spin_lock_acquire(SpinLock* lock);
+void spin_lock_release(SpinLock* lock);
+
+#endif // ATOMIC_H_
@@ -0,0 +1,270 @@
+#include "concurrent_map.h"
+
+#include "assert.h"
+#include "int_utilities.h"
+#include "memory.h"
+
+// A slot goes from empty to full once, and from full to deleted once. It's
+// never emptied or refilled while its table is live, so a reader that finds a
+// full slot with its key can trust the value it reads next.
+#define SLOT_EMPTY 0
+#define SLOT_FULL 1
+#define SLOT_DELETED 2
+
+#define SHARD_BITS 6
+
+static uint64_t hash_key(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    key *= UINT64_C(0xc4ceb9fe1a85ec53);
+    key ^= key >> 33;
+    return key;
+}
+
+// The top bits of the hash pick the shard and the bottom bits pick the slot, so
+// that the keys in a shard still spread over its whole table.
+static ConcurrentMapShard* get_shard(ConcurrentMap* map, uint64_t hash)
+{
+    return &map->shards[hash >> (64 - SHARD_BITS)];
+}
+
+static int get_load_limit(int cap)
+{
+    return (3 * cap) / 4;
+}
+
+static ConcurrentMapTable* create_table(int cap)
+{
+    ASSERT(can_use_bitwise_and_to_cycle(cap));
+
+    uint64_t bytes = sizeof(ConcurrentMapTable) + sizeof(ConcurrentMapSlot) * cap;
+    ConcurrentMapTable* table = (ConcurrentMapTable*) virtual_allocate(bytes);
+    if(!table)
+    {
+        return NULL;
+    }
+    table->retired = NULL;
+    table->slots = (ConcurrentMapSlot*) (table + 1);
+    table->cap = cap;
+    return table;
+}
+
+static void destroy_retired_tables(ConcurrentMapTable* table)
+{
+    ConcurrentMapTable* next;
+    for(ConcurrentMapTable* retired = table->retired; retired; retired = next)
+    {
+        next = retired->retired;
+        virtual_deallocate(retired);
+    }
+    table->retired = NULL;
+}
+
+// Returns the slot holding the key, or the first empty slot if it's missing.
+static int find_slot(ConcurrentMapTable* table, void* key, uint64_t hash)
+{
+    int mask = table->cap - 1;
+    int probe = (int) (hash & mask);
+    for(;;)
+    {
+        ConcurrentMapSlot* slot = &table->slots[probe];
+        int state = atomic_int_load(&slot->state);
+        if(state == SLOT_EMPTY || (state == SLOT_FULL && slot->key == key))
+        {
+            return probe;
+        }
+        probe = (probe + 1) & mask;
+    }
+}
+
+static void fill_slot(ConcurrentMapSlot* slot, void* key, void* value)
+{
+    slot->key = key;
+    slot->value = value;
+    atomic_int_store(&slot->state, SLOT_FULL);
+}
+
+// Build a table without the tombstones, and twice the size if it's more than
+// half full of live pairs, and then publish it. Readers still in the old table
+// see the same pairs there, so it's kept around for later.
+static void rebuild_table(ConcurrentMapShard* shard)
+{
+    ConcurrentMapTable* prior = shard->table;
+    int cap = prior->cap;
+    if(shard->count >= cap / 2)
+    {
+        cap *= 2;
+    }
+
+    ConcurrentMapTable* table = create_table(cap);
+    ASSERT(table);
+
+    for(int i = 0; i < prior->cap; i += 1)
+    {
+        ConcurrentMapSlot* slot = &prior->slots[i];
+        if(slot->state == SLOT_FULL)
+        {
+            uint64_t hash = hash_key((uint64_t) (uintptr_t) slot->key);
+            int index = find_slot(table, slot->key, hash);
+            fill_slot(&table->slots[index], slot->key, slot->value);
+        }
+    }
+
+    table->retired = prior;
+    shard->used = shard->count;
+    atomic_pointer_store((void* volatile*) &shard->table, table);
+}
+
+bool concurrent_map_create(ConcurrentMap* map, int cap)
+{
+    int shard_cap = 16;
+    while(CONCURRENT_MAP_SHARD_COUNT * get_load_limit(shard_cap) < cap)
+    {
+        shard_cap *= 2;
+    }
+
+    // Every shard is cleared first, so that if a table can't be made, the
+    // shards after it don't hold garbage when the map's destroyed.
+    zero_memory(map->shards, sizeof(map->shards));
+
+    for(int i = 0; i < CONCURRENT_MAP_SHARD_COUNT; i += 1)
+    {
+        ConcurrentMapShard* shard = &map->shards[i];
+        shard->table = create_table(shard_cap);
+        if(!shard->table)
+        {
+            concurrent_map_destroy(map);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void concurrent_map_destroy(ConcurrentMap* map)
+{
+    if(map)
+    {
+        for(int i = 0; i < CONCURRENT_MAP_SHARD_COUNT; i += 1)
+        {
+            ConcurrentMapShard* shard = &map->shards[i];
+            if(shard->table)
+            {
+                destroy_retired_tables(shard->table);
+                virtual_deallocate(shard->table);
+                shard->table = NULL;
+            }
+            shard->count = 0;
+            shard->used = 0;
+        }
+    }
+}
+
+MaybePointer concurrent_map_get(ConcurrentMap* map, void* key)
+{
+    MaybePointer result = {0};
+
+    uint64_t hash = hash_key((uint64_t) (uintptr_t) key);
+    ConcurrentMapShard* shard = get_shard(map, hash);
+    ConcurrentMapTable* table = (ConcurrentMapTable*) atomic_pointer_load((void* volatile*) &shard->table);
+
+    // The slot may have been empty when it was found and filled with some other
+    // key since, so the key has to be checked again.
+    int index = find_slot(table, key, hash);
+    ConcurrentMapSlot* slot = &table->slots[index];
+    if(atomic_int_load(&slot->state) == SLOT_FULL && slot->key == key)
+    {
+        result.value = atomic_pointer_load(&slot->value);
+        result.valid = true;
+    }
+
+    return result;
+}
+
+MaybePointer concurrent_map_get_from_uint64(ConcurrentMap* map, uint64_t key)
+{
+    return concurrent_map_get(map, (void*) (uintptr_t) key);
+}
+
+void concurrent_map_add(ConcurrentMap* map, void* key, void* value)
+{
+    uint64_t hash = hash_key((uint64_t) (uintptr_t) key);
+    ConcurrentMapShard* shard = get_shard(map, hash);
+
+    spin_lock_acquire(&shard->lock);
+
+    ConcurrentMapTable* table = shard->table;
+    int index = find_slot(table, key, hash);
+    ConcurrentMapSlot* slot = &table->slots[index];
+
+    if(slot->state == SLOT_FULL)
+    {
+        atomic_pointer_store(&slot->value, value);
+    }
+    else
+    {
+        if(shard->used >= get_load_limit(table->cap))
+        {
+            rebuild_table(shard);
+            table = shard->table;
+            index = find_slot(table, key, hash);
+            slot = &table->slots[index];
+        }
+        fill_slot(slot, key, value);
+        shard->count += 1;
+        shard->used += 1;
+    }
+
+    spin_lock_release(&shard->lock);
+}
+
+void concurrent_map_add_from_uint64(ConcurrentMap* map, uint64_t key, void* value)
+{
+    concurrent_map_add(map, (void*) (uintptr_t) key, value);
+}
+
+void concurrent_map_remove(ConcurrentMap* map, void* key)
+{
+    uint64_t hash = hash_key((uint64_t) (uintptr_t) key);
+    ConcurrentMapShard* shard = get_shard(map, hash);
+
+    spin_lock_acquire(&shard->lock);
+
+    ConcurrentMapTable* table = shard->table;
+    int index = find_slot(table, key, hash);
+    ConcurrentMapSlot* slot = &table->slots[index];
+    if(slot->state == SLOT_FULL)
+    {
+        atomic_int_store(&slot->state, SLOT_DELETED);
+        shard->count -= 1;
+    }
+
+    spin_lock_release(&shard->lock);
+}
+
+void concurrent_map_remove_uint64(ConcurrentMap* map, uint64_t key)
+{
+    concurrent_map_remove(map, (void*) (uintptr_t) key);
+}
+
+int concurrent_map_count(ConcurrentMap* map)
+{
+    int count = 0;
+    for(int i = 0; i < CONCURRENT_MAP_SHARD_COUNT; i += 1)
+    {
+        count += atomic_int_load(&map->shards[i].count);
+    }
+    return count;
+}
+
+// This frees the tables that were replaced when shards grew. It's only safe to
+// call when no other thread is using the map, such as between frames.
+void concurrent_map_reclaim(ConcurrentMap* map)
+{
+    for(int i = 0; i < CONCURRENT_MAP_SHARD_COUNT; i += 1)
+    {
+        destroy_retired_tables(map->shards[i].table);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef CONCURRENT_MAP_H_
+#define CONCURRENT_MAP_H_
+
+#include "atomic.h"
+#include "maybe_types.h"
+#include "platform_definitions.h"
+
+#include <stdint.h>
+
+// This is a hash table with pointer-sized keys and values, like Map, that any
+// number of threads can use at once. Lookups take no locks. Writes lock only
+// the shard that the key hashes to, so writers to different shards don't wait
+// on each other.
+//
+// A shard never moves pairs around within its table, so a reader can't miss a
+// pair that's in it. Removed pairs leave a tombstone instead. When a shard's
+// table fills up, a new table is built and swapped in, and the old one is kept
+// until concurrent_map_reclaim, since readers may still be looking at it.
+#define CONCURRENT_MAP_SHARD_COUNT 64
+
+typedef struct ConcurrentMapSlot
+{
+    void* volatile key;
+    void* volatile value;
+    volatile int state;
+} ConcurrentMapSlot;
+
+typedef struct ConcurrentMapTable
+{
+    struct ConcurrentMapTable* retired;
+    ConcurrentMapSlot* slots;
+    int cap;
+} ConcurrentMapTable;
+
+#if defined(COMPILER_MSVC)
+#define CONCURRENT_MAP_CACHE_ALIGNED __declspec(align(64))
+#elif defined(COMPILER_GCC)
+#define CONCURRENT_MAP_CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+// Shards are aligned to a cache line each, so that writers locking
+// neighbouring shards don't contend over the same line. The alignment only
+// holds where the map itself is placed by the compiler, like on the stack or
+// in static storage. Heaps and pools don't align to more than a pointer.
+typedef struct CONCURRENT_MAP_CACHE_ALIGNED ConcurrentMapShard
+{
+    ConcurrentMapTable* volatile table;
+    SpinLock lock;
+    int count;
+    int used;
+} ConcurrentMapShard;
+
+typedef struct ConcurrentMap
+{
+    ConcurrentMapShard shards[CONCURRENT_MAP_SHARD_COUNT];
+} ConcurrentMap;
+
+bool concurrent_map_create(ConcurrentMap* map, int cap);
+void concurrent_map_destroy(ConcurrentMap* map);
+MaybePointer concurrent_map_get(ConcurrentMap* map, void* key);
+MaybePointer concurrent_map_get_from_uint64(ConcurrentMap* map, uint64_t key);
+void concurrent_map_add(ConcurrentMap* map, void* key, void* value);
+void concurrent_map_add_from_uint64(ConcurrentMap* map, uint64_t key, void* value);
+void concurrent_map_remove(ConcurrentMap* map, void* key);
+void concurrent_map_remove_uint64(ConcurrentMap* map, uint64_t key);
+int concurrent_map_count(ConcurrentMap* map);
+void concurrent_map_reclaim(ConcurrentMap* map);
+
+#endif // CONCURRENT_MAP_H_
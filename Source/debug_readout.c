@@ -1,6 +1,7 @@
 #include "debug_readout.h"
 
 #include "assert.h"
+#include "filesystem.h"
 #include "float_utilities.h"
 #include "math_basics.h"
 #include "memory.h"
@@ -26,6 +27,56 @@ void debug_readout_float(int channel_index, const char* label, float value)
     format_string(channel->label, DEBUG_CHANNEL_LABEL_CAP, "%s: %f", label, value);
 }
 
+static float bytes_to_megabytes(uint64_t bytes)
+{
+    return (float) bytes / (float) megabytes(1);
+}
+
+void debug_readout_memory_tag(int channel_index, MemoryTag tag)
+{
+    MemoryTagInfo info = get_memory_tag_info(tag);
+    float live = bytes_to_megabytes(info.live_bytes);
+    debug_readout_float(channel_index, describe_memory_tag(tag), live);
+
+    DebugChannel* channel = &debug_readout.channels[channel_index];
+    format_string(channel->label, DEBUG_CHANNEL_LABEL_CAP, "%s: %.2f MB, peak %.2f MB, %llu allocations, %.0f%% fragmented", describe_memory_tag(tag), live, bytes_to_megabytes(info.peak_bytes), (unsigned long long) info.live_allocations, 100.0f * info.fragmentation);
+}
+
+#define REPORT_LINE_CAP 256
+
+bool debug_readout_save_memory_report(const char* path, Stack* stack)
+{
+    int report_cap = REPORT_LINE_CAP * (MEMORY_TAG_COUNT + 1);
+    char* report = STACK_ALLOCATE(stack, char, report_cap);
+    if(!report)
+    {
+        return false;
+    }
+
+    int size = copy_string(report, report_cap, "tag,live_bytes,peak_bytes,reserved_bytes,free_bytes,largest_free_bytes,live_allocations,total_allocations,fragmentation\n");
+
+    for(int tag = 0; tag < MEMORY_TAG_COUNT; tag += 1)
+    {
+        MemoryTagInfo info = get_memory_tag_info((MemoryTag) tag);
+        format_string(&report[size], report_cap - size, "%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.4f\n",
+                describe_memory_tag((MemoryTag) tag),
+                (unsigned long long) info.live_bytes,
+                (unsigned long long) info.peak_bytes,
+                (unsigned long long) info.reserved_bytes,
+                (unsigned long long) info.free_bytes,
+                (unsigned long long) info.largest_free_bytes,
+                (unsigned long long) info.live_allocations,
+                (unsigned long long) info.total_allocations,
+                info.fragmentation);
+        size += string_size(&report[size]);
+    }
+
+    bool saved = save_whole_file(path, report, size, stack);
+    STACK_DEALLOCATE(stack, report);
+
+    return saved;
+}
+
 void debug_readout_reset()
 {
     debug_readout.index = (debug_readout.index + 1) % DEBUG_CHANNEL_VALUE_CAP;
@@ -1,9 +1,11 @@
 #ifndef DEBUG_READOUT_H_
 #define DEBUG_READOUT_H_
 
+#include "memory.h"
+
 #include <stdbool.h>
 
-#define DEBUG_CHANNEL_CAP       4
+#define DEBUG_CHANNEL_CAP       6
 #define DEBUG_CHANNEL_LABEL_CAP 128
 #define DEBUG_CHANNEL_VALUE_CAP 128
 
@@ -35,6 +37,8 @@ typedef struct DebugReadout
 } DebugReadout;
 
 void debug_readout_float(int channel_index, const char* label, float value);
+void debug_readout_memory_tag(int channel_index, MemoryTag tag);
+bool debug_readout_save_memory_report(const char* path, Stack* stack);
 void debug_readout_reset();
 void debug_readout_update_ranges();
 
@@ -1,5 +1,6 @@
 #include "editor.h"
 
+#include "arboretum_config.h"
 #include "array2.h"
 #include "assert.h"
 #include "asset_paths.h"
@@ -8,8 +9,8 @@
 #include "colours.h"
 #include "debug_draw.h"
 #include "debug_readout.h"
-#include "dense_map.h"
 #include "file_pick_dialog.h"
+#include "filesystem.h"
 #include "float_utilities.h"
 #include "history.h"
 #include "input.h"
@@ -21,6 +22,7 @@
 #include "obj.h"
 #include "object_lady.h"
 #include "platform.h"
+#include "slot_map.h"
 #include "string_build.h"
 #include "string_utilities.h"
 #include "ui.h"
@@ -61,6 +63,7 @@ struct Editor
 {
     Heap heap;
     Stack scratch;
+    Arena frame_arena;
 
     ObjectLady lady;
     JanSelection selection;
@@ -75,11 +78,11 @@ struct Editor
     History history;
 
     VideoContext* video_context;
-    DenseMapId selection_id;
-    DenseMapId selection_pointcloud_id;
-    DenseMapId selection_wireframe_id;
-    DenseMapId hover_halo;
-    DenseMapId selection_halo;
+    SlotMapHandle selection_id;
+    SlotMapHandle selection_pointcloud_id;
+    SlotMapHandle selection_wireframe_id;
+    SlotMapHandle hover_halo;
+    SlotMapHandle selection_halo;
 
     Camera camera;
     Int2 viewport;
@@ -378,7 +381,7 @@ static void update_object_hover_and_selection(Editor* editor, Platform* platform
         Ray ray = camera_get_ray(camera, mouse->position, viewport);
         ray = transform_ray(ray, matrix4_inverse_transform(model));
 
-        FaceContact contact = jan_first_face_hit_by_ray(mesh, ray, &editor->scratch);
+        FaceContact contact = jan_first_face_hit_by_ray(mesh, ray, &editor->frame_arena);
         if(contact.face && contact.distance < closest)
         {
             closest = contact.distance;
@@ -621,6 +624,18 @@ static void remove_halo(Editor* editor)
     editor->selection_halo = 0;
 }
 
+// Editing scatters a mesh's elements through its pools, so pack them together
+// again once editing is done. This has to be after the selection is destroyed,
+// since compacting moves every element.
+static void compact_selected_mesh(Editor* editor)
+{
+    if(is_valid_index(editor->selected_object_index))
+    {
+        Object* object = &editor->lady.objects[editor->selected_object_index];
+        jan_compact_mesh(&object->mesh);
+    }
+}
+
 static void enter_object_mode(Editor* editor)
 {
     add_halo(editor);
@@ -730,6 +745,7 @@ static void exit_edge_mode(Editor* editor)
     editor->selection_wireframe_id = 0;
 
     remove_halo(editor);
+    compact_selected_mesh(editor);
 }
 
 static void update_edge_mode(Editor* editor, Platform* platform)
@@ -761,7 +777,7 @@ static void update_edge_mode(Editor* editor, Platform* platform)
     EdgeContact edge_contact = jan_first_edge_under_point(mesh, mouse->position, touch_radius, model_view_projection, inverse, viewport, ray.origin, ray.direction);
     if(edge_contact.edge)
     {
-        FaceContact face_contact = jan_first_face_hit_by_ray(mesh, ray, &editor->scratch);
+        FaceContact face_contact = jan_first_face_hit_by_ray(mesh, ray, &editor->frame_arena);
 
         if(face_contact.face
                 && edge_contact.distance < face_contact.distance
@@ -813,6 +829,7 @@ static void exit_face_mode(Editor* editor)
     editor->selection_wireframe_id = 0;
 
     remove_halo(editor);
+    compact_selected_mesh(editor);
 }
 
 static void translate_faces(Editor* editor, Object* object, Platform* platform)
@@ -858,7 +875,7 @@ static void select_face(Editor* editor, Platform* platform, Object* object)
     Ray ray = camera_get_ray(camera, mouse->position, viewport);
     ray = transform_ray(ray, matrix4_inverse_transform(model));
 
-    FaceContact contact = jan_first_face_hit_by_ray(mesh, ray, &editor->scratch);
+    FaceContact contact = jan_first_face_hit_by_ray(mesh, ray, &editor->frame_arena);
     if(contact.face && input_get_mouse_clicked(input_context, MOUSE_BUTTON_LEFT))
     {
         jan_toggle_face_in_selection(&editor->selection, contact.face);
@@ -932,6 +949,7 @@ static void exit_vertex_mode(Editor* editor)
     editor->selection_pointcloud_id = 0;
 
     remove_halo(editor);
+    compact_selected_mesh(editor);
 }
 
 static void update_vertex_mode(Editor* editor, Platform* platform)
@@ -960,7 +978,7 @@ static void update_vertex_mode(Editor* editor, Platform* platform)
     VertexContact vertex_contact = jan_first_vertex_hit_by_ray(mesh, ray, touch_radius, (float) viewport.x);
     if(vertex_contact.vertex)
     {
-        FaceContact face_contact = jan_first_face_hit_by_ray(mesh, ray, &editor->scratch);
+        FaceContact face_contact = jan_first_face_hit_by_ray(mesh, ray, &editor->frame_arena);
 
         if(face_contact.face
                 && vertex_contact.distance <= face_contact.distance
@@ -1261,7 +1279,7 @@ static void handle_ui_events(Editor* editor, Platform* platform)
     {
         if(dialog->enabled)
         {
-            handle_input(dialog, event, &editor->lady, editor->selected_object_index, &editor->history, editor->video_context, ui_context, platform, &editor->heap, &editor->scratch);
+            handle_input(dialog, event, &editor->lady, editor->selected_object_index, &editor->history, editor->video_context, ui_context, platform, &editor->heap, &editor->scratch, &editor->frame_arena);
         }
 
         switch(event.type)
@@ -1313,6 +1331,57 @@ static void handle_ui_events(Editor* editor, Platform* platform)
     }
 }
 
+// The first channels are left for whatever's being debugged at the moment.
+#define FIRST_MEMORY_CHANNEL 2
+
+static void toggle_allocation_trace(Editor* editor, Platform* platform)
+{
+    const char* path = "allocation_trace.bin";
+
+    if(!allocation_trace_is_recording())
+    {
+        if(allocation_trace_start(uptibytes(4)))
+        {
+            log_debug(&platform->logger, "Started recording allocations.");
+        }
+        return;
+    }
+
+    AllocationTrace trace = allocation_trace_stop();
+    bool saved = save_whole_file(path, trace.header, trace.bytes, &editor->scratch);
+    if(saved)
+    {
+        log_debug(&platform->logger, "Saved %llu allocation events to %s.", (unsigned long long) trace.header->events_count, path);
+        if(trace.header->truncated)
+        {
+            log_error(&platform->logger, "The allocation trace %s was truncated, so it ends before recording was stopped.", path);
+        }
+    }
+    else
+    {
+        log_error(&platform->logger, "Failed to save the allocation trace %s.", path);
+    }
+    allocation_trace_release();
+}
+
+static void update_memory_readout(Editor* editor, Platform* platform)
+{
+    for(int tag = 1; tag < MEMORY_TAG_COUNT; tag += 1)
+    {
+        debug_readout_memory_tag(FIRST_MEMORY_CHANNEL + tag - 1, (MemoryTag) tag);
+    }
+
+    if(input_get_key_tapped(platform->input_context, INPUT_KEY_F12))
+    {
+        debug_readout_save_memory_report("memory_report.csv", &editor->scratch);
+    }
+
+    if(input_get_key_tapped(platform->input_context, INPUT_KEY_F11))
+    {
+        toggle_allocation_trace(editor, platform);
+    }
+}
+
 static void update_debug_readout(Editor* editor)
 {
     UiContainer* container = &editor->debug_readout->container;
@@ -1372,8 +1441,18 @@ Editor* editor_start_up(Platform* platform)
     Heap* heap = &editor->heap;
     Stack* stack = &editor->scratch;
 
-    stack_create(stack, (uint32_t) uptibytes(1));
-    heap_create(heap, (uint32_t) uptibytes(1));
+    // Huge pages are set up before anything large is allocated, so that
+    // everything past the threshold can use them.
+#if ARBORETUM_HUGE_PAGES
+    set_huge_page_mode(HUGE_PAGE_MODE_EXPLICIT, HUGE_PAGE_BYTES);
+#endif
+    log_debug(&platform->logger, "Huge pages: %s", describe_huge_page_mode(get_huge_page_mode()));
+
+    // Reserve plenty of address space, since only what's used is committed.
+    stack_create_growable(stack, uptibytes(64));
+    heap_create_growable(heap, uptibytes(64));
+    heap_set_tag(heap, MEMORY_TAG_EDITOR);
+    arena_create(&editor->frame_arena, (uint32_t) uptibytes(1));
 
     unicode_load_tables(heap, stack);
 
@@ -1454,7 +1533,7 @@ Editor* editor_start_up(Platform* platform)
         JanMesh* mesh = &test_model->mesh;
 
         char* path = get_model_path_by_name("test.obj", stack);
-        bool loaded = obj_load_file(path, mesh, heap, stack);
+        bool loaded = obj_load_file(path, mesh, heap, stack, &editor->frame_arena);
         ASSERT(loaded);
         STACK_DEALLOCATE(stack, path);
         jan_colour_all_faces(mesh, float3_yellow);
@@ -1537,6 +1616,7 @@ void editor_shut_down(Editor* editor)
 
     unicode_unload_tables(heap);
 
+    arena_destroy(&editor->frame_arena);
     stack_destroy(&editor->scratch);
     heap_destroy(heap);
 }
@@ -1588,6 +1668,7 @@ void editor_update(Editor* editor, Platform* platform)
 
     clean_up_history(editor);
 
+    update_memory_readout(editor, platform);
     update_debug_readout(editor);
 
     VideoUpdate update =
@@ -1611,6 +1692,10 @@ void editor_update(Editor* editor, Platform* platform)
         .selection_halo = editor->selection_halo,
     };
     video_update_context(editor->video_context, &update, platform);
+
+    // Everything allocated from the frame arena is only good until the end of
+    // the frame.
+    arena_reset(&editor->frame_arena);
 }
 
 void editor_destroy_clipboard_copy(Editor* editor, char* clipboard)
@@ -24,7 +24,7 @@ static bool record_is_before(DirectoryRecord a, DirectoryRecord b)
     return ascii_compare_alphabetic(a.name, b.name) < 0;
 }
 
-DEFINE_QUICK_SORT(DirectoryRecord, record_is_before, by_filename);
+DEFINE_PARALLEL_SORT(DirectoryRecord, record_is_before, by_filename);
 
 static void filter_directory(Directory* directory, const char** extensions, int extensions_count, bool show_hidden, Heap* heap)
 {
@@ -170,7 +170,7 @@ static void list_directory(FilePickDialog* dialog, const char* directory, UiCont
     }
     else
     {
-        quick_sort_by_filename(dialog->directory.records, dialog->directory.records_count);
+        parallel_sort_by_filename(dialog->directory.records, dialog->directory.records_count, heap);
 
         for(int i = 0; i < dialog->directory.records_count; i += 1)
         {
@@ -405,11 +405,11 @@ static void export_file(FilePickDialog* dialog, const char* name, ObjectLady* la
     }
 }
 
-static void import_file(FilePickDialog* dialog, const char* name, ObjectLady* lady, History* history, VideoContext* video_context, UiContext* ui_context, Heap* heap, Stack* stack)
+static void import_file(FilePickDialog* dialog, const char* name, ObjectLady* lady, History* history, VideoContext* video_context, UiContext* ui_context, Heap* heap, Stack* stack, Arena* arena)
 {
     char* path = append_to_path(dialog->path, name, heap);
     JanMesh mesh;
-    bool loaded = obj_load_file(path, &mesh, heap, stack);
+    bool loaded = obj_load_file(path, &mesh, heap, stack, arena);
     HEAP_DEALLOCATE(heap, path);
 
     if(!loaded)
@@ -442,7 +442,7 @@ static void import_file(FilePickDialog* dialog, const char* name, ObjectLady* la
     }
 }
 
-static void pick_file(FilePickDialog* dialog, ObjectLady* lady, int selected_object_index, History* history, VideoContext* video_context, UiContext* ui_context, Heap* heap, Stack* stack)
+static void pick_file(FilePickDialog* dialog, ObjectLady* lady, int selected_object_index, History* history, VideoContext* video_context, UiContext* ui_context, Heap* heap, Stack* stack, Arena* arena)
 {
     int selected = dialog->record_selected;
 
@@ -483,13 +483,13 @@ static void pick_file(FilePickDialog* dialog, ObjectLady* lady, int selected_obj
         {
             ASSERT(is_valid_index(selected));
             DirectoryRecord record = dialog->directory.records[selected];
-            import_file(dialog, record.name, lady, history, video_context, ui_context, heap, stack);
+            import_file(dialog, record.name, lady, history, video_context, ui_context, heap, stack, arena);
             break;
         }
     }
 }
 
-void handle_input(FilePickDialog* dialog, UiEvent event, ObjectLady* lady, int selected_object_index, History* history, VideoContext* video_context, UiContext* ui_context, Platform* platform, Heap* heap, Stack* stack)
+void handle_input(FilePickDialog* dialog, UiEvent event, ObjectLady* lady, int selected_object_index, History* history, VideoContext* video_context, UiContext* ui_context, Platform* platform, Heap* heap, Stack* stack, Arena* arena)
 {
     switch(event.type)
     {
@@ -507,7 +507,7 @@ void handle_input(FilePickDialog* dialog, UiEvent event, ObjectLady* lady, int s
 
             if(id == dialog->pick_button)
             {
-                pick_file(dialog, lady, selected_object_index, history, video_context, ui_context, heap, stack);
+                pick_file(dialog, lady, selected_object_index, history, video_context, ui_context, heap, stack, arena);
             }
             break;
         }
@@ -736,8 +736,8 @@ EdgeContact jan_first_edge_under_point(JanMesh* mesh, Float2 hit_center, float h
     FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
     {
         LineSegment segment;
-        segment.start = matrix4_transform_point(model_view_projection, edge->vertices[0]->position);
-        segment.end = matrix4_transform_point(model_view_projection, edge->vertices[1]->position);
+        segment.start = matrix4_transform_point(model_view_projection, jan_get_vertex(mesh, edge->vertices[0])->position);
+        segment.end = matrix4_transform_point(model_view_projection, jan_get_vertex(mesh, edge->vertices[1])->position);
 
         Float3 intersection;
         bool hit = intersect_line_segment_cylinder(segment, cylinder, &intersection);
@@ -757,20 +757,21 @@ EdgeContact jan_first_edge_under_point(JanMesh* mesh, Float2 hit_center, float h
     return result;
 }
 
-static void project_border_onto_plane(JanBorder* border, Matrix3 transform, Float2* vertices)
+static void project_border_onto_plane(JanMesh* mesh, JanBorder* border, Matrix3 transform, Float2* vertices)
 {
-    JanLink* first = border->first;
-    JanLink* link = first;
+    JanLinkId first = border->first;
+    JanLinkId link_id = first;
     int i = 0;
     do
     {
-        vertices[i] = matrix3_transform(transform, link->vertex->position);
+        JanLink* link = jan_get_link(mesh, link_id);
+        vertices[i] = matrix3_transform(transform, jan_get_vertex(mesh, link->vertex)->position);
         i += 1;
-        link = link->next;
-    } while(link != first);
+        link_id = link->next;
+    } while(link_id.value != first.value);
 }
 
-FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Stack* stack)
+FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Arena* arena)
 {
     FaceContact result =
     {
@@ -779,7 +780,8 @@ FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Stack* stack)
 
     FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
     {
-        Float3 any_point = face->first_border->first->vertex->position;
+        JanLink* any_link = jan_get_link(mesh, jan_get_border(mesh, face->first_border)->first);
+        Float3 any_point = jan_get_vertex(mesh, any_link->vertex)->position;
         MaybeFloat3 intersection = intersect_ray_plane_one_sided(ray.origin, ray.direction, any_point, face->normal);
         if(intersection.valid)
         {
@@ -791,14 +793,24 @@ FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Stack* stack)
 
                 bool on_face = false;
 
-                for(JanBorder* border = face->first_border; border; border = border->next)
+                ArenaMark mark = arena_mark(arena);
+
+                for(JanBorderId border_id = face->first_border; border_id.value;)
                 {
-                    int edges = jan_count_border_edges(border);
-                    Float2* projected = STACK_ALLOCATE(stack, Float2, edges);
-                    project_border_onto_plane(border, mi, projected);
+                    JanBorder* border = jan_get_border(mesh, border_id);
+                    int edges = jan_count_border_edges(mesh, border);
+                    Float2* projected = ARENA_ALLOCATE(arena, Float2, edges);
+                    if(!projected)
+                    {
+                        // The frame arena is full, so this face can't be
+                        // tested and is treated as missed.
+                        on_face = false;
+                        break;
+                    }
+                    project_border_onto_plane(mesh, border, mi, projected);
                     if(point_in_polygon(point, projected, edges))
                     {
-                        if(border == face->first_border)
+                        if(border_id.value == face->first_border.value)
                         {
                             on_face = true;
                         }
@@ -808,9 +820,11 @@ FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Stack* stack)
                             break;
                         }
                     }
-                    STACK_DEALLOCATE(stack, projected);
+                    border_id = border->next;
                 }
 
+                arena_reset_to_mark(arena, mark);
+
                 if(on_face)
                 {
                     result.distance = distance;
@@ -86,7 +86,7 @@ typedef struct VertexContact
 
 VertexContact jan_first_vertex_hit_by_ray(JanMesh* mesh, Ray ray, float hit_radius, float viewport_width);
 EdgeContact jan_first_edge_under_point(JanMesh* mesh, Float2 hit_center, float hit_radius, Matrix4 model_view_projection, Matrix4 inverse, Int2 viewport, Float3 view_position, Float3 view_direction);
-FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Stack* stack);
+FaceContact jan_first_face_hit_by_ray(JanMesh* mesh, Ray ray, Arena* arena);
 
 bool point_in_polygon(Float2 point, Float2* vertices, int vertices_count);
 float distance_point_plane(Float3 point, Float3 origin, Float3 normal);
@@ -2,21 +2,42 @@
 
 #include "array2.h"
 #include "assert.h"
+#include "atomic.h"
 #include "float_utilities.h"
 #include "int_utilities.h"
 #include "invalid_index.h"
 #include "jan_internal.h"
 #include "map.h"
 #include "math_basics.h"
+#include "polygon_normals.h"
 #include "sorting.h"
+#include "thread.h"
+
+const JanBorderId jan_border_none = {0};
+const JanEdgeId jan_edge_none = {0};
+const JanFaceId jan_face_none = {0};
+const JanLinkId jan_link_none = {0};
+const JanVertexId jan_vertex_none = {0};
 
 void jan_create_mesh(JanMesh* mesh)
 {
-    pool_create(&mesh->face_pool, sizeof(JanFace), 1024);
-    pool_create(&mesh->edge_pool, sizeof(JanEdge), 4096);
-    pool_create(&mesh->vertex_pool, sizeof(JanVertex), 4096);
-    pool_create(&mesh->link_pool, sizeof(JanLink), 8192);
-    pool_create(&mesh->border_pool, sizeof(JanLink), 8192);
+    // Start small, so that simple meshes don't each reserve a lot of memory.
+    // The pools grow as needed.
+    pool_create(&mesh->face_pool, sizeof(JanFace), 64);
+    pool_create(&mesh->edge_pool, sizeof(JanEdge), 64);
+    pool_create(&mesh->vertex_pool, sizeof(JanVertex), 64);
+    pool_create(&mesh->link_pool, sizeof(JanLink), 128);
+    pool_create(&mesh->border_pool, sizeof(JanBorder), 64);
+
+    pool_set_tag(&mesh->face_pool, MEMORY_TAG_MESH);
+    pool_set_tag(&mesh->edge_pool, MEMORY_TAG_MESH);
+    pool_set_tag(&mesh->vertex_pool, MEMORY_TAG_MESH);
+    pool_set_tag(&mesh->link_pool, MEMORY_TAG_MESH);
+    pool_set_tag(&mesh->border_pool, MEMORY_TAG_MESH);
+
+    zero_memory(&mesh->dirty_vertices, sizeof(mesh->dirty_vertices));
+    zero_memory(&mesh->dirty_faces, sizeof(mesh->dirty_faces));
+    zero_memory(&mesh->dirty_batch, sizeof(mesh->dirty_batch));
 
     mesh->faces_count = 0;
     mesh->edges_count = 0;
@@ -30,260 +51,412 @@ void jan_destroy_mesh(JanMesh* mesh)
     pool_destroy(&mesh->vertex_pool);
     pool_destroy(&mesh->link_pool);
     pool_destroy(&mesh->border_pool);
+    jan_destroy_dirty_list(&mesh->dirty_vertices);
+    jan_destroy_dirty_list(&mesh->dirty_faces);
+    jan_destroy_normal_batch(&mesh->dirty_batch);
 }
 
-JanVertex* jan_add_vertex(JanMesh* mesh, Float3 position)
+// An id is the index of its element in the pool plus one, which leaves zero to
+// mean there's no element.
+JanBorder* jan_get_border(JanMesh* mesh, JanBorderId id)
+{
+    return id.value ? (JanBorder*) pool_get_object(&mesh->border_pool, id.value - 1) : NULL;
+}
+
+JanEdge* jan_get_edge(JanMesh* mesh, JanEdgeId id)
+{
+    return id.value ? (JanEdge*) pool_get_object(&mesh->edge_pool, id.value - 1) : NULL;
+}
+
+JanFace* jan_get_face(JanMesh* mesh, JanFaceId id)
+{
+    return id.value ? (JanFace*) pool_get_object(&mesh->face_pool, id.value - 1) : NULL;
+}
+
+JanLink* jan_get_link(JanMesh* mesh, JanLinkId id)
+{
+    return id.value ? (JanLink*) pool_get_object(&mesh->link_pool, id.value - 1) : NULL;
+}
+
+JanVertex* jan_get_vertex(JanMesh* mesh, JanVertexId id)
+{
+    return id.value ? (JanVertex*) pool_get_object(&mesh->vertex_pool, id.value - 1) : NULL;
+}
+
+JanBorderId jan_get_border_id(JanMesh* mesh, JanBorder* border)
+{
+    JanBorderId id = {border ? pool_get_index(&mesh->border_pool, border) + 1 : 0};
+    return id;
+}
+
+JanEdgeId jan_get_edge_id(JanMesh* mesh, JanEdge* edge)
+{
+    JanEdgeId id = {edge ? pool_get_index(&mesh->edge_pool, edge) + 1 : 0};
+    return id;
+}
+
+JanFaceId jan_get_face_id(JanMesh* mesh, JanFace* face)
+{
+    JanFaceId id = {face ? pool_get_index(&mesh->face_pool, face) + 1 : 0};
+    return id;
+}
+
+JanLinkId jan_get_link_id(JanMesh* mesh, JanLink* link)
+{
+    JanLinkId id = {link ? pool_get_index(&mesh->link_pool, link) + 1 : 0};
+    return id;
+}
+
+JanVertexId jan_get_vertex_id(JanMesh* mesh, JanVertex* vertex)
+{
+    JanVertexId id = {vertex ? pool_get_index(&mesh->vertex_pool, vertex) + 1 : 0};
+    return id;
+}
+
+// Editing records which elements it touched, so that the normals can be
+// brought up to date afterward without going over the whole mesh.
+static void mark_vertex_dirty(JanMesh* mesh, JanVertexId id)
+{
+    JanVertex* vertex = jan_get_vertex(mesh, id);
+    if(!vertex->dirty)
+    {
+        vertex->dirty = true;
+        jan_add_to_dirty_list(&mesh->dirty_vertices, id.value);
+    }
+}
+
+static void mark_face_dirty(JanMesh* mesh, JanFaceId id)
+{
+    JanFace* face = jan_get_face(mesh, id);
+    if(!face->dirty)
+    {
+        face->dirty = true;
+        jan_add_to_dirty_list(&mesh->dirty_faces, id.value);
+    }
+}
+
+static JanVertexId add_vertex(JanMesh* mesh, Float3 position)
 {
     JanVertex* vertex = POOL_ALLOCATE(&mesh->vertex_pool, JanVertex);
     vertex->position = position;
 
     mesh->vertices_count += 1;
 
-    return vertex;
+    JanVertexId id = jan_get_vertex_id(mesh, vertex);
+    mark_vertex_dirty(mesh, id);
+
+    return id;
+}
+
+JanVertex* jan_add_vertex(JanMesh* mesh, Float3 position)
+{
+    return jan_get_vertex(mesh, add_vertex(mesh, position));
 }
 
-static void add_spoke(JanEdge* edge, JanVertex* vertex)
+static void add_spoke(JanMesh* mesh, JanEdgeId edge_id, JanVertexId vertex_id)
 {
-    JanEdge* existing_edge = vertex->any_edge;
-    if(existing_edge)
+    JanEdge* edge = jan_get_edge(mesh, edge_id);
+    JanVertex* vertex = jan_get_vertex(mesh, vertex_id);
+    JanEdgeId existing_edge = vertex->any_edge;
+    if(existing_edge.value)
     {
-        JanSpoke* a = jan_get_spoke(edge, vertex);
-        JanSpoke* b = jan_get_spoke(existing_edge, vertex);
-        if(b->prior)
+        JanSpoke* a = jan_get_spoke(edge, vertex_id);
+        JanSpoke* b = jan_get_spoke(jan_get_edge(mesh, existing_edge), vertex_id);
+        if(b->prior.value)
         {
-            JanSpoke* c = jan_get_spoke(b->prior, vertex);
-            c->next = edge;
+            JanSpoke* c = jan_get_spoke(jan_get_edge(mesh, b->prior), vertex_id);
+            c->next = edge_id;
         }
         a->next = existing_edge;
         a->prior = b->prior;
-        b->prior = edge;
+        b->prior = edge_id;
     }
     else
     {
-        vertex->any_edge = edge;
-        JanSpoke* spoke = jan_get_spoke(edge, vertex);
-        spoke->next = edge;
-        spoke->prior = edge;
+        vertex->any_edge = edge_id;
+        JanSpoke* spoke = jan_get_spoke(edge, vertex_id);
+        spoke->next = edge_id;
+        spoke->prior = edge_id;
     }
+    mark_vertex_dirty(mesh, vertex_id);
 }
 
-static void remove_spoke(JanEdge* edge, JanVertex* vertex)
+static void remove_spoke(JanMesh* mesh, JanEdgeId edge_id, JanVertexId vertex_id)
 {
-    JanSpoke* spoke = jan_get_spoke(edge, vertex);
-    if(spoke->next)
+    JanSpoke* spoke = jan_get_spoke(jan_get_edge(mesh, edge_id), vertex_id);
+    if(spoke->next.value)
     {
-        JanSpoke* other = jan_get_spoke(spoke->next, vertex);
+        JanSpoke* other = jan_get_spoke(jan_get_edge(mesh, spoke->next), vertex_id);
         other->prior = spoke->prior;
     }
-    if(spoke->prior)
+    if(spoke->prior.value)
     {
-        JanSpoke* other = jan_get_spoke(spoke->prior, vertex);
+        JanSpoke* other = jan_get_spoke(jan_get_edge(mesh, spoke->prior), vertex_id);
         other->next = spoke->next;
     }
-    if(vertex->any_edge == edge)
+    JanVertex* vertex = jan_get_vertex(mesh, vertex_id);
+    if(vertex->any_edge.value == edge_id.value)
     {
-        if(spoke->next == edge)
+        if(spoke->next.value == edge_id.value)
         {
-            vertex->any_edge = NULL;
+            vertex->any_edge = jan_edge_none;
         }
         else
         {
             vertex->any_edge = spoke->next;
         }
     }
-    spoke->next = NULL;
-    spoke->prior = NULL;
+    spoke->next = jan_edge_none;
+    spoke->prior = jan_edge_none;
+    mark_vertex_dirty(mesh, vertex_id);
 }
 
-static bool edge_contains_vertices(JanEdge* edge, JanVertex* a, JanVertex* b)
+static bool edge_contains_vertices(JanEdge* edge, JanVertexId a, JanVertexId b)
 {
-    return (edge->vertices[0] == a && edge->vertices[1] == b)
-        || (edge->vertices[1] == a && edge->vertices[0] == b);
+    return (edge->vertices[0].value == a.value && edge->vertices[1].value == b.value)
+        || (edge->vertices[1].value == a.value && edge->vertices[0].value == b.value);
 }
 
-static JanEdge* get_edge_spoked_from_vertex(JanVertex* hub, JanVertex* vertex)
+static JanEdgeId get_edge_spoked_from_vertex(JanMesh* mesh, JanVertexId hub, JanVertexId vertex)
 {
-    if(!hub->any_edge)
+    JanEdgeId first = jan_get_vertex(mesh, hub)->any_edge;
+    if(!first.value)
     {
-        return NULL;
+        return jan_edge_none;
     }
-    JanEdge* first = hub->any_edge;
-    JanEdge* edge = first;
+    JanEdgeId edge_id = first;
     do
     {
+        JanEdge* edge = jan_get_edge(mesh, edge_id);
         if(edge_contains_vertices(edge, hub, vertex))
         {
-            return edge;
+            return edge_id;
         }
-        edge = jan_get_spoke(edge, hub)->next;
-    } while(edge != first);
-    return NULL;
+        edge_id = jan_get_spoke(edge, hub)->next;
+    } while(edge_id.value != first.value);
+    return jan_edge_none;
 }
 
-JanEdge* jan_add_edge(JanMesh* mesh, JanVertex* start, JanVertex* end)
+static JanEdgeId add_edge(JanMesh* mesh, JanVertexId start, JanVertexId end)
 {
     JanEdge* edge = POOL_ALLOCATE(&mesh->edge_pool, JanEdge);
     edge->vertices[0] = start;
     edge->vertices[1] = end;
 
-    add_spoke(edge, start);
-    add_spoke(edge, end);
+    JanEdgeId id = jan_get_edge_id(mesh, edge);
+    add_spoke(mesh, id, start);
+    add_spoke(mesh, id, end);
 
     mesh->edges_count += 1;
 
-    return edge;
+    return id;
 }
 
-static JanEdge* add_edge_if_nonexistant(JanMesh* mesh, JanVertex* start, JanVertex* end)
+JanEdge* jan_add_edge(JanMesh* mesh, JanVertex* start, JanVertex* end)
 {
-    JanEdge* edge = get_edge_spoked_from_vertex(start, end);
-    if(edge)
+    JanEdgeId id = add_edge(mesh, jan_get_vertex_id(mesh, start), jan_get_vertex_id(mesh, end));
+    return jan_get_edge(mesh, id);
+}
+
+static JanEdgeId add_edge_if_nonexistant(JanMesh* mesh, JanVertexId start, JanVertexId end)
+{
+    JanEdgeId edge = get_edge_spoked_from_vertex(mesh, start, end);
+    if(edge.value)
     {
         return edge;
     }
     else
     {
-        return jan_add_edge(mesh, start, end);
+        return add_edge(mesh, start, end);
     }
 }
 
-static JanLink* add_link(JanMesh* mesh, JanVertex* vertex, JanEdge* edge, JanFace* face)
+static JanLinkId add_link(JanMesh* mesh, JanVertexId vertex, JanEdgeId edge, JanFaceId face)
 {
     JanLink* link = POOL_ALLOCATE(&mesh->link_pool, JanLink);
     link->vertex = vertex;
     link->edge = edge;
     link->face = face;
 
-    return link;
+    return jan_get_link_id(mesh, link);
 }
 
-static bool is_boundary(JanLink* link)
+static bool is_boundary(JanMesh* mesh, JanLinkId link)
 {
-    return link == link->next_fin;
+    return link.value == jan_get_link(mesh, link)->next_fin.value;
 }
 
-static void make_boundary(JanLink* link)
+static void make_boundary(JanLink* link, JanLinkId id)
 {
-    link->next_fin = link;
-    link->prior_fin = link;
+    link->next_fin = id;
+    link->prior_fin = id;
 }
 
-static void add_fin(JanLink* link, JanEdge* edge)
+static void add_fin(JanMesh* mesh, JanLinkId link_id, JanEdgeId edge_id)
 {
-    JanLink* existing_link = edge->any_link;
-    if(existing_link)
+    JanLink* link = jan_get_link(mesh, link_id);
+    JanEdge* edge = jan_get_edge(mesh, edge_id);
+    JanLinkId existing_id = edge->any_link;
+    if(existing_id.value)
     {
-        link->prior_fin = existing_link;
+        JanLink* existing_link = jan_get_link(mesh, existing_id);
+        link->prior_fin = existing_id;
         link->next_fin = existing_link->next_fin;
 
-        existing_link->next_fin->prior_fin = link;
-        existing_link->next_fin = link;
+        jan_get_link(mesh, existing_link->next_fin)->prior_fin = link_id;
+        existing_link->next_fin = link_id;
     }
     else
     {
-        make_boundary(link);
+        make_boundary(link, link_id);
     }
-    edge->any_link = link;
-    link->edge = edge;
+    edge->any_link = link_id;
+    link->edge = edge_id;
 }
 
-static void remove_fin(JanLink* link, JanEdge* edge)
+static void remove_fin(JanMesh* mesh, JanLinkId link_id)
 {
-    if(is_boundary(link))
+    JanLink* link = jan_get_link(mesh, link_id);
+    JanEdge* edge = jan_get_edge(mesh, link->edge);
+    if(link->next_fin.value == link_id.value)
     {
-        ASSERT(edge->any_link == link);
-        edge->any_link = NULL;
+        ASSERT(edge->any_link.value == link_id.value);
+        edge->any_link = jan_link_none;
     }
     else
     {
-        if(edge->any_link == link)
+        if(edge->any_link.value == link_id.value)
         {
             edge->any_link = link->next_fin;
         }
-        link->next_fin->prior_fin = link->prior_fin;
-        link->prior_fin->next_fin = link->next_fin;
+        jan_get_link(mesh, link->next_fin)->prior_fin = link->prior_fin;
+        jan_get_link(mesh, link->prior_fin)->next_fin = link->next_fin;
     }
-    link->next_fin = NULL;
-    link->prior_fin = NULL;
-    link->edge = NULL;
+    link->next_fin = jan_link_none;
+    link->prior_fin = jan_link_none;
+    link->edge = jan_edge_none;
+    mark_vertex_dirty(mesh, link->vertex);
 }
 
-static JanLink* add_border_to_face(JanMesh* mesh, JanVertex* vertex, JanEdge* edge, JanFace* face)
+static JanLinkId add_border_to_face(JanMesh* mesh, JanVertexId vertex, JanEdgeId edge, JanFaceId face_id)
 {
-    JanLink* link = add_link(mesh, vertex, edge, face);
-    add_fin(link, edge);
+    JanLinkId link = add_link(mesh, vertex, edge, face_id);
+    add_fin(mesh, link, edge);
 
+    JanFace* face = jan_get_face(mesh, face_id);
     JanBorder* border = POOL_ALLOCATE(&mesh->border_pool, JanBorder);
+    JanBorderId border_id = jan_get_border_id(mesh, border);
     border->first = link;
     border->last = link;
-    border->next = NULL;
+    border->next = jan_border_none;
     border->prior = face->last_border;
-    if(!face->first_border)
+    if(!face->first_border.value)
     {
-        face->first_border = border;
+        face->first_border = border_id;
     }
-    if(face->last_border)
+    if(face->last_border.value)
     {
-        face->last_border->next = border;
+        jan_get_border(mesh, face->last_border)->next = border_id;
     }
-    face->last_border = border;
+    face->last_border = border_id;
 
     face->borders_count += 1;
 
     return link;
 }
 
-void jan_add_and_link_border(JanMesh* mesh, JanFace* face, JanVertex** vertices, JanEdge** edges, int edges_count)
+// Create a link in the face and chain it to the previous one.
+static JanLinkId chain_link(JanMesh* mesh, JanLinkId prior, JanVertexId vertex, JanEdgeId edge, JanFaceId face)
+{
+    JanLinkId link = add_link(mesh, vertex, edge, face);
+    add_fin(mesh, link, edge);
+
+    jan_get_link(mesh, prior)->next = link;
+    jan_get_link(mesh, link)->prior = prior;
+
+    return link;
+}
+
+// Connect the ends to close the loop.
+static void close_border(JanMesh* mesh, JanLinkId first, JanLinkId last)
+{
+    jan_get_link(mesh, first)->prior = last;
+    jan_get_link(mesh, last)->next = first;
+}
+
+static void link_border(JanMesh* mesh, JanFaceId face, JanVertexId* vertices, JanEdgeId* edges, int edges_count)
 {
-    // Create each link in the face and chain it to the previous.
-    JanLink* first = add_border_to_face(mesh, vertices[0], edges[0], face);
-    JanLink* prior = first;
+    JanLinkId first = add_border_to_face(mesh, vertices[0], edges[0], face);
+    JanLinkId prior = first;
     for(int i = 1; i < edges_count; i += 1)
     {
-        JanLink* link = add_link(mesh, vertices[i], edges[i], face);
-        add_fin(link, edges[i]);
-
-        prior->next = link;
-        link->prior = prior;
+        prior = chain_link(mesh, prior, vertices[i], edges[i], face);
+    }
+    close_border(mesh, first, prior);
+}
 
-        prior = link;
+void jan_add_and_link_border(JanMesh* mesh, JanFace* face, JanVertex** vertices, JanEdge** edges, int edges_count)
+{
+    JanFaceId face_id = jan_get_face_id(mesh, face);
+    JanVertexId vertex = jan_get_vertex_id(mesh, vertices[0]);
+    JanEdgeId edge = jan_get_edge_id(mesh, edges[0]);
+    JanLinkId first = add_border_to_face(mesh, vertex, edge, face_id);
+    JanLinkId prior = first;
+    for(int i = 1; i < edges_count; i += 1)
+    {
+        vertex = jan_get_vertex_id(mesh, vertices[i]);
+        edge = jan_get_edge_id(mesh, edges[i]);
+        prior = chain_link(mesh, prior, vertex, edge, face_id);
     }
-    // Connect the ends to close the loop.
-    first->prior = prior;
-    prior->next = first;
+    close_border(mesh, first, prior);
 }
 
-JanFace* jan_add_face(JanMesh* mesh, JanVertex** vertices, JanEdge** edges, int edges_count)
+static JanFaceId add_empty_face(JanMesh* mesh, int edges_count)
 {
     JanFace* face = POOL_ALLOCATE(&mesh->face_pool, JanFace);
     face->edges = edges_count;
 
-    jan_add_and_link_border(mesh, face, vertices, edges, edges_count);
-
     mesh->faces_count += 1;
 
+    JanFaceId id = jan_get_face_id(mesh, face);
+    mark_face_dirty(mesh, id);
+
+    return id;
+}
+
+static JanFaceId add_face(JanMesh* mesh, JanVertexId* vertices, JanEdgeId* edges, int edges_count)
+{
+    JanFaceId face = add_empty_face(mesh, edges_count);
+    link_border(mesh, face, vertices, edges, edges_count);
+    return face;
+}
+
+JanFace* jan_add_face(JanMesh* mesh, JanVertex** vertices, JanEdge** edges, int edges_count)
+{
+    JanFace* face = jan_get_face(mesh, add_empty_face(mesh, edges_count));
+    jan_add_and_link_border(mesh, face, vertices, edges, edges_count);
     return face;
 }
 
-static JanFace* connect_vertices_and_add_face(JanMesh* mesh, JanVertex** vertices, int vertices_count, Stack* stack)
+static JanFaceId connect_vertices_and_add_face(JanMesh* mesh, JanVertexId* vertices, int vertices_count, Stack* stack)
 {
-    JanEdge** edges = STACK_ALLOCATE(stack, JanEdge*, vertices_count);
+    JanEdgeId* edges = STACK_ALLOCATE(stack, JanEdgeId, vertices_count);
     int end = vertices_count - 1;
     for(int i = 0; i < end; i += 1)
     {
-        edges[i] = jan_add_edge(mesh, vertices[i], vertices[i + 1]);
+        edges[i] = add_edge(mesh, vertices[i], vertices[i + 1]);
     }
-    edges[end] = jan_add_edge(mesh, vertices[end], vertices[0]);
+    edges[end] = add_edge(mesh, vertices[end], vertices[0]);
 
-    JanFace* face = jan_add_face(mesh, vertices, edges, vertices_count);
+    JanFaceId face = add_face(mesh, vertices, edges, vertices_count);
     STACK_DEALLOCATE(stack, edges);
 
     return face;
 }
 
-JanFace* jan_connect_disconnected_vertices_and_add_face(JanMesh* mesh, JanVertex** vertices, int vertices_count, Stack* stack)
+static JanFaceId connect_disconnected_vertices_and_add_face(JanMesh* mesh, JanVertexId* vertices, int vertices_count, Stack* stack)
 {
-    JanEdge** edges = STACK_ALLOCATE(stack, JanEdge*, vertices_count);
+    JanEdgeId* edges = STACK_ALLOCATE(stack, JanEdgeId, vertices_count);
     int end = vertices_count - 1;
     for(int i = 0; i < end; i += 1)
     {
@@ -291,42 +464,58 @@ JanFace* jan_connect_disconnected_vertices_and_add_face(JanMesh* mesh, JanVertex
     }
     edges[end] = add_edge_if_nonexistant(mesh, vertices[end], vertices[0]);
 
-    JanFace* face = jan_add_face(mesh, vertices, edges, vertices_count);
+    JanFaceId face = add_face(mesh, vertices, edges, vertices_count);
     STACK_DEALLOCATE(stack, edges);
 
     return face;
 }
 
-static void connect_vertices_and_add_hole(JanMesh* mesh, JanFace* face, JanVertex** vertices, int vertices_count, Stack* stack)
+JanFace* jan_connect_disconnected_vertices_and_add_face(JanMesh* mesh, JanVertex** vertices, int vertices_count, Stack* stack)
 {
-    JanEdge** edges = STACK_ALLOCATE(stack, JanEdge*, vertices_count);
+    JanVertexId* ids = STACK_ALLOCATE(stack, JanVertexId, vertices_count);
+    for(int i = 0; i < vertices_count; i += 1)
+    {
+        ids[i] = jan_get_vertex_id(mesh, vertices[i]);
+    }
+
+    JanFaceId face = connect_disconnected_vertices_and_add_face(mesh, ids, vertices_count, stack);
+    STACK_DEALLOCATE(stack, ids);
+
+    return jan_get_face(mesh, face);
+}
+
+static void connect_vertices_and_add_hole(JanMesh* mesh, JanFaceId face, JanVertexId* vertices, int vertices_count, Stack* stack)
+{
+    JanEdgeId* edges = STACK_ALLOCATE(stack, JanEdgeId, vertices_count);
     int end = vertices_count - 1;
     for(int i = 0; i < end; i += 1)
     {
-        edges[i] = jan_add_edge(mesh, vertices[i], vertices[i + 1]);
+        edges[i] = add_edge(mesh, vertices[i], vertices[i + 1]);
     }
-    edges[end] = jan_add_edge(mesh, vertices[end], vertices[0]);
+    edges[end] = add_edge(mesh, vertices[end], vertices[0]);
 
-    jan_add_and_link_border(mesh, face, vertices, edges, vertices_count);
+    link_border(mesh, face, vertices, edges, vertices_count);
 
     STACK_DEALLOCATE(stack, edges);
 }
 
 void jan_remove_face(JanMesh* mesh, JanFace* face)
 {
-    JanBorder* next_border;
-    for(JanBorder* border = face->first_border; border; border = next_border)
+    JanBorderId next_border;
+    for(JanBorderId border_id = face->first_border; border_id.value; border_id = next_border)
     {
+        JanBorder* border = jan_get_border(mesh, border_id);
         next_border = border->next;
-        JanLink* first = border->first;
-        JanLink* link = first;
+        JanLinkId first = border->first;
+        JanLinkId link_id = first;
         do
         {
-            JanLink* next = link->next;
-            remove_fin(link, link->edge);
+            JanLink* link = jan_get_link(mesh, link_id);
+            JanLinkId next = link->next;
+            remove_fin(mesh, link_id);
             pool_deallocate(&mesh->link_pool, link);
-            link = next;
-        } while(link != first);
+            link_id = next;
+        } while(link_id.value != first.value);
         pool_deallocate(&mesh->border_pool, border);
     }
     pool_deallocate(&mesh->face_pool, face);
@@ -335,40 +524,42 @@ void jan_remove_face(JanMesh* mesh, JanFace* face)
 
 void jan_remove_face_and_its_unlinked_edges_and_vertices(JanMesh* mesh, JanFace* face)
 {
-    JanBorder* next_border;
-    for(JanBorder* border = face->first_border; border; border = next_border)
+    JanBorderId next_border;
+    for(JanBorderId border_id = face->first_border; border_id.value; border_id = next_border)
     {
+        JanBorder* border = jan_get_border(mesh, border_id);
         next_border = border->next;
-        JanLink* first = border->first;
-        JanLink* link = first;
+        JanLinkId first = border->first;
+        JanLinkId link_id = first;
         do
         {
-            JanLink* next = link->next;
-            JanEdge* edge = link->edge;
-            remove_fin(link, edge);
+            JanLink* link = jan_get_link(mesh, link_id);
+            JanLinkId next = link->next;
+            JanEdgeId edge_id = link->edge;
+            remove_fin(mesh, link_id);
             pool_deallocate(&mesh->link_pool, link);
-            if(!edge->any_link)
+            JanEdge* edge = jan_get_edge(mesh, edge_id);
+            if(!edge->any_link.value)
             {
-                JanVertex* vertices[2];
+                JanVertexId vertices[2];
                 vertices[0] = edge->vertices[0];
                 vertices[1] = edge->vertices[1];
-                remove_spoke(edge, vertices[0]);
-                remove_spoke(edge, vertices[1]);
+                remove_spoke(mesh, edge_id, vertices[0]);
+                remove_spoke(mesh, edge_id, vertices[1]);
                 pool_deallocate(&mesh->edge_pool, edge);
                 mesh->edges_count -= 1;
-                if(!vertices[0]->any_edge)
-                {
-                    pool_deallocate(&mesh->vertex_pool, vertices[0]);
-                    mesh->vertices_count -= 1;
-                }
-                if(!vertices[1]->any_edge)
+                for(int i = 0; i < 2; i += 1)
                 {
-                    pool_deallocate(&mesh->vertex_pool, vertices[1]);
-                    mesh->vertices_count -= 1;
+                    JanVertex* vertex = jan_get_vertex(mesh, vertices[i]);
+                    if(!vertex->any_edge.value)
+                    {
+                        pool_deallocate(&mesh->vertex_pool, vertex);
+                        mesh->vertices_count -= 1;
+                    }
                 }
             }
-            link = next;
-        } while(link != first);
+            link_id = next;
+        } while(link_id.value != first.value);
         pool_deallocate(&mesh->border_pool, border);
     }
     pool_deallocate(&mesh->face_pool, face);
@@ -377,53 +568,57 @@ void jan_remove_face_and_its_unlinked_edges_and_vertices(JanMesh* mesh, JanFace*
 
 void jan_remove_edge(JanMesh* mesh, JanEdge* edge)
 {
-    while(edge->any_link)
+    while(edge->any_link.value)
     {
-        jan_remove_face(mesh, edge->any_link->face);
+        JanLink* link = jan_get_link(mesh, edge->any_link);
+        jan_remove_face(mesh, jan_get_face(mesh, link->face));
     }
-    remove_spoke(edge, edge->vertices[0]);
-    remove_spoke(edge, edge->vertices[1]);
+    JanEdgeId edge_id = jan_get_edge_id(mesh, edge);
+    remove_spoke(mesh, edge_id, edge->vertices[0]);
+    remove_spoke(mesh, edge_id, edge->vertices[1]);
     pool_deallocate(&mesh->edge_pool, edge);
     mesh->edges_count -= 1;
 }
 
 void jan_remove_vertex(JanMesh* mesh, JanVertex* vertex)
 {
-    while(vertex->any_edge)
+    while(vertex->any_edge.value)
     {
-        jan_remove_edge(mesh, vertex->any_edge);
+        jan_remove_edge(mesh, jan_get_edge(mesh, vertex->any_edge));
     }
     pool_deallocate(&mesh->vertex_pool, vertex);
     mesh->vertices_count -= 1;
 }
 
-static void reverse_face_winding(JanFace* face)
+static void reverse_face_winding(JanMesh* mesh, JanFace* face)
 {
-    for(JanBorder* border = face->first_border; border; border = border->next)
+    for(JanBorderId border_id = face->first_border; border_id.value; border_id = jan_get_border(mesh, border_id)->next)
     {
-        JanLink* first = border->first;
-        JanLink* link = first;
-        JanLink* prior_next_fin = link->prior->next_fin;
-        JanLink* prior_prior_fin = link->prior->prior_fin;
-        bool boundary_prior = is_boundary(prior_next_fin);
-        JanEdge* prior_edge = link->prior->edge;
+        JanLinkId first = jan_get_border(mesh, border_id)->first;
+        JanLinkId link_id = first;
+        JanLink* prior = jan_get_link(mesh, jan_get_link(mesh, first)->prior);
+        JanLinkId prior_next_fin = prior->next_fin;
+        JanLinkId prior_prior_fin = prior->prior_fin;
+        bool boundary_prior = is_boundary(mesh, prior_next_fin);
+        JanEdgeId prior_edge = prior->edge;
         do
         {
-            JanLink* next_fin = link->next_fin;
-            JanLink* prior_fin = link->prior_fin;
-            bool boundary = is_boundary(next_fin);
+            JanLink* link = jan_get_link(mesh, link_id);
+            JanLinkId next_fin = link->next_fin;
+            JanLinkId prior_fin = link->prior_fin;
+            bool boundary = is_boundary(mesh, next_fin);
 
             // Reverse the fins.
             if(boundary_prior)
             {
-                make_boundary(link);
+                make_boundary(link, link_id);
             }
             else
             {
                 link->next_fin = prior_next_fin;
                 link->prior_fin = prior_prior_fin;
-                prior_next_fin->prior_fin = link;
-                prior_prior_fin->next_fin = link;
+                jan_get_link(mesh, prior_next_fin)->prior_fin = link_id;
+                jan_get_link(mesh, prior_prior_fin)->next_fin = link_id;
             }
             prior_next_fin = next_fin;
             prior_prior_fin = prior_fin;
@@ -431,88 +626,598 @@ static void reverse_face_winding(JanFace* face)
 
             // Rotate the edge's reference to the link loop forward one link
             // and rotate the link's reference backward one edge.
-            JanEdge* edge = link->edge;
-            if(edge->any_link == link)
+            JanEdgeId edge_id = link->edge;
+            JanEdge* edge = jan_get_edge(mesh, edge_id);
+            if(edge->any_link.value == link_id.value)
             {
                 edge->any_link = link->next;
             }
             link->edge = prior_edge;
-            prior_edge = edge;
+            prior_edge = edge_id;
 
             // Reverse the link itself.
-            JanLink* temp = link->next;
+            JanLinkId temp = link->next;
             link->next = link->prior;
             link->prior = temp;
-            link = temp;
-        } while(link != first);
+            link_id = temp;
+        } while(link_id.value != first.value);
     }
 }
 
-static void flip_face_normal(JanFace* face)
+static void flip_face_normal(JanMesh* mesh, JanFace* face)
 {
-    reverse_face_winding(face);
+    reverse_face_winding(mesh, face);
     face->normal = float3_negate(face->normal);
 }
 
-static void compute_vertex_normal(JanVertex* vertex)
+static void compute_face_normal(JanMesh* mesh, JanFace* face)
+{
+    // This uses Newell's Method to compute the polygon normal.
+    JanLinkId first = jan_get_border(mesh, face->first_border)->first;
+    JanLink* link = jan_get_link(mesh, first);
+    JanLink* prior_link = jan_get_link(mesh, link->prior);
+    Float3 prior = jan_get_vertex(mesh, prior_link->vertex)->position;
+    Float3 current = jan_get_vertex(mesh, link->vertex)->position;
+    Float3 normal = float3_zero;
+    JanLinkId link_id;
+    do
+    {
+        normal.x += (prior.y - current.y) * (prior.z + current.z);
+        normal.y += (prior.z - current.z) * (prior.x + current.x);
+        normal.z += (prior.x - current.x) * (prior.y + current.y);
+        prior = current;
+        link_id = link->next;
+        link = jan_get_link(mesh, link_id);
+        current = jan_get_vertex(mesh, link->vertex)->position;
+    } while(link_id.value != first.value);
+
+    // The length of a Newell normal is twice the area of the polygon.
+    float length = float3_length(normal);
+    ASSERT(length != 0.0f);
+    face->area = length / 2.0f;
+    face->normal = float3_divide(normal, length);
+}
+
+// The normals are worked out with the batch functions in polygon_normals.h,
+// over a JanNormalBatch. A face's normal comes from its outer border alone, and
+// then every border of the face carries that normal, so the corners of a hole
+// are weighted by the face's area the same as its outer corners are.
+//
+// If positions is given, the position of each corner is copied into it as
+// the corner is gathered.
+static void gather_face(JanMesh* mesh, JanNormalBatch* batch, JanFace* face, Float3* positions)
 {
-    // This just averages them and does not take into account face area.
-    JanEdge* edge = vertex->any_edge;
-    if(edge)
+    if(batch->out_of_memory)
+    {
+        return;
+    }
+    if(batch->faces_count == batch->faces_cap
+        && !jan_reserve_normal_batch(batch, 2 * batch->faces_cap, batch->polygons_cap, batch->indices_cap))
+    {
+        return;
+    }
+    batch->faces[batch->faces_count] = face;
+    batch->face_polygons[batch->faces_count] = batch->polygons_count;
+    batch->faces_count += 1;
+
+    for(JanBorderId border_id = face->first_border; border_id.value;)
     {
-        JanEdge* first = edge;
-        Float3 normal = float3_zero;
+        if(batch->polygons_count == batch->polygons_cap
+            && !jan_reserve_normal_batch(batch, batch->faces_cap, 2 * batch->polygons_cap, batch->indices_cap))
+        {
+            return;
+        }
+        batch->offsets[batch->polygons_count] = batch->indices_count;
+        batch->polygons_count += 1;
+
+        JanBorder* border = jan_get_border(mesh, border_id);
+        JanLinkId link_id = border->first;
         do
         {
-            JanVertex* other;
-            JanSpoke spoke;
-            if(edge->vertices[0] == vertex)
+            if(batch->indices_count == batch->indices_cap
+                && !jan_reserve_normal_batch(batch, batch->faces_cap, batch->polygons_cap, 2 * batch->indices_cap))
             {
-                other = edge->vertices[1];
-                spoke = edge->spokes[0];
+                return;
             }
-            else
+            JanLink* link = jan_get_link(mesh, link_id);
+            uint32_t index = link->vertex.value - 1;
+            batch->indices[batch->indices_count] = index;
+            batch->indices_count += 1;
+            if(positions)
             {
-                other = edge->vertices[0];
-                spoke = edge->spokes[1];
+                positions[index] = jan_get_vertex(mesh, link->vertex)->position;
             }
-            normal = float3_add(normal, float3_subtract(vertex->position, other->position));
-            edge = spoke.next;
-        } while(edge != first);
-        vertex->normal = float3_normalise(normal);
+            link_id = link->next;
+        } while(link_id.value != border->first.value);
+
+        border_id = border->next;
     }
 }
 
-static void compute_face_normal(JanFace* face)
+static void end_batch(JanNormalBatch* batch)
 {
-    // This uses Newell's Method to compute the polygon normal.
-    JanLink* link = face->first_border->first;
-    JanLink* first = link;
-    Float3 prior = link->prior->vertex->position;
-    Float3 current = link->vertex->position;
-    Float3 normal = float3_zero;
-    do
+    batch->face_polygons[batch->faces_count] = batch->polygons_count;
+    batch->offsets[batch->polygons_count] = batch->indices_count;
+}
+
+static void compute_batch_face_normals(JanNormalBatch* batch, const Float3* positions)
+{
+    end_batch(batch);
+    compute_newell_normals(batch->polygon_normals, positions, batch->indices, batch->offsets, batch->polygons_count);
+
+    for(int i = 0; i < batch->faces_count; i += 1)
     {
-        normal.x += (prior.y - current.y) * (prior.z + current.z);
-        normal.y += (prior.z - current.z) * (prior.x + current.x);
-        normal.z += (prior.x - current.x) * (prior.y + current.y);
-        prior = current;
-        link = link->next;
-        current = link->vertex->position;
-    } while(link != first);
-    face->normal = float3_normalise(normal);
+        JanFace* face = batch->faces[i];
+        int first = batch->face_polygons[i];
+        Float3 normal = batch->polygon_normals[first];
+
+        // The length of a Newell normal is twice the area of the polygon.
+        float length = float3_length(normal);
+        ASSERT(length != 0.0f);
+        face->area = length / 2.0f;
+        face->normal = float3_divide(normal, length);
+
+        for(int j = first + 1; j < batch->face_polygons[i + 1]; j += 1)
+        {
+            batch->polygon_normals[j] = normal;
+        }
+    }
+}
+
+// A face that didn't change already has the right normal and area, so rather
+// than working it out again, its polygons are given the normal at the length
+// a Newell normal would have.
+static void use_stored_face_normals(JanNormalBatch* batch, int first_face)
+{
+    end_batch(batch);
+    for(int i = first_face; i < batch->faces_count; i += 1)
+    {
+        JanFace* face = batch->faces[i];
+        Float3 normal = float3_multiply(2.0f * face->area, face->normal);
+        for(int j = batch->face_polygons[i]; j < batch->face_polygons[i + 1]; j += 1)
+        {
+            batch->polygon_normals[j] = normal;
+        }
+    }
+}
+
+static void add_batch_corner_normals(JanNormalBatch* batch, Float3* vertex_normals, const Float3* positions)
+{
+    add_corner_normals(vertex_normals, batch->polygon_normals, positions, batch->indices, batch->offsets, batch->polygons_count, NORMAL_WEIGHT_AREA);
+}
+
+static bool dirty_lists_overflowed(JanMesh* mesh)
+{
+    return mesh->dirty_vertices.overflowed || mesh->dirty_faces.overflowed;
+}
+
+static void clear_dirty_lists(JanMesh* mesh)
+{
+    if(dirty_lists_overflowed(mesh))
+    {
+        FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+        {
+            vertex->dirty = false;
+        }
+        FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+        {
+            face->dirty = false;
+        }
+        mesh->dirty_vertices.overflowed = false;
+        mesh->dirty_faces.overflowed = false;
+    }
+    for(int i = 0; i < mesh->dirty_vertices.count; i += 1)
+    {
+        JanVertexId id = {mesh->dirty_vertices.values[i]};
+        jan_get_vertex(mesh, id)->dirty = false;
+    }
+    for(int i = 0; i < mesh->dirty_faces.count; i += 1)
+    {
+        JanFaceId id = {mesh->dirty_faces.values[i]};
+        jan_get_face(mesh, id)->dirty = false;
+    }
+    mesh->dirty_vertices.count = 0;
+    mesh->dirty_faces.count = 0;
+}
+
+// If there isn't the memory to update the normals, they're left as they were,
+// and the dirty lists are marked overflowed so that the next update goes over
+// the whole mesh again.
+static void give_up_on_normals(JanMesh* mesh)
+{
+    mesh->dirty_vertices.overflowed = true;
 }
 
 void jan_update_normals(JanMesh* mesh)
 {
-    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    jan_update_normals_with_jobs(mesh, 1);
+}
+
+#define NORMAL_JOBS_CAP 16
+#define NORMAL_JOB_MINIMUM_FACES 8192
+
+typedef struct NormalJob
+{
+    JanMesh* mesh;
+    const Float3* positions;
+    JanNormalBatch batch;
+    uint32_t faces_start;
+    uint32_t faces_end;
+} NormalJob;
+
+static void compute_face_normals_in_range(void* argument)
+{
+    NormalJob* job = (NormalJob*) argument;
+    JanMesh* mesh = job->mesh;
+    FOR_EACH_IN_POOL_RANGE(JanFace, face, mesh->face_pool, job->faces_start, job->faces_end)
     {
-        compute_face_normal(face);
+        gather_face(mesh, &job->batch, face, NULL);
+    }
+    if(!job->batch.out_of_memory)
+    {
+        compute_batch_face_normals(&job->batch, job->positions);
+    }
+}
+
+// Ranges are split on multiples of POOL_RANGE_ALIGNMENT, and the last range
+// runs on past the end of the pool.
+static uint32_t get_range_start(uint32_t count, int job, int jobs_count)
+{
+    if(job == jobs_count)
+    {
+        return UINT32_MAX;
+    }
+    uint32_t start = (uint32_t) ((uint64_t) count * job / jobs_count);
+    return start - (start % POOL_RANGE_ALIGNMENT);
+}
+
+static int get_batch_share(uint32_t count, int jobs_count)
+{
+    int share = (int) (count / jobs_count);
+    if(jobs_count > 1)
+    {
+        share += share / 4;
+    }
+    return share + 64;
+}
+
+// Each face only writes its own normal, so the face pool is split into one
+// range per job, with the calling thread taking the first. A job whose
+// thread can't be started is done on the calling thread instead. Several
+// faces can share a vertex, so adding the face normals to the vertices is
+// left until every job is joined, and done on the calling thread. That's a
+// plain pass through flat arrays, and much quicker than the faces were.
+void jan_update_normals_with_jobs(JanMesh* mesh, int jobs_count)
+{
+    ASSERT(jobs_count >= 1 && jobs_count <= NORMAL_JOBS_CAP);
+
+    uint32_t slots_count = mesh->vertex_pool.object_count;
+    Float3* positions = (Float3*) virtual_allocate(sizeof(Float3) * (slots_count + 1));
+    Float3* vertex_normals = (Float3*) virtual_allocate(sizeof(Float3) * (slots_count + 1));
+    if(!positions || !vertex_normals)
+    {
+        SAFE_VIRTUAL_DEALLOCATE(positions);
+        SAFE_VIRTUAL_DEALLOCATE(vertex_normals);
+        give_up_on_normals(mesh);
+        return;
     }
     FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
     {
-        compute_vertex_normal(vertex);
+        positions[pool_get_index(&mesh->vertex_pool, vertex)] = vertex->position;
+    }
+
+    // The batches start out big enough for an even share of the mesh, with a
+    // quarter to spare when it's split, since a range with fewer gaps in it
+    // holds more faces.
+    int faces_cap = get_batch_share(mesh->face_pool.used_count, jobs_count);
+    int polygons_cap = get_batch_share(mesh->border_pool.used_count, jobs_count);
+    int indices_cap = get_batch_share(mesh->link_pool.used_count, jobs_count);
+
+    NormalJob jobs[NORMAL_JOBS_CAP];
+    for(int i = 0; i < jobs_count; i += 1)
+    {
+        NormalJob job =
+        {
+            .mesh = mesh,
+            .positions = positions,
+            .faces_start = get_range_start(mesh->face_pool.object_count, i, jobs_count),
+            .faces_end = get_range_start(mesh->face_pool.object_count, i + 1, jobs_count),
+        };
+        jobs[i] = job;
+        jan_reserve_normal_batch(&jobs[i].batch, faces_cap, polygons_cap, indices_cap);
+    }
+
+    Thread threads[NORMAL_JOBS_CAP];
+    bool started[NORMAL_JOBS_CAP];
+    for(int i = 1; i < jobs_count; i += 1)
+    {
+        started[i] = thread_create(&threads[i], compute_face_normals_in_range, &jobs[i]);
+        if(!started[i])
+        {
+            compute_face_normals_in_range(&jobs[i]);
+        }
+    }
+
+    compute_face_normals_in_range(&jobs[0]);
+
+    bool out_of_memory = jobs[0].batch.out_of_memory;
+    for(int i = 1; i < jobs_count; i += 1)
+    {
+        if(started[i])
+        {
+            thread_join(&threads[i]);
+        }
+        out_of_memory = out_of_memory || jobs[i].batch.out_of_memory;
+    }
+
+    if(!out_of_memory)
+    {
+        for(int i = 0; i < jobs_count; i += 1)
+        {
+            add_batch_corner_normals(&jobs[i].batch, vertex_normals, positions);
+        }
+        normalise_normals(vertex_normals, (int) slots_count);
+        FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+        {
+            if(vertex->any_edge.value)
+            {
+                vertex->normal = vertex_normals[pool_get_index(&mesh->vertex_pool, vertex)];
+            }
+        }
+    }
+
+    for(int i = 0; i < jobs_count; i += 1)
+    {
+        jan_destroy_normal_batch(&jobs[i].batch);
+    }
+    virtual_deallocate(positions);
+    virtual_deallocate(vertex_normals);
+
+    if(out_of_memory)
+    {
+        give_up_on_normals(mesh);
+        return;
+    }
+    clear_dirty_lists(mesh);
+}
+
+void jan_update_normals_in_parallel(JanMesh* mesh)
+{
+    // Threads are started afresh on each update, which is why every job is
+    // given enough faces that starting its thread is a small part of its time.
+    int jobs_count = get_logical_core_count();
+    int most_jobs = (int) (mesh->face_pool.used_count / NORMAL_JOB_MINIMUM_FACES);
+    if(jobs_count > most_jobs)
+    {
+        jobs_count = most_jobs;
+    }
+    if(jobs_count > NORMAL_JOBS_CAP)
+    {
+        jobs_count = NORMAL_JOBS_CAP;
+    }
+    if(jobs_count <= 1)
+    {
+        jan_update_normals(mesh);
+        return;
+    }
+    jan_update_normals_with_jobs(mesh, jobs_count);
+}
+
+static void mark_faces_on_edge_dirty(JanMesh* mesh, JanEdge* edge)
+{
+    JanLinkId first_fin = edge->any_link;
+    if(!first_fin.value)
+    {
+        return;
+    }
+    JanLinkId fin = first_fin;
+    do
+    {
+        JanLink* link = jan_get_link(mesh, fin);
+        mark_face_dirty(mesh, link->face);
+        fin = link->next_fin;
+    } while(fin.value != first_fin.value);
+}
+
+// A vertex that moved changes the normals of the faces around it, and of the
+// vertices at the other ends of its edges. A face that changed, in turn,
+// changes the normals of its corners. So the dirty vertices are spread out
+// one ring first, and the faces that brings in are spread to their corners,
+// before any normals are worked out.
+static void spread_dirty_vertex(JanMesh* mesh, JanVertexId vertex_id)
+{
+    JanEdgeId first = jan_get_vertex(mesh, vertex_id)->any_edge;
+    if(!first.value)
+    {
+        return;
+    }
+    JanEdgeId edge_id = first;
+    do
+    {
+        JanEdge* edge = jan_get_edge(mesh, edge_id);
+        JanVertexId other = edge->vertices[0].value == vertex_id.value ? edge->vertices[1] : edge->vertices[0];
+        mark_vertex_dirty(mesh, other);
+        mark_faces_on_edge_dirty(mesh, edge);
+        edge_id = jan_get_spoke(edge, vertex_id)->next;
+    } while(edge_id.value != first.value);
+}
+
+static void spread_dirty_face(JanMesh* mesh, JanFace* face)
+{
+    for(JanBorderId border_id = face->first_border; border_id.value;)
+    {
+        JanBorder* border = jan_get_border(mesh, border_id);
+        JanLinkId link_id = border->first;
+        do
+        {
+            JanLink* link = jan_get_link(mesh, link_id);
+            mark_vertex_dirty(mesh, link->vertex);
+            link_id = link->next;
+        } while(link_id.value != border->first.value);
+        border_id = border->next;
+    }
+}
+
+// A vertex's normal needs every face around it, not only the ones that
+// changed, so those are listed too, though their own normals are kept.
+static void mark_faces_around_vertex_dirty(JanMesh* mesh, JanVertexId vertex_id)
+{
+    JanEdgeId first = jan_get_vertex(mesh, vertex_id)->any_edge;
+    if(!first.value)
+    {
+        return;
     }
+    JanEdgeId edge_id = first;
+    do
+    {
+        JanEdge* edge = jan_get_edge(mesh, edge_id);
+        mark_faces_on_edge_dirty(mesh, edge);
+        edge_id = jan_get_spoke(edge, vertex_id)->next;
+    } while(edge_id.value != first.value);
+}
+
+// The faces listed before changed_count changed, and the rest are only
+// around a dirty vertex, so their normals are already right.
+//
+// The mesh's own batch is used, so nothing is allocated unless the edit is
+// bigger than any before it. The vertex arrays are as long as the vertex pool,
+// but memory from the system is only backed once it's touched, so an edit
+// only pays for the slots of the vertices it reaches. Afterwards, the vertex
+// normals it touched are zeroed again, ready for the next update.
+static void update_dirty_normals_in_batch(JanMesh* mesh, int changed_count)
+{
+    JanNormalBatch* batch = &mesh->dirty_batch;
+    batch->faces_count = 0;
+    batch->polygons_count = 0;
+    batch->indices_count = 0;
+    batch->out_of_memory = false;
+
+    int faces_cap = mesh->dirty_faces.count + 64;
+    if(!jan_reserve_normal_slots(batch, mesh->vertex_pool.object_count)
+        || !jan_reserve_normal_batch(batch, faces_cap, faces_cap, 4 * faces_cap))
+    {
+        give_up_on_normals(mesh);
+        return;
+    }
+
+    for(int i = 0; i < changed_count; i += 1)
+    {
+        JanFaceId id = {mesh->dirty_faces.values[i]};
+        JanFace* face = jan_get_face(mesh, id);
+        if(face->dirty)
+        {
+            gather_face(mesh, batch, face, batch->positions);
+        }
+    }
+    if(!batch->out_of_memory)
+    {
+        compute_batch_face_normals(batch, batch->positions);
+    }
+
+    int unchanged_start = batch->faces_count;
+    for(int i = changed_count; i < mesh->dirty_faces.count; i += 1)
+    {
+        JanFaceId id = {mesh->dirty_faces.values[i]};
+        JanFace* face = jan_get_face(mesh, id);
+        if(face->dirty)
+        {
+            gather_face(mesh, batch, face, NULL);
+        }
+    }
+
+    if(!batch->out_of_memory)
+    {
+        use_stored_face_normals(batch, unchanged_start);
+        add_batch_corner_normals(batch, batch->vertex_normals, batch->positions);
+        for(int i = 0; i < mesh->dirty_vertices.count; i += 1)
+        {
+            JanVertexId id = {mesh->dirty_vertices.values[i]};
+            JanVertex* vertex = jan_get_vertex(mesh, id);
+            if(vertex->dirty && vertex->any_edge.value)
+            {
+                Float3 normal = batch->vertex_normals[id.value - 1];
+                normalise_normals(&normal, 1);
+                vertex->normal = normal;
+            }
+        }
+    }
+    for(int i = 0; i < batch->indices_count; i += 1)
+    {
+        batch->vertex_normals[batch->indices[i]] = float3_zero;
+    }
+
+    if(batch->out_of_memory)
+    {
+        give_up_on_normals(mesh);
+        return;
+    }
+    clear_dirty_lists(mesh);
+}
+
+void jan_update_dirty_normals(JanMesh* mesh)
+{
+    // When most of the mesh moved at once, spreading the dirty vertices would
+    // reach nearly everything anyway, so it's quicker to update all of it
+    // across threads.
+    int moved_count = mesh->dirty_vertices.count;
+    if(dirty_lists_overflowed(mesh))
+    {
+        jan_update_normals(mesh);
+        return;
+    }
+    if(moved_count > 0 && 2 * moved_count >= mesh->vertices_count)
+    {
+        jan_update_normals_in_parallel(mesh);
+        return;
+    }
+
+    // Only the vertices that were dirty to begin with are spread, or else
+    // the whole mesh would be reached a ring at a time.
+    for(int i = 0; i < moved_count; i += 1)
+    {
+        JanVertexId id = {mesh->dirty_vertices.values[i]};
+        if(jan_get_vertex(mesh, id)->dirty)
+        {
+            spread_dirty_vertex(mesh, id);
+        }
+    }
+    if(dirty_lists_overflowed(mesh))
+    {
+        jan_update_normals(mesh);
+        return;
+    }
+
+    for(int i = 0; i < mesh->dirty_faces.count; i += 1)
+    {
+        JanFaceId id = {mesh->dirty_faces.values[i]};
+        JanFace* face = jan_get_face(mesh, id);
+        if(face->dirty)
+        {
+            spread_dirty_face(mesh, face);
+        }
+    }
+    if(dirty_lists_overflowed(mesh))
+    {
+        jan_update_normals(mesh);
+        return;
+    }
+
+    int changed_count = mesh->dirty_faces.count;
+    for(int i = 0; i < mesh->dirty_vertices.count; i += 1)
+    {
+        JanVertexId id = {mesh->dirty_vertices.values[i]};
+        if(jan_get_vertex(mesh, id)->dirty)
+        {
+            mark_faces_around_vertex_dirty(mesh, id);
+        }
+    }
+    if(dirty_lists_overflowed(mesh))
+    {
+        jan_update_normals(mesh);
+        return;
+    }
+
+    update_dirty_normals_in_batch(mesh, changed_count);
 }
 
 #define WEIRD_FACE_VERTICES_COUNT 8
@@ -529,15 +1234,15 @@ void jan_make_a_weird_face(JanMesh* mesh, Stack* stack)
     positions[6] = (Float3){{-0.59335f, -0.28583f, 0.0f}};
     positions[7] = (Float3){{-0.05012f, -0.82722f, 0.0f}};
 
-    JanVertex* vertices[WEIRD_FACE_VERTICES_COUNT];
+    JanVertexId vertices[WEIRD_FACE_VERTICES_COUNT];
     for(int i = 0; i < WEIRD_FACE_VERTICES_COUNT; i += 1)
     {
-        vertices[i] = jan_add_vertex(mesh, positions[i]);
+        vertices[i] = add_vertex(mesh, positions[i]);
     }
 
-    JanFace* face = connect_vertices_and_add_face(mesh, vertices, WEIRD_FACE_VERTICES_COUNT, stack);
+    JanFaceId face = connect_vertices_and_add_face(mesh, vertices, WEIRD_FACE_VERTICES_COUNT, stack);
 
-    compute_face_normal(face);
+    compute_face_normal(mesh, jan_get_face(mesh, face));
 }
 
 void jan_make_a_face_with_holes(JanMesh* mesh, Stack* stack)
@@ -553,15 +1258,15 @@ void jan_make_a_face_with_holes(JanMesh* mesh, Stack* stack)
         {{+0.000000f, -1.000000f, 0.0f}},
     };
 
-    JanVertex* vertices[7];
+    JanVertexId vertices[7];
     for(int i = 0; i < 7; i += 1)
     {
-        vertices[i] = jan_add_vertex(mesh, positions[i]);
+        vertices[i] = add_vertex(mesh, positions[i]);
     }
 
-    JanFace* face = connect_vertices_and_add_face(mesh, vertices, 7, stack);
+    JanFaceId face = connect_vertices_and_add_face(mesh, vertices, 7, stack);
 
-    compute_face_normal(face);
+    compute_face_normal(mesh, jan_get_face(mesh, face));
 
     Float3 hole0_positions[5] =
     {
@@ -574,7 +1279,7 @@ void jan_make_a_face_with_holes(JanMesh* mesh, Stack* stack)
 
     for(int i = 0; i < 5; i += 1)
     {
-        vertices[i] = jan_add_vertex(mesh, hole0_positions[i]);
+        vertices[i] = add_vertex(mesh, hole0_positions[i]);
     }
 
     connect_vertices_and_add_hole(mesh, face, vertices, 5, stack);
@@ -590,7 +1295,7 @@ void jan_make_a_face_with_holes(JanMesh* mesh, Stack* stack)
 
     for(int i = 0; i < 5; i += 1)
     {
-        vertices[i] = jan_add_vertex(mesh, hole1_positions[i]);
+        vertices[i] = add_vertex(mesh, hole1_positions[i]);
     }
 
     connect_vertices_and_add_hole(mesh, face, vertices, 5, stack);
@@ -603,19 +1308,23 @@ void jan_move_faces(JanMesh* mesh, JanSelection* selection, Float3 translation)
     FOR_ALL(JanPart, selection->parts)
     {
         JanFace* face = it->face;
-        for(JanBorder* border = face->first_border; border; border = border->next)
+        for(JanBorderId border_id = face->first_border; border_id.value;)
         {
-            JanLink* first = border->first;
-            JanLink* link = first;
+            JanBorder* border = jan_get_border(mesh, border_id);
+            JanLinkId link_id = border->first;
             do
             {
-                link->vertex->position = float3_add(link->vertex->position, translation);
-                link = link->next;
-            } while(link != first);
+                JanLink* link = jan_get_link(mesh, link_id);
+                JanVertex* vertex = jan_get_vertex(mesh, link->vertex);
+                vertex->position = float3_add(vertex->position, translation);
+                mark_vertex_dirty(mesh, link->vertex);
+                link_id = link->next;
+            } while(link_id.value != border->first.value);
+            border_id = border->next;
         }
     }
 
-    jan_update_normals(mesh);
+    jan_update_dirty_normals(mesh);
 }
 
 void jan_flip_face_normals(JanMesh* mesh, JanSelection* selection)
@@ -624,15 +1333,18 @@ void jan_flip_face_normals(JanMesh* mesh, JanSelection* selection)
 
     FOR_ALL(JanPart, selection->parts)
     {
-        flip_face_normal(it->face);
+        flip_face_normal(mesh, it->face);
+        mark_face_dirty(mesh, jan_get_face_id(mesh, it->face));
     }
+
+    jan_update_dirty_normals(mesh);
 }
 
-static bool is_edge_on_selection_boundary(JanSelection* selection, JanLink* link)
+static bool is_edge_on_selection_boundary(JanMesh* mesh, JanSelection* selection, JanLink* link)
 {
-    for(JanLink* fin = link->next_fin; fin != link; fin = fin->next_fin)
+    for(JanLink* fin = jan_get_link(mesh, link->next_fin); fin != link; fin = jan_get_link(mesh, fin->next_fin))
     {
-        if(jan_face_selected(selection, fin->face))
+        if(jan_face_selected(selection, jan_get_face(mesh, fin->face)))
         {
             return false;
         }
@@ -663,51 +1375,72 @@ void jan_extrude(JanMesh* mesh, JanSelection* selection, float distance, Heap* h
         JanFace* face = it->face;
 
         // @Incomplete: Holes in faces aren't yet supported!
-        ASSERT(!face->first_border->next);
+        ASSERT(!jan_get_border(mesh, face->first_border)->next.value);
 
-        JanLink* first = face->first_border->first;
-        JanLink* link = first;
-        do
+        // Look up the doubles of all the face's vertices at once. Any that
+        // are added along the way are stored back, so that the next edge
+        // sees them, and mapped together once the face is done.
+        const int vertices_count = face->edges;
+        JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, vertices_count);
+        MaybePointer* doubles = STACK_ALLOCATE(stack, MaybePointer, vertices_count);
+        JanVertex** added = STACK_ALLOCATE(stack, JanVertex*, vertices_count);
+        JanVertex** added_doubles = STACK_ALLOCATE(stack, JanVertex*, vertices_count);
+        int added_count = 0;
+
+        JanLink* link = jan_get_link(mesh, jan_get_border(mesh, face->first_border)->first);
+        for(int j = 0; j < vertices_count; j += 1)
+        {
+            vertices[j] = jan_get_vertex(mesh, link->vertex);
+            link = jan_get_link(mesh, link->next);
+        }
+        map_get_many(&map, (void**) vertices, doubles, vertices_count);
+
+        for(int j = 0; j < vertices_count; j += 1, link = jan_get_link(mesh, link->next))
         {
-            if(is_edge_on_selection_boundary(selection, link))
+            if(!is_edge_on_selection_boundary(mesh, selection, link))
             {
-                // Add vertices only where they haven't been added already.
-                JanVertex* start = link->vertex;
-                MaybePointer start_result = map_get(&map, start);
-                if(!start_result.valid)
-                {
-                    Float3 position = float3_add(start->position, extrusion);
-                    JanVertex* vertex = jan_add_vertex(mesh, position);
-                    jan_add_edge(mesh, start, vertex);
-                    map_add(&map, start, vertex, heap);
-                }
-                JanVertex* end = link->next->vertex;
-                MaybePointer end_result = map_get(&map, end);
-                if(!end_result.valid)
+                continue;
+            }
+
+            // Add vertices only where they haven't been added already.
+            int ends[2] = {j, (j + 1) % vertices_count};
+            for(int k = 0; k < 2; k += 1)
+            {
+                int end = ends[k];
+                if(!doubles[end].valid)
                 {
-                    Float3 position = float3_add(end->position, extrusion);
-                    JanVertex* vertex = jan_add_vertex(mesh, position);
-                    jan_add_edge(mesh, end, vertex);
-                    map_add(&map, end, vertex, heap);
+                    JanVertex* vertex = vertices[end];
+                    Float3 position = float3_add(vertex->position, extrusion);
+                    JanVertex* double_vertex = jan_add_vertex(mesh, position);
+                    jan_add_edge(mesh, vertex, double_vertex);
+                    doubles[end].value = double_vertex;
+                    doubles[end].valid = true;
+                    added[added_count] = vertex;
+                    added_doubles[added_count] = double_vertex;
+                    added_count += 1;
                 }
-
-                // Add the extruded side face for this edge.
-                JanVertex* vertices[4];
-                vertices[0] = start;
-                vertices[1] = end;
-                MaybePointer result2 = map_get(&map, end);
-                vertices[2] = (JanVertex*) result2.value;
-                MaybePointer result3 = map_get(&map, start);
-                vertices[3] = (JanVertex*) result3.value;
-                JanEdge* edges[4];
-                edges[0] = link->edge;
-                edges[1] = vertices[2]->any_edge;
-                edges[2] = jan_add_edge(mesh, vertices[2], vertices[3]);
-                edges[3] = vertices[3]->any_edge;
-                jan_add_face(mesh, vertices, edges, 4);
             }
-            link = link->next;
-        } while(link != first);
+
+            // Add the extruded side face for this edge.
+            JanVertex* side[4];
+            side[0] = vertices[ends[0]];
+            side[1] = vertices[ends[1]];
+            side[2] = (JanVertex*) doubles[ends[1]].value;
+            side[3] = (JanVertex*) doubles[ends[0]].value;
+            JanEdge* edges[4];
+            edges[0] = jan_get_edge(mesh, link->edge);
+            edges[1] = jan_get_edge(mesh, side[2]->any_edge);
+            edges[2] = jan_add_edge(mesh, side[2], side[3]);
+            edges[3] = jan_get_edge(mesh, side[3]->any_edge);
+            jan_add_face(mesh, side, edges, 4);
+        }
+
+        map_add_many(&map, (void**) added, (void**) added_doubles, added_count, heap);
+
+        STACK_DEALLOCATE(stack, added_doubles);
+        STACK_DEALLOCATE(stack, added);
+        STACK_DEALLOCATE(stack, doubles);
+        STACK_DEALLOCATE(stack, vertices);
     }
 
     FOR_ALL(JanPart, selection->parts)
@@ -715,17 +1448,23 @@ void jan_extrude(JanMesh* mesh, JanSelection* selection, float distance, Heap* h
         JanFace* face = it->face;
 
         // @Incomplete: Holes in faces aren't yet supported!
-        ASSERT(!face->first_border->next);
+        ASSERT(!jan_get_border(mesh, face->first_border)->next.value);
 
         const int vertices_count = face->edges;
         JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, vertices_count);
-        JanLink* link = face->first_border->first;
+        MaybePointer* results = STACK_ALLOCATE(stack, MaybePointer, vertices_count);
+        JanLink* link = jan_get_link(mesh, jan_get_border(mesh, face->first_border)->first);
+        for(int j = 0; j < vertices_count; j += 1)
+        {
+            vertices[j] = jan_get_vertex(mesh, link->vertex);
+            link = jan_get_link(mesh, link->next);
+        }
+        map_get_many(&map, (void**) vertices, results, vertices_count);
         for(int j = 0; j < vertices_count; j += 1)
         {
-            MaybePointer result = map_get(&map, link->vertex);
-            vertices[j] = (JanVertex*) result.value;
-            link = link->next;
+            vertices[j] = (JanVertex*) results[j].value;
         }
+        STACK_DEALLOCATE(stack, results);
         jan_connect_disconnected_vertices_and_add_face(mesh, vertices, vertices_count, stack);
         jan_remove_face_and_its_unlinked_edges_and_vertices(mesh, face);
         STACK_DEALLOCATE(stack, vertices);
@@ -733,20 +1472,22 @@ void jan_extrude(JanMesh* mesh, JanSelection* selection, float distance, Heap* h
 
     map_destroy(&map, heap);
 
-    jan_update_normals(mesh);
+    jan_update_dirty_normals(mesh);
 }
 
-void jan_colour_just_the_one_face(JanFace* face, Float3 colour)
+void jan_colour_just_the_one_face(JanMesh* mesh, JanFace* face, Float3 colour)
 {
-    for(JanBorder* border = face->first_border; border; border = border->next)
+    for(JanBorderId border_id = face->first_border; border_id.value;)
     {
-        JanLink* first = border->first;
-        JanLink* link = first;
+        JanBorder* border = jan_get_border(mesh, border_id);
+        JanLinkId link_id = border->first;
         do
         {
+            JanLink* link = jan_get_link(mesh, link_id);
             link->colour = colour;
-            link = link->next;
-        } while(link != first);
+            link_id = link->next;
+        } while(link_id.value != border->first.value);
+        border_id = border->next;
     }
 }
 
@@ -764,7 +1505,7 @@ void jan_colour_selection(JanMesh* mesh, JanSelection* selection, Float3 colour)
     {
         FOR_ALL(JanPart, selection->parts)
         {
-            jan_colour_just_the_one_face(it->face, colour);
+            jan_colour_just_the_one_face(mesh, it->face, colour);
         }
     }
 }
@@ -15,25 +15,55 @@ typedef struct JanMesh JanMesh;
 typedef struct JanSpoke JanSpoke;
 typedef struct JanVertex JanVertex;
 
+// Elements refer to each other by their index in the mesh's pools, instead of
+// by pointer. An id is half the size of a pointer, and since it doesn't depend
+// on where the pools are in memory, a mesh can be copied or saved just by
+// copying its pools. An id with a value of zero refers to nothing.
+typedef struct JanBorderId
+{
+    uint32_t value;
+} JanBorderId;
+
+typedef struct JanEdgeId
+{
+    uint32_t value;
+} JanEdgeId;
+
+typedef struct JanFaceId
+{
+    uint32_t value;
+} JanFaceId;
+
+typedef struct JanLinkId
+{
+    uint32_t value;
+} JanLinkId;
+
+typedef struct JanVertexId
+{
+    uint32_t value;
+} JanVertexId;
+
 struct JanVertex
 {
     Float3 position;
     Float3 normal;
-    JanEdge* any_edge;
+    JanEdgeId any_edge;
+    bool dirty;
 };
 
 // Spokes are for navigating edges that all meet at the same vertex "hub".
 struct JanSpoke
 {
-    JanEdge* next;
-    JanEdge* prior;
+    JanEdgeId next;
+    JanEdgeId prior;
 };
 
 struct JanEdge
 {
     JanSpoke spokes[2];
-    JanVertex* vertices[2];
-    JanLink* any_link;
+    JanVertexId vertices[2];
+    JanLinkId any_link;
     bool sharp;
 };
 
@@ -42,34 +72,75 @@ struct JanEdge
 struct JanLink
 {
     Float3 colour;
-    JanLink* next;
-    JanLink* prior;
-    JanLink* next_fin;
-    JanLink* prior_fin;
-    JanVertex* vertex;
-    JanEdge* edge;
-    JanFace* face;
+    JanLinkId next;
+    JanLinkId prior;
+    JanLinkId next_fin;
+    JanLinkId prior_fin;
+    JanVertexId vertex;
+    JanEdgeId edge;
+    JanFaceId face;
 };
 
 // A Border corresponds to a boundary edge. So, either an outer edge of a face
 // or an edge of a hole in a face.
 struct JanBorder
 {
-    JanBorder* next;
-    JanBorder* prior;
-    JanLink* first;
-    JanLink* last;
+    JanBorderId next;
+    JanBorderId prior;
+    JanLinkId first;
+    JanLinkId last;
 };
 
 struct JanFace
 {
     Float3 normal;
-    JanBorder* first_border;
-    JanBorder* last_border;
+    float area;
+    JanBorderId first_border;
+    JanBorderId last_border;
     int edges;
     int borders_count;
+    bool dirty;
 };
 
+// The ids of the elements whose normals are out of date. An element's dirty
+// flag is set while it's listed, so that it's only listed once. An element
+// removed while it's listed leaves its id behind, but since a removed element
+// has its flag cleared, the id is skipped.
+//
+// If a list can't grow, it's marked overflowed, and the next update goes over
+// the whole mesh instead, since some flagged elements aren't listed.
+typedef struct JanDirtyList
+{
+    uint32_t* values;
+    int count;
+    int cap;
+    bool overflowed;
+} JanDirtyList;
+
+// The flat arrays that normals are worked out in, with each border of a face
+// gathered as a polygon of vertex indices. The vertex arrays have a slot for
+// every index in the vertex pool. A mesh keeps the batch that updating its
+// dirty normals uses from one update to the next, like the dirty lists, so
+// that a small edit doesn't have to ask the system for memory each time.
+typedef struct JanNormalBatch
+{
+    JanFace** faces;
+    int* face_polygons;
+    Float3* polygon_normals;
+    int* offsets;
+    uint32_t* indices;
+    Float3* positions;
+    Float3* vertex_normals;
+    int faces_count;
+    int faces_cap;
+    int polygons_count;
+    int polygons_cap;
+    int indices_count;
+    int indices_cap;
+    uint32_t slots_cap;
+    bool out_of_memory;
+} JanNormalBatch;
+
 struct JanMesh
 {
     Pool face_pool;
@@ -77,6 +148,9 @@ struct JanMesh
     Pool vertex_pool;
     Pool link_pool;
     Pool border_pool;
+    JanDirtyList dirty_vertices;
+    JanDirtyList dirty_faces;
+    JanNormalBatch dirty_batch;
     int faces_count;
     int edges_count;
     int vertices_count;
@@ -106,8 +180,24 @@ typedef struct JanSelection
     JanSelectionType type;
 } JanSelection;
 
+extern const JanBorderId jan_border_none;
+extern const JanEdgeId jan_edge_none;
+extern const JanFaceId jan_face_none;
+extern const JanLinkId jan_link_none;
+extern const JanVertexId jan_vertex_none;
+
 void jan_create_mesh(JanMesh* mesh);
 void jan_destroy_mesh(JanMesh* mesh);
+JanBorder* jan_get_border(JanMesh* mesh, JanBorderId id);
+JanEdge* jan_get_edge(JanMesh* mesh, JanEdgeId id);
+JanFace* jan_get_face(JanMesh* mesh, JanFaceId id);
+JanLink* jan_get_link(JanMesh* mesh, JanLinkId id);
+JanVertex* jan_get_vertex(JanMesh* mesh, JanVertexId id);
+JanBorderId jan_get_border_id(JanMesh* mesh, JanBorder* border);
+JanEdgeId jan_get_edge_id(JanMesh* mesh, JanEdge* edge);
+JanFaceId jan_get_face_id(JanMesh* mesh, JanFace* face);
+JanLinkId jan_get_link_id(JanMesh* mesh, JanLink* link);
+JanVertexId jan_get_vertex_id(JanMesh* mesh, JanVertex* vertex);
 JanVertex* jan_add_vertex(JanMesh* mesh, Float3 position);
 JanEdge* jan_add_edge(JanMesh* mesh, JanVertex* start, JanVertex* end);
 void jan_add_and_link_border(JanMesh* mesh, JanFace* face, JanVertex** vertices, JanEdge** edges, int edges_count);
@@ -118,17 +208,22 @@ void jan_remove_edge(JanMesh* mesh, JanEdge* edge);
 void jan_remove_face(JanMesh* mesh, JanFace* face);
 void jan_remove_face_and_its_unlinked_edges_and_vertices(JanMesh* mesh, JanFace* face);
 void jan_update_normals(JanMesh* mesh);
+void jan_update_normals_in_parallel(JanMesh* mesh);
+void jan_update_dirty_normals(JanMesh* mesh);
 void jan_make_a_weird_face(JanMesh* mesh, Stack* stack);
 void jan_make_a_face_with_holes(JanMesh* mesh, Stack* stack);
-void jan_colour_just_the_one_face(JanFace* face, Float3 colour);
+void jan_colour_just_the_one_face(JanMesh* mesh, JanFace* face, Float3 colour);
 void jan_colour_all_faces(JanMesh* mesh, Float3 colour);
 void jan_colour_selection(JanMesh* mesh, JanSelection* selection, Float3 colour);
 void jan_move_faces(JanMesh* mesh, JanSelection* selection, Float3 translation);
 void jan_flip_face_normals(JanMesh* mesh, JanSelection* selection);
 void jan_extrude(JanMesh* mesh, JanSelection* selection, float distance, Heap* heap, Stack* stack);
 
+#include "jan_build.h"
+#include "jan_compact.h"
 #include "jan_copy.h"
 #include "jan_selection.h"
+#include "jan_snapshot.h"
 #include "jan_triangulate.h"
 
 #endif // JAN_H_
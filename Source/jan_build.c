@@ -0,0 +1,343 @@
+#include "jan.h"
+
+#include "assert.h"
+#include "jan_internal.h"
+#include "platform_definitions.h"
+#include "polygon_normals.h"
+#include "typed_map.h"
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
+// This is how many faces ahead the edge lookups prefetch.
+#define PREFETCH_FACES 4
+
+// Building from indices knows every element up front, so instead of adding
+// them one at a time, each pool is sized once and filled in order. Element i
+// of each kind then has the id i + 1. Vertex i is position i, face i is
+// polygon i with a single border, also numbered i, and link i is corner i.
+// Only the edges aren't given, and those are found by looking up the pair of
+// vertices at either end of each side.
+
+// An edge is keyed on the vertices at its ends, smallest first, so that it's
+// found whichever way around a face goes over it.
+typedef struct VertexPair
+{
+    uint32_t first;
+    uint32_t second;
+} VertexPair;
+
+static VertexPair make_vertex_pair(uint32_t a, uint32_t b)
+{
+    VertexPair pair;
+    pair.first = (a < b) ? a : b;
+    pair.second = (a < b) ? b : a;
+    return pair;
+}
+
+static uint32_t hash_vertex_pair(VertexPair pair)
+{
+    uint64_t key = ((uint64_t) pair.first << 32) | pair.second;
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    return (uint32_t) key;
+}
+
+static bool vertex_pairs_equal(VertexPair a, VertexPair b)
+{
+    return a.first == b.first && a.second == b.second;
+}
+
+DEFINE_MAP(EdgeNumberMap, VertexPair, uint32_t, hash_vertex_pair, vertex_pairs_equal, edge_number);
+
+typedef struct EdgeEnds
+{
+    uint32_t start;
+    uint32_t end;
+} EdgeEnds;
+
+static void create_exact_pool(Pool* pool, uint32_t object_size, int count, uint32_t minimum_count)
+{
+    uint32_t cap = (uint32_t) count;
+    if(cap < minimum_count)
+    {
+        cap = minimum_count;
+    }
+    pool_create(pool, object_size, cap);
+    pool_set_tag(pool, MEMORY_TAG_MESH);
+}
+
+// The pools are new and hold exactly enough, so each kind of element fits in
+// one run with the ids counting up from one. Objects in a run are spaced by
+// the pool's object size, which can be larger than the type, so a run is
+// indexed through RUN_AT rather than as an array.
+typedef struct Run
+{
+    uint8_t* memory;
+    uint32_t stride;
+} Run;
+
+#define RUN_AT(type, run, index) \
+    ((type*) ((run).memory + (uint64_t) (run).stride * (index)))
+
+static Run allocate_run(Pool* pool, int count)
+{
+    Run run = {NULL, pool->object_size};
+    if(count > 0)
+    {
+        run.memory = (uint8_t*) pool_allocate_run(pool, (uint32_t) count);
+        ASSERT(run.memory && pool_get_index(pool, run.memory) == 0);
+    }
+    return run;
+}
+
+static void prefetch(const void* address)
+{
+#if defined(COMPILER_MSVC)
+    _mm_prefetch((const char*) address, _MM_HINT_T0);
+#elif defined(COMPILER_GCC)
+    __builtin_prefetch(address);
+#endif
+}
+
+// Each lookup in a map too big for the cache is a miss, so the slots that the
+// sides of a face coming up will probe first are fetched ahead of time.
+static void prefetch_face_edges(EdgeNumberMap* map, const int* face_offsets, const uint32_t* face_indices, int face)
+{
+    int first = face_offsets[face];
+    int last = face_offsets[face + 1] - 1;
+    int mask = map->cap - 1;
+    for(int j = first; j <= last; j += 1)
+    {
+        uint32_t start = face_indices[j];
+        uint32_t end = face_indices[(j < last) ? j + 1 : first];
+        int slot = map_hash_edge_number(make_vertex_pair(start, end)) & mask;
+        prefetch(&map->hashes[slot]);
+        prefetch(&map->keys[slot]);
+    }
+}
+
+// Give each side of each face the number of its edge, adding an edge the first
+// time a pair of vertices is seen. Edges take the direction of the side that
+// added them, the same as jan_add_edge.
+static int number_edges(uint32_t* side_edges, EdgeEnds* ends, const int* face_offsets, const uint32_t* face_indices, int faces_count, Heap* heap)
+{
+    int indices_count = face_offsets[faces_count];
+
+    // A closed mesh has about half as many edges as sides, which keeps the
+    // map at most half full. An open one grows it as needed.
+    EdgeNumberMap map;
+    map_create_edge_number(&map, indices_count, heap);
+
+    int edges_count = 0;
+    for(int i = 0; i < faces_count; i += 1)
+    {
+        if(i + PREFETCH_FACES < faces_count)
+        {
+            prefetch_face_edges(&map, face_offsets, face_indices, i + PREFETCH_FACES);
+        }
+        int first = face_offsets[i];
+        int last = face_offsets[i + 1] - 1;
+        for(int j = first; j <= last; j += 1)
+        {
+            uint32_t start = face_indices[j];
+            uint32_t end = face_indices[(j < last) ? j + 1 : first];
+            // Only a caller that didn't check its faces can get here.
+            ASSERT(start != end);
+            VertexPair pair = make_vertex_pair(start, end);
+            uint32_t* found = map_get_edge_number(&map, pair);
+            if(found)
+            {
+                side_edges[j] = *found;
+            }
+            else
+            {
+                side_edges[j] = (uint32_t) edges_count;
+                ends[edges_count].start = start;
+                ends[edges_count].end = end;
+                map_add_edge_number(&map, pair, (uint32_t) edges_count, heap);
+                edges_count += 1;
+            }
+        }
+    }
+
+    map_destroy_edge_number(&map, heap);
+
+    return edges_count;
+}
+
+// This is the same as adding a spoke while editing, except that nothing is
+// marked dirty, since the normals are computed for everything at the end.
+static void link_spoke(Run edges, Run vertices, JanEdgeId edge_id, JanVertexId vertex_id)
+{
+    JanVertex* vertex = RUN_AT(JanVertex, vertices, vertex_id.value - 1);
+    JanSpoke* spoke = jan_get_spoke(RUN_AT(JanEdge, edges, edge_id.value - 1), vertex_id);
+    JanEdgeId existing_id = vertex->any_edge;
+    if(existing_id.value)
+    {
+        JanSpoke* existing = jan_get_spoke(RUN_AT(JanEdge, edges, existing_id.value - 1), vertex_id);
+        jan_get_spoke(RUN_AT(JanEdge, edges, existing->prior.value - 1), vertex_id)->next = edge_id;
+        spoke->next = existing_id;
+        spoke->prior = existing->prior;
+        existing->prior = edge_id;
+    }
+    else
+    {
+        vertex->any_edge = edge_id;
+        spoke->next = edge_id;
+        spoke->prior = edge_id;
+    }
+}
+
+static void link_fin(Run links, JanEdge* edge, JanLinkId link_id)
+{
+    JanLink* link = RUN_AT(JanLink, links, link_id.value - 1);
+    JanLinkId existing_id = edge->any_link;
+    if(existing_id.value)
+    {
+        JanLink* existing = RUN_AT(JanLink, links, existing_id.value - 1);
+        link->prior_fin = existing_id;
+        link->next_fin = existing->next_fin;
+        RUN_AT(JanLink, links, existing->next_fin.value - 1)->prior_fin = link_id;
+        existing->next_fin = link_id;
+    }
+    else
+    {
+        link->next_fin = link_id;
+        link->prior_fin = link_id;
+    }
+    edge->any_link = link_id;
+}
+
+static void add_vertices(Run vertices, const Float3* positions, int positions_count)
+{
+    for(int i = 0; i < positions_count; i += 1)
+    {
+        RUN_AT(JanVertex, vertices, i)->position = positions[i];
+    }
+}
+
+static void add_edges(Run edges, Run vertices, const EdgeEnds* ends, int edges_count)
+{
+    for(int i = 0; i < edges_count; i += 1)
+    {
+        JanEdge* edge = RUN_AT(JanEdge, edges, i);
+        JanEdgeId edge_id = {(uint32_t) i + 1};
+        JanVertexId start = {ends[i].start + 1};
+        JanVertexId end = {ends[i].end + 1};
+        edge->vertices[0] = start;
+        edge->vertices[1] = end;
+        link_spoke(edges, vertices, edge_id, start);
+        link_spoke(edges, vertices, edge_id, end);
+    }
+}
+
+// The links of a face are consecutive, so each one's neighbours in its border
+// are found by arithmetic rather than by chaining them as they're added.
+static void add_faces(Run faces, Run borders, Run links, Run edges, const int* face_offsets, const uint32_t* face_indices, const uint32_t* side_edges, int faces_count)
+{
+    for(int i = 0; i < faces_count; i += 1)
+    {
+        JanFaceId face_id = {(uint32_t) i + 1};
+        JanBorderId border_id = {(uint32_t) i + 1};
+        int first = face_offsets[i];
+        int last = face_offsets[i + 1] - 1;
+        JanLinkId first_link = {(uint32_t) first + 1};
+        JanLinkId last_link = {(uint32_t) last + 1};
+
+        JanFace* face = RUN_AT(JanFace, faces, i);
+        face->first_border = border_id;
+        face->last_border = border_id;
+        face->edges = last - first + 1;
+        face->borders_count = 1;
+
+        JanBorder* border = RUN_AT(JanBorder, borders, i);
+        border->first = first_link;
+        border->last = last_link;
+
+        for(int j = first; j <= last; j += 1)
+        {
+            JanLink* link = RUN_AT(JanLink, links, j);
+            JanLinkId link_id = {(uint32_t) j + 1};
+            link->next.value = (j < last) ? link_id.value + 1 : first_link.value;
+            link->prior.value = (j > first) ? link_id.value - 1 : last_link.value;
+            link->vertex.value = face_indices[j] + 1;
+            link->edge.value = side_edges[j] + 1;
+            link->face = face_id;
+            link_fin(links, RUN_AT(JanEdge, edges, side_edges[j]), link_id);
+        }
+    }
+}
+
+// The normals come out the same as jan_update_normals gives, short of
+// rounding, with the face normals normalised and the vertex normals weighted
+// by area. Faces with no area are left without a normal, rather than failing
+// the assertion that editing would, since an import can't be fixed up first.
+static void compute_normals(Run faces, Run vertices, const Float3* positions, int positions_count, const int* face_offsets, const uint32_t* face_indices, int faces_count, Heap* heap)
+{
+    Float3* face_normals = HEAP_ALLOCATE(heap, Float3, faces_count + 1);
+    Float3* vertex_normals = HEAP_ALLOCATE(heap, Float3, positions_count + 1);
+
+    compute_newell_normals(face_normals, positions, face_indices, face_offsets, faces_count);
+    zero_memory(vertex_normals, sizeof(Float3) * positions_count);
+    add_corner_normals(vertex_normals, face_normals, positions, face_indices, face_offsets, faces_count, NORMAL_WEIGHT_AREA);
+    normalise_normals(vertex_normals, positions_count);
+
+    for(int i = 0; i < faces_count; i += 1)
+    {
+        float length = float3_length(face_normals[i]);
+        JanFace* face = RUN_AT(JanFace, faces, i);
+        face->area = length / 2.0f;
+        face->normal = (length != 0.0f) ? float3_divide(face_normals[i], length) : float3_zero;
+    }
+    for(int i = 0; i < positions_count; i += 1)
+    {
+        RUN_AT(JanVertex, vertices, i)->normal = vertex_normals[i];
+    }
+
+    HEAP_DEALLOCATE(heap, face_normals);
+    HEAP_DEALLOCATE(heap, vertex_normals);
+}
+
+// Polygon i runs through face_indices[face_offsets[i]] up to, but not
+// including, face_indices[face_offsets[i + 1]], the same layout as the batch
+// normal functions take. Every face needs at least three sides, with no side
+// starting and ending at the same vertex. Data from a file has to be checked
+// for that beforehand, as obj_load_file does.
+void jan_build_mesh_from_indexed(JanMesh* mesh, const Float3* positions, int positions_count, const int* face_offsets, const uint32_t* face_indices, int faces_count, Heap* heap)
+{
+    int indices_count = face_offsets[faces_count];
+
+    uint32_t* side_edges = HEAP_ALLOCATE(heap, uint32_t, indices_count + 1);
+    EdgeEnds* ends = HEAP_ALLOCATE(heap, EdgeEnds, indices_count + 1);
+    int edges_count = number_edges(side_edges, ends, face_offsets, face_indices, faces_count, heap);
+
+    create_exact_pool(&mesh->face_pool, sizeof(JanFace), faces_count, 64);
+    create_exact_pool(&mesh->edge_pool, sizeof(JanEdge), edges_count, 64);
+    create_exact_pool(&mesh->vertex_pool, sizeof(JanVertex), positions_count, 64);
+    create_exact_pool(&mesh->link_pool, sizeof(JanLink), indices_count, 128);
+    create_exact_pool(&mesh->border_pool, sizeof(JanBorder), faces_count, 64);
+    zero_memory(&mesh->dirty_vertices, sizeof(mesh->dirty_vertices));
+    zero_memory(&mesh->dirty_faces, sizeof(mesh->dirty_faces));
+    zero_memory(&mesh->dirty_batch, sizeof(mesh->dirty_batch));
+    mesh->faces_count = faces_count;
+    mesh->edges_count = edges_count;
+    mesh->vertices_count = positions_count;
+
+    Run vertices = allocate_run(&mesh->vertex_pool, positions_count);
+    Run edges = allocate_run(&mesh->edge_pool, edges_count);
+    Run faces = allocate_run(&mesh->face_pool, faces_count);
+    Run borders = allocate_run(&mesh->border_pool, faces_count);
+    Run links = allocate_run(&mesh->link_pool, indices_count);
+
+    add_vertices(vertices, positions, positions_count);
+    add_edges(edges, vertices, ends, edges_count);
+    add_faces(faces, borders, links, edges, face_offsets, face_indices, side_edges, faces_count);
+
+    HEAP_DEALLOCATE(heap, side_edges);
+    HEAP_DEALLOCATE(heap, ends);
+
+    compute_normals(faces, vertices, positions, positions_count, face_offsets, face_indices, faces_count, heap);
+}
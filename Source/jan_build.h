@@ -0,0 +1,6 @@
+#ifndef JAN_BUILD_H_
+#define JAN_BUILD_H_
+
+void jan_build_mesh_from_indexed(JanMesh* mesh, const Float3* positions, int positions_count, const int* face_offsets, const uint32_t* face_indices, int faces_count, Heap* heap);
+
+#endif // JAN_BUILD_H_
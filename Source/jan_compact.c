@@ -0,0 +1,193 @@
+#include "jan.h"
+
+#include "assert.h"
+#include "jan_internal.h"
+
+// Compaction copies every live element into new pools and then rebases the ids
+// between them. Once an element is copied, the start of its old slot is
+// overwritten with the id of the copy. The old pools are thrown away afterward,
+// so this stands in for a map from old ids to new ones.
+static uint32_t forward(Pool* pool, uint32_t value)
+{
+    return value ? *((uint32_t*) pool_get_object(pool, value - 1)) : 0;
+}
+
+#define FORWARD(pool, id) \
+    (id).value = forward(pool, (id).value)
+
+static void* move_element(Pool* pool, void* element)
+{
+    void* moved = pool_allocate(pool);
+    copy_memory(moved, element, pool->object_size);
+    *((uint32_t*) element) = pool_get_index(pool, moved) + 1;
+    return moved;
+}
+
+static void create_compact_pool(Pool* pool, Pool* prior, uint32_t minimum_count)
+{
+    uint32_t count = prior->used_count;
+    if(count < minimum_count)
+    {
+        count = minimum_count;
+    }
+    pool_create(pool, prior->object_size, count);
+    pool_set_tag(pool, prior->tag);
+}
+
+static void rebase_vertex(JanMesh* mesh, JanVertex* vertex)
+{
+    FORWARD(&mesh->edge_pool, vertex->any_edge);
+}
+
+static void rebase_edge(JanMesh* mesh, JanEdge* edge)
+{
+    for(int i = 0; i < 2; i += 1)
+    {
+        FORWARD(&mesh->edge_pool, edge->spokes[i].next);
+        FORWARD(&mesh->edge_pool, edge->spokes[i].prior);
+        FORWARD(&mesh->vertex_pool, edge->vertices[i]);
+    }
+    FORWARD(&mesh->link_pool, edge->any_link);
+}
+
+static void rebase_link(JanMesh* mesh, JanLink* link)
+{
+    FORWARD(&mesh->link_pool, link->next);
+    FORWARD(&mesh->link_pool, link->prior);
+    FORWARD(&mesh->link_pool, link->next_fin);
+    FORWARD(&mesh->link_pool, link->prior_fin);
+    FORWARD(&mesh->vertex_pool, link->vertex);
+    FORWARD(&mesh->edge_pool, link->edge);
+    FORWARD(&mesh->face_pool, link->face);
+}
+
+static void rebase_border(JanMesh* mesh, JanBorder* border)
+{
+    FORWARD(&mesh->border_pool, border->next);
+    FORWARD(&mesh->border_pool, border->prior);
+    FORWARD(&mesh->link_pool, border->first);
+    FORWARD(&mesh->link_pool, border->last);
+}
+
+static void rebase_face(JanMesh* mesh, JanFace* face)
+{
+    FORWARD(&mesh->border_pool, face->first_border);
+    FORWARD(&mesh->border_pool, face->last_border);
+}
+
+// Each listed element's flag is cleared in its old slot as it's carried over,
+// so that an id listed twice, once left behind by a removed element and once
+// for whatever took its slot, is only carried over once. An overflowed list
+// stays overflowed, since the flags of unlisted elements were moved with them.
+static void forward_dirty_vertices(JanMesh* compact, JanMesh* mesh)
+{
+    compact->dirty_vertices.overflowed = mesh->dirty_vertices.overflowed;
+    for(int i = 0; i < mesh->dirty_vertices.count; i += 1)
+    {
+        JanVertexId id = {mesh->dirty_vertices.values[i]};
+        JanVertex* vertex = jan_get_vertex(mesh, id);
+        if(vertex->dirty)
+        {
+            vertex->dirty = false;
+            FORWARD(&mesh->vertex_pool, id);
+            jan_add_to_dirty_list(&compact->dirty_vertices, id.value);
+        }
+    }
+}
+
+static void forward_dirty_faces(JanMesh* compact, JanMesh* mesh)
+{
+    compact->dirty_faces.overflowed = mesh->dirty_faces.overflowed;
+    for(int i = 0; i < mesh->dirty_faces.count; i += 1)
+    {
+        JanFaceId id = {mesh->dirty_faces.values[i]};
+        JanFace* face = jan_get_face(mesh, id);
+        if(face->dirty)
+        {
+            face->dirty = false;
+            FORWARD(&mesh->face_pool, id);
+            jan_add_to_dirty_list(&compact->dirty_faces, id.value);
+        }
+    }
+}
+
+void jan_compact_mesh(JanMesh* mesh)
+{
+    JanMesh compact;
+    create_compact_pool(&compact.face_pool, &mesh->face_pool, 64);
+    create_compact_pool(&compact.edge_pool, &mesh->edge_pool, 64);
+    create_compact_pool(&compact.vertex_pool, &mesh->vertex_pool, 64);
+    create_compact_pool(&compact.link_pool, &mesh->link_pool, 128);
+    create_compact_pool(&compact.border_pool, &mesh->border_pool, 64);
+    zero_memory(&compact.dirty_vertices, sizeof(compact.dirty_vertices));
+    zero_memory(&compact.dirty_faces, sizeof(compact.dirty_faces));
+    zero_memory(&compact.dirty_batch, sizeof(compact.dirty_batch));
+    compact.faces_count = mesh->faces_count;
+    compact.edges_count = mesh->edges_count;
+    compact.vertices_count = mesh->vertices_count;
+
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    {
+        move_element(&compact.vertex_pool, vertex);
+    }
+
+    FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
+    {
+        move_element(&compact.edge_pool, edge);
+    }
+
+    // Borders and links are placed in the order they're walked from their
+    // face, so that going around a face reads memory in a straight line. The
+    // walk goes through the copies, because the start of each old slot no
+    // longer holds what it did.
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        JanFace* moved_face = (JanFace*) move_element(&compact.face_pool, face);
+        JanBorderId border_id = moved_face->first_border;
+        while(border_id.value)
+        {
+            JanBorder* border = jan_get_border(mesh, border_id);
+            JanBorder* moved_border = (JanBorder*) move_element(&compact.border_pool, border);
+            JanLinkId first = moved_border->first;
+            JanLinkId link_id = first;
+            do
+            {
+                JanLink* link = jan_get_link(mesh, link_id);
+                JanLink* moved_link = (JanLink*) move_element(&compact.link_pool, link);
+                link_id = moved_link->next;
+            } while(link_id.value != first.value);
+            border_id = moved_border->next;
+        }
+    }
+
+    // Every link and border belongs to a face, so all of them should have
+    // been reached.
+    ASSERT(compact.link_pool.used_count == mesh->link_pool.used_count);
+    ASSERT(compact.border_pool.used_count == mesh->border_pool.used_count);
+
+    FOR_EACH_IN_POOL(JanVertex, vertex, compact.vertex_pool)
+    {
+        rebase_vertex(mesh, vertex);
+    }
+    FOR_EACH_IN_POOL(JanEdge, edge, compact.edge_pool)
+    {
+        rebase_edge(mesh, edge);
+    }
+    FOR_EACH_IN_POOL(JanLink, link, compact.link_pool)
+    {
+        rebase_link(mesh, link);
+    }
+    FOR_EACH_IN_POOL(JanBorder, border, compact.border_pool)
+    {
+        rebase_border(mesh, border);
+    }
+    FOR_EACH_IN_POOL(JanFace, face, compact.face_pool)
+    {
+        rebase_face(mesh, face);
+    }
+    forward_dirty_vertices(&compact, mesh);
+    forward_dirty_faces(&compact, mesh);
+
+    jan_destroy_mesh(mesh);
+    *mesh = compact;
+}
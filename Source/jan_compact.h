@@ -0,0 +1,6 @@
+#ifndef JAN_COMPACT_H_
+#define JAN_COMPACT_H_
+
+void jan_compact_mesh(JanMesh* mesh);
+
+#endif // JAN_COMPACT_H_
@@ -2,128 +2,69 @@
 
 #include "assert.h"
 #include "jan_internal.h"
-#include "map.h"
 
-static JanFace* copy_face_and_first_border(JanMesh* copy, JanFace* face, Map* vertex_map, Map* edge_map, Stack* stack)
+// Elements refer to each other by their indices in the pools, so if every copy
+// lands at the same index as its original, the copies can be taken byte for
+// byte and still refer to each other.
+//
+// A new pool hands out indices in order. So the copy allocates every index up
+// to the last live one, and then gives back the ones that were free in the
+// original.
+static void copy_pool(Pool* copy, Pool* original, Heap* heap)
 {
-    JanBorder* border = face->first_border;
+    uint32_t gaps_cap = original->object_count - original->used_count;
+    void** gaps = HEAP_ALLOCATE(heap, void*, gaps_cap + 1);
+    uint32_t gaps_count = 0;
 
-    int count = jan_count_border_edges(border);
-    JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, count);
-    JanEdge** edges = STACK_ALLOCATE(stack, JanEdge*, count);
-
-    int i = 0;
-    JanLink* first = border->first;
-    JanLink* link = first;
-    do
+    uint32_t next_index = 0;
+    FOR_EACH_IN_POOL(void, object, *original)
     {
-        MaybePointer vertex_result = map_get(vertex_map, link->vertex);
-        MaybePointer edge_result = map_get(edge_map, link->edge);
-        vertices[i] = (JanVertex*) vertex_result.value;
-        edges[i] = (JanEdge*) edge_result.value;
-        i += 1;
-        link = link->next;
-    } while(link != first);
-
-    JanFace* added = jan_add_face(copy, vertices, edges, count);
-
-    STACK_DEALLOCATE(stack, edges);
-    STACK_DEALLOCATE(stack, vertices);
-
-    return added;
-}
+        uint32_t index = pool_get_index(original, object);
+        for(; next_index < index; next_index += 1)
+        {
+            ASSERT(gaps_count < gaps_cap);
+            gaps[gaps_count] = pool_allocate(copy);
+            gaps_count += 1;
+        }
 
-static void copy_border(JanMesh* copy, JanFace* added, JanBorder* border, Map* vertex_map, Map* edge_map, Stack* stack)
-{
-    int count = jan_count_border_edges(border);
-    JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, count);
-    JanEdge** edges = STACK_ALLOCATE(stack, JanEdge*, count);
+        void* added = pool_allocate(copy);
+        ASSERT(pool_get_index(copy, added) == index);
+        copy_memory(added, object, original->object_size);
+        next_index = index + 1;
+    }
 
-    int i = 0;
-    JanLink* first = border->first;
-    JanLink* link = first;
-    do
+    for(uint32_t i = 0; i < gaps_count; i += 1)
     {
-        MaybePointer vertex_result = map_get(vertex_map, link->vertex);
-        MaybePointer edge_result = map_get(edge_map, link->edge);
-        vertices[i] = (JanVertex*) vertex_result.value;
-        edges[i] = (JanEdge*) edge_result.value;
-        i += 1;
-        link = link->next;
-    } while(link != first);
-
-    jan_add_and_link_border(copy, added, vertices, edges, count);
-
-    STACK_DEALLOCATE(stack, edges);
-    STACK_DEALLOCATE(stack, vertices);
-}
+        pool_deallocate(copy, gaps[i]);
+    }
 
-static void copy_link(JanLink* link, JanLink* from)
-{
-    link->colour = from->colour;
+    HEAP_DEALLOCATE(heap, gaps);
 }
 
-static void copy_face_links(JanFace* added, JanFace* face)
+// The dirty flags come along with the bytes of each element, so the lists only
+// have to be copied to match.
+static void copy_dirty_list(JanDirtyList* copy, JanDirtyList* original)
 {
-    JanBorder* added_border = added->first_border;
-    JanBorder* face_border = face->first_border;
-    while(face_border)
+    copy->overflowed = original->overflowed;
+    for(int i = 0; i < original->count; i += 1)
     {
-        JanLink* added_link = added_border->first;
-        JanLink* face_first = face_border->first;
-        JanLink* face_link = face_first;
-        do
-        {
-            copy_link(added_link, face_link);
-            added_link = added_link->next;
-            face_link = face_link->next;
-        } while(face_link != face_first);
-
-        added_border = added_border->next;
-        face_border = face_border->next;
+        jan_add_to_dirty_list(copy, original->values[i]);
     }
 }
 
-void jan_copy_mesh(JanMesh* copy, JanMesh* original, Heap* heap, Stack* stack)
+void jan_copy_mesh(JanMesh* copy, JanMesh* original, Heap* heap)
 {
     jan_create_mesh(copy);
 
-    Map vertex_map;
-    map_create(&vertex_map, original->vertices_count, heap);
-    Map edge_map;
-    map_create(&edge_map, original->edges_count, heap);
-
-    FOR_EACH_IN_POOL(JanVertex, vertex, original->vertex_pool)
-    {
-        JanVertex* added = jan_add_vertex(copy, vertex->position);
-        map_add(&vertex_map, vertex, added, heap);
-    }
-
-    FOR_EACH_IN_POOL(JanEdge, edge, original->edge_pool)
-    {
-        MaybePointer results[2];
-        results[0] = map_get(&vertex_map, edge->vertices[0]);
-        results[1] = map_get(&vertex_map, edge->vertices[1]);
-        JanVertex* vertices[2];
-        vertices[0] = (JanVertex*) results[0].value;
-        vertices[1] = (JanVertex*) results[1].value;
-        JanEdge* added = jan_add_edge(copy, vertices[0], vertices[1]);
-        map_add(&edge_map, edge, added, heap);
-    }
-
-    FOR_EACH_IN_POOL(JanFace, face, original->face_pool)
-    {
-        JanFace* added = copy_face_and_first_border(copy, face, &vertex_map, &edge_map, stack);
-
-        JanBorder* border = face->first_border;
-        for(border = border->next; border; border = border->next)
-        {
-            copy_border(copy, added, border, &vertex_map, &edge_map, stack);
-        }
-
-        copy_face_links(added, face);
-    }
-
-    map_destroy(&vertex_map, heap);
-    map_destroy(&edge_map, heap);
+    copy_pool(&copy->face_pool, &original->face_pool, heap);
+    copy_pool(&copy->edge_pool, &original->edge_pool, heap);
+    copy_pool(&copy->vertex_pool, &original->vertex_pool, heap);
+    copy_pool(&copy->link_pool, &original->link_pool, heap);
+    copy_pool(&copy->border_pool, &original->border_pool, heap);
+    copy_dirty_list(&copy->dirty_vertices, &original->dirty_vertices);
+    copy_dirty_list(&copy->dirty_faces, &original->dirty_faces);
+
+    copy->faces_count = original->faces_count;
+    copy->edges_count = original->edges_count;
+    copy->vertices_count = original->vertices_count;
 }
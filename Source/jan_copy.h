@@ -1,6 +1,6 @@
 #ifndef JAN_COPY_H_
 #define JAN_COPY_H_
 
-void jan_copy_mesh(JanMesh* copy, JanMesh* original, Heap* heap, Stack* stack);
+void jan_copy_mesh(JanMesh* copy, JanMesh* original, Heap* heap);
 
 #endif // JAN_COPY_H_
@@ -1,38 +1,161 @@
 #include "jan.h"
 #include "jan_internal.h"
 
-int jan_count_border_edges(JanBorder* border)
+#include "assert.h"
+
+// The lists and batches get their memory straight from the system, like the
+// pools do, so that a mesh doesn't need a heap to be edited.
+void jan_add_to_dirty_list(JanDirtyList* list, uint32_t value)
+{
+    if(list->count == list->cap)
+    {
+        int cap = list->cap ? 2 * list->cap : 1024;
+        uint32_t* values = (uint32_t*) virtual_allocate(sizeof(uint32_t) * cap);
+        if(!values)
+        {
+            list->overflowed = true;
+            return;
+        }
+        if(list->values)
+        {
+            copy_memory(values, list->values, sizeof(uint32_t) * list->count);
+            virtual_deallocate(list->values);
+        }
+        list->values = values;
+        list->cap = cap;
+    }
+    list->values[list->count] = value;
+    list->count += 1;
+}
+
+void jan_destroy_dirty_list(JanDirtyList* list)
+{
+    SAFE_VIRTUAL_DEALLOCATE(list->values);
+    list->count = 0;
+    list->cap = 0;
+    list->overflowed = false;
+}
+
+// There's room in each array for one more element than the cap, for the
+// offset that ends the last face or polygon.
+static bool grow_batch_array(void** array, int count, int cap, size_t element_bytes)
+{
+    void* grown = virtual_allocate(element_bytes * (cap + 1));
+    if(!grown)
+    {
+        return false;
+    }
+    if(*array)
+    {
+        copy_memory(grown, *array, element_bytes * count);
+        virtual_deallocate(*array);
+    }
+    *array = grown;
+    return true;
+}
+
+bool jan_reserve_normal_batch(JanNormalBatch* batch, int faces_cap, int polygons_cap, int indices_cap)
+{
+    if(faces_cap > batch->faces_cap)
+    {
+        if(!grow_batch_array((void**) &batch->faces, batch->faces_count, faces_cap, sizeof(JanFace*))
+            || !grow_batch_array((void**) &batch->face_polygons, batch->faces_count, faces_cap, sizeof(int)))
+        {
+            batch->out_of_memory = true;
+            return false;
+        }
+        batch->faces_cap = faces_cap;
+    }
+    if(polygons_cap > batch->polygons_cap)
+    {
+        if(!grow_batch_array((void**) &batch->polygon_normals, batch->polygons_count, polygons_cap, sizeof(Float3))
+            || !grow_batch_array((void**) &batch->offsets, batch->polygons_count, polygons_cap, sizeof(int)))
+        {
+            batch->out_of_memory = true;
+            return false;
+        }
+        batch->polygons_cap = polygons_cap;
+    }
+    if(indices_cap > batch->indices_cap)
+    {
+        if(!grow_batch_array((void**) &batch->indices, batch->indices_count, indices_cap, sizeof(uint32_t)))
+        {
+            batch->out_of_memory = true;
+            return false;
+        }
+        batch->indices_cap = indices_cap;
+    }
+    return true;
+}
+
+// The vertex arrays aren't copied when they grow, since they only hold
+// anything during an update. Fresh memory from the system is zeroed, which is
+// what the vertex normals have to start out as.
+bool jan_reserve_normal_slots(JanNormalBatch* batch, uint32_t slots_cap)
+{
+    if(slots_cap > batch->slots_cap)
+    {
+        SAFE_VIRTUAL_DEALLOCATE(batch->positions);
+        SAFE_VIRTUAL_DEALLOCATE(batch->vertex_normals);
+        batch->slots_cap = 0;
+        batch->positions = (Float3*) virtual_allocate(sizeof(Float3) * slots_cap);
+        batch->vertex_normals = (Float3*) virtual_allocate(sizeof(Float3) * slots_cap);
+        if(!batch->positions || !batch->vertex_normals)
+        {
+            SAFE_VIRTUAL_DEALLOCATE(batch->positions);
+            SAFE_VIRTUAL_DEALLOCATE(batch->vertex_normals);
+            batch->out_of_memory = true;
+            return false;
+        }
+        batch->slots_cap = slots_cap;
+    }
+    return true;
+}
+
+void jan_destroy_normal_batch(JanNormalBatch* batch)
+{
+    SAFE_VIRTUAL_DEALLOCATE(batch->faces);
+    SAFE_VIRTUAL_DEALLOCATE(batch->face_polygons);
+    SAFE_VIRTUAL_DEALLOCATE(batch->polygon_normals);
+    SAFE_VIRTUAL_DEALLOCATE(batch->offsets);
+    SAFE_VIRTUAL_DEALLOCATE(batch->indices);
+    SAFE_VIRTUAL_DEALLOCATE(batch->positions);
+    SAFE_VIRTUAL_DEALLOCATE(batch->vertex_normals);
+    zero_memory(batch, sizeof(*batch));
+}
+
+int jan_count_border_edges(JanMesh* mesh, JanBorder* border)
 {
     int count = 0;
-    JanLink* first = border->first;
-    JanLink* link = first;
+    JanLinkId first = border->first;
+    JanLinkId link = first;
     do
     {
         count += 1;
-        link = link->next;
-    } while(link != first);
+        link = jan_get_link(mesh, link)->next;
+    } while(link.value != first.value);
     return count;
 }
 
-int jan_count_face_borders(JanFace* face)
+int jan_count_face_borders(JanMesh* mesh, JanFace* face)
 {
     int count = 0;
-    for(JanBorder* border = face->first_border; border; border = border->next)
+    for(JanBorderId border = face->first_border; border.value; border = jan_get_border(mesh, border)->next)
     {
         count += 1;
     }
     return count;
 }
 
-bool jan_edge_contains_vertex(JanEdge* edge, JanVertex* vertex)
+bool jan_edge_contains_vertex(JanEdge* edge, JanVertexId vertex)
 {
-    return edge->vertices[0] == vertex
-        || edge->vertices[1] == vertex;
+    return edge->vertices[0].value == vertex.value
+        || edge->vertices[1].value == vertex.value;
 }
 
-JanSpoke* jan_get_spoke(JanEdge* edge, JanVertex* vertex)
+JanSpoke* jan_get_spoke(JanEdge* edge, JanVertexId vertex)
 {
-    if(edge->vertices[0] == vertex)
+    if(edge->vertices[0].value == vertex.value)
     {
         return &edge->spokes[0];
     }
@@ -1,9 +1,15 @@
 #ifndef JAN_INTERNAL_H_
 #define JAN_INTERNAL_H_
 
-int jan_count_border_edges(JanBorder* border);
-int jan_count_face_borders(JanFace* face);
-bool jan_edge_contains_vertex(JanEdge* edge, JanVertex* vertex);
-JanSpoke* jan_get_spoke(JanEdge* edge, JanVertex* vertex);
+void jan_add_to_dirty_list(JanDirtyList* list, uint32_t value);
+void jan_destroy_dirty_list(JanDirtyList* list);
+bool jan_reserve_normal_batch(JanNormalBatch* batch, int faces_cap, int polygons_cap, int indices_cap);
+bool jan_reserve_normal_slots(JanNormalBatch* batch, uint32_t slots_cap);
+void jan_destroy_normal_batch(JanNormalBatch* batch);
+int jan_count_border_edges(JanMesh* mesh, JanBorder* border);
+int jan_count_face_borders(JanMesh* mesh, JanFace* face);
+bool jan_edge_contains_vertex(JanEdge* edge, JanVertexId vertex);
+JanSpoke* jan_get_spoke(JanEdge* edge, JanVertexId vertex);
+void jan_update_normals_with_jobs(JanMesh* mesh, int jobs_count);
 
 #endif // JAN_INTERNAL_H_
@@ -0,0 +1,228 @@
+#include "jan.h"
+
+#include "assert.h"
+
+// Elements removed since the snapshot was built leave gaps in the pools, so
+// the tables from pool index to dense number mark those as missing.
+static void fill_missing(int* numbers, int count)
+{
+    for(int i = 0; i < count; i += 1)
+    {
+        numbers[i] = -1;
+    }
+}
+
+static void allocate_arrays(JanMeshSnapshot* snapshot, Heap* heap)
+{
+    int vertices_count = snapshot->vertices_count;
+    int faces_count = snapshot->faces_count;
+    int edges_count = snapshot->edges_count;
+
+    // Every array gets at least one element, since an empty mesh would
+    // otherwise ask the heap for nothing.
+    snapshot->positions = HEAP_ALLOCATE(heap, Float3, vertices_count + 1);
+    snapshot->normals = HEAP_ALLOCATE(heap, Float3, vertices_count + 1);
+    snapshot->vertex_ids = HEAP_ALLOCATE(heap, JanVertexId, vertices_count + 1);
+    snapshot->face_normals = HEAP_ALLOCATE(heap, Float3, faces_count + 1);
+    snapshot->face_ids = HEAP_ALLOCATE(heap, JanFaceId, faces_count + 1);
+    snapshot->face_offsets = HEAP_ALLOCATE(heap, int, faces_count + 1);
+    snapshot->border_offsets = HEAP_ALLOCATE(heap, int, snapshot->borders_count + 1);
+    snapshot->indices = HEAP_ALLOCATE(heap, uint32_t, snapshot->indices_count + 1);
+    snapshot->edges = HEAP_ALLOCATE(heap, uint32_t, 2 * edges_count + 1);
+    snapshot->edge_ids = HEAP_ALLOCATE(heap, JanEdgeId, edges_count + 1);
+    snapshot->vertex_numbers = HEAP_ALLOCATE(heap, int, snapshot->vertex_numbers_count + 1);
+    snapshot->face_numbers = HEAP_ALLOCATE(heap, int, snapshot->face_numbers_count + 1);
+}
+
+static void copy_vertices(JanMeshSnapshot* snapshot, JanMesh* mesh)
+{
+    fill_missing(snapshot->vertex_numbers, snapshot->vertex_numbers_count);
+
+    int number = 0;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    {
+        JanVertexId id = jan_get_vertex_id(mesh, vertex);
+        snapshot->positions[number] = vertex->position;
+        snapshot->normals[number] = vertex->normal;
+        snapshot->vertex_ids[number] = id;
+        snapshot->vertex_numbers[id.value - 1] = number;
+        number += 1;
+    }
+    ASSERT(number == snapshot->vertices_count);
+}
+
+static void copy_faces(JanMeshSnapshot* snapshot, JanMesh* mesh)
+{
+    fill_missing(snapshot->face_numbers, snapshot->face_numbers_count);
+
+    int number = 0;
+    int border_number = 0;
+    int index = 0;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        JanFaceId id = jan_get_face_id(mesh, face);
+        snapshot->face_normals[number] = face->normal;
+        snapshot->face_ids[number] = id;
+        snapshot->face_offsets[number] = border_number;
+        snapshot->face_numbers[id.value - 1] = number;
+
+        for(JanBorderId border_id = face->first_border; border_id.value;)
+        {
+            JanBorder* border = jan_get_border(mesh, border_id);
+            snapshot->border_offsets[border_number] = index;
+            JanLinkId first = border->first;
+            JanLinkId link_id = first;
+            do
+            {
+                JanLink* link = jan_get_link(mesh, link_id);
+                snapshot->indices[index] = (uint32_t) snapshot->vertex_numbers[link->vertex.value - 1];
+                index += 1;
+                link_id = link->next;
+            } while(link_id.value != first.value);
+            border_number += 1;
+            border_id = border->next;
+        }
+
+        number += 1;
+    }
+    ASSERT(number == snapshot->faces_count);
+    ASSERT(border_number == snapshot->borders_count);
+    ASSERT(index == snapshot->indices_count);
+
+    snapshot->face_offsets[number] = border_number;
+    snapshot->border_offsets[border_number] = index;
+}
+
+static void copy_edges(JanMeshSnapshot* snapshot, JanMesh* mesh)
+{
+    int number = 0;
+    FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
+    {
+        snapshot->edges[2 * number] = (uint32_t) snapshot->vertex_numbers[edge->vertices[0].value - 1];
+        snapshot->edges[2 * number + 1] = (uint32_t) snapshot->vertex_numbers[edge->vertices[1].value - 1];
+        snapshot->edge_ids[number] = jan_get_edge_id(mesh, edge);
+        number += 1;
+    }
+    ASSERT(number == snapshot->edges_count);
+}
+
+void jan_create_snapshot(JanMeshSnapshot* snapshot)
+{
+    zero_memory(snapshot, sizeof(*snapshot));
+}
+
+// Every element is in one pool or another, and every link is in exactly one
+// border, so the size of each array is known before any of them are filled,
+// and each is filled in a single pass through its pool.
+void jan_build_snapshot(JanMeshSnapshot* snapshot, JanMesh* mesh, Heap* heap)
+{
+    jan_destroy_snapshot(snapshot, heap);
+
+    snapshot->vertices_count = (int) mesh->vertex_pool.used_count;
+    snapshot->faces_count = (int) mesh->face_pool.used_count;
+    snapshot->borders_count = (int) mesh->border_pool.used_count;
+    snapshot->indices_count = (int) mesh->link_pool.used_count;
+    snapshot->edges_count = (int) mesh->edge_pool.used_count;
+    snapshot->vertex_numbers_count = (int) mesh->vertex_pool.object_count;
+    snapshot->face_numbers_count = (int) mesh->face_pool.object_count;
+
+    allocate_arrays(snapshot, heap);
+
+    copy_vertices(snapshot, mesh);
+    copy_faces(snapshot, mesh);
+    copy_edges(snapshot, mesh);
+}
+
+void jan_destroy_snapshot(JanMeshSnapshot* snapshot, Heap* heap)
+{
+    if(snapshot)
+    {
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->positions);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->normals);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->vertex_ids);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->face_normals);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->face_ids);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->face_offsets);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->border_offsets);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->indices);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->edges);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->edge_ids);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->vertex_numbers);
+        SAFE_HEAP_DEALLOCATE(heap, snapshot->face_numbers);
+        snapshot->vertices_count = 0;
+        snapshot->faces_count = 0;
+        snapshot->borders_count = 0;
+        snapshot->indices_count = 0;
+        snapshot->edges_count = 0;
+        snapshot->vertex_numbers_count = 0;
+        snapshot->face_numbers_count = 0;
+    }
+}
+
+// Patching only copies over what can change without the topology changing,
+// which is a vertex's position and normal, or a face's normal. If the element
+// isn't in the snapshot, because it was added since it was built, the
+// snapshot has to be built again.
+bool jan_patch_snapshot_vertex(JanMeshSnapshot* snapshot, JanMesh* mesh, JanVertex* vertex)
+{
+    JanVertexId id = jan_get_vertex_id(mesh, vertex);
+    int index = (int) id.value - 1;
+    if(index >= snapshot->vertex_numbers_count || snapshot->vertex_numbers[index] < 0)
+    {
+        return false;
+    }
+
+    int number = snapshot->vertex_numbers[index];
+    snapshot->positions[number] = vertex->position;
+    snapshot->normals[number] = vertex->normal;
+
+    return true;
+}
+
+bool jan_patch_snapshot_face(JanMeshSnapshot* snapshot, JanMesh* mesh, JanFace* face)
+{
+    JanFaceId id = jan_get_face_id(mesh, face);
+    int index = (int) id.value - 1;
+    if(index >= snapshot->face_numbers_count || snapshot->face_numbers[index] < 0)
+    {
+        return false;
+    }
+
+    snapshot->face_normals[snapshot->face_numbers[index]] = face->normal;
+
+    return true;
+}
+
+// A face's normal is the sum of the Newell normals of all of its borders. Its
+// holes lie in the same plane as its outer border, so they don't change which
+// way it points, and every corner of the face, holes included, gets its
+// normal.
+void jan_compute_snapshot_normals(JanMeshSnapshot* snapshot, NormalWeight weight, Heap* heap)
+{
+    Float3* border_normals = HEAP_ALLOCATE(heap, Float3, snapshot->borders_count + 1);
+    compute_newell_normals(border_normals, snapshot->positions, snapshot->indices, snapshot->border_offsets, snapshot->borders_count);
+
+    for(int i = 0; i < snapshot->faces_count; i += 1)
+    {
+        int first = snapshot->face_offsets[i];
+        int last = snapshot->face_offsets[i + 1];
+        Float3 normal = border_normals[first];
+        for(int j = first + 1; j < last; j += 1)
+        {
+            normal = float3_add(normal, border_normals[j]);
+        }
+        snapshot->face_normals[i] = normal;
+        for(int j = first; j < last; j += 1)
+        {
+            border_normals[j] = normal;
+        }
+    }
+
+    zero_memory(snapshot->normals, sizeof(Float3) * snapshot->vertices_count);
+    add_corner_normals(snapshot->normals, border_normals, snapshot->positions, snapshot->indices, snapshot->border_offsets, snapshot->borders_count, weight);
+
+    normalise_normals(snapshot->face_normals, snapshot->faces_count);
+    normalise_normals(snapshot->normals, snapshot->vertices_count);
+
+    HEAP_DEALLOCATE(heap, border_normals);
+}
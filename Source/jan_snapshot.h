@@ -0,0 +1,47 @@
+#ifndef JAN_SNAPSHOT_H_
+#define JAN_SNAPSHOT_H_
+
+#include "polygon_normals.h"
+
+// A snapshot is a flat copy of the parts of a mesh that are read the most, laid
+// out as a structure of arrays, so that passes which only read the mesh run
+// through contiguous memory instead of chasing ids across five pools.
+//
+// Vertices, faces and edges are numbered densely in the order of their pools.
+// Each face's borders are found through face_offsets, and each border's
+// vertices through border_offsets, with the outer border first.
+//
+// jan_build_snapshot frees whatever arrays the snapshot already holds, so a
+// snapshot has to be made empty with jan_create_snapshot before it's built the
+// first time.
+typedef struct JanMeshSnapshot
+{
+    Float3* positions;
+    Float3* normals;
+    JanVertexId* vertex_ids;
+    Float3* face_normals;
+    JanFaceId* face_ids;
+    int* face_offsets;
+    int* border_offsets;
+    uint32_t* indices;
+    uint32_t* edges;
+    JanEdgeId* edge_ids;
+    int* vertex_numbers;
+    int* face_numbers;
+    int vertices_count;
+    int faces_count;
+    int borders_count;
+    int indices_count;
+    int edges_count;
+    int vertex_numbers_count;
+    int face_numbers_count;
+} JanMeshSnapshot;
+
+void jan_create_snapshot(JanMeshSnapshot* snapshot);
+void jan_build_snapshot(JanMeshSnapshot* snapshot, JanMesh* mesh, Heap* heap);
+void jan_destroy_snapshot(JanMeshSnapshot* snapshot, Heap* heap);
+bool jan_patch_snapshot_vertex(JanMeshSnapshot* snapshot, JanMesh* mesh, JanVertex* vertex);
+bool jan_patch_snapshot_face(JanMeshSnapshot* snapshot, JanMesh* mesh, JanFace* face);
+void jan_compute_snapshot_normals(JanMeshSnapshot* snapshot, NormalWeight weight, Heap* heap);
+
+#endif // JAN_SNAPSHOT_H_
@@ -86,7 +86,7 @@ Pointcloud jan_make_pointcloud(JanMesh* mesh, Heap* heap, PointcloudSpec* spec)
     return pointcloud;
 }
 
-static void add_edge_to_wireframe(JanEdge* edge, Float4 colour, Heap* heap,
+static void add_edge_to_wireframe(JanMesh* mesh, JanEdge* edge, Float4 colour, Heap* heap,
         Wireframe* wireframe)
 {
     LineVertex* vertices = wireframe->vertices;
@@ -101,8 +101,8 @@ static void add_edge_to_wireframe(JanEdge* edge, Float4 colour, Heap* heap,
     };
     uint32_t colour_value = rgba_to_u32(colour);
 
-    JanVertex* vertex = edge->vertices[0];
-    JanVertex* other = edge->vertices[1];
+    JanVertex* vertex = jan_get_vertex(mesh, edge->vertices[0]);
+    JanVertex* other = jan_get_vertex(mesh, edge->vertices[1]);
 
     Float3 start = vertex->position;
     Float3 end = other->position;
@@ -143,17 +143,17 @@ Wireframe jan_make_wireframe(JanMesh* mesh, Heap* heap, WireframeSpec* spec)
         {
             if(edge == spec->hovered)
             {
-                add_edge_to_wireframe(edge, spec->hover_colour, heap,
+                add_edge_to_wireframe(mesh, edge, spec->hover_colour, heap,
                         &wireframe);
             }
             else if(jan_edge_selected(spec->selection, edge))
             {
-                add_edge_to_wireframe(edge, spec->select_colour, heap,
+                add_edge_to_wireframe(mesh, edge, spec->select_colour, heap,
                         &wireframe);
             }
             else
             {
-                add_edge_to_wireframe(edge, spec->colour, heap, &wireframe);
+                add_edge_to_wireframe(mesh, edge, spec->colour, heap, &wireframe);
             }
         }
     }
@@ -161,7 +161,7 @@ Wireframe jan_make_wireframe(JanMesh* mesh, Heap* heap, WireframeSpec* spec)
     {
         FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
         {
-            add_edge_to_wireframe(edge, spec->colour, heap, &wireframe);
+            add_edge_to_wireframe(mesh, edge, spec->colour, heap, &wireframe);
         }
     }
 
@@ -375,25 +375,30 @@ static bool is_right(FlatLoop l0, FlatLoop l1)
 
 DEFINE_QUICK_SORT(FlatLoop, is_right, by_rightmost);
 
-static FlatLoop eliminate_holes(JanFace* face, Heap* heap)
+static FlatLoop eliminate_holes(JanMesh* mesh, JanFace* face, Heap* heap)
 {
     Matrix3 transform = matrix3_transpose(matrix3_orthogonal_basis(face->normal));
 
     FlatLoop* queue = HEAP_ALLOCATE(heap, FlatLoop, face->borders_count - 1);
     int added = 0;
-    for(JanBorder* border = face->first_border->next; border; border = border->next)
+    JanBorderId first_border = face->first_border;
+    for(JanBorderId border_id = jan_get_border(mesh, first_border)->next; border_id.value;)
     {
-        int edges = jan_count_border_edges(border);
+        JanBorder* border = jan_get_border(mesh, border_id);
+        border_id = border->next;
+
+        int edges = jan_count_border_edges(mesh, border);
         Float2* projected = HEAP_ALLOCATE(heap, Float2, edges);
         VertexPNC* vertices = HEAP_ALLOCATE(heap, VertexPNC, edges);
-        JanLink* link = border->first;
+        JanLink* link = jan_get_link(mesh, border->first);
         for(int i = 0; i < edges; i += 1)
         {
-            projected[i] = matrix3_transform(transform, link->vertex->position);
-            vertices[i].position = link->vertex->position;
+            Float3 position = jan_get_vertex(mesh, link->vertex)->position;
+            projected[i] = matrix3_transform(transform, position);
+            vertices[i].position = position;
             vertices[i].normal = face->normal;
             vertices[i].colour = rgb_to_u32(link->colour);
-            link = link->next;
+            link = jan_get_link(mesh, link->next);
         }
 
         if(!are_vertices_clockwise(projected, edges))
@@ -417,14 +422,15 @@ static FlatLoop eliminate_holes(JanFace* face, Heap* heap)
     loop.edges = face->edges;
     Float2* projected = HEAP_ALLOCATE(heap, Float2, loop.edges);
     VertexPNC* vertices = HEAP_ALLOCATE(heap, VertexPNC, loop.edges);
-    JanLink* link = face->first_border->first;
+    JanLink* link = jan_get_link(mesh, jan_get_border(mesh, first_border)->first);
     for(int i = 0; i < loop.edges; i += 1)
     {
-        projected[i] = matrix3_transform(transform, link->vertex->position);
-        vertices[i].position = link->vertex->position;
+        Float3 position = jan_get_vertex(mesh, link->vertex)->position;
+        projected[i] = matrix3_transform(transform, position);
+        vertices[i].position = position;
         vertices[i].normal = face->normal;
         vertices[i].colour = rgb_to_u32(link->colour);
-        link = link->next;
+        link = jan_get_link(mesh, link->next);
     }
     loop.positions = projected;
     loop.vertices = vertices;
@@ -460,7 +466,7 @@ static bool is_triangle_vertex(Float2 v0, Float2 v1, Float2 v2, Float2 point)
             || float2_exactly_equals(v2, point);
 }
 
-static void triangulate_face(JanFace* face, Heap* heap,
+static void triangulate_face(JanMesh* mesh, JanFace* face, Heap* heap,
         Triangulation* triangulation)
 {
     VertexPNC* vertices = triangulation->vertices;
@@ -469,7 +475,7 @@ static void triangulate_face(JanFace* face, Heap* heap,
     FlatLoop loop;
     if(face->borders_count > 1)
     {
-        loop = eliminate_holes(face, heap);
+        loop = eliminate_holes(mesh, face, heap);
     }
     else
     {
@@ -478,17 +484,17 @@ static void triangulate_face(JanFace* face, Heap* heap,
         {
             ARRAY_RESERVE(vertices, 3, heap);
             ARRAY_RESERVE(indices, 3, heap);
-            JanLink* link = face->first_border->first;
+            JanLink* link = jan_get_link(mesh, jan_get_border(mesh, face->first_border)->first);
             for(int i = 0; i < 3; i += 1)
             {
                 VertexPNC vertex;
-                vertex.position = link->vertex->position;
+                vertex.position = jan_get_vertex(mesh, link->vertex)->position;
                 vertex.normal = face->normal;
                 vertex.colour = rgb_to_u32(link->colour);
                 int index = array_count(vertices);
                 ARRAY_ADD(vertices, vertex, heap);
                 ARRAY_ADD(indices, index, heap);
-                link = link->next;
+                link = jan_get_link(mesh, link->next);
             }
             triangulation->vertices = vertices;
             triangulation->indices = indices;
@@ -502,14 +508,15 @@ static void triangulate_face(JanFace* face, Heap* heap,
         loop.vertices = HEAP_ALLOCATE(heap, VertexPNC, loop.edges);
         Matrix3 m = matrix3_orthogonal_basis(face->normal);
         Matrix3 mi = matrix3_transpose(m);
-        JanLink* link = face->first_border->first;
+        JanLink* link = jan_get_link(mesh, jan_get_border(mesh, face->first_border)->first);
         for(int i = 0; i < loop.edges; i += 1)
         {
-            loop.positions[i] = matrix3_transform(mi, link->vertex->position);
-            loop.vertices[i].position = link->vertex->position;
+            Float3 position = jan_get_vertex(mesh, link->vertex)->position;
+            loop.positions[i] = matrix3_transform(mi, position);
+            loop.vertices[i].position = position;
             loop.vertices[i].normal = face->normal;
             loop.vertices[i].colour = rgb_to_u32(link->colour);
-            link = link->next;
+            link = jan_get_link(mesh, link->next);
         }
     }
 
@@ -616,7 +623,7 @@ Triangulation jan_triangulate(JanMesh* mesh, Heap* heap)
 
     FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
     {
-        triangulate_face(face, heap, &triangulation);
+        triangulate_face(mesh, face, heap, &triangulation);
     }
 
     return triangulation;
@@ -631,7 +638,7 @@ Triangulation jan_triangulate_selection(JanMesh* mesh, JanSelection* selection,
 
     FOR_ALL(JanPart, selection->parts)
     {
-        triangulate_face(it->face, heap, &triangulation);
+        triangulate_face(mesh, it->face, heap, &triangulation);
     }
 
     return triangulation;
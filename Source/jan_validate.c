@@ -2,12 +2,12 @@
 
 #include "jan_internal.h"
 
-static bool test_vertex_not_in_its_edge(JanVertex* vertex, Log* logger)
+static bool test_vertex_not_in_its_edge(JanMesh* mesh, JanVertex* vertex, Log* logger)
 {
-    JanEdge* edge = vertex->any_edge;
+    JanEdge* edge = jan_get_edge(mesh, vertex->any_edge);
     if(edge)
     {
-        if(!jan_edge_contains_vertex(edge, vertex))
+        if(!jan_edge_contains_vertex(edge, jan_get_vertex_id(mesh, vertex)))
         {
             log_error(logger, "Vertex %p has an edge %p that doesn't contain it.", vertex, edge);
             return true;
@@ -22,7 +22,7 @@ static int validate_vertices(JanMesh* mesh, Log* logger)
 
     FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
     {
-        failures += test_vertex_not_in_its_edge(vertex, logger);
+        failures += test_vertex_not_in_its_edge(mesh, vertex, logger);
     }
 
     return failures;
@@ -30,7 +30,7 @@ static int validate_vertices(JanMesh* mesh, Log* logger)
 
 static bool test_edge_vertices_are_equal(JanEdge* edge, Log* logger)
 {
-    if(edge->vertices[0] == edge->vertices[1])
+    if(edge->vertices[0].value == edge->vertices[1].value)
     {
         log_error(logger, "Both vertices of edge %p are the same.", edge);
         return true;
@@ -38,12 +38,12 @@ static bool test_edge_vertices_are_equal(JanEdge* edge, Log* logger)
     return false;
 }
 
-static bool test_edge_not_in_its_link(JanEdge* edge, Log* logger)
+static bool test_edge_not_in_its_link(JanMesh* mesh, JanEdge* edge, Log* logger)
 {
-    JanLink* link = edge->any_link;
+    JanLink* link = jan_get_link(mesh, edge->any_link);
     if(link)
     {
-        if(link->edge != edge)
+        if(jan_get_edge(mesh, link->edge) != edge)
         {
             log_error(logger, "Edge %p has a link %p that doesn't contain it.", edge, link);
             return true;
@@ -52,15 +52,15 @@ static bool test_edge_not_in_its_link(JanEdge* edge, Log* logger)
     return false;
 }
 
-static bool is_spoke_singular(JanEdge* edge, JanSpoke* spoke)
+static bool is_spoke_singular(JanEdgeId edge, JanSpoke* spoke)
 {
-    return edge == spoke->next && edge == spoke->prior;
+    return edge.value == spoke->next.value && edge.value == spoke->prior.value;
 }
 
-static bool test_spoke_and_link_inconsistent(JanEdge* edge, int index, Log* logger)
+static bool test_spoke_and_link_inconsistent(JanMesh* mesh, JanEdge* edge, int index, Log* logger)
 {
     JanSpoke* spoke = &edge->spokes[index];
-    if(is_spoke_singular(edge, spoke) && edge->any_link)
+    if(is_spoke_singular(jan_get_edge_id(mesh, edge), spoke) && edge->any_link.value)
     {
         log_error(logger, "Edge %p is part of a face, but has a spoke that's singular.", edge);
         return true;
@@ -68,14 +68,15 @@ static bool test_spoke_and_link_inconsistent(JanEdge* edge, int index, Log* logg
     return false;
 }
 
-static bool test_spoke_forward_disconnected(JanEdge* edge, int index, Log* logger)
+static bool test_spoke_forward_disconnected(JanMesh* mesh, JanEdge* edge, int index, Log* logger)
 {
+    JanEdgeId edge_id = jan_get_edge_id(mesh, edge);
     JanSpoke* spoke = &edge->spokes[index];
-    if(!is_spoke_singular(edge, spoke))
+    if(!is_spoke_singular(edge_id, spoke))
     {
-        JanVertex* hub = edge->vertices[index];
-        JanSpoke* adjacent = jan_get_spoke(spoke->next, hub);
-        if(adjacent->prior != edge)
+        JanVertexId hub = edge->vertices[index];
+        JanSpoke* adjacent = jan_get_spoke(jan_get_edge(mesh, spoke->next), hub);
+        if(adjacent->prior.value != edge_id.value)
         {
             log_error(logger, "A non-singular spoke in edge %p is disconnected from its next spoke.", edge);
             return true;
@@ -84,14 +85,15 @@ static bool test_spoke_forward_disconnected(JanEdge* edge, int index, Log* logge
     return false;
 }
 
-static bool test_spoke_backward_disconnected(JanEdge* edge, int index, Log* logger)
+static bool test_spoke_backward_disconnected(JanMesh* mesh, JanEdge* edge, int index, Log* logger)
 {
+    JanEdgeId edge_id = jan_get_edge_id(mesh, edge);
     JanSpoke* spoke = &edge->spokes[index];
-    if(!is_spoke_singular(edge, spoke))
+    if(!is_spoke_singular(edge_id, spoke))
     {
-        JanVertex* hub = edge->vertices[index];
-        JanSpoke* adjacent = jan_get_spoke(spoke->prior, hub);
-        if(adjacent->next != edge)
+        JanVertexId hub = edge->vertices[index];
+        JanSpoke* adjacent = jan_get_spoke(jan_get_edge(mesh, spoke->prior), hub);
+        if(adjacent->next.value != edge_id.value)
         {
             log_error(logger, "A non-singular spoke in edge %p is disconnected from its prior spoke.", edge);
             return true;
@@ -107,22 +109,22 @@ static int validate_edges(JanMesh* mesh, Log* logger)
     FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
     {
         failures += test_edge_vertices_are_equal(edge, logger);
-        failures += test_edge_not_in_its_link(edge, logger);
+        failures += test_edge_not_in_its_link(mesh, edge, logger);
 
         for(int side = 0; side < 2; side += 1)
         {
-            failures += test_spoke_and_link_inconsistent(edge, side, logger);
-            failures += test_spoke_forward_disconnected(edge, side, logger);
-            failures += test_spoke_backward_disconnected(edge, side, logger);
+            failures += test_spoke_and_link_inconsistent(mesh, edge, side, logger);
+            failures += test_spoke_forward_disconnected(mesh, edge, side, logger);
+            failures += test_spoke_backward_disconnected(mesh, edge, side, logger);
         }
     }
 
     return failures;
 }
 
-static bool test_edge_not_in_fin(JanLink* link, JanEdge* edge, Log* logger)
+static bool test_edge_not_in_fin(JanMesh* mesh, JanLink* link, JanEdge* edge, Log* logger)
 {
-    if(link->edge != edge)
+    if(jan_get_edge(mesh, link->edge) != edge)
     {
         log_error(logger, "Edge %p has fin %p that doesn't contain it.", link, edge);
         return true;
@@ -130,19 +132,19 @@ static bool test_edge_not_in_fin(JanLink* link, JanEdge* edge, Log* logger)
     return false;
 }
 
-static bool test_link_vertex_not_in_edge(JanLink* link, JanEdge* edge, Log* logger)
+static bool test_link_vertex_not_in_edge(JanMesh* mesh, JanLink* link, JanEdge* edge, Log* logger)
 {
     if(!jan_edge_contains_vertex(edge, link->vertex))
     {
-        log_error(logger, "Link %p has a vertex %p not in its edge %p.", link, link->vertex, edge);
+        log_error(logger, "Link %p has a vertex %p not in its edge %p.", link, jan_get_vertex(mesh, link->vertex), edge);
         return true;
     }
     return false;
 }
 
-static bool test_forward_fin_disconnected(JanLink* link, Log* logger)
+static bool test_forward_fin_disconnected(JanMesh* mesh, JanLink* link, Log* logger)
 {
-    if(link != link->next_fin->prior_fin)
+    if(link != jan_get_link(mesh, jan_get_link(mesh, link->next_fin)->prior_fin))
     {
         log_error(logger, "Fin %p is disconnected from its next fin.", link);
         return true;
@@ -150,9 +152,9 @@ static bool test_forward_fin_disconnected(JanLink* link, Log* logger)
     return false;
 }
 
-static bool test_backward_fin_disconnected(JanLink* link, Log* logger)
+static bool test_backward_fin_disconnected(JanMesh* mesh, JanLink* link, Log* logger)
 {
-    if(link != link->prior_fin->next_fin)
+    if(link != jan_get_link(mesh, jan_get_link(mesh, link->prior_fin)->next_fin))
     {
         log_error(logger, "Fin %p is disconnected from its prior fin.", link);
         return true;
@@ -166,25 +168,26 @@ static int validate_fins(JanMesh* mesh, Log* logger)
 
     FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
     {
-        JanLink* first = edge->any_link;
-        JanLink* link = first;
+        JanLinkId first = edge->any_link;
+        JanLinkId link_id = first;
         do
         {
-            failures += test_edge_not_in_fin(link, edge, logger);
-            failures += test_link_vertex_not_in_edge(link, edge, logger);
-            failures += test_link_vertex_not_in_edge(link->next_fin, edge, logger);
-            failures += test_forward_fin_disconnected(link, logger);
-            failures += test_backward_fin_disconnected(link, logger);
-            link = link->next_fin;
-        } while(link != first);
+            JanLink* link = jan_get_link(mesh, link_id);
+            failures += test_edge_not_in_fin(mesh, link, edge, logger);
+            failures += test_link_vertex_not_in_edge(mesh, link, edge, logger);
+            failures += test_link_vertex_not_in_edge(mesh, jan_get_link(mesh, link->next_fin), edge, logger);
+            failures += test_forward_fin_disconnected(mesh, link, logger);
+            failures += test_backward_fin_disconnected(mesh, link, logger);
+            link_id = link->next_fin;
+        } while(link_id.value != first.value);
     }
 
     return failures;
 }
 
-static bool test_edge_count_of_face_incorrect(JanFace* face, Log* logger)
+static bool test_edge_count_of_face_incorrect(JanMesh* mesh, JanFace* face, Log* logger)
 {
-    int count = jan_count_border_edges(face->first_border);
+    int count = jan_count_border_edges(mesh, jan_get_border(mesh, face->first_border));
     if(face->edges != count)
     {
         log_error(logger, "Face %p has a different number of edges than it indicates.", face);
@@ -203,9 +206,9 @@ static bool test_edge_count_of_face_invalid(JanFace* face, Log* logger)
     return false;
 }
 
-static bool test_border_count_of_face_incorrect(JanFace* face, Log* logger)
+static bool test_border_count_of_face_incorrect(JanMesh* mesh, JanFace* face, Log* logger)
 {
-    int count = jan_count_face_borders(face);
+    int count = jan_count_face_borders(mesh, face);
     if(face->borders_count != count)
     {
         log_error(logger, "Face %p has a different number of borders than it indicates.", face);
@@ -224,19 +227,20 @@ static bool test_border_count_of_face_invalid(JanFace* face, Log* logger)
     return false;
 }
 
-static bool test_face_not_in_link(JanLink* link, JanFace* face, Log* logger)
+static bool test_face_not_in_link(JanMesh* mesh, JanLink* link, JanFace* face, Log* logger)
 {
-    if(link->face != face)
+    JanFace* link_face = jan_get_face(mesh, link->face);
+    if(link_face != face)
     {
-        log_error(logger, "Face %p has link %p that has the wrong face %p.", face, link, link->face);
+        log_error(logger, "Face %p has link %p that has the wrong face %p.", face, link, link_face);
         return true;
     }
     return false;
 }
 
-static bool test_forward_link_disconnected(JanFace* face, JanLink* link, Log* logger)
+static bool test_forward_link_disconnected(JanMesh* mesh, JanFace* face, JanLink* link, Log* logger)
 {
-    if(link != link->next->prior)
+    if(link != jan_get_link(mesh, jan_get_link(mesh, link->next)->prior))
     {
         log_error(logger, "Face %p has link %p that's disconnected from the next link.", face, link);
         return true;
@@ -244,9 +248,9 @@ static bool test_forward_link_disconnected(JanFace* face, JanLink* link, Log* lo
     return false;
 }
 
-static bool test_backward_link_disconnected(JanFace* face, JanLink* link, Log* logger)
+static bool test_backward_link_disconnected(JanMesh* mesh, JanFace* face, JanLink* link, Log* logger)
 {
-    if(link != link->prior->next)
+    if(link != jan_get_link(mesh, jan_get_link(mesh, link->prior)->next))
     {
         log_error(logger, "Face %p has link %p that's disconnected from the prior link.", face, link);
         return true;
@@ -260,22 +264,25 @@ static int validate_faces(JanMesh* mesh, Log* logger)
 
     FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
     {
-        failures += test_edge_count_of_face_incorrect(face, logger);
+        failures += test_edge_count_of_face_incorrect(mesh, face, logger);
         failures += test_edge_count_of_face_invalid(face, logger);
-        failures += test_border_count_of_face_incorrect(face, logger);
+        failures += test_border_count_of_face_incorrect(mesh, face, logger);
         failures += test_border_count_of_face_invalid(face, logger);
 
-        for(JanBorder* border = face->first_border; border; border = border->next)
+        for(JanBorderId border_id = face->first_border; border_id.value;)
         {
-            JanLink* first = border->first;
-            JanLink* link = first;
+            JanBorder* border = jan_get_border(mesh, border_id);
+            JanLinkId first = border->first;
+            JanLinkId link_id = first;
             do
             {
-                failures += test_face_not_in_link(link, face, logger);
-                failures += test_forward_link_disconnected(face, link, logger);
-                failures += test_backward_link_disconnected(face, link, logger);
-                link = link->next;
-            } while(link != first);
+                JanLink* link = jan_get_link(mesh, link_id);
+                failures += test_face_not_in_link(mesh, link, face, logger);
+                failures += test_forward_link_disconnected(mesh, face, link, logger);
+                failures += test_backward_link_disconnected(mesh, face, link, logger);
+                link_id = link->next;
+            } while(link_id.value != first.value);
+            border_id = border->next;
         }
     }
 
@@ -1,7 +1,14 @@
 #include "map.h"
 
+#if !ARBORETUM_SWISS_MAP
+
 #include "assert.h"
 #include "memory.h"
+#include "platform_definitions.h"
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
 
 // signifies an empty key slot
 static const void* empty = 0;
@@ -36,6 +43,15 @@ static bool can_use_bitwise_and_to_cycle(int count)
     return is_power_of_two(count);
 }
 
+// This is how many keys the batched procedures hash and prefetch before they
+// look any of them up.
+#define BATCH_SIZE 16
+
+static int min_int(int a, int b)
+{
+    return (a < b) ? a : b;
+}
+
 static uint32_t hash_key(uint64_t key)
 {
     key = (~key) + (key << 18); // key = (key << 18) - key - 1;
@@ -202,17 +218,29 @@ static void map_grow(Map* map, int cap, Heap* heap)
     map->cap = cap;
 }
 
+static void insert(Map* map, void* key, void* value, uint32_t hash)
+{
+    int slot = find_slot(map->keys, map->cap, key, hash);
+    if(map->keys[slot] != key)
+    {
+        map->count += 1;
+    }
+    map->keys[slot] = key;
+    map->values[slot] = value;
+    map->hashes[slot] = hash;
+}
+
 void map_add(Map* map, void* key, void* value, Heap* heap)
 {
     if(key == empty)
     {
         int overflow_index = map->cap;
-        map->keys[overflow_index] = key;
-        map->values[overflow_index] = value;
         if(map->keys[overflow_index] != key)
         {
             map->count += 1;
         }
+        map->keys[overflow_index] = key;
+        map->values[overflow_index] = value;
         return;
     }
 
@@ -223,14 +251,7 @@ void map_add(Map* map, void* key, void* value, Heap* heap)
     }
 
     uint32_t hash = hash_key((uint64_t) key);
-    int slot = find_slot(map->keys, map->cap, key, hash);
-    if(map->keys[slot] != key)
-    {
-        map->count += 1;
-    }
-    map->keys[slot] = key;
-    map->values[slot] = value;
-    map->hashes[slot] = hash;
+    insert(map, key, value, hash);
 }
 
 void map_add_uint64(Map* map, void* key, uint64_t value, Heap* heap)
@@ -283,6 +304,8 @@ void map_remove(Map* map, void* key)
         return;
     }
 
+    map->count -= 1;
+
     // Empty the slot, but also shuffle down any stranded pairs. There may
     // have been pairs that slid past their natural hash position and over this
     // slot. And any lookup for that key would hit this now-empty slot and fail
@@ -298,14 +321,13 @@ void map_remove(Map* map, void* key)
             {
                 return;
             }
-            k = map->hashes[j];
+            k = map->hashes[j] & (map->cap - 1);
         } while(in_cyclic_interval(k, i, j));
 
         map->keys[i] = map->keys[j];
         map->values[i] = map->values[j];
         map->hashes[i] = map->hashes[j];
     }
-	map->count -= 1;
 }
 
 void map_remove_uint64(Map* map, uint64_t key)
@@ -322,6 +344,102 @@ void map_reserve(Map* map, int cap, Heap* heap)
     }
 }
 
+// Batched Procedures...........................................................
+
+// Each lookup in a big table is a cache miss, and a loop of lookups waits on
+// them one at a time. So, these hash a batch of keys and prefetch the slots
+// they start probing at, before coming back to resolve each of them. By then,
+// the misses for the whole batch have been overlapping each other.
+
+static void prefetch(const void* address)
+{
+#if defined(COMPILER_MSVC)
+    _mm_prefetch((const char*) address, _MM_HINT_T0);
+#elif defined(COMPILER_GCC)
+    __builtin_prefetch(address);
+#endif
+}
+
+static void prefetch_slot(Map* map, uint32_t hash)
+{
+    int slot = hash & (map->cap - 1);
+    prefetch(&map->keys[slot]);
+    prefetch(&map->values[slot]);
+}
+
+void map_get_many(Map* map, void** keys, MaybePointer* results, int count)
+{
+    uint32_t hashes[BATCH_SIZE];
+
+    for(int start = 0; start < count; start += BATCH_SIZE)
+    {
+        int batch_count = min_int(count - start, BATCH_SIZE);
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            hashes[i] = hash_key((uint64_t) keys[start + i]);
+            prefetch_slot(map, hashes[i]);
+        }
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            void* key = keys[start + i];
+            if(key == empty)
+            {
+                results[start + i] = map_get(map, key);
+                continue;
+            }
+
+            int slot = find_slot(map->keys, map->cap, key, hashes[i]);
+            MaybePointer result = {0};
+            if(map->keys[slot] == key)
+            {
+                result.value = map->values[slot];
+                result.valid = true;
+            }
+            results[start + i] = result;
+        }
+    }
+}
+
+void map_add_many(Map* map, void** keys, void** values, int count, Heap* heap)
+{
+    // Grow once up front, so that the slots prefetched for a batch are still
+    // the right ones when it's resolved.
+    int load_limit = (3 * map->cap) / 4;
+    if(map->count + count >= load_limit)
+    {
+        map_reserve(map, (4 * (map->count + count)) / 3 + 1, heap);
+    }
+
+    uint32_t hashes[BATCH_SIZE];
+
+    for(int start = 0; start < count; start += BATCH_SIZE)
+    {
+        int batch_count = min_int(count - start, BATCH_SIZE);
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            hashes[i] = hash_key((uint64_t) keys[start + i]);
+            prefetch_slot(map, hashes[i]);
+        }
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            void* key = keys[start + i];
+            if(key == empty)
+            {
+                map_add(map, key, values[start + i], heap);
+                continue;
+            }
+
+            insert(map, key, values[start + i], hashes[i]);
+        }
+    }
+}
+
+// Iterator.....................................................................
+
 MapIterator map_iterator_next(MapIterator it)
 {
     int index = it.index;
@@ -346,7 +464,7 @@ MapIterator map_iterator_start(Map* map)
 {
     if(map->count > 0)
     {
-        return (MapIterator){map, 0};
+        return map_iterator_next((MapIterator){map, end_index});
     }
     else
     {
@@ -370,3 +488,5 @@ void* map_iterator_get_value(MapIterator it)
     ASSERT(it.index >= 0 && it.index <= it.map->cap);
     return it.map->values[it.index];
 }
+
+#endif // !ARBORETUM_SWISS_MAP
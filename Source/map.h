@@ -1,11 +1,47 @@
 #ifndef MAP_H_
 #define MAP_H_
 
+#include "arboretum_config.h"
 #include "maybe_types.h"
 #include "memory.h"
 
 #include <stdint.h>
 
+#if ARBORETUM_SWISS_MAP
+
+// Every Map is a SwissMap instead, which has the same interface.
+#include "swiss_map.h"
+
+typedef SwissMap Map;
+typedef SwissMapIterator MapIterator;
+
+#define map_create swiss_map_create
+#define map_destroy swiss_map_destroy
+#define map_clear swiss_map_clear
+#define map_get swiss_map_get
+#define map_get_uint64 swiss_map_get_uint64
+#define map_get_from_uint64 swiss_map_get_from_uint64
+#define map_get_uint64_from_uint64 swiss_map_get_uint64_from_uint64
+#define map_add swiss_map_add
+#define map_add_uint64 swiss_map_add_uint64
+#define map_add_from_uint64 swiss_map_add_from_uint64
+#define map_add_uint64_from_uint64 swiss_map_add_uint64_from_uint64
+#define map_remove swiss_map_remove
+#define map_remove_uint64 swiss_map_remove_uint64
+#define map_reserve swiss_map_reserve
+#define map_get_many swiss_map_get_many
+#define map_add_many swiss_map_add_many
+#define map_iterator_next swiss_map_iterator_next
+#define map_iterator_start swiss_map_iterator_start
+#define map_iterator_is_not_end swiss_map_iterator_is_not_end
+#define map_iterator_get_key swiss_map_iterator_get_key
+#define map_iterator_get_value swiss_map_iterator_get_value
+
+#define ITERATE_MAP(it, map) \
+    ITERATE_SWISS_MAP(it, map)
+
+#else
+
 // This is a hash table that uses pointer-sized values for its key and value
 // pairs. It uses open addressing and linear probing for its collision
 // resolution.
@@ -33,6 +69,11 @@ void map_remove(Map* map, void* key);
 void map_remove_uint64(Map* map, uint64_t key);
 void map_reserve(Map* map, int cap, Heap* heap);
 
+// These do the same as calling map_get or map_add once for each key, in order,
+// but overlap the cache misses of the whole batch.
+void map_get_many(Map* map, void** keys, MaybePointer* results, int count);
+void map_add_many(Map* map, void** keys, void** values, int count, Heap* heap);
+
 typedef struct MapIterator
 {
     Map* map;
@@ -48,4 +89,6 @@ void* map_iterator_get_value(MapIterator it);
 #define ITERATE_MAP(it, map) \
     for(MapIterator it = map_iterator_start(map); map_iterator_is_not_end(it); it = map_iterator_next(it))
 
+#endif // ARBORETUM_SWISS_MAP
+
 #endif // MAP_H_
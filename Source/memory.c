@@ -1,6 +1,8 @@
 #include "memory.h"
 
 #include "assert.h"
+#include "atomic.h"
+#include "thread.h"
 
 #if defined(OS_WINDOWS)
 #define WINVER        0x0600
@@ -14,10 +16,44 @@
 
 // General Memory...............................................................
 
+static HugePageMode huge_page_mode = HUGE_PAGE_MODE_OFF;
+static uint64_t huge_page_threshold = UINT64_MAX;
+
+static uint64_t round_up_to_multiple(uint64_t x, uint64_t multiple)
+{
+    return (x + multiple - 1) / multiple * multiple;
+}
+
+static bool wants_huge_pages(uint64_t bytes)
+{
+    return huge_page_mode != HUGE_PAGE_MODE_OFF && bytes >= huge_page_threshold;
+}
+
 #if defined(OS_WINDOWS)
 
+// Large pages have to be committed all at once and need the "Lock pages in
+// memory" privilege, so there's no transparent mode on Windows.
+static void* allocate_large_pages(uint64_t bytes)
+{
+    SIZE_T large_page_bytes = GetLargePageMinimum();
+    if(!large_page_bytes)
+    {
+        return NULL;
+    }
+    uint64_t rounded = round_up_to_multiple(bytes, large_page_bytes);
+    return VirtualAlloc(NULL, rounded, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
 void* virtual_allocate(uint64_t bytes)
 {
+    if(wants_huge_pages(bytes))
+    {
+        void* memory = allocate_large_pages(bytes);
+        if(memory)
+        {
+            return memory;
+        }
+    }
     return VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 }
 
@@ -26,13 +62,101 @@ void virtual_deallocate(void* memory)
     VirtualFree(memory, 0, MEM_RELEASE);
 }
 
+void* virtual_reserve(uint64_t bytes)
+{
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool virtual_commit(void* memory, uint64_t bytes)
+{
+    return VirtualAlloc(memory, bytes, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void virtual_release(void* memory, uint64_t bytes)
+{
+    (void) bytes;
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+HugePageMode set_huge_page_mode(HugePageMode mode, uint64_t threshold)
+{
+    ASSERT(mode >= 0 && mode < HUGE_PAGE_MODE_COUNT);
+
+    if(mode != HUGE_PAGE_MODE_OFF)
+    {
+        void* probe = allocate_large_pages(1);
+        if(probe)
+        {
+            VirtualFree(probe, 0, MEM_RELEASE);
+            mode = HUGE_PAGE_MODE_EXPLICIT;
+        }
+        else
+        {
+            mode = HUGE_PAGE_MODE_OFF;
+        }
+    }
+
+    huge_page_mode = mode;
+    huge_page_threshold = threshold;
+    return mode;
+}
+
+#else
+
+#if !defined(MAP_HUGETLB)
+#define MAP_HUGETLB 0
+#endif
+
+// Explicit huge pages come from a pool the system administrator sets aside, so
+// they can run out. Transparent huge pages are only a hint, and the kernel uses
+// regular pages whenever it can't find huge ones.
+static void* map_huge_pages(uint64_t bytes)
+{
+    if(!MAP_HUGETLB)
+    {
+        return MAP_FAILED;
+    }
+    return mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+}
+
+static bool advise_huge_pages(void* memory, uint64_t bytes)
+{
+#if defined(MADV_HUGEPAGE)
+    return madvise(memory, bytes, MADV_HUGEPAGE) == 0;
 #else
+    return false;
+#endif
+}
 
+// The size of the whole mapping is kept just before the memory handed out, so
+// that it can be unmapped without being told the size.
 void* virtual_allocate(uint64_t bytes)
 {
-    void* m = mmap(NULL, bytes + sizeof(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint64_t total = bytes + sizeof(uint64_t);
+    void* m = MAP_FAILED;
+    if(huge_page_mode == HUGE_PAGE_MODE_EXPLICIT && bytes >= huge_page_threshold)
+    {
+        uint64_t rounded = round_up_to_multiple(total, HUGE_PAGE_BYTES);
+        m = map_huge_pages(rounded);
+        if(m != MAP_FAILED)
+        {
+            total = rounded;
+        }
+    }
+    if(m == MAP_FAILED)
+    {
+        m = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(m == MAP_FAILED)
+        {
+            return NULL;
+        }
+        if(wants_huge_pages(bytes))
+        {
+            advise_huge_pages(m, total);
+        }
+    }
     uint64_t* p = (uint64_t*) m;
-    *p = bytes;
+    *p = total;
     return p + 1;
 }
 
@@ -44,35 +168,87 @@ void virtual_deallocate(void* memory)
     munmap(p, bytes);
 }
 
-#endif // defined(OS_WINDOWS)
+void* virtual_reserve(uint64_t bytes)
+{
+    // Reserve the range without backing it, so it doesn't count against the
+    // system's commit limit until parts of it are committed.
+    void* memory = mmap(NULL, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(memory == MAP_FAILED)
+    {
+        return NULL;
+    }
 
-void copy_memory(void* to, const void* from, uint64_t bytes)
+    // Explicit huge pages would have to be set aside for the whole range up
+    // front, so a reserved range only ever gets the hint.
+    if(wants_huge_pages(bytes))
+    {
+        advise_huge_pages(memory, bytes);
+    }
+
+    return memory;
+}
+
+bool virtual_commit(void* memory, uint64_t bytes)
+{
+    return mprotect(memory, bytes, PROT_READ | PROT_WRITE) == 0;
+}
+
+void virtual_release(void* memory, uint64_t bytes)
+{
+    munmap(memory, bytes);
+}
+
+HugePageMode set_huge_page_mode(HugePageMode mode, uint64_t threshold)
 {
-    const uint8_t* p0 = from;
-    uint8_t* p1 = to;
-    if(p0 < p1)
+    ASSERT(mode >= 0 && mode < HUGE_PAGE_MODE_COUNT);
+
+    // Try a single huge page, and fall back to the next best mode if the
+    // system doesn't allow it.
+    if(mode == HUGE_PAGE_MODE_EXPLICIT)
     {
-        for(p0 += bytes, p1 += bytes; bytes; bytes -= 1)
+        void* probe = map_huge_pages(HUGE_PAGE_BYTES);
+        if(probe != MAP_FAILED)
+        {
+            munmap(probe, HUGE_PAGE_BYTES);
+        }
+        else
         {
-            p0 -= 1;
-            p1 -= 1;
-            *p1 = *p0;
+            mode = HUGE_PAGE_MODE_TRANSPARENT;
         }
     }
-    else
+    if(mode == HUGE_PAGE_MODE_TRANSPARENT)
     {
-        for(; bytes; bytes -= 1, p0 +=1, p1 += 1)
+        void* probe = mmap(NULL, HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(probe == MAP_FAILED || !advise_huge_pages(probe, HUGE_PAGE_BYTES))
+        {
+            mode = HUGE_PAGE_MODE_OFF;
+        }
+        if(probe != MAP_FAILED)
         {
-            *p1 = *p0;
+            munmap(probe, HUGE_PAGE_BYTES);
         }
     }
+
+    huge_page_mode = mode;
+    huge_page_threshold = threshold;
+    return mode;
 }
 
-void zero_memory(void* memory, uint64_t bytes)
+#endif // defined(OS_WINDOWS)
+
+HugePageMode get_huge_page_mode()
 {
-    for(uint8_t* p = memory; bytes; bytes -= 1, p += 1)
+    return huge_page_mode;
+}
+
+const char* describe_huge_page_mode(HugePageMode mode)
+{
+    switch(mode)
     {
-        *p = 0;
+        default:
+        case HUGE_PAGE_MODE_OFF:         return "off";
+        case HUGE_PAGE_MODE_TRANSPARENT: return "transparent";
+        case HUGE_PAGE_MODE_EXPLICIT:    return "explicit";
     }
 }
 
@@ -101,239 +277,1771 @@ uint64_t uptibytes(uint64_t count)
     return 256 * capobytes(count);
 }
 
+// Commit in steps no smaller than this, which is a multiple of the page size
+// everywhere and also the allocation granularity on Windows.
+#define COMMIT_GRANULARITY 0x10000
+
+// Commit more of a reserved range so that at least the needed bytes are usable.
+// Growing at least doubles what's committed, so that something growing a bit
+// at a time doesn't commit over and over.
+static bool commit_more(uint8_t* memory, uint64_t* committed, uint64_t needed, uint64_t reserved)
+{
+    if(needed > reserved)
+    {
+        return false;
+    }
+
+    uint64_t target = 2 * (*committed);
+    if(target < needed)
+    {
+        target = needed;
+    }
+    target = (target + (COMMIT_GRANULARITY - 1)) & ~((uint64_t) COMMIT_GRANULARITY - 1);
+    if(target > reserved)
+    {
+        target = reserved;
+    }
+
+    if(!virtual_commit(memory + *committed, target - *committed))
+    {
+        return false;
+    }
+    *committed = target;
+    return true;
+}
+
 static bool is_aligned(const void* memory, uint64_t alignment)
 {
     uintptr_t address = (uintptr_t) memory;
     return ~(address & (alignment - 1));
 }
 
-// Stack........................................................................
+static int count_trailing_zeros(uint64_t x)
+{
+    ASSERT(x);
+#if defined(COMPILER_MSVC)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int) index;
+#elif defined(COMPILER_GCC)
+    return __builtin_ctzll(x);
+#endif
+}
 
-void stack_create(Stack* stack, uint32_t bytes)
+static int find_last_set(uint64_t x)
 {
-    stack->memory = (uint8_t*) virtual_allocate(bytes);
-    stack->top = 0;
-    stack->bytes = bytes;
+    ASSERT(x);
+#if defined(COMPILER_MSVC)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return (int) index;
+#elif defined(COMPILER_GCC)
+    return 63 - __builtin_clzll(x);
+#endif
 }
 
-void stack_destroy(Stack* stack)
+// Memory Kernels...............................................................
+
+// The copy and zero procedures are used all over, so they have variants that
+// work a byte at a time, a word at a time, and with SSE2 or AVX2 vectors. The
+// fastest one the CPU supports is picked the first time either is called.
+
+#if defined(COMPILER_GCC)
+typedef uint64_t __attribute__((__may_alias__, __aligned__(1))) UnalignedWord;
+#else
+typedef uint64_t UnalignedWord;
+#endif
+
+typedef struct MemoryKernels
 {
-    if(stack)
+    void (*copy_forward)(uint8_t* to, const uint8_t* from, uint64_t bytes);
+    void (*copy_backward)(uint8_t* to, const uint8_t* from, uint64_t bytes);
+    void (*zero)(uint8_t* memory, uint64_t bytes);
+} MemoryKernels;
+
+static void copy_forward_bytes(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    for(; bytes; bytes -= 1, from += 1, to += 1)
     {
-        SAFE_VIRTUAL_DEALLOCATE(stack->memory);
-        stack->top = 0;
-        stack->bytes = 0;
+        *to = *from;
     }
 }
 
-void* stack_allocate(Stack* stack, uint32_t bytes)
+static void copy_backward_bytes(uint8_t* to, const uint8_t* from, uint64_t bytes)
 {
-    uint32_t prior_top = stack->top;
-    uint32_t header_size = sizeof(prior_top);
-    uint8_t* top = stack->memory + stack->top;
+    for(from += bytes, to += bytes; bytes; bytes -= 1)
+    {
+        from -= 1;
+        to -= 1;
+        *to = *from;
+    }
+}
 
-    // ARM Neon's 4 lane 32-bit vector types and Intel AVX-256 packed types ask
-    // for 32 byte aligned addresses (This isn't a hard requirement under Neon,
-    // but it is faster). It doesn't hurt to just align everything to support
-    // these easily.
-    //
-    // If Intel AVX-512 support is added, this should be bumped up to 64 bytes
-    // to align accesses for its 512-bit registers.
-    const uint32_t alignment = 32;
-    uintptr_t address = (uintptr_t) (top + header_size);
-    uint32_t adjustment = alignment - (address & (alignment - 1));
-    if(adjustment == alignment)
+static void zero_bytes(uint8_t* memory, uint64_t bytes)
+{
+    for(; bytes; bytes -= 1, memory += 1)
     {
-        adjustment = 0;
+        *memory = 0;
+    }
+}
+
+// Copy bytes one at a time until the destination is aligned, so that the
+// wider stores that follow don't straddle cache lines.
+static uint64_t count_bytes_to_align(const uint8_t* memory, uint64_t alignment, uint64_t bytes)
+{
+    uint64_t misalignment = ((uintptr_t) memory) & (alignment - 1);
+    uint64_t head = misalignment ? alignment - misalignment : 0;
+    return head < bytes ? head : bytes;
+}
+
+static uint64_t count_bytes_to_align_end(const uint8_t* memory, uint64_t alignment, uint64_t bytes)
+{
+    uint64_t tail = ((uintptr_t) (memory + bytes)) & (alignment - 1);
+    return tail < bytes ? tail : bytes;
+}
+
+static void copy_forward_words(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t head = count_bytes_to_align(to, 8, bytes);
+    copy_forward_bytes(to, from, head);
+    to += head;
+    from += head;
+    bytes -= head;
+
+    for(; bytes >= 8; bytes -= 8, from += 8, to += 8)
+    {
+        *((UnalignedWord*) to) = *((const UnalignedWord*) from);
+    }
+
+    copy_forward_bytes(to, from, bytes);
+}
+
+static void copy_backward_words(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t tail = count_bytes_to_align_end(to, 8, bytes);
+    bytes -= tail;
+    copy_backward_bytes(to + bytes, from + bytes, tail);
+
+    for(; bytes >= 8; bytes -= 8)
+    {
+        *((UnalignedWord*) (to + bytes - 8)) = *((const UnalignedWord*) (from + bytes - 8));
+    }
+
+    copy_backward_bytes(to, from, bytes);
+}
+
+static void zero_words(uint8_t* memory, uint64_t bytes)
+{
+    uint64_t head = count_bytes_to_align(memory, 8, bytes);
+    zero_bytes(memory, head);
+    memory += head;
+    bytes -= head;
+
+    for(; bytes >= 8; bytes -= 8, memory += 8)
+    {
+        *((UnalignedWord*) memory) = 0;
+    }
+
+    zero_bytes(memory, bytes);
+}
+
+#if defined(INSTRUCTION_SET_X86) || defined(INSTRUCTION_SET_X64)
+
+#if defined(COMPILER_GCC)
+#include <cpuid.h>
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(COMPILER_MSVC)
+#include <intrin.h>
+#include <immintrin.h>
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+TARGET_SSE2 static void copy_forward_sse2(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t head = count_bytes_to_align(to, 16, bytes);
+    copy_forward_words(to, from, head);
+    to += head;
+    from += head;
+    bytes -= head;
+
+    for(; bytes >= 64; bytes -= 64, from += 64, to += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*) from);
+        __m128i b = _mm_loadu_si128((const __m128i*) (from + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*) (from + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*) (from + 48));
+        _mm_store_si128((__m128i*) to, a);
+        _mm_store_si128((__m128i*) (to + 16), b);
+        _mm_store_si128((__m128i*) (to + 32), c);
+        _mm_store_si128((__m128i*) (to + 48), d);
+    }
+    for(; bytes >= 16; bytes -= 16, from += 16, to += 16)
+    {
+        _mm_store_si128((__m128i*) to, _mm_loadu_si128((const __m128i*) from));
+    }
+
+    copy_forward_words(to, from, bytes);
+}
+
+TARGET_SSE2 static void copy_backward_sse2(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t tail = count_bytes_to_align_end(to, 16, bytes);
+    bytes -= tail;
+    copy_backward_words(to + bytes, from + bytes, tail);
+
+    for(; bytes >= 64; bytes -= 64)
+    {
+        const uint8_t* f = from + bytes - 64;
+        uint8_t* t = to + bytes - 64;
+        __m128i a = _mm_loadu_si128((const __m128i*) (f + 48));
+        __m128i b = _mm_loadu_si128((const __m128i*) (f + 32));
+        __m128i c = _mm_loadu_si128((const __m128i*) (f + 16));
+        __m128i d = _mm_loadu_si128((const __m128i*) f);
+        _mm_store_si128((__m128i*) (t + 48), a);
+        _mm_store_si128((__m128i*) (t + 32), b);
+        _mm_store_si128((__m128i*) (t + 16), c);
+        _mm_store_si128((__m128i*) t, d);
+    }
+    for(; bytes >= 16; bytes -= 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*) (from + bytes - 16));
+        _mm_store_si128((__m128i*) (to + bytes - 16), a);
+    }
+
+    copy_backward_words(to, from, bytes);
+}
+
+TARGET_SSE2 static void zero_sse2(uint8_t* memory, uint64_t bytes)
+{
+    uint64_t head = count_bytes_to_align(memory, 16, bytes);
+    zero_words(memory, head);
+    memory += head;
+    bytes -= head;
+
+    __m128i zero = _mm_setzero_si128();
+    for(; bytes >= 64; bytes -= 64, memory += 64)
+    {
+        _mm_store_si128((__m128i*) memory, zero);
+        _mm_store_si128((__m128i*) (memory + 16), zero);
+        _mm_store_si128((__m128i*) (memory + 32), zero);
+        _mm_store_si128((__m128i*) (memory + 48), zero);
+    }
+    for(; bytes >= 16; bytes -= 16, memory += 16)
+    {
+        _mm_store_si128((__m128i*) memory, zero);
+    }
+
+    zero_words(memory, bytes);
+}
+
+TARGET_AVX2 static void copy_forward_avx2(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t head = count_bytes_to_align(to, 32, bytes);
+    copy_forward_words(to, from, head);
+    to += head;
+    from += head;
+    bytes -= head;
+
+    for(; bytes >= 128; bytes -= 128, from += 128, to += 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*) from);
+        __m256i b = _mm256_loadu_si256((const __m256i*) (from + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (from + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*) (from + 96));
+        _mm256_store_si256((__m256i*) to, a);
+        _mm256_store_si256((__m256i*) (to + 32), b);
+        _mm256_store_si256((__m256i*) (to + 64), c);
+        _mm256_store_si256((__m256i*) (to + 96), d);
+    }
+    for(; bytes >= 32; bytes -= 32, from += 32, to += 32)
+    {
+        _mm256_store_si256((__m256i*) to, _mm256_loadu_si256((const __m256i*) from));
+    }
+
+    copy_forward_words(to, from, bytes);
+}
+
+TARGET_AVX2 static void copy_backward_avx2(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    uint64_t tail = count_bytes_to_align_end(to, 32, bytes);
+    bytes -= tail;
+    copy_backward_words(to + bytes, from + bytes, tail);
+
+    for(; bytes >= 128; bytes -= 128)
+    {
+        const uint8_t* f = from + bytes - 128;
+        uint8_t* t = to + bytes - 128;
+        __m256i a = _mm256_loadu_si256((const __m256i*) (f + 96));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (f + 64));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (f + 32));
+        __m256i d = _mm256_loadu_si256((const __m256i*) f);
+        _mm256_store_si256((__m256i*) (t + 96), a);
+        _mm256_store_si256((__m256i*) (t + 64), b);
+        _mm256_store_si256((__m256i*) (t + 32), c);
+        _mm256_store_si256((__m256i*) t, d);
+    }
+    for(; bytes >= 32; bytes -= 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (from + bytes - 32));
+        _mm256_store_si256((__m256i*) (to + bytes - 32), a);
+    }
+
+    copy_backward_words(to, from, bytes);
+}
+
+TARGET_AVX2 static void zero_avx2(uint8_t* memory, uint64_t bytes)
+{
+    uint64_t head = count_bytes_to_align(memory, 32, bytes);
+    zero_words(memory, head);
+    memory += head;
+    bytes -= head;
+
+    __m256i zero = _mm256_setzero_si256();
+    for(; bytes >= 128; bytes -= 128, memory += 128)
+    {
+        _mm256_store_si256((__m256i*) memory, zero);
+        _mm256_store_si256((__m256i*) (memory + 32), zero);
+        _mm256_store_si256((__m256i*) (memory + 64), zero);
+        _mm256_store_si256((__m256i*) (memory + 96), zero);
+    }
+    for(; bytes >= 32; bytes -= 32, memory += 32)
+    {
+        _mm256_store_si256((__m256i*) memory, zero);
+    }
+
+    zero_words(memory, bytes);
+}
+
+typedef struct CpuidResult
+{
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+} CpuidResult;
+
+static CpuidResult cpuid(uint32_t leaf, uint32_t subleaf)
+{
+    CpuidResult result = {0};
+#if defined(COMPILER_GCC)
+    __cpuid_count(leaf, subleaf, result.eax, result.ebx, result.ecx, result.edx);
+#elif defined(COMPILER_MSVC)
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    result.eax = info[0];
+    result.ebx = info[1];
+    result.ecx = info[2];
+    result.edx = info[3];
+#endif
+    return result;
+}
+
+static uint64_t get_extended_control_register(uint32_t index)
+{
+#if defined(COMPILER_GCC)
+    uint32_t low;
+    uint32_t high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(index));
+    return ((uint64_t) high << 32) | low;
+#elif defined(COMPILER_MSVC)
+    return _xgetbv(index);
+#endif
+}
+
+static bool is_memory_kernel_type_supported(MemoryKernelType type)
+{
+    switch(type)
+    {
+        case MEMORY_KERNEL_TYPE_BYTE:
+        case MEMORY_KERNEL_TYPE_WORD:
+        {
+            return true;
+        }
+        case MEMORY_KERNEL_TYPE_SSE2:
+        {
+            CpuidResult features = cpuid(1, 0);
+            return features.edx & (1 << 26);
+        }
+        case MEMORY_KERNEL_TYPE_AVX2:
+        {
+            CpuidResult highest = cpuid(0, 0);
+            if(highest.eax < 7)
+            {
+                return false;
+            }
+            // The OS also has to save the upper halves of the AVX registers
+            // on context switches, or they can't be used.
+            CpuidResult features = cpuid(1, 0);
+            bool osxsave = features.ecx & (1 << 27);
+            bool avx = features.ecx & (1 << 28);
+            if(!osxsave || !avx)
+            {
+                return false;
+            }
+            uint64_t enabled_state = get_extended_control_register(0);
+            if((enabled_state & 0x6) != 0x6)
+            {
+                return false;
+            }
+            CpuidResult extended_features = cpuid(7, 0);
+            return extended_features.ebx & (1 << 5);
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+#else
+
+static bool is_memory_kernel_type_supported(MemoryKernelType type)
+{
+    return type == MEMORY_KERNEL_TYPE_BYTE || type == MEMORY_KERNEL_TYPE_WORD;
+}
+
+#endif // defined(INSTRUCTION_SET_X86) || defined(INSTRUCTION_SET_X64)
+
+static void copy_forward_unselected(uint8_t* to, const uint8_t* from, uint64_t bytes);
+static void copy_backward_unselected(uint8_t* to, const uint8_t* from, uint64_t bytes);
+static void zero_unselected(uint8_t* memory, uint64_t bytes);
+
+static MemoryKernels memory_kernels =
+{
+    .copy_forward = copy_forward_unselected,
+    .copy_backward = copy_backward_unselected,
+    .zero = zero_unselected,
+};
+
+static MemoryKernelType memory_kernel_type = MEMORY_KERNEL_TYPE_COUNT;
+
+bool set_memory_kernel_type(MemoryKernelType type)
+{
+    if(!is_memory_kernel_type_supported(type))
+    {
+        return false;
+    }
+
+    MemoryKernels kernels;
+    switch(type)
+    {
+        default:
+        case MEMORY_KERNEL_TYPE_BYTE:
+        {
+            kernels.copy_forward = copy_forward_bytes;
+            kernels.copy_backward = copy_backward_bytes;
+            kernels.zero = zero_bytes;
+            break;
+        }
+        case MEMORY_KERNEL_TYPE_WORD:
+        {
+            kernels.copy_forward = copy_forward_words;
+            kernels.copy_backward = copy_backward_words;
+            kernels.zero = zero_words;
+            break;
+        }
+#if defined(INSTRUCTION_SET_X86) || defined(INSTRUCTION_SET_X64)
+        case MEMORY_KERNEL_TYPE_SSE2:
+        {
+            kernels.copy_forward = copy_forward_sse2;
+            kernels.copy_backward = copy_backward_sse2;
+            kernels.zero = zero_sse2;
+            break;
+        }
+        case MEMORY_KERNEL_TYPE_AVX2:
+        {
+            kernels.copy_forward = copy_forward_avx2;
+            kernels.copy_backward = copy_backward_avx2;
+            kernels.zero = zero_avx2;
+            break;
+        }
+#endif
+    }
+
+    memory_kernels = kernels;
+    memory_kernel_type = type;
+
+    return true;
+}
+
+MemoryKernelType get_memory_kernel_type()
+{
+    if(memory_kernel_type == MEMORY_KERNEL_TYPE_COUNT)
+    {
+        for(int type = MEMORY_KERNEL_TYPE_COUNT - 1; type >= 0; type -= 1)
+        {
+            if(set_memory_kernel_type((MemoryKernelType) type))
+            {
+                break;
+            }
+        }
+    }
+    return memory_kernel_type;
+}
+
+static void copy_forward_unselected(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    get_memory_kernel_type();
+    memory_kernels.copy_forward(to, from, bytes);
+}
+
+static void copy_backward_unselected(uint8_t* to, const uint8_t* from, uint64_t bytes)
+{
+    get_memory_kernel_type();
+    memory_kernels.copy_backward(to, from, bytes);
+}
+
+static void zero_unselected(uint8_t* memory, uint64_t bytes)
+{
+    get_memory_kernel_type();
+    memory_kernels.zero(memory, bytes);
+}
+
+void copy_memory(void* to, const void* from, uint64_t bytes)
+{
+    const uint8_t* p0 = (const uint8_t*) from;
+    uint8_t* p1 = (uint8_t*) to;
+    if(p0 < p1 && p1 < p0 + bytes)
+    {
+        // The end of the source overlaps the start of the destination, so
+        // copy from the end backwards to avoid overwriting it before it's
+        // copied.
+        memory_kernels.copy_backward(p1, p0, bytes);
+    }
+    else
+    {
+        memory_kernels.copy_forward(p1, p0, bytes);
+    }
+}
+
+void zero_memory(void* memory, uint64_t bytes)
+{
+    memory_kernels.zero((uint8_t*) memory, bytes);
+}
+
+// Memory Accounting............................................................
+
+// Allocators on any thread can share a tag, so the counts are only ever changed
+// atomically.
+static MemoryTagInfo memory_tag_infos[MEMORY_TAG_COUNT];
+
+// Every heap made with heap_create is kept here, so the free space in each can
+// be checked for fragmentation without having to walk its blocks.
+#define LIVE_HEAP_CAP 32
+
+static Heap* live_heaps[LIVE_HEAP_CAP];
+static int live_heaps_count;
+static SpinLock live_heaps_lock;
+
+static void raise_peak(MemoryTagInfo* info, uint64_t live_bytes)
+{
+    uint64_t peak = atomic_uint64_load(&info->peak_bytes);
+    while(live_bytes > peak)
+    {
+        if(atomic_uint64_compare_exchange(&info->peak_bytes, &peak, live_bytes))
+        {
+            break;
+        }
+    }
+}
+
+static void account_allocate(MemoryTag tag, uint64_t bytes)
+{
+    MemoryTagInfo* info = &memory_tag_infos[tag];
+    uint64_t live_bytes = atomic_uint64_add(&info->live_bytes, bytes) + bytes;
+    atomic_uint64_add(&info->live_allocations, 1);
+    atomic_uint64_add(&info->total_allocations, 1);
+    raise_peak(info, live_bytes);
+}
+
+// A run of pool objects counts as one allocation for each object in it.
+static void account_allocate_run(MemoryTag tag, uint64_t object_bytes, uint32_t count)
+{
+    MemoryTagInfo* info = &memory_tag_infos[tag];
+    uint64_t bytes = object_bytes * count;
+    uint64_t live_bytes = atomic_uint64_add(&info->live_bytes, bytes) + bytes;
+    atomic_uint64_add(&info->live_allocations, count);
+    atomic_uint64_add(&info->total_allocations, count);
+    raise_peak(info, live_bytes);
+}
+
+static void account_deallocate(MemoryTag tag, uint64_t bytes)
+{
+    MemoryTagInfo* info = &memory_tag_infos[tag];
+    uint64_t prior_bytes = atomic_uint64_subtract(&info->live_bytes, bytes);
+    uint64_t prior_allocations = atomic_uint64_subtract(&info->live_allocations, 1);
+    ASSERT(prior_bytes >= bytes && prior_allocations > 0);
+}
+
+static void account_resize(MemoryTag tag, uint64_t prior_bytes, uint64_t bytes)
+{
+    MemoryTagInfo* info = &memory_tag_infos[tag];
+    uint64_t live_bytes = atomic_uint64_add(&info->live_bytes, bytes - prior_bytes) + bytes - prior_bytes;
+    raise_peak(info, live_bytes);
+}
+
+static void account_reserve(MemoryTag tag, uint64_t bytes)
+{
+    atomic_uint64_add(&memory_tag_infos[tag].reserved_bytes, bytes);
+}
+
+// Move everything an allocator has in use from one tag to another, or release
+// it from a tag if it's being destroyed.
+static void account_move(MemoryTag from, MemoryTag to, uint64_t live_bytes, uint64_t live_allocations, uint64_t reserved_bytes, bool destroying)
+{
+    MemoryTagInfo* prior = &memory_tag_infos[from];
+    atomic_uint64_subtract(&prior->live_bytes, live_bytes);
+    atomic_uint64_subtract(&prior->live_allocations, live_allocations);
+    atomic_uint64_subtract(&prior->reserved_bytes, reserved_bytes);
+
+    if(!destroying)
+    {
+        MemoryTagInfo* info = &memory_tag_infos[to];
+        uint64_t total = atomic_uint64_add(&info->live_bytes, live_bytes) + live_bytes;
+        atomic_uint64_add(&info->live_allocations, live_allocations);
+        atomic_uint64_add(&info->reserved_bytes, reserved_bytes);
+        raise_peak(info, total);
+    }
+}
+
+// Only the owner changes its heap's counts, so they're read and modified
+// without contention, and only stored atomically so that they can be read from
+// other threads.
+static void account_heap_allocate(Heap* heap, uint64_t bytes)
+{
+    if(!heap->owner)
+    {
+        account_allocate(heap->tag, bytes);
+        return;
+    }
+    HeapCounts* counts = &heap->counts;
+    uint64_t live_bytes = counts->live_bytes + bytes;
+    atomic_uint64_store(&counts->live_bytes, live_bytes);
+    atomic_uint64_store(&counts->live_allocations, counts->live_allocations + 1);
+    atomic_uint64_store(&counts->total_allocations, counts->total_allocations + 1);
+    if(live_bytes > counts->peak_bytes)
+    {
+        atomic_uint64_store(&counts->peak_bytes, live_bytes);
+    }
+}
+
+static void account_heap_deallocate(Heap* heap, uint64_t bytes)
+{
+    if(!heap->owner)
+    {
+        account_deallocate(heap->tag, bytes);
+        return;
+    }
+    HeapCounts* counts = &heap->counts;
+    ASSERT(counts->live_bytes >= bytes && counts->live_allocations > 0);
+    atomic_uint64_store(&counts->live_bytes, counts->live_bytes - bytes);
+    atomic_uint64_store(&counts->live_allocations, counts->live_allocations - 1);
+}
+
+static void account_heap_resize(Heap* heap, uint64_t prior_bytes, uint64_t bytes)
+{
+    if(!heap->owner)
+    {
+        account_resize(heap->tag, prior_bytes, bytes);
+        return;
+    }
+    HeapCounts* counts = &heap->counts;
+    uint64_t live_bytes = counts->live_bytes + bytes - prior_bytes;
+    atomic_uint64_store(&counts->live_bytes, live_bytes);
+    if(live_bytes > counts->peak_bytes)
+    {
+        atomic_uint64_store(&counts->peak_bytes, live_bytes);
+    }
+}
+
+// Give the tag the allocations a heap has made so far and its peak, before the
+// heap changes tag or goes away. Its live counts are left, since they're only
+// ever added in while the heap is alive. This has to be done with the live
+// heaps locked, so that nothing reading the counts sees them twice.
+static void retire_heap_counts(Heap* heap)
+{
+    HeapCounts* counts = &heap->counts;
+    MemoryTagInfo* info = &memory_tag_infos[heap->tag];
+    atomic_uint64_add(&info->total_allocations, counts->total_allocations);
+    raise_peak(info, counts->peak_bytes);
+    atomic_uint64_store(&counts->total_allocations, 0);
+    atomic_uint64_store(&counts->peak_bytes, counts->live_bytes);
+}
+
+static void add_live_heap(Heap* heap)
+{
+    spin_lock_acquire(&live_heaps_lock);
+    ASSERT(live_heaps_count < LIVE_HEAP_CAP);
+    if(live_heaps_count < LIVE_HEAP_CAP)
+    {
+        live_heaps[live_heaps_count] = heap;
+        live_heaps_count += 1;
+    }
+    spin_lock_release(&live_heaps_lock);
+}
+
+static void remove_live_heap(Heap* heap)
+{
+    spin_lock_acquire(&live_heaps_lock);
+    if(heap->owner)
+    {
+        retire_heap_counts(heap);
+    }
+    for(int i = 0; i < live_heaps_count; i += 1)
+    {
+        if(live_heaps[i] == heap)
+        {
+            live_heaps_count -= 1;
+            live_heaps[i] = live_heaps[live_heaps_count];
+            break;
+        }
+    }
+    spin_lock_release(&live_heaps_lock);
+}
+
+MemoryTagInfo get_memory_tag_info(MemoryTag tag)
+{
+    ASSERT(tag >= 0 && tag < MEMORY_TAG_COUNT);
+
+    MemoryTagInfo* counts = &memory_tag_infos[tag];
+    MemoryTagInfo info = {0};
+    info.live_bytes = atomic_uint64_load(&counts->live_bytes);
+    info.peak_bytes = atomic_uint64_load(&counts->peak_bytes);
+    info.reserved_bytes = atomic_uint64_load(&counts->reserved_bytes);
+    info.live_allocations = atomic_uint64_load(&counts->live_allocations);
+    info.total_allocations = atomic_uint64_load(&counts->total_allocations);
+
+    // Heaps with an owner keep their own counts, which are added in here.
+    //
+    // Fragmentation is how much of the free space can't be handed out in a
+    // single allocation. Only heaps count, since a pool's free space always
+    // fits its objects. Heaps belonging to other threads can't be looked into
+    // while they're in use, so they're left out.
+    uint64_t thread_id = thread_get_id();
+    spin_lock_acquire(&live_heaps_lock);
+    for(int i = 0; i < live_heaps_count; i += 1)
+    {
+        Heap* heap = live_heaps[i];
+        if(heap->tag != tag)
+        {
+            continue;
+        }
+        if(heap->owner)
+        {
+            HeapCounts* heap_counts = &heap->counts;
+            info.live_bytes += atomic_uint64_load(&heap_counts->live_bytes);
+            info.live_allocations += atomic_uint64_load(&heap_counts->live_allocations);
+            info.total_allocations += atomic_uint64_load(&heap_counts->total_allocations);
+            uint64_t heap_peak = atomic_uint64_load(&heap_counts->peak_bytes);
+            if(heap_peak > info.peak_bytes)
+            {
+                info.peak_bytes = heap_peak;
+            }
+        }
+        if(!heap->owner || heap->owner == thread_id)
+        {
+            info.free_bytes += sizeof(HeapBlock) * heap->free_blocks;
+            uint64_t largest = heap_get_largest_free_size(heap);
+            if(largest > info.largest_free_bytes)
+            {
+                info.largest_free_bytes = largest;
+            }
+        }
+    }
+    spin_lock_release(&live_heaps_lock);
+    if(info.live_bytes > info.peak_bytes)
+    {
+        info.peak_bytes = info.live_bytes;
+    }
+    if(info.free_bytes)
+    {
+        info.fragmentation = 1.0f - ((float) info.largest_free_bytes / (float) info.free_bytes);
+    }
+
+    return info;
+}
+
+const char* describe_memory_tag(MemoryTag tag)
+{
+    switch(tag)
+    {
+        default:
+        case MEMORY_TAG_UNTAGGED: return "untagged";
+        case MEMORY_TAG_EDITOR:   return "editor";
+        case MEMORY_TAG_MESH:     return "mesh";
+        case MEMORY_TAG_PLATFORM: return "platform";
+        case MEMORY_TAG_VIDEO:    return "video";
+    }
+}
+
+// Allocation Trace.............................................................
+
+// Events go in a buffer that's reserved up front and committed as it fills,
+// so that recording never allocates from anything it's recording.
+typedef struct TraceRecorder
+{
+    uint8_t* memory;
+    uint64_t committed;
+    uint64_t reserved;
+    uint64_t events_count;
+    const void* allocators[ALLOCATION_TRACE_ALLOCATOR_CAP];
+    int allocators_count;
+    SpinLock lock;
+    volatile int recording;
+    bool truncated;
+} TraceRecorder;
+
+static TraceRecorder trace_recorder;
+
+static int find_trace_allocator(TraceRecorder* recorder, const void* allocator)
+{
+    for(int i = 0; i < recorder->allocators_count; i += 1)
+    {
+        if(recorder->allocators[i] == allocator)
+        {
+            return i;
+        }
+    }
+    if(recorder->allocators_count >= ALLOCATION_TRACE_ALLOCATOR_CAP)
+    {
+        return -1;
+    }
+    int index = recorder->allocators_count;
+    recorder->allocators[index] = allocator;
+    recorder->allocators_count += 1;
+    return index;
+}
+
+// Deallocations have to be recorded before the memory is freed and allocations
+// after, or else another thread could be handed the same address and record it
+// in-between.
+//
+// An event that can't be recorded truncates the trace, and nothing after it is
+// recorded either, rather than it being dropped or put on the wrong allocator.
+// That way a replay of the trace is never of something that didn't happen.
+static void record_event(AllocationEventType type, const void* allocator, const void* address, const void* result, uint32_t bytes)
+{
+    TraceRecorder* recorder = &trace_recorder;
+    if(!atomic_int_load(&recorder->recording))
+    {
+        return;
+    }
+
+    spin_lock_acquire(&recorder->lock);
+
+    if(recorder->recording && !recorder->truncated)
+    {
+        uint64_t offset = sizeof(AllocationTraceHeader) + sizeof(AllocationEvent) * recorder->events_count;
+        uint64_t needed = offset + sizeof(AllocationEvent);
+        int allocator_index = find_trace_allocator(recorder, allocator);
+        if(allocator_index != -1
+                && (needed <= recorder->committed || commit_more(recorder->memory, &recorder->committed, needed, recorder->reserved)))
+        {
+            AllocationEvent* event = (AllocationEvent*) (recorder->memory + offset);
+            event->address = (uintptr_t) address;
+            event->result = (uintptr_t) result;
+            event->bytes = bytes;
+            event->type = (uint8_t) type;
+            event->allocator = (uint8_t) allocator_index;
+            event->padding = 0;
+            recorder->events_count += 1;
+        }
+        else
+        {
+            recorder->truncated = true;
+        }
+    }
+
+    spin_lock_release(&recorder->lock);
+}
+
+bool allocation_trace_start(uint64_t reserve_bytes)
+{
+    TraceRecorder* recorder = &trace_recorder;
+    ASSERT(!recorder->recording);
+    ASSERT(reserve_bytes > sizeof(AllocationTraceHeader));
+
+    allocation_trace_release();
+
+    recorder->memory = (uint8_t*) virtual_reserve(reserve_bytes);
+    if(!recorder->memory)
+    {
+        return false;
+    }
+    recorder->reserved = reserve_bytes;
+    recorder->committed = 0;
+    if(!commit_more(recorder->memory, &recorder->committed, sizeof(AllocationTraceHeader), reserve_bytes))
+    {
+        allocation_trace_release();
+        return false;
+    }
+    recorder->events_count = 0;
+    recorder->allocators_count = 0;
+    recorder->truncated = false;
+
+    atomic_int_store(&recorder->recording, 1);
+
+    return true;
+}
+
+AllocationTrace allocation_trace_stop()
+{
+    TraceRecorder* recorder = &trace_recorder;
+
+    spin_lock_acquire(&recorder->lock);
+    atomic_int_store(&recorder->recording, 0);
+    spin_lock_release(&recorder->lock);
+
+    AllocationTrace trace = {0};
+    if(recorder->memory)
+    {
+        trace.header = (AllocationTraceHeader*) recorder->memory;
+        trace.header->magic = ALLOCATION_TRACE_MAGIC;
+        trace.header->version = ALLOCATION_TRACE_VERSION;
+        trace.header->events_count = recorder->events_count;
+        trace.header->truncated = recorder->truncated;
+        trace.header->padding = 0;
+        trace.events = (AllocationEvent*) (trace.header + 1);
+        trace.bytes = sizeof(AllocationTraceHeader) + sizeof(AllocationEvent) * recorder->events_count;
+    }
+    return trace;
+}
+
+void allocation_trace_release()
+{
+    TraceRecorder* recorder = &trace_recorder;
+    ASSERT(!recorder->recording);
+    if(recorder->memory)
+    {
+        virtual_release(recorder->memory, recorder->reserved);
+    }
+    recorder->memory = NULL;
+    recorder->committed = 0;
+    recorder->reserved = 0;
+    recorder->events_count = 0;
+}
+
+bool allocation_trace_is_recording()
+{
+    return atomic_int_load(&trace_recorder.recording);
+}
+
+// Stack........................................................................
+
+static bool create_stack(Stack* stack, uint64_t reserve_bytes, uint64_t commit_bytes)
+{
+    stack->memory = (uint8_t*) virtual_reserve(reserve_bytes);
+    stack->top = 0;
+    stack->committed = 0;
+    stack->bytes = 0;
+    if(!stack->memory)
+    {
+        return false;
+    }
+    if(!virtual_commit(stack->memory, commit_bytes))
+    {
+        virtual_release(stack->memory, reserve_bytes);
+        stack->memory = NULL;
+        return false;
+    }
+    stack->committed = commit_bytes;
+    stack->bytes = reserve_bytes;
+    return true;
+}
+
+bool stack_create(Stack* stack, uint64_t bytes)
+{
+    return create_stack(stack, bytes, bytes);
+}
+
+bool stack_create_growable(Stack* stack, uint64_t reserve_bytes)
+{
+    uint64_t commit_bytes = COMMIT_GRANULARITY;
+    if(commit_bytes > reserve_bytes)
+    {
+        commit_bytes = reserve_bytes;
+    }
+    return create_stack(stack, reserve_bytes, commit_bytes);
+}
+
+void stack_destroy(Stack* stack)
+{
+    if(stack)
+    {
+        if(stack->memory)
+        {
+            virtual_release(stack->memory, stack->bytes);
+            stack->memory = NULL;
+        }
+        stack->top = 0;
+        stack->committed = 0;
+        stack->bytes = 0;
+    }
+}
+
+// Make sure everything up to the given top is committed.
+static bool reach_stack_top(Stack* stack, uint64_t top)
+{
+    if(top <= stack->committed)
+    {
+        return true;
+    }
+    return commit_more(stack->memory, &stack->committed, top, stack->bytes);
+}
+
+void* stack_allocate(Stack* stack, uint32_t bytes)
+{
+    uint64_t prior_top = stack->top;
+    uint32_t header_size = sizeof(prior_top);
+    uint8_t* top = stack->memory + stack->top;
+
+    // ARM Neon's 4 lane 32-bit vector types and Intel AVX-256 packed types ask
+    // for 32 byte aligned addresses (This isn't a hard requirement under Neon,
+    // but it is faster). It doesn't hurt to just align everything to support
+    // these easily.
+    //
+    // If Intel AVX-512 support is added, this should be bumped up to 64 bytes
+    // to align accesses for its 512-bit registers.
+    const uint32_t alignment = 32;
+    uintptr_t address = (uintptr_t) (top + header_size);
+    uint32_t adjustment = alignment - (address & (alignment - 1));
+    if(adjustment == alignment)
+    {
+        adjustment = 0;
+    }
+
+    uint64_t total_bytes = (uint64_t) adjustment + header_size + bytes;
+    if(!reach_stack_top(stack, stack->top + total_bytes))
+    {
+        return NULL;
+    }
+    stack->top += total_bytes;
+
+    top += adjustment;
+    *((uint64_t*) top) = prior_top;
+
+    void* result = top + header_size;
+    zero_memory(result, bytes);
+    ASSERT(is_aligned(result, alignment));
+    record_event(ALLOCATION_EVENT_TYPE_STACK_ALLOCATE, stack, NULL, result, bytes);
+    return result;
+}
+
+void* stack_reallocate(Stack* stack, void* memory, uint32_t bytes)
+{
+    if(!memory)
+    {
+        return stack_allocate(stack, bytes);
+    }
+    if(bytes == 0)
+    {
+        stack_deallocate(stack, memory);
+        return NULL;
+    }
+
+    uint8_t* place = (uint8_t*) memory;
+    uint64_t present_bytes = stack->top - (place - stack->memory);
+    if(bytes <= present_bytes)
+    {
+        record_event(ALLOCATION_EVENT_TYPE_STACK_REALLOCATE, stack, memory, memory, bytes);
+        return memory;
+    }
+    uint64_t more_bytes = bytes - present_bytes;
+    if(!reach_stack_top(stack, stack->top + more_bytes))
+    {
+        return NULL;
+    }
+
+    zero_memory(&stack->memory[stack->top], more_bytes);
+    stack->top += more_bytes;
+
+    record_event(ALLOCATION_EVENT_TYPE_STACK_REALLOCATE, stack, memory, memory, bytes);
+    return memory;
+}
+
+void stack_deallocate(Stack* stack, void* memory)
+{
+    record_event(ALLOCATION_EVENT_TYPE_STACK_DEALLOCATE, stack, memory, NULL, 0);
+    uint64_t* header = ((uint64_t*) memory) - 1;
+    uint64_t prior_top = *header;
+    stack->top = prior_top;
+}
+
+// Arena........................................................................
+
+void arena_create(Arena* arena, uint32_t bytes)
+{
+    arena->memory = (uint8_t*) virtual_allocate(bytes);
+    arena->top = 0;
+    arena->bytes = bytes;
+}
+
+void arena_destroy(Arena* arena)
+{
+    if(arena)
+    {
+        SAFE_VIRTUAL_DEALLOCATE(arena->memory);
+        arena->top = 0;
+        arena->bytes = 0;
+    }
+}
+
+void* arena_allocate(Arena* arena, uint32_t bytes)
+{
+    // Use the same alignment as stack_allocate, but without a header, since
+    // allocations are only ever given back in bulk.
+    const uint32_t alignment = 32;
+    uintptr_t address = (uintptr_t) (arena->memory + arena->top);
+    uint32_t adjustment = (uint32_t) (-address & (alignment - 1));
+    uint32_t start = arena->top + adjustment;
+
+    if((uint64_t) start + bytes > arena->bytes)
+    {
+        return NULL;
+    }
+    arena->top = start + bytes;
+
+    void* result = arena->memory + start;
+    zero_memory(result, bytes);
+    return result;
+}
+
+ArenaMark arena_mark(Arena* arena)
+{
+    ArenaMark mark;
+    mark.top = arena->top;
+    return mark;
+}
+
+void arena_reset_to_mark(Arena* arena, ArenaMark mark)
+{
+    ASSERT(mark.top <= arena->top);
+    arena->top = mark.top;
+}
+
+void arena_reset(Arena* arena)
+{
+    arena->top = 0;
+}
+
+// Pool.........................................................................
+
+static int count_occupancy_words(uint32_t object_count)
+{
+    return (object_count + 63) / 64;
+}
+
+void* pool_iterator_next(PoolIterator* it)
+{
+    Pool* pool = it->pool;
+
+    // Skip over any words with no bits set, since they mark 64 free objects
+    // in a row.
+    while(!it->bits)
+    {
+        if(it->chunk_index >= pool->chunks_count)
+        {
+            return NULL;
+        }
+        PoolChunk* chunk = &pool->chunks[it->chunk_index];
+        it->word_index += 1;
+        if(it->word_index >= count_occupancy_words(chunk->object_count))
+        {
+            it->chunk_index += 1;
+            it->word_index = -1;
+            continue;
+        }
+        if(chunk->first_index + 64 * (uint32_t) it->word_index >= it->end)
+        {
+            it->chunk_index = pool->chunks_count;
+            return NULL;
+        }
+        it->bits = chunk->occupancy[it->word_index];
+    }
+
+    int index = (64 * it->word_index) + count_trailing_zeros(it->bits);
+    it->bits &= it->bits - 1;
+
+    return pool->chunks[it->chunk_index].memory + (pool->object_size * index);
+}
+
+void* pool_iterator_create(PoolIterator* it, Pool* pool)
+{
+    it->pool = pool;
+    it->bits = 0;
+    it->end = UINT32_MAX;
+    it->chunk_index = 0;
+    it->word_index = -1;
+    return pool_iterator_next(it);
+}
+
+// Past the first chunk, each chunk starts at the next power of two, so the top
+// set bit of an index picks out its chunk.
+static int find_chunk_index(Pool* pool, uint32_t index)
+{
+    uint32_t high = index >> pool->first_chunk_shift;
+    return high ? find_last_set(high) + 1 : 0;
+}
+
+// Every chunk past the first starts at a power of two that's at least the size
+// of the first chunk. So, a start that's a multiple of 64 falls either in the
+// first chunk or at the start of an occupancy word.
+void* pool_iterator_create_range(PoolIterator* it, Pool* pool, uint32_t start, uint32_t end)
+{
+    ASSERT(start % POOL_RANGE_ALIGNMENT == 0);
+    ASSERT(end % POOL_RANGE_ALIGNMENT == 0 || end >= pool->object_count);
+
+    it->pool = pool;
+    it->bits = 0;
+    it->end = end;
+    if(start >= pool->object_count)
+    {
+        it->chunk_index = pool->chunks_count;
+        it->word_index = -1;
+        return NULL;
+    }
+    it->chunk_index = find_chunk_index(pool, start);
+    it->word_index = (int) ((start - pool->chunks[it->chunk_index].first_index) / 64) - 1;
+    return pool_iterator_next(it);
+}
+
+static bool add_chunk(Pool* pool, uint32_t object_count)
+{
+    if(pool->chunks_count >= POOL_CHUNK_CAP
+            || object_count > UINT32_MAX - pool->object_count)
+    {
+        return false;
+    }
+
+    // Put the occupancy bitmap after the objects, aligned so its words can be
+    // read whole.
+    uint64_t object_bytes = (uint64_t) pool->object_size * object_count;
+    object_bytes = (object_bytes + 7) & ~((uint64_t) 7);
+    uint64_t occupancy_bytes = sizeof(uint64_t) * count_occupancy_words(object_count);
+    uint8_t* memory = (uint8_t*) virtual_allocate(object_bytes + occupancy_bytes);
+    if(!memory)
+    {
+        return false;
+    }
+
+    PoolChunk* chunk = &pool->chunks[pool->chunks_count];
+    chunk->memory = memory;
+    chunk->occupancy = (uint64_t*) (memory + object_bytes);
+    chunk->object_count = object_count;
+    chunk->first_index = pool->object_count;
+    pool->chunks_count += 1;
+    pool->object_count += object_count;
+    account_reserve(pool->tag, (uint64_t) pool->object_size * object_count);
+
+    // A chunk is only added once the free list is empty, so its objects can
+    // be handed out sequentially straight from the chunk.
+    ASSERT(!pool->free_list);
+    pool->untouched = memory;
+    pool->untouched_end = memory + (uint64_t) pool->object_size * object_count;
+
+    zero_memory(chunk->occupancy, occupancy_bytes);
+
+    return true;
+}
+
+bool pool_create(Pool* pool, uint32_t object_size, uint32_t object_count)
+{
+    // The free list can't fit in empty slots unless objects are at least as
+    // large as a pointer.
+    ASSERT(object_size >= sizeof(void*));
+    ASSERT(object_count > 0);
+
+    // Each empty slot holds a pointer, so slots are spaced to keep those
+    // aligned, even for objects that are only aligned to four bytes.
+    object_size = (uint32_t) (((uint64_t) object_size + sizeof(void*) - 1) & ~(uint64_t) (sizeof(void*) - 1));
+
+    int shift = 0;
+    while(shift < 31 && (UINT32_C(1) << shift) < object_count)
+    {
+        shift += 1;
+    }
+
+    pool->free_list = NULL;
+    pool->untouched = NULL;
+    pool->untouched_end = NULL;
+    pool->object_size = object_size;
+    pool->object_count = 0;
+    pool->used_count = 0;
+    pool->chunks_count = 0;
+    pool->first_chunk_shift = shift;
+    pool->tag = MEMORY_TAG_UNTAGGED;
+
+    return add_chunk(pool, UINT32_C(1) << shift);
+}
+
+void pool_destroy(Pool* pool)
+{
+    if(pool)
+    {
+        uint64_t live_bytes = (uint64_t) pool->object_size * pool->used_count;
+        uint64_t reserved_bytes = (uint64_t) pool->object_size * pool->object_count;
+        account_move(pool->tag, pool->tag, live_bytes, pool->used_count, reserved_bytes, true);
+
+        for(int i = 0; i < pool->chunks_count; i += 1)
+        {
+            PoolChunk* chunk = &pool->chunks[i];
+            SAFE_VIRTUAL_DEALLOCATE(chunk->memory);
+            chunk->occupancy = NULL;
+            chunk->object_count = 0;
+        }
+        pool->free_list = NULL;
+        pool->untouched = NULL;
+        pool->untouched_end = NULL;
+        pool->object_count = 0;
+        pool->used_count = 0;
+        pool->chunks_count = 0;
+    }
+}
+
+// The later chunks are the larger ones, so most objects are found quickest by
+// searching backward.
+static PoolChunk* find_chunk(Pool* pool, void* object, uint32_t* index)
+{
+    uint8_t* place = (uint8_t*) object;
+    for(int i = pool->chunks_count - 1; i >= 0; i -= 1)
+    {
+        PoolChunk* chunk = &pool->chunks[i];
+        uint64_t offset = (uint64_t) (place - chunk->memory);
+        if(place >= chunk->memory && offset < (uint64_t) pool->object_size * chunk->object_count)
+        {
+            *index = (uint32_t) (offset / pool->object_size);
+            return chunk;
+        }
+    }
+    ASSERT(false); // The object isn't from this pool.
+    return NULL;
+}
+
+static void mark_occupancy(Pool* pool, void* object, bool used)
+{
+    uint32_t index;
+    PoolChunk* chunk = find_chunk(pool, object, &index);
+    uint64_t bit = ((uint64_t) 1) << (index % 64);
+    if(used)
+    {
+        chunk->occupancy[index / 64] |= bit;
+    }
+    else
+    {
+        chunk->occupancy[index / 64] &= ~bit;
+    }
+}
+
+void* pool_allocate(Pool* pool)
+{
+    void* next_free;
+    if(pool->free_list)
+    {
+        next_free = pool->free_list;
+        pool->free_list = ((void**) *pool->free_list);
+    }
+    else
+    {
+        if(pool->untouched == pool->untouched_end)
+        {
+            // Double the capacity of the pool.
+            bool added = add_chunk(pool, pool->object_count);
+            if(!added)
+            {
+                ASSERT(false);
+                return NULL;
+            }
+        }
+        next_free = pool->untouched;
+        pool->untouched += pool->object_size;
+    }
+    mark_occupancy(pool, next_free, true);
+    *((void**) next_free) = NULL;
+    pool->used_count += 1;
+    account_allocate(pool->tag, pool->object_size);
+    record_event(ALLOCATION_EVENT_TYPE_POOL_ALLOCATE, pool, NULL, next_free, pool->object_size);
+    return next_free;
+}
+
+// A run always comes from the newest chunk, so its bits are all in the one
+// bitmap, and whole words of them are set at once.
+static void mark_run_occupied(Pool* pool, void* first, uint32_t count)
+{
+    uint32_t start;
+    PoolChunk* chunk = find_chunk(pool, first, &start);
+    uint32_t end = start + count;
+    for(uint32_t i = start; i < end;)
+    {
+        uint32_t bit = i % 64;
+        uint32_t bits = 64 - bit;
+        if(bits > end - i)
+        {
+            bits = end - i;
+        }
+        uint64_t mask = (bits == 64) ? ~UINT64_C(0) : (((UINT64_C(1) << bits) - 1) << bit);
+        chunk->occupancy[i / 64] |= mask;
+        i += bits;
     }
+}
 
-    uint32_t total_bytes = adjustment + header_size + bytes;
-    if(stack->top + total_bytes > stack->bytes)
+void* pool_allocate_run(Pool* pool, uint32_t count)
+{
+    ASSERT(count > 0);
+    uint64_t bytes = (uint64_t) pool->object_size * count;
+    if((uint64_t) (pool->untouched_end - pool->untouched) < bytes)
     {
         return NULL;
     }
-    stack->top += total_bytes;
+    uint8_t* run = pool->untouched;
+    pool->untouched += bytes;
+    mark_run_occupied(pool, run, count);
+    pool->used_count += count;
+    account_allocate_run(pool->tag, pool->object_size, count);
+    for(uint32_t i = 0; i < count; i += 1)
+    {
+        record_event(ALLOCATION_EVENT_TYPE_POOL_ALLOCATE, pool, NULL, run + (uint64_t) pool->object_size * i, pool->object_size);
+    }
+    return run;
+}
 
-    top += adjustment;
-    *((uint32_t*) top) = prior_top;
+void pool_deallocate(Pool* pool, void* memory)
+{
+    ASSERT(memory);
+    record_event(ALLOCATION_EVENT_TYPE_POOL_DEALLOCATE, pool, memory, NULL, pool->object_size);
+    zero_memory(memory, pool->object_size);
+    *((void**) memory) = pool->free_list;
+    pool->free_list = ((void**) memory);
+    mark_occupancy(pool, memory, false);
+    pool->used_count -= 1;
+    account_deallocate(pool->tag, pool->object_size);
+}
 
-    void* result = top + header_size;
-    zero_memory(result, bytes);
-    ASSERT(is_aligned(result, alignment));
-    return result;
+void pool_set_tag(Pool* pool, MemoryTag tag)
+{
+    uint64_t live_bytes = (uint64_t) pool->object_size * pool->used_count;
+    uint64_t reserved_bytes = (uint64_t) pool->object_size * pool->object_count;
+    account_move(pool->tag, tag, live_bytes, pool->used_count, reserved_bytes, false);
+    pool->tag = tag;
 }
 
-void* stack_reallocate(Stack* stack, void* memory, uint32_t bytes)
+uint32_t pool_get_index(Pool* pool, void* object)
 {
-    if(!memory)
+    uint32_t index;
+    PoolChunk* chunk = find_chunk(pool, object, &index);
+    return chunk->first_index + index;
+}
+
+void* pool_get_object(Pool* pool, uint32_t index)
+{
+    ASSERT(index < pool->object_count);
+    PoolChunk* chunk = &pool->chunks[find_chunk_index(pool, index)];
+    return chunk->memory + (uint64_t) pool->object_size * (index - chunk->first_index);
+}
+
+// Heap.........................................................................
+
+#define NEXT_FREE(index)   heap->blocks[index].body.free.next
+#define PREV_FREE(index)   heap->blocks[index].body.free.prior
+#define BLOCK_DATA(index)  heap->blocks[index].body.data
+#define NEXT_BLOCK(index)  heap->blocks[index].header.used.next
+#define PREV_BLOCK(index)  heap->blocks[index].header.used.prior
+
+static const uint32_t freelist_mask = 0x80000000;
+static const uint32_t blockno_mask = 0x7fffffff;
+
+// Block 0 is never free, so its index doubles as the end of a free list.
+static const uint32_t no_block = 0;
+
+typedef struct FreeListIndex
+{
+    int first;
+    int second;
+} FreeListIndex;
+
+static FreeListIndex map_size_to_free_list(uint32_t blocks)
+{
+    FreeListIndex index;
+    if(blocks < HEAP_SECOND_LEVEL_COUNT)
     {
-        return stack_allocate(stack, bytes);
+        index.first = 0;
+        index.second = blocks;
     }
-    if(bytes == 0)
+    else
     {
-        stack_deallocate(stack, memory);
-        return NULL;
+        int power = find_last_set(blocks);
+        index.first = power - HEAP_SECOND_LEVEL_LOG2 + 1;
+        index.second = (blocks >> (power - HEAP_SECOND_LEVEL_LOG2)) ^ HEAP_SECOND_LEVEL_COUNT;
     }
+    return index;
+}
 
-    uint8_t* place = (uint8_t*) memory;
-    uint32_t present_bytes = (uint32_t) (stack->top - (place - stack->memory));
-    uint32_t more_bytes = bytes - present_bytes;
-    if(stack->top + more_bytes > stack->bytes)
+// Every block in a free list is at least as large as the smallest size that
+// maps to it. So, when searching, round the size up to the next list's
+// smallest size to guarantee any block found will fit.
+static FreeListIndex map_size_to_fitting_free_list(uint32_t blocks)
+{
+    if(blocks >= HEAP_SECOND_LEVEL_COUNT)
     {
-        return NULL;
+        int power = find_last_set(blocks);
+        blocks += (1 << (power - HEAP_SECOND_LEVEL_LOG2)) - 1;
     }
-
-    zero_memory(&stack->memory[stack->top], more_bytes);
-    stack->top += more_bytes;
-
-    return memory;
+    return map_size_to_free_list(blocks);
 }
 
-void stack_deallocate(Stack* stack, void* memory)
+static uint32_t get_block_size(Heap* heap, uint32_t c)
 {
-    uint32_t* header = ((uint32_t*) memory) - 1;
-    uint32_t prior_top = *header;
-    stack->top = prior_top;
+    return (NEXT_BLOCK(c) & blockno_mask) - c;
 }
 
-// Pool.........................................................................
-
-void* pool_iterator_next(PoolIterator* it)
+static void add_to_free_list(Heap* heap, uint32_t c)
 {
-    int object_count = it->pool->object_count;
-    do
+    uint32_t blocks = get_block_size(heap, c);
+    FreeListIndex index = map_size_to_free_list(blocks);
+    heap->free_blocks += blocks;
+    uint32_t head = heap->free_lists[index.first][index.second];
+
+    NEXT_FREE(c) = head;
+    PREV_FREE(c) = no_block;
+    if(head != no_block)
     {
-        it->index += 1;
-        if(it->index >= object_count)
-        {
-            return NULL;
-        }
-    } while(it->pool->statuses[it->index] == POOL_BLOCK_STATUS_FREE);
-    return it->pool->memory + (it->pool->object_size * it->index);
-}
+        PREV_FREE(head) = c;
+    }
+    heap->free_lists[index.first][index.second] = c;
+    NEXT_BLOCK(c) |= freelist_mask;
 
-void* pool_iterator_create(PoolIterator* it, Pool* pool)
-{
-    it->pool = pool;
-    it->index = -1;
-    return pool_iterator_next(it);
+    heap->first_level_bitmap |= UINT32_C(1) << index.first;
+    heap->second_level_bitmaps[index.first] |= UINT32_C(1) << index.second;
 }
 
-bool pool_create(Pool* pool, uint32_t object_size, uint32_t object_count)
+static void disconnect_from_free_list(Heap* heap, uint32_t c)
 {
-    // The free list can't fit in empty slots unless objects are at least as
-    // large as a pointer.
-    ASSERT(object_size >= sizeof(void*));
+    uint32_t blocks = get_block_size(heap, c);
+    FreeListIndex index = map_size_to_free_list(blocks);
+    heap->free_blocks -= blocks;
+    uint32_t next = NEXT_FREE(c);
+    uint32_t prior = PREV_FREE(c);
 
-    void* memory = virtual_allocate(object_size * object_count);
-    PoolBlockStatus* statuses = (PoolBlockStatus*) virtual_allocate(sizeof(PoolBlockStatus) * object_count);
-    if(!memory || !statuses)
+    if(next != no_block)
     {
-        return false;
+        PREV_FREE(next) = prior;
     }
+    if(prior != no_block)
+    {
+        NEXT_FREE(prior) = next;
+    }
+    else
+    {
+        heap->free_lists[index.first][index.second] = next;
+        if(next == no_block)
+        {
+            heap->second_level_bitmaps[index.first] &= ~(UINT32_C(1) << index.second);
+            if(!heap->second_level_bitmaps[index.first])
+            {
+                heap->first_level_bitmap &= ~(UINT32_C(1) << index.first);
+            }
+        }
+    }
+    NEXT_BLOCK(c) &= ~freelist_mask;
+}
 
-    pool->memory = (uint8_t*) memory;
-    pool->object_size = object_size;
-    pool->object_count = object_count;
-    pool->free_list = (void**) pool->memory;
-    pool->statuses = statuses;
-
-    void** p = pool->free_list;
-    for(uint32_t i = 0; i < object_count - 1; i += 1)
+static uint32_t find_free_block(Heap* heap, uint32_t blocks)
+{
+    FreeListIndex index = map_size_to_fitting_free_list(blocks);
+    if(index.first >= HEAP_FIRST_LEVEL_COUNT)
     {
-        *p = ((uint8_t*) p) + object_size;
-        p = ((void**) *p);
+        return no_block;
     }
-    *p = NULL;
 
-    for(uint32_t i = 0; i < object_count; i += 1)
+    uint32_t second_map = heap->second_level_bitmaps[index.first] & (UINT32_MAX << index.second);
+    if(!second_map)
     {
-        statuses[i] = POOL_BLOCK_STATUS_FREE;
+        // Nothing fits at this first level, so look for the next largest
+        // first level with any free blocks at all.
+        if(index.first + 1 >= 32)
+        {
+            return no_block;
+        }
+        uint32_t first_map = heap->first_level_bitmap & (UINT32_MAX << (index.first + 1));
+        if(!first_map)
+        {
+            return no_block;
+        }
+        index.first = count_trailing_zeros(first_map);
+        second_map = heap->second_level_bitmaps[index.first];
     }
+    index.second = count_trailing_zeros(second_map);
 
-    return true;
+    return heap->free_lists[index.first][index.second];
 }
 
-void pool_destroy(Pool* pool)
+// Split a block into one of the given size and put whatever's left over back
+// on a free list.
+static void split_block(Heap* heap, uint32_t c, uint32_t blocks)
 {
-    if(pool)
+    uint32_t next = NEXT_BLOCK(c) & blockno_mask;
+    if(next - c <= blocks)
     {
-        SAFE_VIRTUAL_DEALLOCATE(pool->memory);
-        SAFE_VIRTUAL_DEALLOCATE(pool->statuses);
-        pool->free_list = NULL;
+        return;
     }
+    uint32_t rest = c + blocks;
+    NEXT_BLOCK(rest) = next;
+    PREV_BLOCK(rest) = c;
+    PREV_BLOCK(next) = rest;
+    NEXT_BLOCK(c) = rest | (NEXT_BLOCK(c) & freelist_mask);
+    add_to_free_list(heap, rest);
 }
 
-static void mark_block_status(Pool* pool, void* object, PoolBlockStatus status)
+static bool is_free(Heap* heap, uint32_t c)
 {
-    uint8_t* offset = ((uint8_t*) object);
-    int index = (int) ((offset - pool->memory) / pool->object_size);
-    pool->statuses[index] = status;
+    return NEXT_BLOCK(c) & freelist_mask;
 }
 
-void* pool_allocate(Pool* pool)
+// Merge the next block into this one. Neither block can be in a free list.
+static void assimilate_up(Heap* heap, uint32_t c)
 {
-    if(!pool->free_list)
-    {
-        ASSERT(false);
-        return NULL;
-    }
-    void* next_free = pool->free_list;
-    pool->free_list = ((void**) *pool->free_list);
-    mark_block_status(pool, next_free, POOL_BLOCK_STATUS_USED);
-    *((void**) next_free) = NULL;
-    return next_free;
+    uint32_t next = NEXT_BLOCK(c) & blockno_mask;
+    uint32_t after = NEXT_BLOCK(next) & blockno_mask;
+    PREV_BLOCK(after) = c;
+    NEXT_BLOCK(c) = after;
 }
 
-void pool_deallocate(Pool* pool, void* memory)
+static uint32_t get_data_size(uint32_t blocks)
 {
-    ASSERT(memory);
-    zero_memory(memory, pool->object_size);
-    *((void**) memory) = pool->free_list;
-    pool->free_list = ((void**) memory);
-    mark_block_status(pool, memory, POOL_BLOCK_STATUS_FREE);
+    return sizeof(HeapBlock) * blocks - sizeof(HeapBlockHeader);
 }
 
-// Heap.........................................................................
-
-#define DO_BEST_FIT
-
-#define NEXT_FREE(index)   heap->blocks[index].body.free.next
-#define PREV_FREE(index)   heap->blocks[index].body.free.prior
-#define BLOCK_DATA(index)  heap->blocks[index].body.data
-#define NEXT_BLOCK(index)  heap->blocks[index].header.used.next
-#define PREV_BLOCK(index)  heap->blocks[index].header.used.prior
-
-static const uint32_t freelist_mask = 0x80000000;
-static const uint32_t blockno_mask = 0x7fffffff;
-
-void heap_make_in_place(Heap* heap, void* place, uint32_t bytes)
+void heap_make_in_place(Heap* heap, void* place, uint64_t bytes)
 {
     ASSERT(heap);
     ASSERT(place);
-    ASSERT(bytes != 0);
+    ASSERT(bytes != 0 && bytes <= HEAP_MAX_BYTES);
     ASSERT(!heap->blocks); // trying to create an already existent heap
     heap->blocks = (HeapBlock*) place;
     heap->total_blocks = bytes / sizeof(HeapBlock);
+    heap->reserved_blocks = 0;
+    ASSERT(heap->total_blocks >= 3);
+
+    zero_memory(heap->free_lists, sizeof(heap->free_lists));
+    zero_memory(heap->second_level_bitmaps, sizeof(heap->second_level_bitmaps));
+    heap->first_level_bitmap = 0;
+    heap->free_blocks = 0;
+    heap->remote_frees = NULL;
+    heap->owner = 0;
+    zero_memory(&heap->counts, sizeof(heap->counts));
+    heap->tag = MEMORY_TAG_UNTAGGED;
+    account_reserve(heap->tag, sizeof(HeapBlock) * heap->total_blocks);
+
+    // The first and last blocks are sentinels that are never free, so that
+    // the blocks in-between never try to merge past the ends of the heap.
+    uint32_t last = (uint32_t) heap->total_blocks - 1;
     NEXT_BLOCK(0) = 1;
-    NEXT_FREE(0) = 1;
+    PREV_BLOCK(0) = 0;
+    NEXT_BLOCK(1) = last;
+    PREV_BLOCK(1) = 0;
+    NEXT_BLOCK(last) = 0;
+    PREV_BLOCK(last) = 1;
+    add_to_free_list(heap, 1);
 }
 
-bool heap_create(Heap* heap, uint32_t bytes)
+static bool create_heap(Heap* heap, uint64_t reserve_bytes, uint64_t commit_bytes)
 {
-    void* memory = virtual_allocate(bytes);
+    ASSERT(reserve_bytes <= HEAP_MAX_BYTES);
+
+    void* memory = virtual_reserve(reserve_bytes);
     if(!memory)
     {
         return false;
     }
-    heap_make_in_place(heap, memory, bytes);
+    if(!virtual_commit(memory, commit_bytes))
+    {
+        virtual_release(memory, reserve_bytes);
+        return false;
+    }
+    heap_make_in_place(heap, memory, commit_bytes);
+    heap->reserved_blocks = reserve_bytes / sizeof(HeapBlock);
+    add_live_heap(heap);
     return true;
 }
 
+bool heap_create(Heap* heap, uint64_t bytes)
+{
+    return create_heap(heap, bytes, bytes);
+}
+
+bool heap_create_growable(Heap* heap, uint64_t reserve_bytes)
+{
+    uint64_t commit_bytes = COMMIT_GRANULARITY;
+    if(commit_bytes > reserve_bytes)
+    {
+        commit_bytes = reserve_bytes;
+    }
+    return create_heap(heap, reserve_bytes, commit_bytes);
+}
+
 void heap_destroy(Heap* heap)
 {
-    SAFE_VIRTUAL_DEALLOCATE(heap->blocks);
+    if(heap->blocks)
+    {
+        heap_reclaim_remote_frees(heap);
+
+        // A heap with an owner never added its live counts to its tag.
+        HeapInfo info = heap_get_info(heap);
+        uint64_t live_bytes = heap->owner ? 0 : sizeof(HeapBlock) * info.used_blocks;
+        uint64_t live_allocations = heap->owner ? 0 : info.used_entries;
+        uint64_t reserved_bytes = sizeof(HeapBlock) * heap->total_blocks;
+        account_move(heap->tag, heap->tag, live_bytes, live_allocations, reserved_bytes, true);
+        remove_live_heap(heap);
+
+        // Heaps made in place don't own their memory.
+        if(heap->reserved_blocks)
+        {
+            virtual_release(heap->blocks, sizeof(HeapBlock) * heap->reserved_blocks);
+        }
+    }
+    heap->blocks = NULL;
     heap->total_blocks = 0;
+    heap->reserved_blocks = 0;
+    heap->free_blocks = 0;
+    heap->owner = 0;
+}
+
+// Commit more of the heap's reserved space, so that a free block of at least
+// the given size becomes available at the end.
+static bool grow_heap(Heap* heap, uint32_t blocks)
+{
+    uint64_t committed = sizeof(HeapBlock) * heap->total_blocks;
+    uint64_t needed = committed + sizeof(HeapBlock) * ((uint64_t) blocks + 1);
+    uint64_t reserved = sizeof(HeapBlock) * heap->reserved_blocks;
+    if(!commit_more((uint8_t*) heap->blocks, &committed, needed, reserved))
+    {
+        return false;
+    }
+
+    uint32_t last = (uint32_t) heap->total_blocks - 1;
+    uint64_t total_blocks = committed / sizeof(HeapBlock);
+    account_reserve(heap->tag, sizeof(HeapBlock) * (total_blocks - heap->total_blocks));
+    heap->total_blocks = total_blocks;
+
+    // The end sentinel becomes a free block covering the new space, and a new
+    // sentinel goes at the new end.
+    uint32_t new_last = (uint32_t) total_blocks - 1;
+    NEXT_BLOCK(last) = new_last;
+    NEXT_BLOCK(new_last) = 0;
+    PREV_BLOCK(new_last) = last;
+
+    uint32_t prior = PREV_BLOCK(last);
+    if(is_free(heap, prior))
+    {
+        disconnect_from_free_list(heap, prior);
+        assimilate_up(heap, prior);
+        last = prior;
+    }
+    add_to_free_list(heap, last);
+
+    return true;
 }
 
 static uint32_t determine_blocks_needed(uint32_t size)
@@ -350,104 +2058,40 @@ static uint32_t determine_blocks_needed(uint32_t size)
     return 2 + size / sizeof(HeapBlock);
 }
 
-static void disconnect_from_free_list(Heap* heap, uint32_t c)
-{
-    NEXT_FREE(PREV_FREE(c)) = NEXT_FREE(c);
-    PREV_FREE(NEXT_FREE(c)) = PREV_FREE(c);
-    NEXT_BLOCK(c) &= ~freelist_mask;
-}
-
-static void make_new_block(Heap* heap, uint32_t c, uint32_t blocks, uint32_t freemask)
-{
-    NEXT_BLOCK(c + blocks) = NEXT_BLOCK(c) & blockno_mask;
-    PREV_BLOCK(c + blocks) = c;
-    PREV_BLOCK(NEXT_BLOCK(c) & blockno_mask) = c + blocks;
-    NEXT_BLOCK(c) = (c + blocks) | freemask;
-}
-
 void* heap_allocate(Heap* heap, uint32_t bytes)
 {
     ASSERT(heap);
     ASSERT(bytes != 0);
+    ASSERT(!heap->owner || heap->owner == thread_get_id());
 
-    uint32_t blocks = determine_blocks_needed(bytes);
-    uint32_t cf;
-    uint32_t block_size = 0;
+    if(atomic_pointer_load(&heap->remote_frees))
     {
-        uint32_t best_size = 0x7fffffff;
-        uint32_t best_block = NEXT_FREE(0);
-
-        for(cf = NEXT_FREE(0); NEXT_FREE(cf); cf = NEXT_FREE(cf))
-        {
-            block_size = (NEXT_BLOCK(cf) & blockno_mask) - cf;
-            if(block_size >= blocks && block_size < best_size)
-            {
-                best_block = cf;
-                best_size = block_size;
-            }
-        }
-
-        if(best_size != 0x7fffffff)
-        {
-            cf = best_block;
-            block_size = best_size;
-        }
+        heap_reclaim_remote_frees(heap);
     }
 
-    if(NEXT_BLOCK(cf) & blockno_mask)
-    {
-        // This is an existing block in the memory heap, we just need to split
-        // off what we need, unlink it from the free list and mark it as in
-        // use, and link the rest of the block back into the freelist as if it
-        // was a new block on the free list...
-        if(block_size == blocks)
-        {
-            // It's an exact fit and we don't need to split off a block.
-            disconnect_from_free_list(heap, cf);
-        }
-        else
-        {
-            // It's not an exact fit and we need to split off a block.
-            make_new_block(heap, cf, block_size - blocks, freelist_mask);
-            cf += block_size - blocks;
-        }
-    }
-    else
+    uint32_t blocks = determine_blocks_needed(bytes);
+    uint32_t c = find_free_block(heap, blocks);
+    while(c == no_block)
     {
-        // We're at the end of the heap - allocate a new block, but check to
-        // see if there's enough memory left for the requested block!
-        if(heap->total_blocks <= (uint64_t) (cf + blocks + 1))
+        // A free block is only searched for in lists whose smallest size
+        // fits, so growing by exactly the size asked for may not be enough.
+        uint32_t fitting = blocks + (blocks >> HEAP_SECOND_LEVEL_LOG2) + 1;
+        if(heap->total_blocks >= heap->reserved_blocks || !grow_heap(heap, fitting))
         {
             return NULL;
         }
-        NEXT_FREE(PREV_FREE(cf)) = cf + blocks;
-        copy_memory(&heap->blocks[cf + blocks], &heap->blocks[cf], sizeof(HeapBlock));
-        NEXT_BLOCK(cf) = cf + blocks;
-        PREV_BLOCK(cf + blocks) = cf;
+        c = find_free_block(heap, blocks);
     }
 
-    zero_memory(&BLOCK_DATA(cf), bytes);
-    return &BLOCK_DATA(cf);
-}
-
-static void try_to_assimilate_up(Heap* heap, uint32_t c)
-{
-    if(NEXT_BLOCK(NEXT_BLOCK(c)) & freelist_mask)
-    {
-        // The next block is a free block, so assimilate up and remove it from
-        // the free list.
-        disconnect_from_free_list(heap, NEXT_BLOCK(c));
-        // Assimilate the next block with this one
-        PREV_BLOCK(NEXT_BLOCK(NEXT_BLOCK(c)) & blockno_mask) = c;
-        NEXT_BLOCK(c) = NEXT_BLOCK(NEXT_BLOCK(c)) & blockno_mask;
-    }
-}
+    disconnect_from_free_list(heap, c);
+    split_block(heap, c, blocks);
+    account_heap_allocate(heap, sizeof(HeapBlock) * get_block_size(heap, c));
 
-static uint32_t assimilate_down(Heap* heap, uint32_t c, uint32_t freemask)
-{
-    NEXT_BLOCK(PREV_BLOCK(c)) = NEXT_BLOCK(c) | freemask;
-    PREV_BLOCK(NEXT_BLOCK(c)) = PREV_BLOCK(c);
-    return PREV_BLOCK(c);
+    // Clear the whole block and not just the bytes asked for, so that growing
+    // it in place later only has to clear what's new.
+    zero_memory(&BLOCK_DATA(c), get_data_size(blocks));
+    record_event(ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE, heap, NULL, &BLOCK_DATA(c), bytes);
+    return &BLOCK_DATA(c);
 }
 
 static uint32_t index_from_pointer(void* base, void* p, uint32_t size)
@@ -458,6 +2102,7 @@ static uint32_t index_from_pointer(void* base, void* p, uint32_t size)
 void* heap_reallocate(Heap* heap, void* memory, uint32_t bytes)
 {
     ASSERT(heap);
+    ASSERT(!heap->owner || heap->owner == thread_get_id());
 
     if(!memory)
     {
@@ -473,57 +2118,91 @@ void* heap_reallocate(Heap* heap, void* memory, uint32_t bytes)
     uint32_t c = index_from_pointer(heap->blocks, memory, sizeof(HeapBlock));
 
     uint32_t blocks = determine_blocks_needed(bytes);
-    uint32_t block_room = NEXT_BLOCK(c) - c;
-    uint32_t current_size = sizeof(HeapBlock) * block_room - sizeof(HeapBlockHeader);
+    uint32_t block_room = get_block_size(heap, c);
+    uint32_t current_size = get_data_size(block_room);
 
-    if(block_room == blocks)
+    if(blocks <= block_room)
     {
-        // They had the space needed all along. ;o)
+        // Give back the end of the block, if it's now bigger than needed.
+        if(blocks < block_room)
+        {
+            split_block(heap, c, blocks);
+            uint32_t rest = c + blocks;
+            uint32_t next = NEXT_BLOCK(rest) & blockno_mask;
+            if(is_free(heap, next))
+            {
+                disconnect_from_free_list(heap, rest);
+                disconnect_from_free_list(heap, next);
+                assimilate_up(heap, rest);
+                add_to_free_list(heap, rest);
+            }
+            account_heap_resize(heap, sizeof(HeapBlock) * block_room, sizeof(HeapBlock) * blocks);
+        }
+        record_event(ALLOCATION_EVENT_TYPE_HEAP_REALLOCATE, heap, memory, memory, bytes);
         return memory;
     }
 
-    try_to_assimilate_up(heap, c);
-
-    if((NEXT_BLOCK(PREV_BLOCK(c)) & freelist_mask) && (blocks <= NEXT_BLOCK(c) - PREV_BLOCK(c)))
+    // Try to grow into the following block, if it's free and large enough.
+    uint32_t next = NEXT_BLOCK(c) & blockno_mask;
+    if(is_free(heap, next) && block_room + get_block_size(heap, next) >= blocks)
     {
-        disconnect_from_free_list(heap, PREV_BLOCK(c));
-        // Connect the previous block to the next block ... and then realign
-        // the current block pointer
-        c = assimilate_down(heap, c, 0);
-        // Move the bytes down to the new block we just created, but be sure to
-        // move only the original bytes.
-        void* to = &BLOCK_DATA(c);
-        copy_memory(to, memory, current_size);
-        memory = to;
+        disconnect_from_free_list(heap, next);
+        assimilate_up(heap, c);
+        split_block(heap, c, blocks);
+        account_heap_resize(heap, sizeof(HeapBlock) * block_room, sizeof(HeapBlock) * get_block_size(heap, c));
+        uint32_t size = get_data_size(blocks);
+        zero_memory(&BLOCK_DATA(c)[current_size], size - current_size);
+        record_event(ALLOCATION_EVENT_TYPE_HEAP_REALLOCATE, heap, memory, memory, bytes);
+        return memory;
     }
 
-    block_room = NEXT_BLOCK(c) - c;
-
-    if(block_room == blocks)
+    // Otherwise, move it somewhere else that's big enough. This is traced as
+    // an allocation and a deallocation.
+    void* moved = heap_allocate(heap, bytes);
+    if(moved)
     {
-        // return the original pointer
-        return memory;
+        copy_memory(moved, memory, current_size);
     }
-    else if(blocks < block_room)
+    heap_deallocate(heap, memory);
+
+    return moved;
+}
+
+static void free_block(Heap* heap, void* memory)
+{
+    // which block the memory is in
+    uint32_t c = index_from_pointer(heap->blocks, memory, sizeof(HeapBlock));
+    ASSERT(!is_free(heap, c));
+    account_heap_deallocate(heap, sizeof(HeapBlock) * get_block_size(heap, c));
+
+    uint32_t next = NEXT_BLOCK(c);
+    if(is_free(heap, next))
     {
-        // New block is smaller than the old block, so just make a new block
-        // at the end of this one and put it up on the free list.
-        make_new_block(heap, c, blocks, 0);
-        heap_deallocate(heap, &BLOCK_DATA(c + blocks));
+        disconnect_from_free_list(heap, next);
+        assimilate_up(heap, c);
     }
-    else
+
+    uint32_t prior = PREV_BLOCK(c);
+    if(is_free(heap, prior))
     {
-        // New block is bigger than the old block.
-        void* old = memory;
-        memory = heap_allocate(heap, bytes);
-        if(memory)
-        {
-            copy_memory(memory, old, current_size);
-        }
-        heap_deallocate(heap, old);
+        disconnect_from_free_list(heap, prior);
+        assimilate_up(heap, prior);
+        c = prior;
     }
 
-    return memory;
+    add_to_free_list(heap, c);
+}
+
+// A block freed by a thread that doesn't own the heap is pushed onto a list
+// for the owner to free later, since only the owner can touch the free lists.
+// The link to the next block in the list is kept in the block's own data.
+static void push_remote_free(Heap* heap, void* memory)
+{
+    void* head = atomic_pointer_load(&heap->remote_frees);
+    do
+    {
+        *((void**) memory) = head;
+    } while(!atomic_pointer_compare_exchange(&heap->remote_frees, &head, memory));
 }
 
 void heap_deallocate(Heap* heap, void* memory)
@@ -533,25 +2212,25 @@ void heap_deallocate(Heap* heap, void* memory)
     {
         return;
     }
-    // which block the memory is in
-    uint32_t c = index_from_pointer(heap->blocks, memory, sizeof(HeapBlock));
-
-    try_to_assimilate_up(heap, c);
-
-    if (NEXT_BLOCK(PREV_BLOCK(c)) & freelist_mask)
+    record_event(ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE, heap, memory, NULL, 0);
+    if(heap->owner && heap->owner != thread_get_id())
     {
-        // assimilate with the previous block if possible
-        c = assimilate_down(heap, c, freelist_mask);
+        push_remote_free(heap, memory);
+        return;
     }
-    else
+    free_block(heap, memory);
+}
+
+void heap_reclaim_remote_frees(Heap* heap)
+{
+    // The whole list is taken at once, so a block can't be freed and pushed
+    // again while the list is being walked, and there's no ABA problem.
+    void* memory = atomic_pointer_exchange(&heap->remote_frees, NULL);
+    while(memory)
     {
-        // The previous block is not a free block, so add this one to the head
-        // of the free list
-        PREV_FREE(NEXT_FREE(0)) = c;
-        NEXT_FREE(c) = NEXT_FREE(0);
-        PREV_FREE(c) = 0;
-        NEXT_FREE(0) = c;
-        NEXT_BLOCK(c) |= freelist_mask;
+        void* next = *((void**) memory);
+        free_block(heap, memory);
+        memory = next;
     }
 }
 
@@ -577,8 +2256,89 @@ HeapInfo heap_get_info(Heap* heap)
             info.used_blocks += (NEXT_BLOCK(blockno) & blockno_mask) - blockno;
         }
     }
-    info.free_blocks  += heap->total_blocks - blockno;
+    // Count the sentinel at the end.
     info.total_blocks += heap->total_blocks - blockno;
     return info;
 }
 
+uint64_t heap_get_largest_free_size(Heap* heap)
+{
+    if(!heap->first_level_bitmap)
+    {
+        return 0;
+    }
+
+    // The largest free block has to be in the largest non-empty free list,
+    // though not necessarily first in it.
+    int first = find_last_set(heap->first_level_bitmap);
+    int second = find_last_set(heap->second_level_bitmaps[first]);
+    uint32_t largest = 0;
+    for(uint32_t c = heap->free_lists[first][second]; c != no_block; c = NEXT_FREE(c))
+    {
+        uint32_t blocks = get_block_size(heap, c);
+        if(blocks > largest)
+        {
+            largest = blocks;
+        }
+    }
+
+    return sizeof(HeapBlock) * (uint64_t) largest;
+}
+
+void heap_set_tag(Heap* heap, MemoryTag tag)
+{
+    ASSERT(!heap->owner || heap->owner == thread_get_id());
+
+    // A heap with an owner only has its reserved space counted in its tag, and
+    // its own counts go along with it.
+    if(heap->owner)
+    {
+        uint64_t reserved_bytes = sizeof(HeapBlock) * heap->total_blocks;
+        spin_lock_acquire(&live_heaps_lock);
+        retire_heap_counts(heap);
+        account_move(heap->tag, tag, 0, 0, reserved_bytes, false);
+        heap->tag = tag;
+        spin_lock_release(&live_heaps_lock);
+        return;
+    }
+
+    HeapInfo info = heap_get_info(heap);
+    uint64_t live_bytes = sizeof(HeapBlock) * info.used_blocks;
+    uint64_t reserved_bytes = sizeof(HeapBlock) * heap->total_blocks;
+    account_move(heap->tag, tag, live_bytes, info.used_entries, reserved_bytes, false);
+    heap->tag = tag;
+}
+
+// Thread Heaps.................................................................
+
+static THREAD_LOCAL Heap* thread_heap;
+
+Heap* get_thread_heap()
+{
+    if(!thread_heap)
+    {
+        Heap* heap = (Heap*) virtual_allocate(sizeof(Heap));
+        if(!heap)
+        {
+            return NULL;
+        }
+        if(!heap_create_growable(heap, uptibytes(64)))
+        {
+            virtual_deallocate(heap);
+            return NULL;
+        }
+        heap->owner = thread_get_id();
+        thread_heap = heap;
+    }
+    return thread_heap;
+}
+
+void destroy_thread_heap()
+{
+    if(thread_heap)
+    {
+        heap_destroy(thread_heap);
+        virtual_deallocate(thread_heap);
+        thread_heap = NULL;
+    }
+}
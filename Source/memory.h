@@ -11,6 +11,9 @@
 
 void* virtual_allocate(uint64_t bytes);
 void virtual_deallocate(void* memory);
+void* virtual_reserve(uint64_t bytes);
+bool virtual_commit(void* memory, uint64_t bytes);
+void virtual_release(void* memory, uint64_t bytes);
 void copy_memory(void* to, const void* from, uint64_t bytes);
 void zero_memory(void* memory, uint64_t bytes);
 uint64_t kilobytes(uint64_t count);
@@ -19,22 +22,143 @@ uint64_t ezlabytes(uint64_t count);
 uint64_t capobytes(uint64_t count);
 uint64_t uptibytes(uint64_t count);
 
+typedef enum MemoryKernelType
+{
+    MEMORY_KERNEL_TYPE_BYTE,
+    MEMORY_KERNEL_TYPE_WORD,
+    MEMORY_KERNEL_TYPE_SSE2,
+    MEMORY_KERNEL_TYPE_AVX2,
+    MEMORY_KERNEL_TYPE_COUNT,
+} MemoryKernelType;
+
+bool set_memory_kernel_type(MemoryKernelType type);
+MemoryKernelType get_memory_kernel_type();
+
+// Huge pages cut down on TLB misses when walking through large allocations.
+// Explicit ones must be set aside by the system ahead of time, while
+// transparent ones are only a hint the system may or may not act on.
+typedef enum HugePageMode
+{
+    HUGE_PAGE_MODE_OFF,
+    HUGE_PAGE_MODE_TRANSPARENT,
+    HUGE_PAGE_MODE_EXPLICIT,
+    HUGE_PAGE_MODE_COUNT,
+} HugePageMode;
+
+#define HUGE_PAGE_BYTES 0x200000
+
+HugePageMode set_huge_page_mode(HugePageMode mode, uint64_t threshold);
+HugePageMode get_huge_page_mode();
+const char* describe_huge_page_mode(HugePageMode mode);
+
 #define SAFE_VIRTUAL_DEALLOCATE(memory) \
     if(memory) {virtual_deallocate(memory); (memory) = NULL;}
 
 #define COPY_ARRAY(to, from, count) \
     copy_memory(to, from, (count) * sizeof(*from))
 
+// Memory Accounting............................................................
+
+// Heaps and pools are tagged with the subsystem that owns them, so that what
+// each subsystem has in use can be tracked as allocations happen, without
+// walking anything.
+typedef enum MemoryTag
+{
+    MEMORY_TAG_UNTAGGED,
+    MEMORY_TAG_EDITOR,
+    MEMORY_TAG_MESH,
+    MEMORY_TAG_PLATFORM,
+    MEMORY_TAG_VIDEO,
+    MEMORY_TAG_COUNT,
+} MemoryTag;
+
+typedef struct MemoryTagInfo
+{
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t reserved_bytes;
+    uint64_t free_bytes;
+    uint64_t largest_free_bytes;
+    uint64_t live_allocations;
+    uint64_t total_allocations;
+    float fragmentation;
+} MemoryTagInfo;
+
+MemoryTagInfo get_memory_tag_info(MemoryTag tag);
+const char* describe_memory_tag(MemoryTag tag);
+
+// Allocation Trace.............................................................
+
+// A trace records every heap, stack and pool operation, so that a real session
+// can be replayed later against a different allocator. It's saved as the
+// header followed directly by the events.
+#define ALLOCATION_TRACE_MAGIC UINT32_C(0x43525441) // "ATRC"
+#define ALLOCATION_TRACE_VERSION 2
+#define ALLOCATION_TRACE_ALLOCATOR_CAP 256
+
+typedef enum AllocationEventType
+{
+    ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE,
+    ALLOCATION_EVENT_TYPE_HEAP_REALLOCATE,
+    ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE,
+    ALLOCATION_EVENT_TYPE_POOL_ALLOCATE,
+    ALLOCATION_EVENT_TYPE_POOL_DEALLOCATE,
+    ALLOCATION_EVENT_TYPE_STACK_ALLOCATE,
+    ALLOCATION_EVENT_TYPE_STACK_REALLOCATE,
+    ALLOCATION_EVENT_TYPE_STACK_DEALLOCATE,
+    ALLOCATION_EVENT_TYPE_COUNT,
+} AllocationEventType;
+
+// Addresses are only used to match up operations on the same memory, and the
+// allocator is an index standing in for the address of the heap, stack or pool.
+typedef struct AllocationEvent
+{
+    uint64_t address;
+    uint64_t result;
+    uint32_t bytes;
+    uint8_t type;
+    uint8_t allocator;
+    uint16_t padding;
+} AllocationEvent;
+
+// A trace is truncated when recording had to stop early, because the events
+// filled the memory reserved for them or more allocators were used than an
+// event can tell apart. Every event up to that point is still recorded.
+typedef struct AllocationTraceHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t events_count;
+    uint32_t truncated;
+    uint32_t padding;
+} AllocationTraceHeader;
+
+typedef struct AllocationTrace
+{
+    AllocationTraceHeader* header;
+    AllocationEvent* events;
+    uint64_t bytes;
+} AllocationTrace;
+
+bool allocation_trace_start(uint64_t reserve_bytes);
+AllocationTrace allocation_trace_stop();
+void allocation_trace_release();
+bool allocation_trace_is_recording();
+
 // Stack........................................................................
 
+// A growable stack reserves all of its address space up front, but only
+// commits memory as the top reaches it.
 typedef struct Stack
 {
     uint8_t* memory;
-    uint32_t top;
-    uint32_t bytes;
+    uint64_t top;
+    uint64_t committed;
+    uint64_t bytes;
 } Stack;
 
-void stack_create(Stack* stack, uint32_t bytes);
+bool stack_create(Stack* stack, uint64_t bytes);
+bool stack_create_growable(Stack* stack, uint64_t reserve_bytes);
 void stack_destroy(Stack* stack);
 void* stack_allocate(Stack* stack, uint32_t bytes);
 void* stack_reallocate(Stack* stack, void* memory, uint32_t bytes);
@@ -49,31 +173,81 @@ void stack_deallocate(Stack* stack, void* memory);
 #define STACK_DEALLOCATE(stack, memory) \
     stack_deallocate(stack, memory)
 
+// Arena........................................................................
+
+typedef struct Arena
+{
+    uint8_t* memory;
+    uint32_t top;
+    uint32_t bytes;
+} Arena;
+
+typedef struct ArenaMark
+{
+    uint32_t top;
+} ArenaMark;
+
+void arena_create(Arena* arena, uint32_t bytes);
+void arena_destroy(Arena* arena);
+void* arena_allocate(Arena* arena, uint32_t bytes);
+ArenaMark arena_mark(Arena* arena);
+void arena_reset_to_mark(Arena* arena, ArenaMark mark);
+void arena_reset(Arena* arena);
+
+#define ARENA_ALLOCATE(arena, type, count) \
+    ((type*) arena_allocate(arena, (uint32_t) (sizeof(type) * (count))))
+
 // Pool.........................................................................
 
-typedef enum PoolBlockStatus
+// A pool grows by adding chunks, each as large as all the chunks before it
+// combined, so the total capacity doubles each time. Objects are never moved
+// once they're allocated, so pointers to them stay valid for as long as the
+// object is.
+//
+// Objects also have an index, counting up through the chunks in order. The
+// first chunk's size is rounded up to a power of two, so the chunk an index is
+// in can be found from its top set bit.
+#define POOL_CHUNK_CAP 32
+
+// Each bit in the occupancy bitmap is set if the object at the same index is in
+// use.
+typedef struct PoolChunk
 {
-    POOL_BLOCK_STATUS_FREE,
-    POOL_BLOCK_STATUS_USED,
-} PoolBlockStatus;
+    uint8_t* memory;
+    uint64_t* occupancy;
+    uint32_t object_count;
+    uint32_t first_index;
+} PoolChunk;
 
+// Objects from untouched up to untouched_end, at the end of the newest chunk,
+// have never been allocated. They're handed out in order once the free list is
+// empty, so adding a chunk doesn't have to write to every object in it.
 typedef struct Pool
 {
-    uint8_t* memory;
+    PoolChunk chunks[POOL_CHUNK_CAP];
+    void** free_list;
+    uint8_t* untouched;
+    uint8_t* untouched_end;
     uint32_t object_size;
     uint32_t object_count;
-    void** free_list;
-    PoolBlockStatus* statuses;
+    uint32_t used_count;
+    int chunks_count;
+    int first_chunk_shift;
+    MemoryTag tag;
 } Pool;
 
 typedef struct PoolIterator
 {
     Pool* pool;
-    int index;
+    uint64_t bits;
+    uint32_t end;
+    int chunk_index;
+    int word_index;
 } PoolIterator;
 
 void* pool_iterator_next(PoolIterator* it);
 void* pool_iterator_create(PoolIterator* it, Pool* pool);
+void* pool_iterator_create_range(PoolIterator* it, Pool* pool, uint32_t start, uint32_t end);
 
 #define PASTE2(x, y) x##y
 #define PASTE(x, y) PASTE2(x, y)
@@ -82,10 +256,24 @@ void* pool_iterator_create(PoolIterator* it, Pool* pool);
     PoolIterator PASTE(it_, __LINE__); \
     for(type* object = ((type*) pool_iterator_create(&PASTE(it_, __LINE__), &pool)); object; object = ((type*) pool_iterator_next(&PASTE(it_, __LINE__))))
 
+// This only visits the objects with indices from start up to, but not
+// including, end. Both have to be multiples of POOL_RANGE_ALIGNMENT, except
+// that end can be anything past the last object, so that a pool can be split
+// into ranges for separate threads to walk.
+#define POOL_RANGE_ALIGNMENT 64
+
+#define FOR_EACH_IN_POOL_RANGE(type, object, pool, start, end) \
+    PoolIterator PASTE(it_, __LINE__); \
+    for(type* object = ((type*) pool_iterator_create_range(&PASTE(it_, __LINE__), &pool, start, end)); object; object = ((type*) pool_iterator_next(&PASTE(it_, __LINE__))))
+
 bool pool_create(Pool* pool, uint32_t object_size, uint32_t object_count);
 void pool_destroy(Pool* pool);
 void* pool_allocate(Pool* pool);
+void* pool_allocate_run(Pool* pool, uint32_t count);
 void pool_deallocate(Pool* pool, void* memory);
+void pool_set_tag(Pool* pool, MemoryTag tag);
+uint32_t pool_get_index(Pool* pool, void* object);
+void* pool_get_object(Pool* pool, uint32_t index);
 
 #define POOL_ALLOCATE(pool, type) \
     ((type*) pool_allocate(pool))
@@ -115,10 +303,48 @@ typedef struct HeapBlock
     HeapBlockBody body;
 } HeapBlock;
 
+// Free blocks are kept in segregated lists by size, two levels deep. The first
+// level splits sizes by powers of two and the second splits each power of two
+// into linear steps. This is the Two-Level Segregated Fit (TLSF) scheme, and
+// the bitmaps of which lists are non-empty allow finding a free block that
+// fits, or freeing one, in constant time.
+#define HEAP_SECOND_LEVEL_LOG2  3
+#define HEAP_SECOND_LEVEL_COUNT (1 << HEAP_SECOND_LEVEL_LOG2)
+#define HEAP_FIRST_LEVEL_COUNT  (32 - HEAP_SECOND_LEVEL_LOG2)
+
+// A growable heap commits more of its reserved address space whenever nothing
+// free is large enough. Block indices are 31 bits, so a heap can't be larger
+// than 32 GiB.
+#define HEAP_MAX_BYTES (UINT64_C(0x80000000) * sizeof(HeapBlock))
+
+// A heap with an owner keeps its own counts, which only the owner changes, so
+// that threads allocating at the same time don't contend over the counts for
+// their tag. They're added to the tag's counts whenever those are read.
+typedef struct HeapCounts
+{
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t live_allocations;
+    uint64_t total_allocations;
+} HeapCounts;
+
+// A heap with an owner can only allocate from the owning thread. Any other
+// thread can still deallocate, which queues the memory to be freed the next
+// time the owner allocates. A heap without an owner isn't safe to use from
+// more than one thread at a time.
 typedef struct Heap
 {
     HeapBlock* blocks;
     uint64_t total_blocks;
+    uint64_t reserved_blocks;
+    uint32_t free_lists[HEAP_FIRST_LEVEL_COUNT][HEAP_SECOND_LEVEL_COUNT];
+    uint32_t second_level_bitmaps[HEAP_FIRST_LEVEL_COUNT];
+    uint32_t first_level_bitmap;
+    uint64_t free_blocks;
+    void* volatile remote_frees;
+    uint64_t owner;
+    HeapCounts counts;
+    MemoryTag tag;
 } Heap;
 
 typedef struct HeapInfo
@@ -131,13 +357,17 @@ typedef struct HeapInfo
     uint64_t used_blocks;
 } HeapInfo;
 
-void heap_make_in_place(Heap* heap, void* place, uint32_t bytes);
-bool heap_create(Heap* heap, uint32_t bytes);
+void heap_make_in_place(Heap* heap, void* place, uint64_t bytes);
+bool heap_create(Heap* heap, uint64_t bytes);
+bool heap_create_growable(Heap* heap, uint64_t reserve_bytes);
 void heap_destroy(Heap* heap);
 void* heap_allocate(Heap* heap, uint32_t bytes);
 void* heap_reallocate(Heap* heap, void* memory, uint32_t bytes);
 void heap_deallocate(Heap* heap, void* memory);
+void heap_reclaim_remote_frees(Heap* heap);
 HeapInfo heap_get_info(Heap* heap);
+uint64_t heap_get_largest_free_size(Heap* heap);
+void heap_set_tag(Heap* heap, MemoryTag tag);
 
 #define HEAP_ALLOCATE(heap, type, count) \
     ((type*) heap_allocate(heap, (uint32_t) (sizeof(type) * (count))))
@@ -151,4 +381,11 @@ HeapInfo heap_get_info(Heap* heap);
 #define SAFE_HEAP_DEALLOCATE(heap, array) \
     {heap_deallocate(heap, array); (array) = NULL;}
 
+// Thread Heaps.................................................................
+
+// Each thread gets a heap of its own the first time it asks, so that threads
+// allocating at the same time never contend over a lock.
+Heap* get_thread_heap();
+void destroy_thread_heap();
+
 #endif // MEMORY_H_
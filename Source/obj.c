@@ -4,8 +4,8 @@
 #include "ascii.h"
 #include "assert.h"
 #include "filesystem.h"
+#include "invalid_index.h"
 #include "jan.h"
-#include "map.h"
 #include "math_basics.h"
 #include "memory.h"
 #include "string_utilities.h"
@@ -13,6 +13,7 @@
 typedef struct Stream
 {
     const char* buffer;
+    bool out_of_memory;
 } Stream;
 
 static bool stream_has_more(Stream* stream)
@@ -38,7 +39,7 @@ static void next_line(Stream* stream)
     stream->buffer = s;
 }
 
-static char* next_token(Stream* stream, Stack* stack)
+static char* next_token(Stream* stream, Arena* arena)
 {
     skip_spacing(stream);
 
@@ -52,14 +53,21 @@ static char* next_token(Stream* stream, Stack* stack)
         return NULL;
     }
 
-    char* token = STACK_ALLOCATE(stack, char, token_size + 1);
+    // A line too long for what's left of the arena can't be read, which is
+    // different from there being nothing left to read.
+    char* token = ARENA_ALLOCATE(arena, char, token_size + 1);
+    if(!token)
+    {
+        stream->out_of_memory = true;
+        return NULL;
+    }
     copy_string(token, token_size + 1, stream->buffer);
     stream->buffer += token_size;
 
     return token;
 }
 
-static char* next_index(Stream* stream, Stack* stack)
+static char* next_index(Stream* stream, Arena* arena)
 {
     const char* first = stream->buffer;
     const char* s;
@@ -84,7 +92,12 @@ static char* next_index(Stream* stream, Stack* stack)
         return NULL;
     }
 
-    char* index = STACK_ALLOCATE(stack, char, index_size + 1);
+    char* index = ARENA_ALLOCATE(arena, char, index_size + 1);
+    if(!index)
+    {
+        stream->out_of_memory = true;
+        return NULL;
+    }
     copy_string(index, index_size + 1, stream->buffer);
     stream->buffer += index_size;
 
@@ -125,7 +138,7 @@ typedef struct Face
     int material_index;
 } Face;
 
-bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
+bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack, Arena* arena)
 {
     WholeFile whole_file = load_whole_file(path, stack);
     if(!whole_file.loaded)
@@ -135,6 +148,7 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
 
     Stream stream;
     stream.buffer = (char*) whole_file.contents;
+    stream.out_of_memory = false;
 
     Float4* positions = NULL;
     Float3* normals = NULL;
@@ -147,9 +161,13 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
     char* material_library = NULL;
     int smoothing_group = 0;
 
+    // Tokens only live until the end of their line, so they're all given back
+    // at once there instead of one at a time.
+    ArenaMark line_mark = arena_mark(arena);
+
     for(; stream_has_more(&stream) && !error_occurred; next_line(&stream))
     {
-        char* keyword = next_token(&stream, stack);
+        char* keyword = next_token(&stream, arena);
 
         if(!keyword)
         {
@@ -158,10 +176,16 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
         }
         else if(strings_match(keyword, "v"))
         {
-            char* x = next_token(&stream, stack);
-            char* y = next_token(&stream, stack);
-            char* z = next_token(&stream, stack);
-            char* w = next_token(&stream, stack);
+            char* x = next_token(&stream, arena);
+            char* y = next_token(&stream, arena);
+            char* z = next_token(&stream, arena);
+            char* w = next_token(&stream, arena);
+
+            if(stream.out_of_memory)
+            {
+                error_occurred = true;
+                break;
+            }
 
             Float4 position;
             MaybeFloat maybe_x = string_to_float(x);
@@ -179,14 +203,6 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
                 position.w = maybe_w.value;
             }
 
-            if(w)
-            {
-                STACK_DEALLOCATE(stack, w);
-            }
-            STACK_DEALLOCATE(stack, z);
-            STACK_DEALLOCATE(stack, y);
-            STACK_DEALLOCATE(stack, x);
-
             if(!maybe_x.valid || !maybe_y.valid || !maybe_z.valid || !success_w)
             {
                 error_occurred = true;
@@ -198,9 +214,15 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
         }
         else if(strings_match(keyword, "vn"))
         {
-            char* x = next_token(&stream, stack);
-            char* y = next_token(&stream, stack);
-            char* z = next_token(&stream, stack);
+            char* x = next_token(&stream, arena);
+            char* y = next_token(&stream, arena);
+            char* z = next_token(&stream, arena);
+
+            if(stream.out_of_memory)
+            {
+                error_occurred = true;
+                break;
+            }
 
             Float3 normal;
             MaybeFloat maybe_x = string_to_float(x);
@@ -210,10 +232,6 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
             normal.y = maybe_y.value;
             normal.z = maybe_z.value;
 
-            STACK_DEALLOCATE(stack, z);
-            STACK_DEALLOCATE(stack, y);
-            STACK_DEALLOCATE(stack, x);
-
             if(!maybe_x.valid || !maybe_y.valid || !maybe_z.valid)
             {
                 error_occurred = true;
@@ -225,9 +243,15 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
         }
         else if(strings_match(keyword, "vt"))
         {
-            char* x = next_token(&stream, stack);
-            char* y = next_token(&stream, stack);
-            char* z = next_token(&stream, stack);
+            char* x = next_token(&stream, arena);
+            char* y = next_token(&stream, arena);
+            char* z = next_token(&stream, arena);
+
+            if(stream.out_of_memory)
+            {
+                error_occurred = true;
+                break;
+            }
 
             Float3 texcoord;
             MaybeFloat maybe_x = string_to_float(x);
@@ -250,16 +274,6 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
                 success_z = maybe_z.valid;
             }
 
-            if(z)
-            {
-                STACK_DEALLOCATE(stack, z);
-            }
-            if(y)
-            {
-                STACK_DEALLOCATE(stack, y);
-            }
-            STACK_DEALLOCATE(stack, x);
-
             if(!success_x || !success_y || !success_z)
             {
                 error_occurred = true;
@@ -274,14 +288,21 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
             int base_index = array_count(multi_indices);
             int indices_in_face = 0;
 
-            char* token = next_token(&stream, stack);
+            char* token = next_token(&stream, arena);
             while(token)
             {
                 Stream token_stream;
                 token_stream.buffer = token;
-                char* position_index = next_index(&token_stream, stack);
-                char* texcoord_index = next_index(&token_stream, stack);
-                char* normal_index = next_index(&token_stream, stack);
+                token_stream.out_of_memory = false;
+                char* position_index = next_index(&token_stream, arena);
+                char* texcoord_index = next_index(&token_stream, arena);
+                char* normal_index = next_index(&token_stream, arena);
+
+                if(token_stream.out_of_memory)
+                {
+                    error_occurred = true;
+                    break;
+                }
 
                 MultiIndex index;
                 MaybeInt position = string_to_int(position_index);
@@ -308,18 +329,7 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
                 }
                 ARRAY_ADD(multi_indices, index, heap);
 
-                if(normal_index)
-                {
-                    STACK_DEALLOCATE(stack, normal_index);
-                }
-                if(texcoord_index)
-                {
-                    STACK_DEALLOCATE(stack, texcoord_index);
-                }
-                STACK_DEALLOCATE(stack, position_index);
-
                 indices_in_face += 1;
-                STACK_DEALLOCATE(stack, token);
 
                 if(!position.valid || !success_texcoord || !success_normal)
                 {
@@ -327,9 +337,11 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
                     break;
                 }
 
-                token = next_token(&stream, stack);
+                token = next_token(&stream, arena);
             }
 
+            error_occurred = error_occurred || stream.out_of_memory;
+
             if(!error_occurred)
             {
                 Face face;
@@ -341,7 +353,14 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
         }
         else if(strings_match(keyword, "usemtl"))
         {
-            char* name = next_token(&stream, stack);
+            char* name = next_token(&stream, arena);
+
+            if(stream.out_of_memory)
+            {
+                error_occurred = true;
+                break;
+            }
+
             int size = string_size(name) + 1;
             Label material;
             material.name = HEAP_ALLOCATE(heap, char, size);
@@ -350,15 +369,28 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
         }
         else if(strings_match(keyword, "mtllib"))
         {
-            char* library = next_token(&stream, stack);
+            char* library = next_token(&stream, arena);
+
+            if(stream.out_of_memory)
+            {
+                error_occurred = true;
+                break;
+            }
+
             int size = string_size(library) + 1;
             material_library = HEAP_ALLOCATE(heap, char, size);
             copy_string(material_library, size, library);
-            STACK_DEALLOCATE(stack, library);
         }
         else if(strings_match(keyword, "s"))
         {
-            char* token = next_token(&stream, stack);
+            char* token = next_token(&stream, arena);
+
+            if(stream.out_of_memory)
+            {
+                error_occurred = true;
+                break;
+            }
+
             int group;
             bool success_group = true;
             if(strings_match(token, "off"))
@@ -375,7 +407,6 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
             {
                 smoothing_group = group;
             }
-            STACK_DEALLOCATE(stack, token);
 
             if(!success_group)
             {
@@ -383,9 +414,10 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
             }
         }
 
-        STACK_DEALLOCATE(stack, keyword);
+        arena_reset_to_mark(arena, line_mark);
     }
 
+    arena_reset_to_mark(arena, line_mark);
     STACK_DEALLOCATE(stack, whole_file.contents);
 
     error_occurred = error_occurred || array_count(positions) == 0;
@@ -398,39 +430,70 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
     // Fill the mesh with the completed data.
     if(!error_occurred)
     {
-        JanMesh mesh;
-        jan_create_mesh(&mesh);
-        JanVertex** seen = STACK_ALLOCATE(stack, JanVertex*, array_count(positions));
-        for(int i = 0; i < array_count(faces); i += 1)
+        int positions_count = array_count(positions);
+        int faces_count = array_count(faces);
+        int indices_count = array_count(multi_indices);
+        Float3* points = HEAP_ALLOCATE(heap, Float3, positions_count);
+        int* face_offsets = HEAP_ALLOCATE(heap, int, faces_count + 1);
+        uint32_t* face_indices = HEAP_ALLOCATE(heap, uint32_t, indices_count + 1);
+
+        // Only positions that a face uses become vertices, numbered in the
+        // order they're first used.
+        int* seen = HEAP_ALLOCATE(heap, int, positions_count);
+        for(int i = 0; i < positions_count; i += 1)
+        {
+            seen[i] = invalid_index;
+        }
+        int points_count = 0;
+
+        int index = 0;
+        for(int i = 0; i < faces_count && !error_occurred; i += 1)
         {
             Face obj_face = faces[i];
-            JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, obj_face.sides);
+            face_offsets[i] = index;
+            if(obj_face.sides < 3)
+            {
+                error_occurred = true;
+                break;
+            }
             for(int j = 0; j < obj_face.sides; j += 1)
             {
-                MultiIndex index = multi_indices[obj_face.base_index + j];
-                Float4 position = positions[index.position];
+                MultiIndex multi_index = multi_indices[obj_face.base_index + j];
 #if 0
-                Float3 normal = normals[index.normal];
-                Float3 texcoord = texcoords[index.texcoord];
+                Float3 normal = normals[multi_index.normal];
+                Float3 texcoord = texcoords[multi_index.texcoord];
 #endif
-                JanVertex* vertex;
-                if(seen[index.position])
+                int next = (j + 1) % obj_face.sides;
+                int next_position = multi_indices[obj_face.base_index + next].position;
+                if(multi_index.position < 0 || multi_index.position >= positions_count
+                    || multi_index.position == next_position)
                 {
-                    vertex = seen[index.position];
+                    error_occurred = true;
+                    break;
                 }
-                else
+                if(seen[multi_index.position] == invalid_index)
                 {
-                    vertex = jan_add_vertex(&mesh, float4_extract_float3(position));
-                    seen[index.position] = vertex;
+                    seen[multi_index.position] = points_count;
+                    points[points_count] = float4_extract_float3(positions[multi_index.position]);
+                    points_count += 1;
                 }
-                vertices[j] = vertex;
+                face_indices[index] = (uint32_t) seen[multi_index.position];
+                index += 1;
             }
-            jan_connect_disconnected_vertices_and_add_face(&mesh, vertices, obj_face.sides, stack);
-            STACK_DEALLOCATE(stack, vertices);
         }
-        jan_update_normals(&mesh);
-        STACK_DEALLOCATE(stack, seen);
-        *result = mesh;
+        face_offsets[faces_count] = index;
+
+        if(!error_occurred)
+        {
+            JanMesh mesh;
+            jan_build_mesh_from_indexed(&mesh, points, points_count, face_offsets, face_indices, faces_count, heap);
+            *result = mesh;
+        }
+
+        HEAP_DEALLOCATE(heap, seen);
+        HEAP_DEALLOCATE(heap, points);
+        HEAP_DEALLOCATE(heap, face_offsets);
+        HEAP_DEALLOCATE(heap, face_indices);
     }
 
     // Cleanup
@@ -455,36 +518,41 @@ bool obj_load_file(const char* path, JanMesh* result, Heap* heap, Stack* stack)
     return !error_occurred;
 }
 
-static bool vertex_attached_to_face(JanVertex* vertex)
-{
-    return vertex->any_edge && vertex->any_edge->any_link;
-}
-
 #define LINE_SIZE 128
 
+// The file is written from a snapshot of the mesh, so that the faces are read
+// as runs of vertex numbers, rather than by walking their links.
 bool obj_save_file(const char* path, JanMesh* mesh, Heap* heap)
 {
     File* file = open_file(NULL, FILE_OPEN_MODE_WRITE_TEMPORARY, heap);
 
     char line[LINE_SIZE];
 
-    Map map;
-    map_create(&map, mesh->vertices_count, heap);
+    JanMeshSnapshot snapshot;
+    jan_create_snapshot(&snapshot);
+    jan_build_snapshot(&snapshot, mesh, heap);
+
+    // Vertices that aren't part of any face are left out, so each vertex gets
+    // a number in the file only once a face is found to use it.
+    int* file_indices = HEAP_ALLOCATE(heap, int, snapshot.vertices_count + 1);
+    for(int i = 0; i < snapshot.indices_count; i += 1)
+    {
+        file_indices[snapshot.indices[i]] = 1;
+    }
 
     int index = 1;
-    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    for(int i = 0; i < snapshot.vertices_count; i += 1)
     {
-        if(!vertex_attached_to_face(vertex))
+        if(!file_indices[i])
         {
             continue;
         }
 
-        Float3 v = vertex->position;
+        Float3 v = snapshot.positions[i];
         format_string(line, LINE_SIZE, "v %.6f %.6f %.6f\n", v.x, v.y, v.z);
         write_file(file, line, string_size(line));
 
-        void* value = (void*) (uintptr_t) index;
-        map_add(&map, vertex, value, heap);
+        file_indices[i] = index;
         index += 1;
     }
 
@@ -494,7 +562,7 @@ bool obj_save_file(const char* path, JanMesh* mesh, Heap* heap)
     const char* s = "s off\n";
     write_file(file, s, string_size(s));
 
-    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    for(int face = 0; face < snapshot.faces_count; face += 1)
     {
         int i = 0;
         int line_left = LINE_SIZE;
@@ -506,29 +574,27 @@ bool obj_save_file(const char* path, JanMesh* mesh, Heap* heap)
         // be in it. .obj doesn't support holes, so the most reasonable way to
         // handle this would be to detect if the face has holes and, if it does,
         // split it into multiple faces.
-        ASSERT(!face->first_border->next);
+        int border = snapshot.face_offsets[face];
+        ASSERT(snapshot.face_offsets[face + 1] == border + 1);
 
-        JanLink* first = face->first_border->first;
-        JanLink* link = first;
-        do
+        int first = snapshot.border_offsets[border];
+        int last = snapshot.border_offsets[border + 1];
+        for(int j = first; j < last; j += 1)
         {
-            MaybePointer result = map_get(&map, link->vertex);
-            uintptr_t index = (uintptr_t) result.value;
             char text[22];
             text[0] = ' ';
-            int_to_string(text + 1, 21, (int) index);
+            int_to_string(text + 1, 21, file_indices[snapshot.indices[j]]);
             copied = copy_string(&line[i], line_left, text);
             i += copied;
             line_left -= copied;
-
-            link = link->next;
-        } while(link != first);
+        }
 
         copy_string(&line[i], line_left, "\n");
         write_file(file, line, string_size(line));
     }
 
-    map_destroy(&map, heap);
+    HEAP_DEALLOCATE(heap, file_indices);
+    jan_destroy_snapshot(&snapshot, heap);
 
     make_file_permanent(file, path);
     close_file(file);
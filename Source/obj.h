@@ -6,7 +6,7 @@
 #include "jan.h"
 #include "memory.h"
 
-bool obj_load_file(const char* path, JanMesh* mesh, Heap* heap, Stack* stack);
+bool obj_load_file(const char* path, JanMesh* mesh, Heap* heap, Stack* stack, Arena* arena);
 bool obj_save_file(const char* path, JanMesh* mesh, Heap* heap);
 
 #endif // OBJ_H_
@@ -14,7 +14,7 @@ typedef struct Object
     Float3 position;
     Quaternion orientation;
 
-    DenseMapId video_object;
+    SlotMapHandle video_object;
 
     ObjectId id;
 } Object;
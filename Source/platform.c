@@ -16,6 +16,7 @@ void destroy_stack(Platform* platform)
 void platform_create_heap(Platform* platform)
 {
     heap_create(&platform->heap, (uint32_t) ezlabytes(8));
+    heap_set_tag(&platform->heap, MEMORY_TAG_PLATFORM);
 }
 
 void platform_destroy_heap(Platform* platform)
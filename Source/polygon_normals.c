@@ -0,0 +1,393 @@
+#include "polygon_normals.h"
+
+#include "assert.h"
+#include "float_utilities.h"
+#include "platform_definitions.h"
+
+#include <math.h>
+
+#if defined(INSTRUCTION_SET_X64)
+#include <xmmintrin.h>
+
+#define LANES_COUNT 4
+
+typedef __m128 Lanes;
+
+#define lanes_gather(v, member) _mm_setr_ps(v[0].member, v[1].member, v[2].member, v[3].member)
+#define lanes_store(x, a) _mm_storeu_ps(x, a)
+#define lanes_zero() _mm_setzero_ps()
+#define lanes_add(a, b) _mm_add_ps(a, b)
+#define lanes_subtract(a, b) _mm_sub_ps(a, b)
+#define lanes_multiply(a, b) _mm_mul_ps(a, b)
+#define lanes_divide(a, b) _mm_div_ps(a, b)
+#define lanes_sqrt(a) _mm_sqrt_ps(a)
+#define lanes_set(x) _mm_set1_ps(x)
+#define lanes_min(a, b) _mm_min_ps(a, b)
+#define lanes_max(a, b) _mm_max_ps(a, b)
+#define lanes_and(a, b) _mm_and_ps(a, b)
+#define lanes_and_not(a, b) _mm_andnot_ps(a, b)
+#define lanes_or(a, b) _mm_or_ps(a, b)
+#define lanes_greater_than(a, b) _mm_cmpgt_ps(a, b)
+#define lanes_less_than(a, b) _mm_cmplt_ps(a, b)
+
+#endif // defined(INSTRUCTION_SET_X64)
+
+// The vertices are walked in pairs of prior and current, from the first vertex
+// around and back to it again. The result isn't normalised, and its length is
+// twice the area of the polygon.
+static Float3 compute_newell_normal(const Float3* positions, const uint32_t* indices, int start, int end)
+{
+    ASSERT(end > start);
+
+    Float3 normal = float3_zero;
+    Float3 prior = positions[indices[start]];
+    for(int i = start + 1; i <= end; i += 1)
+    {
+        Float3 current = positions[indices[i < end ? i : start]];
+        normal.x += (prior.y - current.y) * (prior.z + current.z);
+        normal.y += (prior.z - current.z) * (prior.x + current.x);
+        normal.z += (prior.x - current.x) * (prior.y + current.y);
+        prior = current;
+    }
+    return normal;
+}
+
+static Float3 normalise_or_zero(Float3 v)
+{
+    float squared_length = (v.x * v.x) + (v.y * v.y) + (v.z * v.z);
+    if(squared_length > 0.0f)
+    {
+        float length = sqrtf(squared_length);
+        v.x /= length;
+        v.y /= length;
+        v.z /= length;
+        return v;
+    }
+    return float3_zero;
+}
+
+// This is formula 4.4.46 from Abramowitz and Stegun's Handbook of
+// Mathematical Functions, which is within 2e-8 of the arccosine, so closer
+// than a float can tell apart near the right angles that are most common in
+// meshes. It's several times quicker than acosf, which takes up most of the
+// time of angle weighting otherwise.
+static float approximate_arccosine(float x)
+{
+    float a = fabsf(x);
+    float p = -0.0012624911f;
+    p = (p * a) + 0.0066700901f;
+    p = (p * a) - 0.0170881256f;
+    p = (p * a) + 0.0308918810f;
+    p = (p * a) - 0.0501743046f;
+    p = (p * a) + 0.0889789874f;
+    p = (p * a) - 0.2145988016f;
+    p = (p * a) + 1.5707963050f;
+    float angle = sqrtf(1.0f - a) * p;
+    return (x < 0.0f) ? pi - angle : angle;
+}
+
+// A corner where either side has no length has no angle to give it a weight.
+float get_corner_angle(Float3 prior, Float3 corner, Float3 next)
+{
+    Float3 a = {{prior.x - corner.x, prior.y - corner.y, prior.z - corner.z}};
+    Float3 b = {{next.x - corner.x, next.y - corner.y, next.z - corner.z}};
+    float squared_lengths = ((a.x * a.x) + (a.y * a.y) + (a.z * a.z)) * ((b.x * b.x) + (b.y * b.y) + (b.z * b.z));
+    if(squared_lengths == 0.0f)
+    {
+        return 0.0f;
+    }
+    float phase = ((a.x * b.x) + (a.y * b.y) + (a.z * b.z)) / sqrtf(squared_lengths);
+    phase = (phase < -1.0f) ? -1.0f : phase;
+    phase = (phase > 1.0f) ? 1.0f : phase;
+    return approximate_arccosine(phase);
+}
+
+#if defined(LANES_COUNT)
+
+typedef struct Float3Lanes
+{
+    Lanes x;
+    Lanes y;
+    Lanes z;
+} Float3Lanes;
+
+// Each lane gets the position at its own place in the indices. The lanes are
+// put together in registers, since storing floats one at a time and loading
+// them back as a whole stalls waiting on the stores.
+static Float3Lanes gather_positions(const Float3* positions, const uint32_t* indices, const int* places)
+{
+    Float3 gathered[LANES_COUNT];
+    for(int lane = 0; lane < LANES_COUNT; lane += 1)
+    {
+        gathered[lane] = positions[indices[places[lane]]];
+    }
+    Float3Lanes result = {lanes_gather(gathered, x), lanes_gather(gathered, y), lanes_gather(gathered, z)};
+    return result;
+}
+
+static Float3Lanes subtract_lanes3(Float3Lanes a, Float3Lanes b)
+{
+    Float3Lanes result = {lanes_subtract(a.x, b.x), lanes_subtract(a.y, b.y), lanes_subtract(a.z, b.z)};
+    return result;
+}
+
+static Lanes dot_lanes3(Float3Lanes a, Float3Lanes b)
+{
+    return lanes_add(lanes_add(lanes_multiply(a.x, b.x), lanes_multiply(a.y, b.y)), lanes_multiply(a.z, b.z));
+}
+
+static int find_most_sides(const int* offsets)
+{
+    int most_sides = 0;
+    for(int lane = 0; lane < LANES_COUNT; lane += 1)
+    {
+        int sides = offsets[lane + 1] - offsets[lane];
+        ASSERT(sides > 0);
+        if(sides > most_sides)
+        {
+            most_sides = sides;
+        }
+    }
+    return most_sides;
+}
+
+// Polygons are done a batch at a time, one to each lane. A polygon with fewer
+// sides than the biggest in its batch keeps pairing its first vertex with
+// itself once it's wrapped around, and those pairs add exactly zero, so each
+// lane sums the same terms in the same order as compute_newell_normal.
+static void compute_newell_normals_in_lanes(Float3* normals, const Float3* positions, const uint32_t* indices, const int* offsets)
+{
+    int most_sides = find_most_sides(offsets);
+
+    Float3Lanes prior = gather_positions(positions, indices, offsets);
+    Float3Lanes normal = {lanes_zero(), lanes_zero(), lanes_zero()};
+
+    for(int side = 1; side <= most_sides; side += 1)
+    {
+        int places[LANES_COUNT];
+        for(int lane = 0; lane < LANES_COUNT; lane += 1)
+        {
+            int place = offsets[lane] + side;
+            places[lane] = (place < offsets[lane + 1]) ? place : offsets[lane];
+        }
+        Float3Lanes current = gather_positions(positions, indices, places);
+
+        normal.x = lanes_add(normal.x, lanes_multiply(lanes_subtract(prior.y, current.y), lanes_add(prior.z, current.z)));
+        normal.y = lanes_add(normal.y, lanes_multiply(lanes_subtract(prior.z, current.z), lanes_add(prior.x, current.x)));
+        normal.z = lanes_add(normal.z, lanes_multiply(lanes_subtract(prior.x, current.x), lanes_add(prior.y, current.y)));
+
+        prior = current;
+    }
+
+    float xs[LANES_COUNT];
+    float ys[LANES_COUNT];
+    float zs[LANES_COUNT];
+    lanes_store(xs, normal.x);
+    lanes_store(ys, normal.y);
+    lanes_store(zs, normal.z);
+    for(int lane = 0; lane < LANES_COUNT; lane += 1)
+    {
+        normals[lane] = (Float3){{xs[lane], ys[lane], zs[lane]}};
+    }
+}
+
+// These are the same steps as approximate_arccosine, and get the same results.
+static Lanes approximate_arccosine_in_lanes(Lanes x)
+{
+    Lanes a = lanes_and_not(lanes_set(-0.0f), x);
+    Lanes p = lanes_set(-0.0012624911f);
+    p = lanes_add(lanes_multiply(p, a), lanes_set(0.0066700901f));
+    p = lanes_subtract(lanes_multiply(p, a), lanes_set(0.0170881256f));
+    p = lanes_add(lanes_multiply(p, a), lanes_set(0.0308918810f));
+    p = lanes_subtract(lanes_multiply(p, a), lanes_set(0.0501743046f));
+    p = lanes_add(lanes_multiply(p, a), lanes_set(0.0889789874f));
+    p = lanes_subtract(lanes_multiply(p, a), lanes_set(0.2145988016f));
+    p = lanes_add(lanes_multiply(p, a), lanes_set(1.5707963050f));
+    Lanes angle = lanes_multiply(lanes_sqrt(lanes_subtract(lanes_set(1.0f), a)), p);
+    Lanes negative = lanes_less_than(x, lanes_zero());
+    Lanes flipped = lanes_subtract(lanes_set(pi), angle);
+    return lanes_or(lanes_and(negative, flipped), lanes_and_not(negative, angle));
+}
+
+// The corners of a batch of polygons are gone around together, with one
+// polygon to each lane, and only adding to the vertex normals is left to do
+// one corner at a time. A lane whose polygon has run out of corners works out
+// an angle of zero at its first vertex, which is thrown away.
+static void add_corner_angles_in_lanes(Float3* vertex_normals, const Float3* polygon_normals, const Float3* positions, const uint32_t* indices, const int* offsets)
+{
+    int most_sides = find_most_sides(offsets);
+
+    Float3 normals[LANES_COUNT];
+    for(int lane = 0; lane < LANES_COUNT; lane += 1)
+    {
+        normals[lane] = normalise_or_zero(polygon_normals[lane]);
+    }
+
+    for(int side = 0; side < most_sides; side += 1)
+    {
+        int prior_places[LANES_COUNT];
+        int corner_places[LANES_COUNT];
+        int next_places[LANES_COUNT];
+        for(int lane = 0; lane < LANES_COUNT; lane += 1)
+        {
+            int start = offsets[lane];
+            int end = offsets[lane + 1];
+            int place = start + side;
+            if(place < end)
+            {
+                prior_places[lane] = (place == start) ? end - 1 : place - 1;
+                corner_places[lane] = place;
+                next_places[lane] = (place == end - 1) ? start : place + 1;
+            }
+            else
+            {
+                prior_places[lane] = start;
+                corner_places[lane] = start;
+                next_places[lane] = start;
+            }
+        }
+        Float3Lanes prior = gather_positions(positions, indices, prior_places);
+        Float3Lanes corner = gather_positions(positions, indices, corner_places);
+        Float3Lanes next = gather_positions(positions, indices, next_places);
+
+        Float3Lanes a = subtract_lanes3(prior, corner);
+        Float3Lanes b = subtract_lanes3(next, corner);
+        Lanes squared_lengths = lanes_multiply(dot_lanes3(a, a), dot_lanes3(b, b));
+        Lanes phase = lanes_divide(dot_lanes3(a, b), lanes_sqrt(squared_lengths));
+        phase = lanes_min(lanes_max(phase, lanes_set(-1.0f)), lanes_set(1.0f));
+        Lanes angle = approximate_arccosine_in_lanes(phase);
+        angle = lanes_and(angle, lanes_greater_than(squared_lengths, lanes_zero()));
+
+        float angles[LANES_COUNT];
+        lanes_store(angles, angle);
+        for(int lane = 0; lane < LANES_COUNT; lane += 1)
+        {
+            if(offsets[lane] + side < offsets[lane + 1])
+            {
+                Float3 normal = normals[lane];
+                Float3* sum = &vertex_normals[indices[corner_places[lane]]];
+                sum->x += angles[lane] * normal.x;
+                sum->y += angles[lane] * normal.y;
+                sum->z += angles[lane] * normal.z;
+            }
+        }
+    }
+}
+
+// Zero vectors are masked out, instead of being divided into NaN.
+static void normalise_normals_in_lanes(Float3* normals)
+{
+    Lanes x = lanes_gather(normals, x);
+    Lanes y = lanes_gather(normals, y);
+    Lanes z = lanes_gather(normals, z);
+
+    Lanes squared_length = lanes_add(lanes_add(lanes_multiply(x, x), lanes_multiply(y, y)), lanes_multiply(z, z));
+    Lanes nonzero = lanes_greater_than(squared_length, lanes_zero());
+    Lanes length = lanes_sqrt(squared_length);
+    x = lanes_and(lanes_divide(x, length), nonzero);
+    y = lanes_and(lanes_divide(y, length), nonzero);
+    z = lanes_and(lanes_divide(z, length), nonzero);
+
+    float xs[LANES_COUNT];
+    float ys[LANES_COUNT];
+    float zs[LANES_COUNT];
+    lanes_store(xs, x);
+    lanes_store(ys, y);
+    lanes_store(zs, z);
+    for(int lane = 0; lane < LANES_COUNT; lane += 1)
+    {
+        normals[lane] = (Float3){{xs[lane], ys[lane], zs[lane]}};
+    }
+}
+
+#endif // defined(LANES_COUNT)
+
+void compute_newell_normals(Float3* normals, const Float3* positions, const uint32_t* indices, const int* offsets, int polygons_count)
+{
+    int i = 0;
+#if defined(LANES_COUNT)
+    for(; i + LANES_COUNT <= polygons_count; i += LANES_COUNT)
+    {
+        compute_newell_normals_in_lanes(&normals[i], positions, indices, &offsets[i]);
+    }
+#endif
+    for(; i < polygons_count; i += 1)
+    {
+        normals[i] = compute_newell_normal(positions, indices, offsets[i], offsets[i + 1]);
+    }
+}
+
+// Each corner adds its polygon's normal to the corner's vertex. The polygon
+// normals are expected to be Newell normals, straight from
+// compute_newell_normals, whose lengths are what give area weighting. Angle
+// weighting normalises them first. The vertex normals aren't cleared, so that
+// several batches of polygons can add to the same vertices.
+//
+// Only angle weighting has a lanes path, since that's where the arithmetic
+// is. Area weighting is nothing but adds into scattered vertices, one corner
+// at a time either way.
+void add_corner_normals(Float3* vertex_normals, const Float3* polygon_normals, const Float3* positions, const uint32_t* indices, const int* offsets, int polygons_count, NormalWeight weight)
+{
+    int i = 0;
+#if defined(LANES_COUNT)
+    if(weight == NORMAL_WEIGHT_ANGLE)
+    {
+        for(; i + LANES_COUNT <= polygons_count; i += LANES_COUNT)
+        {
+            add_corner_angles_in_lanes(vertex_normals, &polygon_normals[i], positions, indices, &offsets[i]);
+        }
+    }
+#endif
+    for(; i < polygons_count; i += 1)
+    {
+        int start = offsets[i];
+        int end = offsets[i + 1];
+        Float3 normal = polygon_normals[i];
+
+        switch(weight)
+        {
+            case NORMAL_WEIGHT_AREA:
+            {
+                for(int j = start; j < end; j += 1)
+                {
+                    Float3* sum = &vertex_normals[indices[j]];
+                    sum->x += normal.x;
+                    sum->y += normal.y;
+                    sum->z += normal.z;
+                }
+                break;
+            }
+            case NORMAL_WEIGHT_ANGLE:
+            {
+                normal = normalise_or_zero(normal);
+                for(int j = start; j < end; j += 1)
+                {
+                    int prior = (j == start) ? end - 1 : j - 1;
+                    int next = (j == end - 1) ? start : j + 1;
+                    float angle = get_corner_angle(positions[indices[prior]], positions[indices[j]], positions[indices[next]]);
+                    Float3* sum = &vertex_normals[indices[j]];
+                    sum->x += angle * normal.x;
+                    sum->y += angle * normal.y;
+                    sum->z += angle * normal.z;
+                }
+                break;
+            }
+        }
+    }
+}
+
+// A normal with no length, such as a vertex with no faces, is left as zero.
+void normalise_normals(Float3* normals, int count)
+{
+    int i = 0;
+#if defined(LANES_COUNT)
+    for(; i + LANES_COUNT <= count; i += LANES_COUNT)
+    {
+        normalise_normals_in_lanes(&normals[i]);
+    }
+#endif
+    for(; i < count; i += 1)
+    {
+        normals[i] = normalise_or_zero(normals[i]);
+    }
+}
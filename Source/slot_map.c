@@ -0,0 +1,201 @@
+#include "slot_map.h"
+
+#include "assert.h"
+#include "invalid_index.h"
+
+#define INDEX_MASK (SLOT_MAP_SLOTS_CAP - 1)
+#define GENERATION_MASK ((1 << (32 - SLOT_MAP_INDEX_BITS)) - 1)
+
+const SlotMapHandle slot_map_handle_none = 0;
+
+static SlotMapHandle make_handle(uint32_t slot_index, uint32_t generation)
+{
+    return (generation << SLOT_MAP_INDEX_BITS) | slot_index;
+}
+
+static uint32_t get_slot_index(SlotMapHandle handle)
+{
+    return handle & INDEX_MASK;
+}
+
+static uint32_t get_generation(SlotMapHandle handle)
+{
+    return handle >> SLOT_MAP_INDEX_BITS;
+}
+
+// Generations wrap around within their bits, but skip zero so that a handle
+// can't ever be the same as slot_map_handle_none.
+static uint32_t next_generation(uint32_t generation)
+{
+    generation = (generation + 1) & GENERATION_MASK;
+    return generation ? generation : 1;
+}
+
+static void grow_elements(SlotMap* map, Heap* heap)
+{
+    int cap = map->cap ? 2 * map->cap : 16;
+    map->elements = (uint8_t*) heap_reallocate(heap, map->elements, map->element_size * cap);
+    map->handles = HEAP_REALLOCATE(heap, map->handles, SlotMapHandle, cap);
+    map->cap = cap;
+}
+
+static void grow_slots(SlotMap* map, Heap* heap)
+{
+    int cap = map->slots_cap ? 2 * map->slots_cap : 16;
+    ASSERT(cap <= SLOT_MAP_SLOTS_CAP);
+    map->slots = HEAP_REALLOCATE(heap, map->slots, SlotMapSlot, cap);
+    map->slots_cap = cap;
+}
+
+static SlotMapSlot* find_slot(SlotMap* map, SlotMapHandle handle)
+{
+    uint32_t slot_index = get_slot_index(handle);
+    if(handle == slot_map_handle_none || slot_index >= (uint32_t) map->slots_count)
+    {
+        return NULL;
+    }
+    SlotMapSlot* slot = &map->slots[slot_index];
+    if(slot->generation != get_generation(handle))
+    {
+        return NULL;
+    }
+    return slot;
+}
+
+void slot_map_create(SlotMap* map, uint32_t element_size, int cap, Heap* heap)
+{
+    ASSERT(element_size > 0);
+
+    map->elements = NULL;
+    map->handles = NULL;
+    map->slots = NULL;
+    map->element_size = element_size;
+    map->count = 0;
+    map->cap = 0;
+    map->slots_count = 0;
+    map->slots_cap = 0;
+    map->free_slot = invalid_index;
+
+    if(cap > 0)
+    {
+        map->elements = (uint8_t*) heap_allocate(heap, element_size * cap);
+        map->handles = HEAP_ALLOCATE(heap, SlotMapHandle, cap);
+        map->slots = HEAP_ALLOCATE(heap, SlotMapSlot, cap);
+        map->cap = cap;
+        map->slots_cap = cap;
+    }
+}
+
+void slot_map_destroy(SlotMap* map, Heap* heap)
+{
+    if(map)
+    {
+        SAFE_HEAP_DEALLOCATE(heap, map->elements);
+        SAFE_HEAP_DEALLOCATE(heap, map->handles);
+        SAFE_HEAP_DEALLOCATE(heap, map->slots);
+        map->count = 0;
+        map->cap = 0;
+        map->slots_count = 0;
+        map->slots_cap = 0;
+        map->free_slot = invalid_index;
+    }
+}
+
+SlotMapHandle slot_map_add(SlotMap* map, Heap* heap)
+{
+    if(map->count == map->cap)
+    {
+        grow_elements(map, heap);
+    }
+
+    uint32_t slot_index;
+    SlotMapSlot* slot;
+    if(map->free_slot != invalid_index)
+    {
+        slot_index = (uint32_t) map->free_slot;
+        slot = &map->slots[slot_index];
+        map->free_slot = (int) slot->index;
+    }
+    else
+    {
+        if(map->slots_count == map->slots_cap)
+        {
+            grow_slots(map, heap);
+        }
+        slot_index = (uint32_t) map->slots_count;
+        map->slots_count += 1;
+        slot = &map->slots[slot_index];
+        slot->generation = 1;
+    }
+
+    int index = map->count;
+    map->count += 1;
+
+    slot->index = (uint32_t) index;
+    SlotMapHandle handle = make_handle(slot_index, slot->generation);
+    map->handles[index] = handle;
+
+    // A removed element leaves its bytes behind, so clear them out.
+    zero_memory(map->elements + map->element_size * index, map->element_size);
+
+    return handle;
+}
+
+// The last element is moved into the place of the removed one, so that the
+// elements stay packed together.
+void slot_map_remove(SlotMap* map, SlotMapHandle handle)
+{
+    SlotMapSlot* slot = find_slot(map, handle);
+    ASSERT(slot);
+    if(!slot)
+    {
+        return;
+    }
+
+    int index = (int) slot->index;
+    int last = map->count - 1;
+    if(index != last)
+    {
+        uint32_t size = map->element_size;
+        copy_memory(map->elements + size * index, map->elements + size * last, size);
+        SlotMapHandle moved = map->handles[last];
+        map->handles[index] = moved;
+        map->slots[get_slot_index(moved)].index = (uint32_t) index;
+    }
+    map->count -= 1;
+
+    slot->generation = next_generation(slot->generation);
+    slot->index = (uint32_t) map->free_slot;
+    map->free_slot = (int) get_slot_index(handle);
+}
+
+void* slot_map_look_up(SlotMap* map, SlotMapHandle handle)
+{
+    if(handle == slot_map_handle_none)
+    {
+        return NULL;
+    }
+    // A stale handle is a bug in the caller, so it's caught here rather than
+    // handing back NULL for them to dereference. Use slot_map_contains to
+    // check a handle that may be stale.
+    SlotMapSlot* slot = find_slot(map, handle);
+    ASSERT(slot);
+    return map->elements + map->element_size * slot->index;
+}
+
+bool slot_map_contains(SlotMap* map, SlotMapHandle handle)
+{
+    return find_slot(map, handle) != NULL;
+}
+
+void* slot_map_get_element(SlotMap* map, int index)
+{
+    ASSERT(index >= 0 && index < map->count);
+    return map->elements + map->element_size * index;
+}
+
+SlotMapHandle slot_map_get_handle(SlotMap* map, int index)
+{
+    ASSERT(index >= 0 && index < map->count);
+    return map->handles[index];
+}
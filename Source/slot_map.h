@@ -0,0 +1,67 @@
+// A slot map stores elements of one size densely in an array, and hands out
+// handles to refer to them. A handle goes through an indirection array of slots
+// to find where its element is in the array, so elements can be moved, such as
+// when removing one swaps the last element into its place, without any handle
+// changing.
+//
+// Each slot has a generation that's bumped whenever its element is removed. A
+// handle records the generation it was made in, so one that outlives its
+// element is caught, instead of referring to whatever took the slot next.
+
+#ifndef SLOT_MAP_H_
+#define SLOT_MAP_H_
+
+#include "memory.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The low bits of a handle are its slot index and the high bits are its
+// generation. Generations start at one, so no valid handle is zero.
+typedef uint32_t SlotMapHandle;
+
+#define SLOT_MAP_INDEX_BITS 20
+#define SLOT_MAP_SLOTS_CAP (1 << SLOT_MAP_INDEX_BITS)
+
+extern const SlotMapHandle slot_map_handle_none;
+
+// A slot in use holds the index of its element in the dense array. A free slot
+// holds the index of the next free slot instead.
+typedef struct SlotMapSlot
+{
+    uint32_t index;
+    uint32_t generation;
+} SlotMapSlot;
+
+typedef struct SlotMap
+{
+    uint8_t* elements;
+    SlotMapHandle* handles;
+    SlotMapSlot* slots;
+    uint32_t element_size;
+    int count;
+    int cap;
+    int slots_count;
+    int slots_cap;
+    int free_slot;
+} SlotMap;
+
+void slot_map_create(SlotMap* map, uint32_t element_size, int cap, Heap* heap);
+void slot_map_destroy(SlotMap* map, Heap* heap);
+SlotMapHandle slot_map_add(SlotMap* map, Heap* heap);
+void slot_map_remove(SlotMap* map, SlotMapHandle handle);
+void* slot_map_look_up(SlotMap* map, SlotMapHandle handle);
+bool slot_map_contains(SlotMap* map, SlotMapHandle handle);
+void* slot_map_get_element(SlotMap* map, int index);
+SlotMapHandle slot_map_get_handle(SlotMap* map, int index);
+
+#define SLOT_MAP_LOOK_UP(map, type, handle) \
+    ((type*) slot_map_look_up(map, handle))
+
+// Iterate over every element in the dense array, in no particular order.
+#define FOR_ALL_IN_SLOT_MAP(type, map) \
+    for(type* it = (type*) (map)->elements; \
+            it != (type*) ((map)->elements + (map)->element_size * (map)->count); \
+            it += 1)
+
+#endif // SLOT_MAP_H_
@@ -1,6 +1,11 @@
 #ifndef SORTING_H_
 #define SORTING_H_
 
+#include "memory.h"
+#include "thread.h"
+
+#include <stdint.h>
+
 #define SWAP(type, a, b)\
     do { type temp = (a); (a) = (b); (b) = temp; } while(0)
 
@@ -19,114 +24,718 @@
         }\
     }
 
+#define DEFINE_HEAP_SORT(type, before, suffix)\
+    static void sift_down_##suffix(type* a, int left, int right)\
+    {\
+        int root = left;\
+        while(2 * root + 1 <= right)\
+        {\
+            int child = 2 * root + 1;\
+            int index = root;\
+            if(before(a[index], a[child]))\
+            {\
+                index = child;\
+            }\
+            if(child + 1 <= right && before(a[index], a[child + 1]))\
+            {\
+                index = child + 1;\
+            }\
+            if(index == root)\
+            {\
+                return;\
+            }\
+            else\
+            {\
+                SWAP(type, a[index], a[root]);\
+                root = index;\
+            }\
+        }\
+    }\
+    static void heap_sort_##suffix(type* a, int count)\
+    {\
+        for(int left = (count - 2) / 2; left >= 0; --left)\
+        {\
+            sift_down_##suffix(a, left, count - 1);\
+        }\
+        for(int right = count - 1; right > 0;)\
+        {\
+            SWAP(type, a[right], a[0]);\
+            right -= 1;\
+            sift_down_##suffix(a, 0, right);\
+        }\
+    }
+
+// The quick sort is a pattern-defeating quicksort, after Orson Peters' pdqsort.
+// It's an introsort at heart: a partition that comes out badly lopsided counts
+// against a budget of log2(count), and once that's spent the range falls back
+// to a heap sort, so the worst case is O(n log n) and the recursion depth is
+// bounded. On top of that, it notices when a partition didn't have to move
+// anything and tries to finish the range with an insertion sort that gives up
+// after a few moves, so sorted and reversed inputs take linear time. A pivot
+// equal to the element just left of the range means the range holds a run of
+// equal elements, which get split off in one pass instead of being recursed
+// into, so inputs with many duplicates stay fast too.
+//
+// DEFINE_QUICK_SORT_BRANCHLESS partitions in blocks, after Edelkamp and Weiss'
+// BlockQuicksort. It compares a block of elements into a buffer of offsets
+// without branching, and only then swaps them, so the branch predictor has
+// nothing to get wrong. That pays off when before is a cheap comparison of a
+// primitive key, like a float or an integer, and costs more than it saves when
+// before is expensive, like a string comparison.
+
+#define QUICK_SORT_INSERTION_THRESHOLD 24
+#define QUICK_SORT_NINTHER_THRESHOLD 128
+#define QUICK_SORT_PARTIAL_INSERTION_LIMIT 8
+#define QUICK_SORT_BLOCK_SIZE 64
+
 #define DEFINE_QUICK_SORT(type, before, suffix)\
-    static void quick_sort_innards(type* a, int left, int right)\
+    DEFINE_PATTERN_DEFEATING_SORT(type, before, suffix, false)
+
+#define DEFINE_QUICK_SORT_BRANCHLESS(type, before, suffix)\
+    DEFINE_PATTERN_DEFEATING_SORT(type, before, suffix, true)
+
+#define DEFINE_PATTERN_DEFEATING_SORT(type, before, suffix, branchless)\
+    DEFINE_INSERTION_SORT(type, before, suffix);\
+    DEFINE_HEAP_SORT(type, before, suffix);\
+    \
+    /* This is only safe when there's an element before the range that's not
+       after any element in it, which stops the scan instead of a bounds check. */\
+    static void unguarded_insertion_sort_##suffix(type* first, type* last)\
+    {\
+        for(type* i = first + 1; i < last; i += 1)\
+        {\
+            if(before(*i, *(i - 1)))\
+            {\
+                type temp = *i;\
+                type* j = i;\
+                do\
+                {\
+                    *j = *(j - 1);\
+                    j -= 1;\
+                } while(before(temp, *(j - 1)));\
+                *j = temp;\
+            }\
+        }\
+    }\
+    \
+    /* Returns false, leaving the range partly sorted, if it takes more than a
+       few moves to sort. */\
+    static bool partial_insertion_sort_##suffix(type* first, type* last)\
+    {\
+        int moves = 0;\
+        for(type* i = first + 1; i < last; i += 1)\
+        {\
+            if(before(*i, *(i - 1)))\
+            {\
+                type temp = *i;\
+                type* j = i;\
+                do\
+                {\
+                    *j = *(j - 1);\
+                    j -= 1;\
+                } while(j > first && before(temp, *(j - 1)));\
+                *j = temp;\
+                moves += (int) (i - j);\
+            }\
+            if(moves > QUICK_SORT_PARTIAL_INSERTION_LIMIT)\
+            {\
+                return false;\
+            }\
+        }\
+        return true;\
+    }\
+    \
+    static void sort2_##suffix(type* a, type* b)\
+    {\
+        if(before(*b, *a))\
+        {\
+            SWAP(type, *a, *b);\
+        }\
+    }\
+    \
+    static void sort3_##suffix(type* a, type* b, type* c)\
+    {\
+        sort2_##suffix(a, b);\
+        sort2_##suffix(b, c);\
+        sort2_##suffix(a, b);\
+    }\
+    \
+    /* Scans in from both ends for the first pair that's out of place. If they
+       cross without finding one, the range was already partitioned. */\
+    static void start_partition_##suffix(type* first, type* last, type pivot, type** left, type** right, bool* already_partitioned)\
+    {\
+        type* i = first;\
+        type* j = last;\
+        do {i += 1;} while(before(*i, pivot));\
+        if(i - 1 == first)\
+        {\
+            do {j -= 1;} while(i < j && !before(*j, pivot));\
+        }\
+        else\
+        {\
+            do {j -= 1;} while(!before(*j, pivot));\
+        }\
+        *already_partitioned = i >= j;\
+        *left = i;\
+        *right = j;\
+    }\
+    \
+    static type* finish_partition_##suffix(type* first, type* i, type pivot)\
+    {\
+        type* pivot_position = i - 1;\
+        *first = *pivot_position;\
+        *pivot_position = pivot;\
+        return pivot_position;\
+    }\
+    \
+    /* Partitions around the pivot at the start of the range, with elements
+       equal to it going to the right. */\
+    static type* partition_right_##suffix(type* first, type* last, bool* already_partitioned)\
+    {\
+        type pivot = *first;\
+        type* i;\
+        type* j;\
+        start_partition_##suffix(first, last, pivot, &i, &j, already_partitioned);\
+        while(i < j)\
+        {\
+            SWAP(type, *i, *j);\
+            do {i += 1;} while(before(*i, pivot));\
+            do {j -= 1;} while(!before(*j, pivot));\
+        }\
+        return finish_partition_##suffix(first, i, pivot);\
+    }\
+    \
+    /* Swaps the elements at the offsets from the left base with the ones at the
+       offsets back from the right base. When there are as many on each side,
+       which is always the case for a reversed range, it has to be plain swaps,
+       or the range wouldn't come out reversed and the next partition couldn't
+       tell it was sorted. Otherwise, it moves them around in one cycle, which
+       is cheaper. */\
+    static void swap_offsets_##suffix(type* left_base, type* right_base, uint8_t* left_offsets, uint8_t* right_offsets, int count, bool use_swaps)\
+    {\
+        if(use_swaps)\
+        {\
+            for(int k = 0; k < count; k += 1)\
+            {\
+                SWAP(type, left_base[left_offsets[k]], *(right_base - right_offsets[k]));\
+            }\
+        }\
+        else if(count > 0)\
+        {\
+            type* l = left_base + left_offsets[0];\
+            type* r = right_base - right_offsets[0];\
+            type temp = *l;\
+            *l = *r;\
+            for(int k = 1; k < count; k += 1)\
+            {\
+                l = left_base + left_offsets[k];\
+                *r = *l;\
+                r = right_base - right_offsets[k];\
+                *l = *r;\
+            }\
+            *r = temp;\
+        }\
+    }\
+    \
+    /* Does the same as partition_right, but a block at a time. The offsets of
+       the elements on the wrong side are written unconditionally, and the count
+       only moves past those that really are on the wrong side. */\
+    static type* block_partition_right_##suffix(type* first, type* last, bool* already_partitioned)\
     {\
-        while(left + 16 < right)\
+        type pivot = *first;\
+        type* i;\
+        type* j;\
+        start_partition_##suffix(first, last, pivot, &i, &j, already_partitioned);\
+        if(!*already_partitioned)\
         {\
-            int middle = (left + right) / 2;\
-            type median;\
-            if(before(a[left], a[right]))\
+            SWAP(type, *i, *j);\
+            i += 1;\
+            \
+            uint8_t left_offsets[QUICK_SORT_BLOCK_SIZE];\
+            uint8_t right_offsets[QUICK_SORT_BLOCK_SIZE];\
+            type* left_base = i;\
+            type* right_base = j;\
+            int left_count = 0;\
+            int right_count = 0;\
+            int left_start = 0;\
+            int right_start = 0;\
+            \
+            while(i < j)\
             {\
-                if(before(a[middle], a[left]))\
+                int unknown = (int) (j - i);\
+                int left_split = left_count == 0 ? (right_count == 0 ? unknown / 2 : unknown) : 0;\
+                int right_split = right_count == 0 ? unknown - left_split : 0;\
+                if(left_split > QUICK_SORT_BLOCK_SIZE)\
                 {\
-                    median = a[left];\
+                    left_split = QUICK_SORT_BLOCK_SIZE;\
                 }\
-                else if(before(a[middle], a[right]))\
+                if(right_split > QUICK_SORT_BLOCK_SIZE)\
                 {\
-                    median = a[middle];\
+                    right_split = QUICK_SORT_BLOCK_SIZE;\
                 }\
-                else\
+                \
+                for(int k = 0; k < left_split; k += 1)\
                 {\
-                    median = a[right];\
+                    left_offsets[left_count] = (uint8_t) k;\
+                    left_count += !before(*i, pivot);\
+                    i += 1;\
                 }\
-            }\
-            else\
-            {\
-                if(before(a[middle], a[right]))\
+                for(int k = 1; k <= right_split; k += 1)\
                 {\
-                    median = a[right];\
+                    j -= 1;\
+                    right_offsets[right_count] = (uint8_t) k;\
+                    right_count += before(*j, pivot);\
                 }\
-                else if(before(a[middle], a[left]))\
+                \
+                int count = left_count < right_count ? left_count : right_count;\
+                swap_offsets_##suffix(left_base, right_base, left_offsets + left_start, right_offsets + right_start, count, left_count == right_count);\
+                left_count -= count;\
+                right_count -= count;\
+                left_start += count;\
+                right_start += count;\
+                \
+                if(left_count == 0)\
                 {\
-                    median = a[middle];\
+                    left_start = 0;\
+                    left_base = i;\
                 }\
-                else\
+                if(right_count == 0)\
                 {\
-                    median = a[left];\
+                    right_start = 0;\
+                    right_base = j;\
                 }\
             }\
-            int i = left - 1;\
-            int j = right + 1;\
-            int pivot;\
-            for(;;)\
+            \
+            /* Whatever's left over on one side gets swapped into the middle. */\
+            if(left_count)\
             {\
-                do {j -= 1;} while(before(median, a[j]));\
-                do {i += 1;} while(before(a[i], median));\
-                if(i >= j)\
+                while(left_count--)\
                 {\
-                    pivot = j;\
-                    break;\
+                    j -= 1;\
+                    SWAP(type, left_base[left_offsets[left_start + left_count]], *j);\
                 }\
-                else\
+                i = j;\
+            }\
+            if(right_count)\
+            {\
+                while(right_count--)\
                 {\
-                    SWAP(type, a[i], a[j]);\
+                    SWAP(type, *(right_base - right_offsets[right_start + right_count]), *i);\
+                    i += 1;\
                 }\
             }\
-            quick_sort_innards(a, left, pivot);\
-            left = pivot + 1;\
         }\
+        return finish_partition_##suffix(first, i, pivot);\
     }\
     \
-    DEFINE_INSERTION_SORT(type, before, suffix);\
+    /* Partitions around the pivot at the start of the range, with elements
+       equal to it going to the left. Only called when nothing in the range is
+       before the pivot, so everything to its left is equal and done. */\
+    static type* partition_left_##suffix(type* first, type* last)\
+    {\
+        type pivot = *first;\
+        type* i = first;\
+        type* j = last;\
+        do {j -= 1;} while(before(pivot, *j));\
+        if(j + 1 == last)\
+        {\
+            do {i += 1;} while(i < j && !before(pivot, *i));\
+        }\
+        else\
+        {\
+            do {i += 1;} while(!before(pivot, *i));\
+        }\
+        while(i < j)\
+        {\
+            SWAP(type, *i, *j);\
+            do {j -= 1;} while(before(pivot, *j));\
+            do {i += 1;} while(!before(pivot, *i));\
+        }\
+        *first = *j;\
+        *j = pivot;\
+        return j;\
+    }\
+    \
+    /* Swaps a few elements from the ends of a lopsided part with ones a
+       quarter of the way in, to break up whatever pattern made it lopsided. */\
+    static void break_patterns_##suffix(type* first, type* last)\
+    {\
+        int count = (int) (last - first);\
+        if(count >= QUICK_SORT_INSERTION_THRESHOLD)\
+        {\
+            int quarter = count / 4;\
+            SWAP(type, first[0], first[quarter]);\
+            SWAP(type, last[-1], last[-quarter]);\
+            if(count > QUICK_SORT_NINTHER_THRESHOLD)\
+            {\
+                SWAP(type, first[1], first[quarter + 1]);\
+                SWAP(type, first[2], first[quarter + 2]);\
+                SWAP(type, last[-2], last[-(quarter + 1)]);\
+                SWAP(type, last[-3], last[-(quarter + 2)]);\
+            }\
+        }\
+    }\
+    \
+    static void quick_sort_innards_##suffix(type* first, type* last, int bad_allowed, bool leftmost)\
+    {\
+        for(;;)\
+        {\
+            int count = (int) (last - first);\
+            if(count < QUICK_SORT_INSERTION_THRESHOLD)\
+            {\
+                if(leftmost)\
+                {\
+                    insertion_sort_##suffix(first, count);\
+                }\
+                else\
+                {\
+                    unguarded_insertion_sort_##suffix(first, last);\
+                }\
+                return;\
+            }\
+            \
+            /* The pivot is a median of three, or for large ranges a pseudo
+               median of nine, and is swapped to the start of the range. */\
+            int half = count / 2;\
+            if(count > QUICK_SORT_NINTHER_THRESHOLD)\
+            {\
+                sort3_##suffix(first, first + half, last - 1);\
+                sort3_##suffix(first + 1, first + (half - 1), last - 2);\
+                sort3_##suffix(first + 2, first + (half + 1), last - 3);\
+                sort3_##suffix(first + (half - 1), first + half, first + (half + 1));\
+                SWAP(type, *first, first[half]);\
+            }\
+            else\
+            {\
+                sort3_##suffix(first + half, first, last - 1);\
+            }\
+            \
+            if(!leftmost && !before(*(first - 1), *first))\
+            {\
+                first = partition_left_##suffix(first, last) + 1;\
+                continue;\
+            }\
+            \
+            bool already_partitioned;\
+            type* pivot = branchless\
+                ? block_partition_right_##suffix(first, last, &already_partitioned)\
+                : partition_right_##suffix(first, last, &already_partitioned);\
+            \
+            int left_count = (int) (pivot - first);\
+            int right_count = (int) (last - (pivot + 1));\
+            bool lopsided = left_count < count / 8 || right_count < count / 8;\
+            if(lopsided)\
+            {\
+                bad_allowed -= 1;\
+                if(bad_allowed == 0)\
+                {\
+                    heap_sort_##suffix(first, count);\
+                    return;\
+                }\
+                break_patterns_##suffix(first, pivot);\
+                break_patterns_##suffix(pivot + 1, last);\
+            }\
+            else if(already_partitioned\
+                    && partial_insertion_sort_##suffix(first, pivot)\
+                    && partial_insertion_sort_##suffix(pivot + 1, last))\
+            {\
+                return;\
+            }\
+            \
+            quick_sort_innards_##suffix(first, pivot, bad_allowed, leftmost);\
+            first = pivot + 1;\
+            leftmost = false;\
+        }\
+    }\
     \
     static void quick_sort_##suffix(type* a, int count)\
     {\
-        quick_sort_innards(a, 0, count - 1);\
-        insertion_sort_##suffix(a, count);\
+        int bad_allowed = 0;\
+        for(int n = count; n > 0; n >>= 1)\
+        {\
+            bad_allowed += 1;\
+        }\
+        quick_sort_innards_##suffix(a, a + count, bad_allowed, true);\
     }
 
-#define DEFINE_HEAP_SORT(type, before, suffix)\
-    static void sift_down_##suffix(type* a, int left, int right)\
+// A radix sort orders elements by an unsigned key, a byte at a time, starting
+// with the least significant byte. It takes linear time and is stable, so it
+// beats the comparison sorts on large arrays with integer or float keys.
+//
+// get_key takes an element and gives back its key as a key_type, which should
+// be uint32_t or uint64_t. Use the RADIX_KEY_FROM_ macros below to get a key
+// that orders signed integers and floats correctly.
+#define DEFINE_RADIX_SORT(type, key_type, get_key, suffix)\
+    static void radix_sort_##suffix(type* a, int count, Heap* heap)\
     {\
-        int root = left;\
-        while(2 * root + 1 <= right)\
+        if(count < 2)\
         {\
-            int child = 2 * root + 1;\
-            int index = root;\
-            if(before(a[index], a[child]))\
+            return;\
+        }\
+        \
+        /* Count the digits for every pass at once, so the array is only read\
+           one extra time. */\
+        int counts[sizeof(key_type)][256] = {{0}};\
+        for(int i = 0; i < count; i += 1)\
+        {\
+            key_type key = get_key(a[i]);\
+            for(int pass = 0; pass < (int) sizeof(key_type); pass += 1)\
             {\
-                index = child;\
+                counts[pass][(key >> (8 * pass)) & 0xff] += 1;\
             }\
-            if(child + 1 <= right && before(a[index], a[child + 1]))\
+        }\
+        \
+        type* scratch = HEAP_ALLOCATE(heap, type, count);\
+        type* from = a;\
+        type* to = scratch;\
+        for(int pass = 0; pass < (int) sizeof(key_type); pass += 1)\
+        {\
+            /* If every key has the same digit, the pass wouldn't move\
+               anything. */\
+            int* digit_counts = counts[pass];\
+            if(digit_counts[(get_key(from[0]) >> (8 * pass)) & 0xff] == count)\
             {\
-                index = child + 1;\
+                continue;\
             }\
-            if(index == root)\
+            int offsets[256];\
+            int total = 0;\
+            for(int digit = 0; digit < 256; digit += 1)\
             {\
-                return;\
+                offsets[digit] = total;\
+                total += digit_counts[digit];\
+            }\
+            for(int i = 0; i < count; i += 1)\
+            {\
+                int digit = (int) ((get_key(from[i]) >> (8 * pass)) & 0xff);\
+                to[offsets[digit]] = from[i];\
+                offsets[digit] += 1;\
+            }\
+            SWAP(type*, from, to);\
+        }\
+        if(from != a)\
+        {\
+            copy_memory(a, from, sizeof(type) * count);\
+        }\
+        HEAP_DEALLOCATE(heap, scratch);\
+    }
+
+// A parallel sort splits the array into runs, quick sorts the runs on separate
+// threads, and then has each thread merge one slice of the output from all of
+// the runs at once. The slices are cut at splitters sampled from the sorted
+// runs.
+//
+// The number of runs doesn't depend on the number of cores, and the merge
+// always takes equal elements from the earliest run first. So the result is the
+// same on every machine, though it isn't stable. Arrays too small to be worth
+// the threads are quick sorted instead.
+//
+// This also defines quick_sort_<suffix> and insertion_sort_<suffix>, so don't
+// define a quick sort with the same suffix. before is called from several
+// threads at once, so it mustn't change anything.
+#define PARALLEL_SORT_RUNS 8
+#define PARALLEL_SORT_MINIMUM 65536
+
+#define DEFINE_PARALLEL_SORT(type, before, suffix)\
+    DEFINE_QUICK_SORT(type, before, suffix)\
+    \
+    typedef struct ParallelSortJob_##suffix\
+    {\
+        type* a;\
+        type* merged;\
+        int* starts;\
+        int* ends;\
+        type* splitters;\
+        int job_index;\
+        int jobs_count;\
+    } ParallelSortJob_##suffix;\
+    \
+    /* Find the first element that's not before the value. */\
+    static int lower_bound_##suffix(type* a, int left, int right, type value)\
+    {\
+        while(left < right)\
+        {\
+            int middle = left + (right - left) / 2;\
+            if(before(a[middle], value))\
+            {\
+                left = middle + 1;\
             }\
             else\
             {\
-                SWAP(type, a[index], a[root]);\
-                root = index;\
+                right = middle;\
             }\
         }\
+        return left;\
     }\
-    static void heap_sort_##suffix(type* a, int count)\
+    \
+    static void sort_runs_##suffix(void* argument)\
     {\
-        for(int left = floor((count - 2) / 2); left >= 0; --left)\
+        ParallelSortJob_##suffix* job = (ParallelSortJob_##suffix*) argument;\
+        for(int run = job->job_index; run < PARALLEL_SORT_RUNS; run += job->jobs_count)\
         {\
-            sift_down_##suffix(a, left, count - 1);\
+            quick_sort_##suffix(&job->a[job->starts[run]], job->ends[run] - job->starts[run]);\
         }\
-        for(int right = count - 1; right > 0;)\
+    }\
+    \
+    static void merge_slice_##suffix(ParallelSortJob_##suffix* job, int slice)\
+    {\
+        int heads[PARALLEL_SORT_RUNS];\
+        int ends[PARALLEL_SORT_RUNS];\
+        int offset = 0;\
+        for(int run = 0; run < PARALLEL_SORT_RUNS; run += 1)\
         {\
-            SWAP(type, a[right], a[0]);\
-            right -= 1;\
-            sift_down_##suffix(a, 0, right);\
+            int start = job->starts[run];\
+            int end = job->ends[run];\
+            int low = start;\
+            if(slice > 0)\
+            {\
+                low = lower_bound_##suffix(job->a, start, end, job->splitters[slice - 1]);\
+            }\
+            int high = end;\
+            if(slice < PARALLEL_SORT_RUNS - 1)\
+            {\
+                high = lower_bound_##suffix(job->a, start, end, job->splitters[slice]);\
+            }\
+            heads[run] = low;\
+            ends[run] = high;\
+            offset += low - start;\
+        }\
+        \
+        type* out = &job->merged[offset];\
+        for(;;)\
+        {\
+            int best = -1;\
+            for(int run = 0; run < PARALLEL_SORT_RUNS; run += 1)\
+            {\
+                if(heads[run] < ends[run]\
+                        && (best == -1 || before(job->a[heads[run]], job->a[heads[best]])))\
+                {\
+                    best = run;\
+                }\
+            }\
+            if(best == -1)\
+            {\
+                break;\
+            }\
+            *out = job->a[heads[best]];\
+            out += 1;\
+            heads[best] += 1;\
+        }\
+    }\
+    \
+    static void merge_slices_##suffix(void* argument)\
+    {\
+        ParallelSortJob_##suffix* job = (ParallelSortJob_##suffix*) argument;\
+        for(int slice = job->job_index; slice < PARALLEL_SORT_RUNS; slice += job->jobs_count)\
+        {\
+            merge_slice_##suffix(job, slice);\
+        }\
+    }\
+    \
+    /* The calling thread takes the first job, and the others each get a\
+       thread of their own. A job whose thread can't be started is done on\
+       the calling thread instead, since no job depends on another. */\
+    static void run_jobs_##suffix(ParallelSortJob_##suffix* jobs, int jobs_count, ThreadProcedure procedure)\
+    {\
+        Thread threads[PARALLEL_SORT_RUNS];\
+        bool started[PARALLEL_SORT_RUNS];\
+        for(int i = 1; i < jobs_count; i += 1)\
+        {\
+            started[i] = thread_create(&threads[i], procedure, &jobs[i]);\
+        }\
+        procedure(&jobs[0]);\
+        for(int i = 1; i < jobs_count; i += 1)\
+        {\
+            if(started[i])\
+            {\
+                thread_join(&threads[i]);\
+            }\
+            else\
+            {\
+                procedure(&jobs[i]);\
+            }\
         }\
+    }\
+    \
+    static void parallel_sort_##suffix(type* a, int count, Heap* heap)\
+    {\
+        if(count < PARALLEL_SORT_MINIMUM)\
+        {\
+            quick_sort_##suffix(a, count);\
+            return;\
+        }\
+        \
+        int starts[PARALLEL_SORT_RUNS];\
+        int ends[PARALLEL_SORT_RUNS];\
+        for(int run = 0; run < PARALLEL_SORT_RUNS; run += 1)\
+        {\
+            starts[run] = (int) ((int64_t) count * run / PARALLEL_SORT_RUNS);\
+            ends[run] = (int) ((int64_t) count * (run + 1) / PARALLEL_SORT_RUNS);\
+        }\
+        \
+        int jobs_count = get_logical_core_count();\
+        if(jobs_count > PARALLEL_SORT_RUNS)\
+        {\
+            jobs_count = PARALLEL_SORT_RUNS;\
+        }\
+        \
+        type* merged = HEAP_ALLOCATE(heap, type, count);\
+        type splitters[PARALLEL_SORT_RUNS - 1];\
+        ParallelSortJob_##suffix jobs[PARALLEL_SORT_RUNS];\
+        for(int i = 0; i < jobs_count; i += 1)\
+        {\
+            ParallelSortJob_##suffix job = {a, merged, starts, ends, splitters, i, jobs_count};\
+            jobs[i] = job;\
+        }\
+        \
+        run_jobs_##suffix(jobs, jobs_count, sort_runs_##suffix);\
+        \
+        /* Sample evenly through every run, and pick splitters evenly through\
+           the samples. */\
+        type samples[PARALLEL_SORT_RUNS * PARALLEL_SORT_RUNS];\
+        for(int run = 0; run < PARALLEL_SORT_RUNS; run += 1)\
+        {\
+            int length = ends[run] - starts[run];\
+            for(int i = 0; i < PARALLEL_SORT_RUNS; i += 1)\
+            {\
+                int index = starts[run] + (int) ((int64_t) length * (2 * i + 1) / (2 * PARALLEL_SORT_RUNS));\
+                samples[PARALLEL_SORT_RUNS * run + i] = a[index];\
+            }\
+        }\
+        insertion_sort_##suffix(samples, PARALLEL_SORT_RUNS * PARALLEL_SORT_RUNS);\
+        for(int i = 0; i < PARALLEL_SORT_RUNS - 1; i += 1)\
+        {\
+            splitters[i] = samples[PARALLEL_SORT_RUNS * (i + 1)];\
+        }\
+        \
+        run_jobs_##suffix(jobs, jobs_count, merge_slices_##suffix);\
+        \
+        copy_memory(a, merged, sizeof(type) * count);\
+        HEAP_DEALLOCATE(heap, merged);\
     }
 
+// These turn signed integers and floats into unsigned keys in the same order.
+// Flipping the sign bit puts the positive values above the negative ones. For
+// floats, the other bits of a negative value are also flipped, since a larger
+// magnitude there means a smaller value. The float ones use their argument
+// twice, so it shouldn't have side effects.
+#define RADIX_KEY_FROM_INT32(value)\
+    ((uint32_t) (int32_t) (value) ^ UINT32_C(0x80000000))
+
+#define RADIX_KEY_FROM_INT64(value)\
+    ((uint64_t) (int64_t) (value) ^ UINT64_C(0x8000000000000000))
+
+#define FLOAT_BITS(value)\
+    (((union {float f; uint32_t u;}) {.f = (value)}).u)
+
+#define DOUBLE_BITS(value)\
+    (((union {double f; uint64_t u;}) {.f = (value)}).u)
+
+#define RADIX_KEY_FROM_FLOAT(value)\
+    (FLOAT_BITS(value) ^ ((uint32_t) -(int32_t) (FLOAT_BITS(value) >> 31) | UINT32_C(0x80000000)))
+
+#define RADIX_KEY_FROM_DOUBLE(value)\
+    (DOUBLE_BITS(value) ^ ((uint64_t) -(int64_t) (DOUBLE_BITS(value) >> 63) | UINT64_C(0x8000000000000000)))
+
 #define REVERSE_ARRAY(type, array, count) \
     do \
     { \
@@ -0,0 +1,504 @@
+#include "swiss_map.h"
+
+#include "assert.h"
+#include "int_utilities.h"
+#include "platform_definitions.h"
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
+#if defined(INSTRUCTION_SET_X64)
+#include <emmintrin.h>
+#endif
+
+// A control byte with its high bit set is in use, and the low 7 bits are
+// taken from the hash of its key. Since heap memory comes back zeroed, a new
+// table starts out with every slot empty.
+#define CONTROL_EMPTY 0x00
+#define CONTROL_DELETED 0x01
+#define CONTROL_FULL 0x80
+
+// This value is used to indicate an invalid iterator, or one that's reached the
+// end of iteration. It's also returned when a key isn't found.
+static const int end_index = -1;
+
+// This is how many keys the batched procedures hash and prefetch before they
+// look any of them up.
+#define BATCH_SIZE 16
+
+static uint64_t hash_key(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    key *= UINT64_C(0xc4ceb9fe1a85ec53);
+    key ^= key >> 33;
+    return key;
+}
+
+static uint8_t get_full_control(uint64_t hash)
+{
+    return CONTROL_FULL | (hash & 0x7f);
+}
+
+static int get_probe_start(SwissMap* map, uint64_t hash)
+{
+    return (int) (hash >> 7) & (map->cap - 1);
+}
+
+static int get_growth_limit(int cap)
+{
+    return cap - (cap / 8);
+}
+
+static int count_trailing_zeros(uint32_t x)
+{
+    ASSERT(x);
+#if defined(COMPILER_MSVC)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int) index;
+#elif defined(COMPILER_GCC)
+    return __builtin_ctz(x);
+#endif
+}
+
+static int count_leading_zeros_in_group(uint32_t x)
+{
+    int count = 0;
+    for(uint32_t bit = 1 << (SWISS_MAP_GROUP_WIDTH - 1); bit && !(x & bit); bit >>= 1)
+    {
+        count += 1;
+    }
+    return count;
+}
+
+// Group Matching...............................................................
+
+// Each of these compares a whole group of control bytes and returns a mask
+// with one bit set for each byte that matches. SSE2 is always available on
+// x64, so there's no need to check for it.
+#if defined(INSTRUCTION_SET_X64)
+
+static uint32_t match_control(const uint8_t* group, uint8_t control)
+{
+    __m128i controls = _mm_loadu_si128((const __m128i*) group);
+    __m128i matches = _mm_cmpeq_epi8(controls, _mm_set1_epi8((char) control));
+    return (uint32_t) _mm_movemask_epi8(matches);
+}
+
+static uint32_t match_free(const uint8_t* group)
+{
+    __m128i controls = _mm_loadu_si128((const __m128i*) group);
+    return ~((uint32_t) _mm_movemask_epi8(controls)) & 0xffff;
+}
+
+#else
+
+static uint32_t match_control(const uint8_t* group, uint8_t control)
+{
+    uint32_t mask = 0;
+    for(int i = 0; i < SWISS_MAP_GROUP_WIDTH; i += 1)
+    {
+        mask |= (uint32_t) (group[i] == control) << i;
+    }
+    return mask;
+}
+
+static uint32_t match_free(const uint8_t* group)
+{
+    uint32_t mask = 0;
+    for(int i = 0; i < SWISS_MAP_GROUP_WIDTH; i += 1)
+    {
+        mask |= (uint32_t) !(group[i] & CONTROL_FULL) << i;
+    }
+    return mask;
+}
+
+#endif // defined(INSTRUCTION_SET_X64)
+
+static uint32_t match_empty(const uint8_t* group)
+{
+    return match_control(group, CONTROL_EMPTY);
+}
+
+// Probing......................................................................
+
+static void set_control(SwissMap* map, int index, uint8_t control)
+{
+    map->controls[index] = control;
+    if(index < SWISS_MAP_GROUP_WIDTH)
+    {
+        map->controls[map->cap + index] = control;
+    }
+}
+
+// Groups are probed at triangular number offsets, which visits every group
+// once before repeating, as long as the capacity is a power of two.
+static int find_slot(SwissMap* map, void* key, uint64_t hash)
+{
+    int mask = map->cap - 1;
+    uint8_t control = get_full_control(hash);
+    int position = get_probe_start(map, hash);
+
+    for(int stride = SWISS_MAP_GROUP_WIDTH;; stride += SWISS_MAP_GROUP_WIDTH)
+    {
+        const uint8_t* group = &map->controls[position];
+        for(uint32_t matches = match_control(group, control); matches; matches &= matches - 1)
+        {
+            int index = (position + count_trailing_zeros(matches)) & mask;
+            if(map->slots[index].key == key)
+            {
+                return index;
+            }
+        }
+        if(match_empty(group))
+        {
+            return end_index;
+        }
+        position = (position + stride) & mask;
+    }
+}
+
+static int find_free_slot(SwissMap* map, uint64_t hash)
+{
+    int mask = map->cap - 1;
+    int position = get_probe_start(map, hash);
+
+    for(int stride = SWISS_MAP_GROUP_WIDTH;; stride += SWISS_MAP_GROUP_WIDTH)
+    {
+        uint32_t frees = match_free(&map->controls[position]);
+        if(frees)
+        {
+            return (position + count_trailing_zeros(frees)) & mask;
+        }
+        position = (position + stride) & mask;
+    }
+}
+
+static void allocate_table(SwissMap* map, int cap, Heap* heap)
+{
+    ASSERT(can_use_bitwise_and_to_cycle(cap));
+    ASSERT(cap >= SWISS_MAP_GROUP_WIDTH);
+
+    map->cap = cap;
+    map->count = 0;
+    map->growth_left = get_growth_limit(cap);
+    map->slots = HEAP_ALLOCATE(heap, SwissMapSlot, cap);
+    map->controls = HEAP_ALLOCATE(heap, uint8_t, cap + SWISS_MAP_GROUP_WIDTH);
+}
+
+// Deleted slots count against the growth limit, so a table can run out of room
+// with few keys in it. If so, it's rebuilt at the same size to clear them out.
+static void resize(SwissMap* map, int cap, Heap* heap)
+{
+    SwissMap prior = *map;
+    allocate_table(map, cap, heap);
+
+    for(int i = 0; i < prior.cap; i += 1)
+    {
+        if(prior.controls[i] & CONTROL_FULL)
+        {
+            SwissMapSlot slot = prior.slots[i];
+            uint64_t hash = hash_key((uint64_t) (uintptr_t) slot.key);
+            int index = find_free_slot(map, hash);
+            set_control(map, index, get_full_control(hash));
+            map->slots[index] = slot;
+        }
+    }
+    map->count = prior.count;
+    map->growth_left -= prior.count;
+
+    HEAP_DEALLOCATE(heap, prior.slots);
+    HEAP_DEALLOCATE(heap, prior.controls);
+}
+
+static int get_valid_cap(int cap)
+{
+    if(cap <= SWISS_MAP_GROUP_WIDTH)
+    {
+        return SWISS_MAP_GROUP_WIDTH;
+    }
+    return (int) next_power_of_two((uint32_t) cap);
+}
+
+// Map..........................................................................
+
+void swiss_map_create(SwissMap* map, int cap, Heap* heap)
+{
+    allocate_table(map, get_valid_cap(cap), heap);
+}
+
+void swiss_map_destroy(SwissMap* map, Heap* heap)
+{
+    if(map)
+    {
+        SAFE_HEAP_DEALLOCATE(heap, map->slots);
+        SAFE_HEAP_DEALLOCATE(heap, map->controls);
+
+        map->cap = 0;
+        map->count = 0;
+        map->growth_left = 0;
+    }
+}
+
+void swiss_map_clear(SwissMap* map)
+{
+    zero_memory(map->controls, map->cap + SWISS_MAP_GROUP_WIDTH);
+    map->count = 0;
+    map->growth_left = get_growth_limit(map->cap);
+}
+
+MaybePointer swiss_map_get(SwissMap* map, void* key)
+{
+    MaybePointer result = {0};
+
+    uint64_t hash = hash_key((uint64_t) (uintptr_t) key);
+    int index = find_slot(map, key, hash);
+    if(index != end_index)
+    {
+        result.value = map->slots[index].value;
+        result.valid = true;
+    }
+    return result;
+}
+
+MaybeUint64 swiss_map_get_uint64(SwissMap* map, void* key)
+{
+    MaybePointer result = swiss_map_get(map, key);
+    MaybeUint64 result_uint64 =
+    {
+        .valid = result.valid,
+        .value = (uint64_t) (uintptr_t) result.value,
+    };
+    return result_uint64;
+}
+
+MaybePointer swiss_map_get_from_uint64(SwissMap* map, uint64_t key)
+{
+    return swiss_map_get(map, (void*) (uintptr_t) key);
+}
+
+MaybeUint64 swiss_map_get_uint64_from_uint64(SwissMap* map, uint64_t key)
+{
+    return swiss_map_get_uint64(map, (void*) (uintptr_t) key);
+}
+
+static void insert(SwissMap* map, void* key, void* value, uint64_t hash, Heap* heap)
+{
+    int index = find_slot(map, key, hash);
+    if(index != end_index)
+    {
+        map->slots[index].value = value;
+        return;
+    }
+
+    index = find_free_slot(map, hash);
+    if(map->growth_left == 0 && map->controls[index] == CONTROL_EMPTY)
+    {
+        int cap = map->cap;
+        if(map->count >= get_growth_limit(cap) / 2)
+        {
+            cap *= 2;
+        }
+        resize(map, cap, heap);
+        index = find_free_slot(map, hash);
+    }
+
+    if(map->controls[index] == CONTROL_EMPTY)
+    {
+        map->growth_left -= 1;
+    }
+    set_control(map, index, get_full_control(hash));
+    map->slots[index].key = key;
+    map->slots[index].value = value;
+    map->count += 1;
+}
+
+void swiss_map_add(SwissMap* map, void* key, void* value, Heap* heap)
+{
+    uint64_t hash = hash_key((uint64_t) (uintptr_t) key);
+    insert(map, key, value, hash, heap);
+}
+
+void swiss_map_add_uint64(SwissMap* map, void* key, uint64_t value, Heap* heap)
+{
+    swiss_map_add(map, key, (void*) (uintptr_t) value, heap);
+}
+
+void swiss_map_add_from_uint64(SwissMap* map, uint64_t key, void* value, Heap* heap)
+{
+    swiss_map_add(map, (void*) (uintptr_t) key, value, heap);
+}
+
+void swiss_map_add_uint64_from_uint64(SwissMap* map, uint64_t key, uint64_t value, Heap* heap)
+{
+    swiss_map_add(map, (void*) (uintptr_t) key, (void*) (uintptr_t) value, heap);
+}
+
+void swiss_map_remove(SwissMap* map, void* key)
+{
+    uint64_t hash = hash_key((uint64_t) (uintptr_t) key);
+    int index = find_slot(map, key, hash);
+    if(index == end_index)
+    {
+        return;
+    }
+
+    map->count -= 1;
+
+    // A lookup only stops at an empty slot. So, if this slot and its neighbours
+    // never made up a full group, no lookup could have probed past it, and it
+    // can be emptied. Otherwise, it has to be marked deleted.
+    int mask = map->cap - 1;
+    int before = (index - SWISS_MAP_GROUP_WIDTH) & mask;
+    uint32_t empty_before = match_empty(&map->controls[before]);
+    uint32_t empty_after = match_empty(&map->controls[index]);
+    bool was_never_full = empty_before && empty_after
+        && count_trailing_zeros(empty_after) + count_leading_zeros_in_group(empty_before) < SWISS_MAP_GROUP_WIDTH;
+
+    if(was_never_full)
+    {
+        set_control(map, index, CONTROL_EMPTY);
+        map->growth_left += 1;
+    }
+    else
+    {
+        set_control(map, index, CONTROL_DELETED);
+    }
+}
+
+void swiss_map_remove_uint64(SwissMap* map, uint64_t key)
+{
+    swiss_map_remove(map, (void*) (uintptr_t) key);
+}
+
+void swiss_map_reserve(SwissMap* map, int cap, Heap* heap)
+{
+    cap = get_valid_cap(cap);
+    if(cap > map->cap)
+    {
+        resize(map, cap, heap);
+    }
+}
+
+// Batched Procedures...........................................................
+
+// These hash a batch of keys and prefetch the group and slot each one starts
+// probing at, before coming back to resolve them. So, the cache misses for the
+// whole batch overlap, instead of each lookup waiting on its own.
+
+static void prefetch(const void* address)
+{
+#if defined(COMPILER_MSVC)
+    _mm_prefetch((const char*) address, _MM_HINT_T0);
+#elif defined(COMPILER_GCC)
+    __builtin_prefetch(address);
+#endif
+}
+
+static void prefetch_group(SwissMap* map, uint64_t hash)
+{
+    int position = get_probe_start(map, hash);
+    prefetch(&map->controls[position]);
+    prefetch(&map->slots[position]);
+}
+
+void swiss_map_get_many(SwissMap* map, void** keys, MaybePointer* results, int count)
+{
+    uint64_t hashes[BATCH_SIZE];
+
+    for(int start = 0; start < count; start += BATCH_SIZE)
+    {
+        int batch_count = imin(count - start, BATCH_SIZE);
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            hashes[i] = hash_key((uint64_t) (uintptr_t) keys[start + i]);
+            prefetch_group(map, hashes[i]);
+        }
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            MaybePointer result = {0};
+            int index = find_slot(map, keys[start + i], hashes[i]);
+            if(index != end_index)
+            {
+                result.value = map->slots[index].value;
+                result.valid = true;
+            }
+            results[start + i] = result;
+        }
+    }
+}
+
+void swiss_map_add_many(SwissMap* map, void** keys, void** values, int count, Heap* heap)
+{
+    // Make room up front, so a batch isn't likely to resize out from under
+    // the slots it prefetched. A resize partway is still handled, just slower.
+    int needed = map->count + count;
+    if(needed > get_growth_limit(map->cap))
+    {
+        swiss_map_reserve(map, needed + needed / 7 + 1, heap);
+    }
+
+    uint64_t hashes[BATCH_SIZE];
+
+    for(int start = 0; start < count; start += BATCH_SIZE)
+    {
+        int batch_count = imin(count - start, BATCH_SIZE);
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            hashes[i] = hash_key((uint64_t) (uintptr_t) keys[start + i]);
+            prefetch_group(map, hashes[i]);
+        }
+
+        for(int i = 0; i < batch_count; i += 1)
+        {
+            insert(map, keys[start + i], values[start + i], hashes[i], heap);
+        }
+    }
+}
+
+// Iterator.....................................................................
+
+static int find_next_full(SwissMap* map, int index)
+{
+    for(index += 1; index < map->cap; index += 1)
+    {
+        if(map->controls[index] & CONTROL_FULL)
+        {
+            return index;
+        }
+    }
+    return end_index;
+}
+
+SwissMapIterator swiss_map_iterator_next(SwissMapIterator it)
+{
+    return (SwissMapIterator){it.map, find_next_full(it.map, it.index)};
+}
+
+SwissMapIterator swiss_map_iterator_start(SwissMap* map)
+{
+    return (SwissMapIterator){map, find_next_full(map, -1)};
+}
+
+bool swiss_map_iterator_is_not_end(SwissMapIterator it)
+{
+    return it.index != end_index;
+}
+
+void* swiss_map_iterator_get_key(SwissMapIterator it)
+{
+    ASSERT(it.index >= 0 && it.index < it.map->cap);
+    return it.map->slots[it.index].key;
+}
+
+void* swiss_map_iterator_get_value(SwissMapIterator it)
+{
+    ASSERT(it.index >= 0 && it.index < it.map->cap);
+    return it.map->slots[it.index].value;
+}
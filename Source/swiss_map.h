@@ -0,0 +1,65 @@
+#ifndef SWISS_MAP_H_
+#define SWISS_MAP_H_
+
+#include "maybe_types.h"
+#include "memory.h"
+
+#include <stdint.h>
+
+// This is a hash table with the same interface as Map, laid out after the
+// SwissTable scheme. Each slot has a control byte that's either empty, deleted
+// or holds 7 bits of the key's hash. A lookup compares a whole group of
+// control bytes at once, and only touches slots whose hash bits match. Keys are
+// stored next to their values, so a match costs one more cache line at most.
+#define SWISS_MAP_GROUP_WIDTH 16
+
+typedef struct SwissMapSlot
+{
+    void* key;
+    void* value;
+} SwissMapSlot;
+
+// There are SWISS_MAP_GROUP_WIDTH more control bytes than slots, which mirror
+// the first ones, so a group can be read from any slot without wrapping.
+typedef struct SwissMap
+{
+    SwissMapSlot* slots;
+    uint8_t* controls;
+    int cap;
+    int count;
+    int growth_left;
+} SwissMap;
+
+void swiss_map_create(SwissMap* map, int cap, Heap* heap);
+void swiss_map_destroy(SwissMap* map, Heap* heap);
+void swiss_map_clear(SwissMap* map);
+MaybePointer swiss_map_get(SwissMap* map, void* key);
+MaybeUint64 swiss_map_get_uint64(SwissMap* map, void* key);
+MaybePointer swiss_map_get_from_uint64(SwissMap* map, uint64_t key);
+MaybeUint64 swiss_map_get_uint64_from_uint64(SwissMap* map, uint64_t key);
+void swiss_map_add(SwissMap* map, void* key, void* value, Heap* heap);
+void swiss_map_add_uint64(SwissMap* map, void* key, uint64_t value, Heap* heap);
+void swiss_map_add_from_uint64(SwissMap* map, uint64_t key, void* value, Heap* heap);
+void swiss_map_add_uint64_from_uint64(SwissMap* map, uint64_t key, uint64_t value, Heap* heap);
+void swiss_map_remove(SwissMap* map, void* key);
+void swiss_map_remove_uint64(SwissMap* map, uint64_t key);
+void swiss_map_reserve(SwissMap* map, int cap, Heap* heap);
+void swiss_map_get_many(SwissMap* map, void** keys, MaybePointer* results, int count);
+void swiss_map_add_many(SwissMap* map, void** keys, void** values, int count, Heap* heap);
+
+typedef struct SwissMapIterator
+{
+    SwissMap* map;
+    int index;
+} SwissMapIterator;
+
+SwissMapIterator swiss_map_iterator_next(SwissMapIterator it);
+SwissMapIterator swiss_map_iterator_start(SwissMap* map);
+bool swiss_map_iterator_is_not_end(SwissMapIterator it);
+void* swiss_map_iterator_get_key(SwissMapIterator it);
+void* swiss_map_iterator_get_value(SwissMapIterator it);
+
+#define ITERATE_SWISS_MAP(it, map) \
+    for(SwissMapIterator it = swiss_map_iterator_start(map); swiss_map_iterator_is_not_end(it); it = swiss_map_iterator_next(it))
+
+#endif // SWISS_MAP_H_
@@ -0,0 +1,97 @@
+#include "thread.h"
+
+#include "assert.h"
+
+#if defined(OS_LINUX)
+
+#include <sched.h>
+#include <unistd.h>
+
+static void* run_thread(void* argument)
+{
+    Thread* thread = (Thread*) argument;
+    thread->procedure(thread->argument);
+    return NULL;
+}
+
+bool thread_create(Thread* thread, ThreadProcedure procedure, void* argument)
+{
+    thread->procedure = procedure;
+    thread->argument = argument;
+    int result = pthread_create(&thread->handle, NULL, run_thread, thread);
+    ASSERT(result == 0);
+    return result == 0;
+}
+
+void thread_join(Thread* thread)
+{
+    int result = pthread_join(thread->handle, NULL);
+    ASSERT(result == 0);
+}
+
+uint64_t thread_get_id()
+{
+    return (uint64_t) pthread_self();
+}
+
+void thread_yield()
+{
+    sched_yield();
+}
+
+int get_logical_core_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if(count < 1)
+    {
+        return 1;
+    }
+    return (int) count;
+}
+
+#elif defined(OS_WINDOWS)
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+static DWORD WINAPI run_thread(LPVOID argument)
+{
+    Thread* thread = (Thread*) argument;
+    thread->procedure(thread->argument);
+    return 0;
+}
+
+bool thread_create(Thread* thread, ThreadProcedure procedure, void* argument)
+{
+    thread->procedure = procedure;
+    thread->argument = argument;
+    thread->handle = CreateThread(NULL, 0, run_thread, thread, 0, NULL);
+    ASSERT(thread->handle);
+    return thread->handle;
+}
+
+void thread_join(Thread* thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    thread->handle = NULL;
+}
+
+uint64_t thread_get_id()
+{
+    return GetCurrentThreadId();
+}
+
+void thread_yield()
+{
+    SwitchToThread();
+}
+
+int get_logical_core_count()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#endif // defined(OS_WINDOWS)
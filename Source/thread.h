@@ -0,0 +1,38 @@
+#ifndef THREAD_H_
+#define THREAD_H_
+
+#include "platform_definitions.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(OS_LINUX)
+#include <pthread.h>
+#endif
+
+#if defined(COMPILER_MSVC)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(COMPILER_GCC)
+#define THREAD_LOCAL __thread
+#endif
+
+typedef void (*ThreadProcedure)(void* argument);
+
+typedef struct Thread
+{
+    ThreadProcedure procedure;
+    void* argument;
+#if defined(OS_LINUX)
+    pthread_t handle;
+#elif defined(OS_WINDOWS)
+    void* handle;
+#endif
+} Thread;
+
+bool thread_create(Thread* thread, ThreadProcedure procedure, void* argument);
+void thread_join(Thread* thread);
+uint64_t thread_get_id();
+void thread_yield();
+int get_logical_core_count();
+
+#endif // THREAD_H_
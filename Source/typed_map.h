@@ -0,0 +1,184 @@
+#ifndef TYPED_MAP_H_
+#define TYPED_MAP_H_
+
+#include "memory.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// This defines a hash table for the given key and value types, in the same way
+// DEFINE_QUICK_SORT defines a sort. It has the same scheme as Map, open
+// addressing with linear probing, but keys and values are stored as they are
+// and the hash and equality functions are called directly, so they can be
+// inlined.
+//
+// The hash function takes a key and returns a uint32_t, and the equality
+// function takes two keys and returns whether they're equal. A stored hash of
+// zero marks an empty slot, so a hash that comes out as zero is bumped to one.
+// Any slot whose hash is nonzero is full, which is how to iterate over one.
+// The procedures are all static inline, so that a file using only some of them
+// doesn't get warnings about the rest.
+//
+// For example, DEFINE_MAP(EdgeMap, VertexPair, JanEdge*, hash_pair,
+// pairs_equal, edge) defines the type EdgeMap and procedures like
+// map_add_edge and map_get_edge.
+#define DEFINE_MAP(name, key_type, value_type, hash, equals, suffix)\
+    typedef struct name\
+    {\
+        key_type* keys;\
+        value_type* values;\
+        uint32_t* hashes;\
+        int cap;\
+        int count;\
+    } name;\
+    \
+    static inline uint32_t map_hash_##suffix(key_type key)\
+    {\
+        uint32_t hash_value = hash(key);\
+        return hash_value ? hash_value : 1;\
+    }\
+    \
+    static inline int map_find_slot_##suffix(name* map, key_type key, uint32_t hash_value)\
+    {\
+        int mask = map->cap - 1;\
+        int probe = hash_value & mask;\
+        while(map->hashes[probe]\
+                && !(map->hashes[probe] == hash_value && equals(map->keys[probe], key)))\
+        {\
+            probe = (probe + 1) & mask;\
+        }\
+        return probe;\
+    }\
+    \
+    static inline void map_allocate_##suffix(name* map, int cap, Heap* heap)\
+    {\
+        map->cap = cap;\
+        map->count = 0;\
+        map->keys = HEAP_ALLOCATE(heap, key_type, cap);\
+        map->values = HEAP_ALLOCATE(heap, value_type, cap);\
+        map->hashes = HEAP_ALLOCATE(heap, uint32_t, cap);\
+    }\
+    \
+    static inline void map_create_##suffix(name* map, int cap, Heap* heap)\
+    {\
+        int valid_cap = 16;\
+        while(valid_cap < cap)\
+        {\
+            valid_cap *= 2;\
+        }\
+        map_allocate_##suffix(map, valid_cap, heap);\
+    }\
+    \
+    static inline void map_destroy_##suffix(name* map, Heap* heap)\
+    {\
+        if(map)\
+        {\
+            SAFE_HEAP_DEALLOCATE(heap, map->keys);\
+            SAFE_HEAP_DEALLOCATE(heap, map->values);\
+            SAFE_HEAP_DEALLOCATE(heap, map->hashes);\
+            map->cap = 0;\
+            map->count = 0;\
+        }\
+    }\
+    \
+    static inline void map_clear_##suffix(name* map)\
+    {\
+        zero_memory(map->hashes, sizeof(*map->hashes) * map->cap);\
+        map->count = 0;\
+    }\
+    \
+    static inline void map_grow_##suffix(name* map, int cap, Heap* heap)\
+    {\
+        name prior = *map;\
+        map_allocate_##suffix(map, cap, heap);\
+        for(int i = 0; i < prior.cap; i += 1)\
+        {\
+            uint32_t hash_value = prior.hashes[i];\
+            if(hash_value)\
+            {\
+                int slot = map_find_slot_##suffix(map, prior.keys[i], hash_value);\
+                map->keys[slot] = prior.keys[i];\
+                map->values[slot] = prior.values[i];\
+                map->hashes[slot] = hash_value;\
+            }\
+        }\
+        map->count = prior.count;\
+        HEAP_DEALLOCATE(heap, prior.keys);\
+        HEAP_DEALLOCATE(heap, prior.values);\
+        HEAP_DEALLOCATE(heap, prior.hashes);\
+    }\
+    \
+    static inline void map_reserve_##suffix(name* map, int cap, Heap* heap)\
+    {\
+        int valid_cap = map->cap;\
+        while(valid_cap < cap)\
+        {\
+            valid_cap *= 2;\
+        }\
+        if(valid_cap > map->cap)\
+        {\
+            map_grow_##suffix(map, valid_cap, heap);\
+        }\
+    }\
+    \
+    static inline value_type* map_get_##suffix(name* map, key_type key)\
+    {\
+        uint32_t hash_value = map_hash_##suffix(key);\
+        int slot = map_find_slot_##suffix(map, key, hash_value);\
+        if(map->hashes[slot])\
+        {\
+            return &map->values[slot];\
+        }\
+        return NULL;\
+    }\
+    \
+    static inline void map_add_##suffix(name* map, key_type key, value_type value, Heap* heap)\
+    {\
+        if(map->count >= (3 * map->cap) / 4)\
+        {\
+            map_grow_##suffix(map, 2 * map->cap, heap);\
+        }\
+        uint32_t hash_value = map_hash_##suffix(key);\
+        int slot = map_find_slot_##suffix(map, key, hash_value);\
+        if(!map->hashes[slot])\
+        {\
+            map->count += 1;\
+        }\
+        map->keys[slot] = key;\
+        map->values[slot] = value;\
+        map->hashes[slot] = hash_value;\
+    }\
+    \
+    static inline void map_remove_##suffix(name* map, key_type key)\
+    {\
+        uint32_t hash_value = map_hash_##suffix(key);\
+        int slot = map_find_slot_##suffix(map, key, hash_value);\
+        if(!map->hashes[slot])\
+        {\
+            return;\
+        }\
+        map->count -= 1;\
+        /* Shuffle down any pairs that probed past the emptied slot. */\
+        int mask = map->cap - 1;\
+        for(int i = slot, j = slot;; i = j)\
+        {\
+            map->hashes[i] = 0;\
+            int k;\
+            bool stays;\
+            do\
+            {\
+                j = (j + 1) & mask;\
+                if(!map->hashes[j])\
+                {\
+                    return;\
+                }\
+                k = map->hashes[j] & mask;\
+                stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);\
+            } while(stays);\
+            map->keys[i] = map->keys[j];\
+            map->values[i] = map->values[j];\
+            map->hashes[i] = map->hashes[j];\
+        }\
+    }
+
+#endif // TYPED_MAP_H_
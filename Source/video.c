@@ -131,7 +131,7 @@ struct VideoContext
 {
     Stack scratch;
     Heap heap;
-    DenseMap objects;
+    SlotMap objects;
     Buffers buffers;
     Images images;
     Passes passes;
@@ -1113,7 +1113,8 @@ static void create_context(VideoContext* context, PlatformVideo* platform,
 {
     stack_create(&context->scratch, (uint32_t) uptibytes(1));
     heap_create(&context->heap, (uint32_t) uptibytes(1));
-    dense_map_create(&context->objects, &context->heap);
+    heap_set_tag(&context->heap, MEMORY_TAG_VIDEO);
+    slot_map_create(&context->objects, sizeof(VideoObject), 1024, &context->heap);
 
     switch(platform->backend_type)
     {
@@ -1184,7 +1185,7 @@ static void destroy_context(VideoContext* context)
 
     destroy_backend(context->backend, &context->heap);
 
-    dense_map_destroy(&context->objects, &context->heap);
+    slot_map_destroy(&context->objects, &context->heap);
 
     stack_destroy(&context->scratch);
     heap_destroy(&context->heap);
@@ -1549,13 +1550,13 @@ static void draw_scale_tool(bool silhouetted)
     immediate_draw();
 }
 
-static void draw_object_with_halo(VideoContext* context, ObjectLady* lady, int index, DenseMapId halo_id, Float4 colour, Matrix4 projection)
+static void draw_object_with_halo(VideoContext* context, ObjectLady* lady, int index, SlotMapHandle halo_id, Float4 colour, Matrix4 projection)
 {
     ASSERT(index != invalid_index);
     ASSERT(index >= 0 && index < array_count(lady->objects));
 
-    VideoObject* object = dense_map_look_up(&context->objects, lady->objects[index].video_object);
-    VideoObject* halo = dense_map_look_up(&context->objects, halo_id);
+    VideoObject* object = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, lady->objects[index].video_object);
+    VideoObject* halo = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, halo_id);
     ASSERT(object->indices_count > 0);
     ASSERT(halo->indices_count > 0);
 
@@ -1699,24 +1700,24 @@ static void draw_wireframe(VideoContext* context, VideoObject* object, Matrix4 p
     draw_object(context, object);
 }
 
-static void draw_selection(VideoContext* context, DenseMapId faces_id, DenseMapId pointcloud_id, DenseMapId wireframe_id, Matrix4 projection)
+static void draw_selection(VideoContext* context, SlotMapHandle faces_id, SlotMapHandle pointcloud_id, SlotMapHandle wireframe_id, Matrix4 projection)
 {
     VideoObject* faces = NULL;
     if(faces_id)
     {
-        faces = dense_map_look_up(&context->objects, faces_id);
+        faces = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, faces_id);
     }
 
     VideoObject* pointcloud = NULL;
     if(pointcloud_id)
     {
-        pointcloud = dense_map_look_up(&context->objects, pointcloud_id);
+        pointcloud = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, pointcloud_id);
     }
 
     VideoObject* wireframe = NULL;
     if(wireframe_id)
     {
-        wireframe = dense_map_look_up(&context->objects, wireframe_id);
+        wireframe = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, wireframe_id);
     }
 
     draw_face_selection(context, faces);
@@ -2083,8 +2084,8 @@ static void draw_opaque_phase(VideoContext* context, VideoUpdate* update, Matric
     RotateTool* rotate_tool = update->rotate_tool;
     int selected_object_index = update->selected_object_index;
     int hovered_object_index = update->hovered_object_index;
-    DenseMapId hover_halo = update->hover_halo;
-    DenseMapId selection_halo = update->selection_halo;
+    SlotMapHandle hover_halo = update->hover_halo;
+    SlotMapHandle selection_halo = update->selection_halo;
     Int2 viewport = update->viewport;
 
     Backend* backend = context->backend;
@@ -2092,7 +2093,7 @@ static void draw_opaque_phase(VideoContext* context, VideoUpdate* update, Matric
     Pipelines* pipelines = &context->pipelines;
     Uniforms* uniforms = &context->uniforms;
 
-    FOR_ALL(VideoObject, context->objects.array)
+    FOR_ALL_IN_SLOT_MAP(VideoObject, &context->objects)
     {
         video_object_set_matrices(it, matrices->view, matrices->projection);
     }
@@ -2136,7 +2137,7 @@ static void draw_opaque_phase(VideoContext* context, VideoUpdate* update, Matric
             continue;
         }
         Object* object = &lady->objects[object_index];
-        VideoObject* video_object = dense_map_look_up(&context->objects, object->video_object);
+        VideoObject* video_object = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, object->video_object);
         apply_object_block(context, video_object);
         draw_object(context, video_object);
     }
@@ -2171,9 +2172,9 @@ static void draw_transparent_phase(VideoContext* context, VideoUpdate* update, M
 
     set_regular_view(context, viewport, matrices->view, matrices->projection);
 
-    DenseMapId selection_id = update->selection_id;
-    DenseMapId selection_pointcloud_id = update->selection_pointcloud_id;
-    DenseMapId selection_wireframe_id = update->selection_wireframe_id;
+    SlotMapHandle selection_id = update->selection_id;
+    SlotMapHandle selection_pointcloud_id = update->selection_pointcloud_id;
+    SlotMapHandle selection_wireframe_id = update->selection_wireframe_id;
 
     draw_selection(context, selection_id, selection_pointcloud_id, selection_wireframe_id, matrices->projection);
 }
@@ -2407,21 +2408,21 @@ void video_resize_viewport(VideoContext* context, Int2 dimensions, double dots_p
     }
 }
 
-DenseMapId video_add_object(VideoContext* context, VertexLayout vertex_layout)
+SlotMapHandle video_add_object(VideoContext* context, VertexLayout vertex_layout)
 {
-    DenseMap* objects = &context->objects;
-    DenseMapId id = dense_map_add(objects, &context->heap);
-    VideoObject* object = dense_map_look_up(objects, id);
+    SlotMap* objects = &context->objects;
+    SlotMapHandle id = slot_map_add(objects, &context->heap);
+    VideoObject* object = SLOT_MAP_LOOK_UP(objects, VideoObject, id);
     video_object_create(object, vertex_layout);
     return id;
 }
 
-void video_remove_object(VideoContext* context, DenseMapId id)
+void video_remove_object(VideoContext* context, SlotMapHandle id)
 {
-    DenseMap* objects = &context->objects;
-    VideoObject* object = dense_map_look_up(objects, id);
+    SlotMap* objects = &context->objects;
+    VideoObject* object = SLOT_MAP_LOOK_UP(objects, VideoObject, id);
     video_object_destroy(object, context->backend);
-    dense_map_remove(objects, id, &context->heap);
+    slot_map_remove(objects, id);
 }
 
 void video_set_up_font(VideoContext* context, BmfFont* font)
@@ -2437,15 +2438,15 @@ void video_set_up_font(VideoContext* context, BmfFont* font)
     }
 }
 
-void video_set_model(VideoContext* context, DenseMapId id, Matrix4 model)
+void video_set_model(VideoContext* context, SlotMapHandle id, Matrix4 model)
 {
-    VideoObject* object = dense_map_look_up(&context->objects, id);
+    VideoObject* object = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, id);
     video_object_set_model(object, model);
 }
 
 void video_update_mesh(VideoContext* context, VideoMeshUpdate* update)
 {
-    VideoObject* object = dense_map_look_up(&context->objects, update->object);
+    VideoObject* object = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, update->object);
     MeshUpdate mesh_update =
     {
         .backend = context->backend,
@@ -2459,7 +2460,7 @@ void video_update_mesh(VideoContext* context, VideoMeshUpdate* update)
 
 void video_update_wireframe(VideoContext* context, VideoWireframeUpdate* update)
 {
-    VideoObject* object = dense_map_look_up(&context->objects, update->object);
+    VideoObject* object = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, update->object);
     WireframeUpdate wire_update =
     {
         .backend = context->backend,
@@ -2475,7 +2476,7 @@ void video_update_wireframe(VideoContext* context, VideoWireframeUpdate* update)
 void video_update_pointcloud(VideoContext* context,
         VideoPointcloudUpdate* update)
 {
-    VideoObject* object = dense_map_look_up(&context->objects, update->object);
+    VideoObject* object = SLOT_MAP_LOOK_UP(&context->objects, VideoObject, update->object);
     PointcloudUpdate pointcloud_update =
     {
         .mesh = update->mesh,
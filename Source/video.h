@@ -3,12 +3,12 @@
 
 #include "bmfont.h"
 #include "camera.h"
-#include "dense_map.h"
 #include "int2.h"
 #include "jan.h"
 #include "log.h"
 #include "memory.h"
 #include "platform.h"
+#include "slot_map.h"
 #include "tools.h"
 #include "ui.h"
 
@@ -24,7 +24,7 @@ typedef struct VideoMeshUpdate
 {
     JanMesh* mesh;
     JanSelection* selection;
-    DenseMapId object;
+    SlotMapHandle object;
 } VideoMeshUpdate;
 
 typedef struct VideoPointcloudUpdate
@@ -32,7 +32,7 @@ typedef struct VideoPointcloudUpdate
     JanVertex* hovered;
     JanMesh* mesh;
     JanSelection* selection;
-    DenseMapId object;
+    SlotMapHandle object;
 } VideoPointcloudUpdate;
 
 typedef struct VideoUpdate
@@ -49,11 +49,11 @@ typedef struct VideoUpdate
     struct ObjectLady* lady;
     int hovered_object_index;
     int selected_object_index;
-    DenseMapId selection_id;
-    DenseMapId selection_pointcloud_id;
-    DenseMapId selection_wireframe_id;
-    DenseMapId hover_halo;
-    DenseMapId selection_halo;
+    SlotMapHandle selection_id;
+    SlotMapHandle selection_pointcloud_id;
+    SlotMapHandle selection_wireframe_id;
+    SlotMapHandle hover_halo;
+    SlotMapHandle selection_halo;
 } VideoUpdate;
 
 typedef struct VideoWireframeUpdate
@@ -61,7 +61,7 @@ typedef struct VideoWireframeUpdate
     JanEdge* hovered;
     JanMesh* mesh;
     JanSelection* selection;
-    DenseMapId object;
+    SlotMapHandle object;
 } VideoWireframeUpdate;
 
 typedef struct VideoContext VideoContext;
@@ -71,11 +71,11 @@ void video_destroy_context(VideoContext* context, Heap* heap);
 void video_update_context(VideoContext* context, VideoUpdate* update, Platform* platform);
 void video_resize_viewport(VideoContext* context, Int2 dimensions, double dots_per_millimeter, float fov);
 
-DenseMapId video_add_object(VideoContext* context, VertexLayout vertex_layout);
-void video_remove_object(VideoContext* context, DenseMapId id);
+SlotMapHandle video_add_object(VideoContext* context, VertexLayout vertex_layout);
+void video_remove_object(VideoContext* context, SlotMapHandle id);
 void video_set_up_font(VideoContext* context, BmfFont* font);
 
-void video_set_model(VideoContext* context, DenseMapId id, Matrix4 model);
+void video_set_model(VideoContext* context, SlotMapHandle id, Matrix4 model);
 void video_update_mesh(VideoContext* context, VideoMeshUpdate* update);
 void video_update_wireframe(VideoContext* context, VideoWireframeUpdate* update);
 void video_update_pointcloud(VideoContext* context, VideoPointcloudUpdate* update);
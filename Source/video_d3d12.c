@@ -6,8 +6,8 @@
 #include <dxgi1_6.h>
 
 #include "assert.h"
-#include "id_pool.h"
 #include "platform_d3d12.h"
+#include "slot_map.h"
 
 
 #define FRAME_COUNT 2
@@ -37,9 +37,9 @@ typedef struct Buffer
 typedef struct BackendD3d12
 {
     Backend base;
-    IdPool buffer_id_pool;
+    Heap* heap;
+    SlotMap buffers;
     ID3D12Resource* render_targets[FRAME_COUNT];
-    Buffer* buffers;
     ID3D12CommandQueue* command_queue;
     ID3D12Debug* debug_controller;
     ID3D12Device* device;
@@ -183,13 +183,7 @@ static void wait_for_prior_frame(BackendD3d12* backend)
 
 static Buffer* fetch_buffer(BackendD3d12* backend, BufferId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->buffer_id_pool.cap);
-        return &backend->buffers[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->buffers, Buffer, id.value);
 }
 
 static void load_buffer(Buffer* buffer, BufferSpec* spec,
@@ -381,9 +375,8 @@ static void create_backend_d3d12(Backend* backend_base, PlatformVideo* video,
 {
     BackendD3d12* backend = (BackendD3d12*) backend_base;
 
-    create_id_pool(&backend->buffer_id_pool, heap, 32);
-
-    backend->buffers = HEAP_ALLOCATE(heap, Buffer, backend->buffer_id_pool.cap);
+    backend->heap = heap;
+    slot_map_create(&backend->buffers, sizeof(Buffer), 32, heap);
 
     PlatformVideoD3d12* platform = (PlatformVideoD3d12*) video;
 
@@ -511,20 +504,15 @@ static void destroy_backend_d3d12(Backend* backend_base, Heap* heap)
 {
     BackendD3d12* backend = (BackendD3d12*) backend_base;
 
-    for(int buffer_index = 0;
-            buffer_index < backend->buffer_id_pool.cap;
-            buffer_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Buffer, &backend->buffers)
     {
-        Buffer* buffer = &backend->buffers[buffer_index];
-        if(buffer->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_buffer(buffer);
+            unload_buffer(it);
         }
     }
 
-    destroy_id_pool(&backend->buffer_id_pool, heap);
-
-    HEAP_DEALLOCATE(heap, backend->buffers);
+    slot_map_destroy(&backend->buffers, heap);
 
     if(backend->command_queue
             && backend->fence
@@ -576,18 +564,10 @@ static BufferId create_buffer_d3d12(Backend* backend_base, BufferSpec* spec,
 {
     BackendD3d12* backend = (BackendD3d12*) backend_base;
 
-    IdPool* pool = &backend->buffer_id_pool;
-    BufferId id = (BufferId) {allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Buffer* buffer = fetch_buffer(backend, id);
-        load_buffer(buffer, spec, backend);
-        ASSERT(buffer->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The buffer pool is out of memory.");
-    }
+    BufferId id = (BufferId) {slot_map_add(&backend->buffers, backend->heap)};
+    Buffer* buffer = fetch_buffer(backend, id);
+    load_buffer(buffer, spec, backend);
+    ASSERT(buffer->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
@@ -598,8 +578,8 @@ static void destroy_buffer_d3d12(Backend* backend_base, BufferId id)
     if(buffer)
     {
         unload_buffer(buffer);
-        deallocate_id(&backend->buffer_id_pool, id.value);
         ASSERT(buffer->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->buffers, id.value);
     }
 }
 
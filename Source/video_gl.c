@@ -7,9 +7,9 @@
 #endif
 
 #include "assert.h"
-#include "id_pool.h"
 #include "int_utilities.h"
 #include "float_utilities.h"
+#include "slot_map.h"
 #include "string_utilities.h"
 
 #ifndef GL_COMPRESSED_RGB8_ETC2
@@ -200,18 +200,13 @@ typedef struct BackendGl
     Backend base;
     Capabilities capabilities;
     Features features;
-    IdPool buffer_id_pool;
-    IdPool image_id_pool;
-    IdPool pass_id_pool;
-    IdPool pipeline_id_pool;
-    IdPool sampler_id_pool;
-    IdPool shader_id_pool;
-    Buffer* buffers;
-    Image* images;
-    Pass* passes;
-    Pipeline* pipelines;
-    Sampler* samplers;
-    Shader* shaders;
+    Heap* heap;
+    SlotMap buffers;
+    SlotMap images;
+    SlotMap passes;
+    SlotMap pipelines;
+    SlotMap samplers;
+    SlotMap shaders;
     PipelineId current_pipeline;
     PassId current_pass;
 } BackendGl;
@@ -697,68 +692,32 @@ static bool is_pixel_format_supported(BackendGl* backend, PixelFormat pixel_form
 
 static Buffer* fetch_buffer(BackendGl* backend, BufferId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->buffer_id_pool.cap);
-        return &backend->buffers[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->buffers, Buffer, id.value);
 }
 
 static Image* fetch_image(BackendGl* backend, ImageId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->image_id_pool.cap);
-        return &backend->images[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->images, Image, id.value);
 }
 
 static Pass* fetch_pass(BackendGl* backend, PassId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->pass_id_pool.cap);
-        return &backend->passes[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->passes, Pass, id.value);
 }
 
 static Pipeline* fetch_pipeline(BackendGl* backend, PipelineId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->pipeline_id_pool.cap);
-        return &backend->pipelines[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->pipelines, Pipeline, id.value);
 }
 
 static Sampler* fetch_sampler(BackendGl* backend, SamplerId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->sampler_id_pool.cap);
-        return &backend->samplers[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->samplers, Sampler, id.value);
 }
 
 static Shader* fetch_shader(BackendGl* backend, ShaderId id)
 {
-    if(id.value != invalid_id)
-    {
-        uint32_t slot = get_id_slot(id.value);
-        ASSERT(slot >= 0 && slot < (uint32_t) backend->shader_id_pool.cap);
-        return &backend->shaders[slot];
-    }
-    return NULL;
+    return SLOT_MAP_LOOK_UP(&backend->shaders, Shader, id.value);
 }
 
 static void load_buffer(Buffer* buffer, BufferSpec* spec)
@@ -982,7 +941,7 @@ static void load_pass(Pass* pass, PassSpec* spec, BackendGl* backend)
     for(int attachment_index = 0; attachment_index < PASS_COLOUR_ATTACHMENT_CAP; attachment_index += 1)
     {
         attachment_spec = &spec->colour_attachments[attachment_index];
-        if(attachment_spec->image.value == invalid_id)
+        if(attachment_spec->image.value == slot_map_handle_none)
         {
             break;
         }
@@ -994,7 +953,7 @@ static void load_pass(Pass* pass, PassSpec* spec, BackendGl* backend)
     }
 
     attachment_spec = &spec->depth_stencil_attachment;
-    if(attachment_spec->image.value != invalid_id)
+    if(attachment_spec->image.value != slot_map_handle_none)
     {
         attachment = &pass->depth_stencil_attachment;
         attachment->image = attachment_spec->image;
@@ -1154,7 +1113,7 @@ static void load_vertex_layout(Pipeline* pipeline, VertexLayoutSpec* spec, Backe
 
 static void load_pipeline(Pipeline* pipeline, PipelineSpec* spec, BackendGl* backend)
 {
-    ASSERT(spec->shader.value != invalid_id);
+    ASSERT(spec->shader.value != slot_map_handle_none);
     pipeline->shader = spec->shader;
 
     load_blend_state(&pipeline->blend, &spec->blend);
@@ -1440,20 +1399,14 @@ static void create_backend_gl(Backend* backend_base, PlatformVideo* platform,
         Heap* heap)
 {
     BackendGl* backend = (BackendGl*) backend_base;
+    backend->heap = heap;
 
-    create_id_pool(&backend->buffer_id_pool, heap, 32);
-    create_id_pool(&backend->image_id_pool, heap, 16);
-    create_id_pool(&backend->pass_id_pool, heap, 4);
-    create_id_pool(&backend->pipeline_id_pool, heap, 32);
-    create_id_pool(&backend->sampler_id_pool, heap, 4);
-    create_id_pool(&backend->shader_id_pool, heap, 16);
-
-    backend->buffers = HEAP_ALLOCATE(heap, Buffer, backend->buffer_id_pool.cap);
-    backend->images = HEAP_ALLOCATE(heap, Image, backend->image_id_pool.cap);
-    backend->passes = HEAP_ALLOCATE(heap, Pass, backend->pass_id_pool.cap);
-    backend->pipelines = HEAP_ALLOCATE(heap, Pipeline, backend->pipeline_id_pool.cap);
-    backend->samplers = HEAP_ALLOCATE(heap, Sampler, backend->sampler_id_pool.cap);
-    backend->shaders = HEAP_ALLOCATE(heap, Shader, backend->shader_id_pool.cap);
+    slot_map_create(&backend->buffers, sizeof(Buffer), 32, heap);
+    slot_map_create(&backend->images, sizeof(Image), 16, heap);
+    slot_map_create(&backend->passes, sizeof(Pass), 4, heap);
+    slot_map_create(&backend->pipelines, sizeof(Pipeline), 32, heap);
+    slot_map_create(&backend->samplers, sizeof(Sampler), 4, heap);
+    slot_map_create(&backend->shaders, sizeof(Shader), 16, heap);
 
     platform_video_create(platform);
     set_up_features(&backend->features);
@@ -1468,180 +1421,119 @@ static void destroy_backend_gl(Backend* backend_base, Heap* heap)
 {
     BackendGl* backend = (BackendGl*) backend_base;
 
-    for(int buffer_index = 0; buffer_index < backend->buffer_id_pool.cap; buffer_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Buffer, &backend->buffers)
     {
-        Buffer* buffer = &backend->buffers[buffer_index];
-        if(buffer->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_buffer(buffer);
+            unload_buffer(it);
         }
     }
 
-    for(int image_index = 0; image_index < backend->image_id_pool.cap; image_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Image, &backend->images)
     {
-        Image* image = &backend->images[image_index];
-        if(image->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_image(image);
+            unload_image(it);
         }
     }
 
-    for(int pass_index = 0; pass_index < backend->pass_id_pool.cap; pass_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Pass, &backend->passes)
     {
-        Pass* pass = &backend->passes[pass_index];
-        if(pass->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_pass(pass);
+            unload_pass(it);
         }
     }
 
-    for(int pipeline_index = 0; pipeline_index < backend->pipeline_id_pool.cap; pipeline_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Pipeline, &backend->pipelines)
     {
-        Pipeline* pipeline = &backend->pipelines[pipeline_index];
-        if(pipeline->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_pipeline(pipeline);
+            unload_pipeline(it);
         }
     }
 
-    for(int sampler_index = 0; sampler_index < backend->sampler_id_pool.cap; sampler_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Sampler, &backend->samplers)
     {
-        Sampler* sampler = &backend->samplers[sampler_index];
-        if(sampler->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_sampler(sampler);
+            unload_sampler(it);
         }
     }
 
-    for(int shader_index = 0; shader_index < backend->shader_id_pool.cap; shader_index += 1)
+    FOR_ALL_IN_SLOT_MAP(Shader, &backend->shaders)
     {
-        Shader* shader = &backend->shaders[shader_index];
-        if(shader->resource.status != RESOURCE_STATUS_INVALID)
+        if(it->resource.status != RESOURCE_STATUS_INVALID)
         {
-            unload_shader(shader);
+            unload_shader(it);
         }
     }
 
-    destroy_id_pool(&backend->buffer_id_pool, heap);
-    destroy_id_pool(&backend->image_id_pool, heap);
-    destroy_id_pool(&backend->pass_id_pool, heap);
-    destroy_id_pool(&backend->pipeline_id_pool, heap);
-    destroy_id_pool(&backend->sampler_id_pool, heap);
-    destroy_id_pool(&backend->shader_id_pool, heap);
-
-    HEAP_DEALLOCATE(heap, backend->buffers);
-    HEAP_DEALLOCATE(heap, backend->images);
-    HEAP_DEALLOCATE(heap, backend->passes);
-    HEAP_DEALLOCATE(heap, backend->pipelines);
-    HEAP_DEALLOCATE(heap, backend->samplers);
-    HEAP_DEALLOCATE(heap, backend->shaders);
+    slot_map_destroy(&backend->buffers, heap);
+    slot_map_destroy(&backend->images, heap);
+    slot_map_destroy(&backend->passes, heap);
+    slot_map_destroy(&backend->pipelines, heap);
+    slot_map_destroy(&backend->samplers, heap);
+    slot_map_destroy(&backend->shaders, heap);
 }
 
 static BufferId create_buffer_gl(Backend* backend_base, BufferSpec* spec, Log* log)
 {
     BackendGl* backend = (BackendGl*) backend_base;
-    IdPool* pool = &backend->buffer_id_pool;
-    BufferId id = (BufferId){allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Buffer* buffer = fetch_buffer(backend, id);
-        load_buffer(buffer, spec);
-        ASSERT(buffer->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The buffer pool is out of memory.");
-    }
+    BufferId id = (BufferId){slot_map_add(&backend->buffers, backend->heap)};
+    Buffer* buffer = fetch_buffer(backend, id);
+    load_buffer(buffer, spec);
+    ASSERT(buffer->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
 static ImageId create_image_gl(Backend* backend_base, ImageSpec* spec, Log* log)
 {
     BackendGl* backend = (BackendGl*) backend_base;
-    IdPool* pool = &backend->image_id_pool;
-    ImageId id = (ImageId){allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Image* image = fetch_image(backend, id);
-        load_image(image, spec, backend);
-        ASSERT(image->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The image pool is out of memory.");
-    }
+    ImageId id = (ImageId){slot_map_add(&backend->images, backend->heap)};
+    Image* image = fetch_image(backend, id);
+    load_image(image, spec, backend);
+    ASSERT(image->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
 static PassId create_pass_gl(Backend* backend_base, PassSpec* spec, Log* log)
 {
     BackendGl* backend = (BackendGl*) backend_base;
-    IdPool* pool = &backend->pass_id_pool;
-    PassId id = (PassId){allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Pass* pass = fetch_pass(backend, id);
-        load_pass(pass, spec, backend);
-        ASSERT(pass->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The pass pool is out of memory.");
-    }
+    PassId id = (PassId){slot_map_add(&backend->passes, backend->heap)};
+    Pass* pass = fetch_pass(backend, id);
+    load_pass(pass, spec, backend);
+    ASSERT(pass->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
 static PipelineId create_pipeline_gl(Backend* backend_base, PipelineSpec* spec, Log* log)
 {
     BackendGl* backend = (BackendGl*) backend_base;
-    IdPool* pool = &backend->pipeline_id_pool;
-    PipelineId id = (PipelineId){allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Pipeline* pipeline = fetch_pipeline(backend, id);
-        load_pipeline(pipeline, spec, backend);
-        ASSERT(pipeline->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The pipeline pool is out of memory.");
-    }
+    PipelineId id = (PipelineId){slot_map_add(&backend->pipelines, backend->heap)};
+    Pipeline* pipeline = fetch_pipeline(backend, id);
+    load_pipeline(pipeline, spec, backend);
+    ASSERT(pipeline->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
 static SamplerId create_sampler_gl(Backend* backend_base, SamplerSpec* spec, Log* log)
 {
     BackendGl* backend = (BackendGl*) backend_base;
-    IdPool* pool = &backend->sampler_id_pool;
-    SamplerId id = (SamplerId){allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Sampler* sampler = fetch_sampler(backend, id);
-        load_sampler(sampler, spec, backend);
-        ASSERT(sampler->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The sampler pool is out of memory.");
-    }
+    SamplerId id = (SamplerId){slot_map_add(&backend->samplers, backend->heap)};
+    Sampler* sampler = fetch_sampler(backend, id);
+    load_sampler(sampler, spec, backend);
+    ASSERT(sampler->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
 static ShaderId create_shader_gl(Backend* backend_base, ShaderSpec* spec, Heap* heap, Log* log)
 {
     BackendGl* backend = (BackendGl*) backend_base;
-    IdPool* pool = &backend->shader_id_pool;
-    ShaderId id = (ShaderId){allocate_id(pool)};
-    if(id.value != invalid_id)
-    {
-        Shader* shader = fetch_shader(backend, id);
-        load_shader(shader, spec, heap, log);
-        ASSERT(shader->resource.status == RESOURCE_STATUS_VALID);
-    }
-    else
-    {
-        log_error(log, "The shader pool is out of memory!");
-    }
+    ShaderId id = (ShaderId){slot_map_add(&backend->shaders, backend->heap)};
+    Shader* shader = fetch_shader(backend, id);
+    load_shader(shader, spec, heap, log);
+    ASSERT(shader->resource.status == RESOURCE_STATUS_VALID);
     return id;
 }
 
@@ -1652,8 +1544,8 @@ static void destroy_buffer_gl(Backend* backend_base, BufferId id)
     if(buffer)
     {
         unload_buffer(buffer);
-        deallocate_id(&backend->buffer_id_pool, id.value);
         ASSERT(buffer->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->buffers, id.value);
     }
 }
 
@@ -1664,8 +1556,8 @@ static void destroy_image_gl(Backend* backend_base, ImageId id)
     if(image)
     {
         unload_image(image);
-        deallocate_id(&backend->image_id_pool, id.value);
         ASSERT(image->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->images, id.value);
     }
 }
 
@@ -1676,8 +1568,8 @@ static void destroy_pass_gl(Backend* backend_base, PassId id)
     if(pass)
     {
         unload_pass(pass);
-        deallocate_id(&backend->pass_id_pool, id.value);
         ASSERT(pass->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->passes, id.value);
     }
 }
 
@@ -1688,8 +1580,8 @@ static void destroy_pipeline_gl(Backend* backend_base, PipelineId id)
     if(pipeline)
     {
         unload_pipeline(pipeline);
-        deallocate_id(&backend->pipeline_id_pool, id.value);
         ASSERT(pipeline->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->pipelines, id.value);
     }
 }
 
@@ -1700,8 +1592,8 @@ static void destroy_sampler_gl(Backend* backend_base, SamplerId id)
     if(sampler)
     {
         unload_sampler(sampler);
-        deallocate_id(&backend->sampler_id_pool, id.value);
         ASSERT(sampler->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->samplers, id.value);
     }
 }
 
@@ -1712,8 +1604,8 @@ static void destroy_shader_gl(Backend* backend_base, ShaderId id)
     if(shader)
     {
         unload_shader(shader);
-        deallocate_id(&backend->shader_id_pool, id.value);
         ASSERT(shader->resource.status == RESOURCE_STATUS_INVALID);
+        slot_map_remove(&backend->shaders, id.value);
     }
 }
 
@@ -1954,7 +1846,7 @@ static void set_images_gl(Backend* backend_base, ImageSet* image_set)
         {
             ImageId image_id = stage_set->images[image_index];
             SamplerId sampler_id = stage_set->samplers[image_index];
-            if(image_id.value == invalid_id)
+            if(image_id.value == slot_map_handle_none)
             {
                 break;
             }
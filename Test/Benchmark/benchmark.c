@@ -0,0 +1,39 @@
+#include "benchmark.h"
+
+#include "../../Source/platform_definitions.h"
+
+#if defined(OS_LINUX)
+#include <time.h>
+
+double get_time()
+{
+    struct timespec timestamp;
+    clock_gettime(CLOCK_MONOTONIC, &timestamp);
+    int64_t nanoseconds = timestamp.tv_nsec + timestamp.tv_sec * 1000000000;
+    return ((double) nanoseconds) / 1.0e9;
+}
+
+#elif defined(OS_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+double get_time()
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return ((double) now.QuadPart) / frequency.QuadPart;
+}
+
+#endif // defined(OS_WINDOWS)
+
+void timer_start(Timer* timer)
+{
+    timer->start = get_time();
+}
+
+double timer_milliseconds(Timer* timer)
+{
+    return 1000.0 * (get_time() - timer->start);
+}
@@ -0,0 +1,15 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <stdint.h>
+
+typedef struct Timer
+{
+    double start;
+} Timer;
+
+double get_time();
+void timer_start(Timer* timer);
+double timer_milliseconds(Timer* timer);
+
+#endif // BENCHMARK_H_
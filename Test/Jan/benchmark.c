@@ -0,0 +1,510 @@
+#include "../../Source/jan.h"
+#include "../../Source/jan_compact.h"
+#include "../../Source/jan_copy.h"
+#include "../../Source/jan_snapshot.h"
+#include "../../Source/random.h"
+#include "../../Source/thread.h"
+#include "../Benchmark/benchmark.h"
+
+#include <stdio.h>
+
+#define GRID_SIDE 256
+#define COPY_GRID_SIDE 512
+#define COPY_PASSES 5
+#define CHURN_ROUNDS 4
+#define TRAVERSAL_PASSES 20
+#define SNAPSHOT_GRID_SIDE 1024
+#define SNAPSHOT_PASSES 10
+#define NORMALS_PASSES 5
+#define PATCHED_VERTICES_COUNT 1000
+#define DRAG_FACES_COUNT 4
+#define DRAG_STEPS 100
+#define BUILD_GRID_SIDE 1000
+
+// The heights are bumpy, since a flat vertex would have no normal.
+static void add_grid(JanMesh* mesh, int grid_side, float z, RandomGenerator* generator, Stack* stack)
+{
+    int side = grid_side + 1;
+    JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, side * side);
+    for(int i = 0; i < side; i += 1)
+    {
+        for(int j = 0; j < side; j += 1)
+        {
+            float bump = (float) (random_generate(generator) >> 40) / 67108864.0f;
+            Float3 position = {{(float) j, (float) i, z + bump}};
+            vertices[side * i + j] = jan_add_vertex(mesh, position);
+        }
+    }
+
+    for(int i = 0; i < grid_side; i += 1)
+    {
+        for(int j = 0; j < grid_side; j += 1)
+        {
+            JanVertex* quad[4] =
+            {
+                vertices[side * i + j],
+                vertices[side * i + j + 1],
+                vertices[side * (i + 1) + j + 1],
+                vertices[side * (i + 1) + j],
+            };
+            jan_connect_disconnected_vertices_and_add_face(mesh, quad, 4, stack);
+        }
+    }
+
+    STACK_DEALLOCATE(stack, vertices);
+}
+
+// Remove about half of the faces at random, and then add as many again, so
+// that the new elements fill the holes left all through the pools.
+static void churn(JanMesh* mesh, float z, RandomGenerator* generator, Stack* stack)
+{
+    int faces_count = mesh->faces_count;
+    JanFace** faces = STACK_ALLOCATE(stack, JanFace*, faces_count);
+    int i = 0;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        faces[i] = face;
+        i += 1;
+    }
+    for(i = 0; i < faces_count; i += 1)
+    {
+        if(random_generate(generator) % 2)
+        {
+            jan_remove_face_and_its_unlinked_edges_and_vertices(mesh, faces[i]);
+        }
+    }
+    STACK_DEALLOCATE(stack, faces);
+
+    add_grid(mesh, GRID_SIDE, z, generator, stack);
+}
+
+static float walk_borders(JanMesh* mesh)
+{
+    float sum = 0.0f;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        for(JanBorderId border_id = face->first_border; border_id.value;)
+        {
+            JanBorder* border = jan_get_border(mesh, border_id);
+            JanLinkId first = border->first;
+            JanLinkId link_id = first;
+            do
+            {
+                JanLink* link = jan_get_link(mesh, link_id);
+                sum += jan_get_vertex(mesh, link->vertex)->position.x;
+                link_id = link->next;
+            } while(link_id.value != first.value);
+            border_id = border->next;
+        }
+    }
+    return sum;
+}
+
+static void time_traversals(const char* label, JanMesh* mesh)
+{
+    Timer timer;
+    timer_start(&timer);
+    for(int pass = 0; pass < TRAVERSAL_PASSES; pass += 1)
+    {
+        jan_update_normals(mesh);
+    }
+    double normals = timer_milliseconds(&timer) / TRAVERSAL_PASSES;
+
+    float sum = 0.0f;
+    timer_start(&timer);
+    for(int pass = 0; pass < TRAVERSAL_PASSES; pass += 1)
+    {
+        sum += walk_borders(mesh);
+    }
+    double borders = timer_milliseconds(&timer) / TRAVERSAL_PASSES;
+
+    Float3 normal_sum = float3_zero;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    {
+        normal_sum = float3_add(normal_sum, vertex->normal);
+    }
+
+    printf("%-10s  %9.3f ms update normals  %9.3f ms walk borders  (%g, %g)\n", label, normals, borders, sum, normal_sum.z);
+}
+
+// Copying looks up every vertex and edge in a map, so this is mostly a measure
+// of how well those lookups hide their cache misses.
+static void time_copy(RandomGenerator* generator, Heap* heap, Stack* stack)
+{
+    JanMesh mesh;
+    jan_create_mesh(&mesh);
+    add_grid(&mesh, COPY_GRID_SIDE, 0.0f, generator, stack);
+
+    int elements = mesh.faces_count + mesh.edges_count + mesh.vertices_count;
+
+    double total = 0.0;
+    int faces_count = 0;
+    for(int pass = 0; pass < COPY_PASSES; pass += 1)
+    {
+        JanMesh copy;
+        Timer timer;
+        timer_start(&timer);
+        jan_copy_mesh(&copy, &mesh, heap);
+        total += timer_milliseconds(&timer);
+        faces_count = copy.faces_count;
+        jan_destroy_mesh(&copy);
+    }
+
+    printf("jan_copy_mesh over %d elements took %.3f ms  (%d)\n", elements, total / COPY_PASSES, faces_count);
+
+    jan_destroy_mesh(&mesh);
+}
+
+static float walk_edges(JanMesh* mesh)
+{
+    float sum = 0.0f;
+    FOR_EACH_IN_POOL(JanEdge, edge, mesh->edge_pool)
+    {
+        Float3 start = jan_get_vertex(mesh, edge->vertices[0])->position;
+        Float3 end = jan_get_vertex(mesh, edge->vertices[1])->position;
+        sum += float3_distance(start, end);
+    }
+    return sum;
+}
+
+static float walk_snapshot_borders(JanMeshSnapshot* snapshot)
+{
+    float sum = 0.0f;
+    for(int border = 0; border < snapshot->borders_count; border += 1)
+    {
+        int end = snapshot->border_offsets[border + 1];
+        for(int i = snapshot->border_offsets[border]; i < end; i += 1)
+        {
+            sum += snapshot->positions[snapshot->indices[i]].x;
+        }
+    }
+    return sum;
+}
+
+static float walk_snapshot_edges(JanMeshSnapshot* snapshot)
+{
+    float sum = 0.0f;
+    for(int edge = 0; edge < snapshot->edges_count; edge += 1)
+    {
+        Float3 start = snapshot->positions[snapshot->edges[2 * edge]];
+        Float3 end = snapshot->positions[snapshot->edges[2 * edge + 1]];
+        sum += float3_distance(start, end);
+    }
+    return sum;
+}
+
+// Dragging a few faces around should cost about the same however large the
+// mesh is, since only the normals around them change.
+static void time_drag(RandomGenerator* generator, Heap* heap, Stack* stack)
+{
+    JanMesh mesh;
+    jan_create_mesh(&mesh);
+    add_grid(&mesh, COPY_GRID_SIDE, 0.0f, generator, stack);
+
+    Timer timer;
+    timer_start(&timer);
+    jan_update_normals(&mesh);
+    double full = timer_milliseconds(&timer);
+
+    JanSelection selection;
+    jan_create_selection(&selection, heap);
+    selection.type = JAN_SELECTION_TYPE_FACE;
+    selection.parts = NULL;
+    int i = 0;
+    int start = mesh.faces_count / 2;
+    FOR_EACH_IN_POOL(JanFace, face, mesh.face_pool)
+    {
+        if(i >= start && i < start + DRAG_FACES_COUNT)
+        {
+            jan_toggle_face_in_selection(&selection, face);
+        }
+        i += 1;
+    }
+
+    Float3 step = {{0.0f, 0.0f, 0.01f}};
+    timer_start(&timer);
+    for(int j = 0; j < DRAG_STEPS; j += 1)
+    {
+        jan_move_faces(&mesh, &selection, step);
+    }
+    double drag = timer_milliseconds(&timer) / DRAG_STEPS;
+
+    printf("Dragging %d of %d faces took %.4f ms a step, and jan_update_normals took %.3f ms\n", DRAG_FACES_COUNT, mesh.faces_count, drag, full);
+
+    jan_destroy_selection(&selection);
+    jan_destroy_mesh(&mesh);
+}
+
+// The grid is freshly built, so its pools are in about the order they're
+// walked, which is the best case for the pointer walks.
+static void time_snapshot(RandomGenerator* generator, Heap* heap, Stack* stack)
+{
+    JanMesh mesh;
+    jan_create_mesh(&mesh);
+    add_grid(&mesh, SNAPSHOT_GRID_SIDE, 0.0f, generator, stack);
+
+    Timer timer;
+
+    timer_start(&timer);
+    for(int pass = 0; pass < NORMALS_PASSES; pass += 1)
+    {
+        jan_update_normals(&mesh);
+    }
+    double serial_normals = timer_milliseconds(&timer) / NORMALS_PASSES;
+
+    timer_start(&timer);
+    for(int pass = 0; pass < NORMALS_PASSES; pass += 1)
+    {
+        jan_update_normals_in_parallel(&mesh);
+    }
+    double parallel_normals = timer_milliseconds(&timer) / NORMALS_PASSES;
+
+    JanMeshSnapshot snapshot;
+    jan_create_snapshot(&snapshot);
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        jan_build_snapshot(&snapshot, &mesh, heap);
+    }
+    double build = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    float pointer_sums[2] = {0.0f, 0.0f};
+    float snapshot_sums[2] = {0.0f, 0.0f};
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        pointer_sums[0] += walk_borders(&mesh);
+    }
+    double pointer_borders = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        snapshot_sums[0] += walk_snapshot_borders(&snapshot);
+    }
+    double snapshot_borders = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        pointer_sums[1] += walk_edges(&mesh);
+    }
+    double pointer_edges = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        snapshot_sums[1] += walk_snapshot_edges(&snapshot);
+    }
+    double snapshot_edges = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    // Nudge some vertices, like a small selection being dragged, and patch
+    // just those into the snapshot.
+    JanVertex* moved[PATCHED_VERTICES_COUNT];
+    for(int i = 0; i < PATCHED_VERTICES_COUNT; i += 1)
+    {
+        JanVertexId id = snapshot.vertex_ids[random_generate(generator) % snapshot.vertices_count];
+        moved[i] = jan_get_vertex(&mesh, id);
+        moved[i]->position.z += 0.5f;
+    }
+    timer_start(&timer);
+    int patched = 0;
+    for(int i = 0; i < PATCHED_VERTICES_COUNT; i += 1)
+    {
+        patched += jan_patch_snapshot_vertex(&snapshot, &mesh, moved[i]);
+    }
+    double patch = timer_milliseconds(&timer);
+
+    // The pools' own normals are area weighted, so the area weighted pass,
+    // which runs last, should only differ from them by rounding.
+    jan_update_normals(&mesh);
+    jan_build_snapshot(&snapshot, &mesh, heap);
+
+    Float3* newell_normals = HEAP_ALLOCATE(heap, Float3, snapshot.borders_count);
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        compute_newell_normals(newell_normals, snapshot.positions, snapshot.indices, snapshot.border_offsets, snapshot.borders_count);
+    }
+    double newell = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+    HEAP_DEALLOCATE(heap, newell_normals);
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        jan_compute_snapshot_normals(&snapshot, NORMAL_WEIGHT_ANGLE, heap);
+    }
+    double angle_normals = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    timer_start(&timer);
+    for(int pass = 0; pass < SNAPSHOT_PASSES; pass += 1)
+    {
+        jan_compute_snapshot_normals(&snapshot, NORMAL_WEIGHT_AREA, heap);
+    }
+    double area_normals = timer_milliseconds(&timer) / SNAPSHOT_PASSES;
+
+    float most_different = 0.0f;
+    for(int i = 0; i < snapshot.vertices_count; i += 1)
+    {
+        Float3 normal = jan_get_vertex(&mesh, snapshot.vertex_ids[i])->normal;
+        float difference = float3_distance(normal, snapshot.normals[i]);
+        if(difference > most_different)
+        {
+            most_different = difference;
+        }
+    }
+
+    printf("Snapshot of %d faces, %d edges and %d vertices\n", snapshot.faces_count, snapshot.edges_count, snapshot.vertices_count);
+    printf("jan_update_normals took %.3f ms, and jan_update_normals_in_parallel took %.3f ms on %d threads\n", serial_normals, parallel_normals, get_logical_core_count());
+    printf("jan_build_snapshot took %.3f ms, and patching %d vertices took %.3f ms\n", build, patched, patch);
+    printf("walk borders  pointers %9.3f ms   snapshot %9.3f ms  (%g, %g)\n", pointer_borders, snapshot_borders, pointer_sums[0], snapshot_sums[0]);
+    printf("walk edges    pointers %9.3f ms   snapshot %9.3f ms  (%g, %g)\n", pointer_edges, snapshot_edges, pointer_sums[1], snapshot_sums[1]);
+    printf("compute_newell_normals took %.3f ms, and jan_compute_snapshot_normals took %.3f ms area weighted and %.3f ms angle weighted\n", newell, area_normals, angle_normals);
+    printf("The most a vertex normal differs from jan_update_normals is %g\n", most_different);
+
+    jan_destroy_snapshot(&snapshot, heap);
+    jan_destroy_mesh(&mesh);
+}
+
+// Each quad of the grid is split into two triangles, the way an importer would
+// most often see a mesh. Adding the faces one at a time, and then updating the
+// normals, is what building from indices replaces.
+static void time_build(RandomGenerator* generator, Heap* heap, Stack* stack)
+{
+    int side = BUILD_GRID_SIDE + 1;
+    int positions_count = side * side;
+    int faces_count = 2 * BUILD_GRID_SIDE * BUILD_GRID_SIDE;
+    Float3* positions = HEAP_ALLOCATE(heap, Float3, positions_count);
+    int* face_offsets = HEAP_ALLOCATE(heap, int, faces_count + 1);
+    uint32_t* face_indices = HEAP_ALLOCATE(heap, uint32_t, 3 * faces_count);
+
+    for(int i = 0; i < side; i += 1)
+    {
+        for(int j = 0; j < side; j += 1)
+        {
+            float bump = (float) (random_generate(generator) >> 40) / 67108864.0f;
+            Float3 position = {{(float) j, (float) i, bump}};
+            positions[side * i + j] = position;
+        }
+    }
+
+    int index = 0;
+    for(int i = 0; i < BUILD_GRID_SIDE; i += 1)
+    {
+        for(int j = 0; j < BUILD_GRID_SIDE; j += 1)
+        {
+            uint32_t quad[4] =
+            {
+                (uint32_t) (side * i + j),
+                (uint32_t) (side * i + j + 1),
+                (uint32_t) (side * (i + 1) + j + 1),
+                (uint32_t) (side * (i + 1) + j),
+            };
+            uint32_t triangles[6] = {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]};
+            for(int k = 0; k < 6; k += 1)
+            {
+                if(k % 3 == 0)
+                {
+                    face_offsets[index / 3] = index;
+                }
+                face_indices[index] = triangles[k];
+                index += 1;
+            }
+        }
+    }
+    face_offsets[faces_count] = index;
+
+    Timer timer;
+    timer_start(&timer);
+    JanMesh added;
+    jan_create_mesh(&added);
+    JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, positions_count);
+    for(int i = 0; i < positions_count; i += 1)
+    {
+        vertices[i] = jan_add_vertex(&added, positions[i]);
+    }
+    for(int i = 0; i < faces_count; i += 1)
+    {
+        JanVertex* triangle[3];
+        for(int j = 0; j < 3; j += 1)
+        {
+            triangle[j] = vertices[face_indices[face_offsets[i] + j]];
+        }
+        jan_connect_disconnected_vertices_and_add_face(&added, triangle, 3, stack);
+    }
+    jan_update_normals(&added);
+    double one_at_a_time = timer_milliseconds(&timer);
+    STACK_DEALLOCATE(stack, vertices);
+
+    timer_start(&timer);
+    JanMesh built;
+    jan_build_mesh_from_indexed(&built, positions, positions_count, face_offsets, face_indices, faces_count, heap);
+    double bulk = timer_milliseconds(&timer);
+
+    // Both meshes number their vertices in the same order.
+    float most_different = 0.0f;
+    for(int i = 0; i < positions_count; i += 1)
+    {
+        JanVertexId id = {(uint32_t) i + 1};
+        Float3 a = jan_get_vertex(&added, id)->normal;
+        Float3 b = jan_get_vertex(&built, id)->normal;
+        float difference = float3_distance(a, b);
+        if(difference > most_different)
+        {
+            most_different = difference;
+        }
+    }
+
+    printf("Building %d triangles, %d edges and %d vertices\n", built.faces_count, built.edges_count, built.vertices_count);
+    printf("adding faces one at a time took %.3f ms, and jan_build_mesh_from_indexed took %.3f ms\n", one_at_a_time, bulk);
+    printf("The most a vertex normal differs between the two is %g\n", most_different);
+
+    jan_destroy_mesh(&added);
+    jan_destroy_mesh(&built);
+    HEAP_DEALLOCATE(heap, positions);
+    HEAP_DEALLOCATE(heap, face_offsets);
+    HEAP_DEALLOCATE(heap, face_indices);
+}
+
+int main(int argc, char** argv)
+{
+    Stack stack = {0};
+    stack_create_growable(&stack, uptibytes(1));
+
+    RandomGenerator generator;
+    random_seed(&generator, 1729);
+
+    JanMesh mesh;
+    jan_create_mesh(&mesh);
+    add_grid(&mesh, GRID_SIDE, 0.0f, &generator, &stack);
+    for(int round = 0; round < CHURN_ROUNDS; round += 1)
+    {
+        churn(&mesh, (float) (round + 1), &generator, &stack);
+    }
+
+    printf("Mesh traversal over %d faces, %d edges and %d vertices\n", mesh.faces_count, mesh.edges_count, mesh.vertices_count);
+    time_traversals("scattered", &mesh);
+
+    Timer timer;
+    timer_start(&timer);
+    jan_compact_mesh(&mesh);
+    double compact = timer_milliseconds(&timer);
+
+    time_traversals("compacted", &mesh);
+    printf("jan_compact_mesh took %.3f ms\n", compact);
+
+    jan_destroy_mesh(&mesh);
+
+    Heap heap = {0};
+    heap_create_growable(&heap, uptibytes(64));
+    time_copy(&generator, &heap, &stack);
+    time_drag(&generator, &heap, &stack);
+    time_snapshot(&generator, &heap, &stack);
+    time_build(&generator, &heap, &stack);
+    heap_destroy(&heap);
+    stack_destroy(&stack);
+
+    return 0;
+}
@@ -0,0 +1,606 @@
+#include "../../Source/jan.h"
+#include "../../Source/jan_compact.h"
+#include "../../Source/jan_copy.h"
+#include "../../Source/jan_internal.h"
+#include "../../Source/jan_snapshot.h"
+#include "../../Source/jan_validate.h"
+#include "../../Source/random.h"
+
+#include <math.h>
+#include <stdio.h>
+
+typedef enum TestType
+{
+    TEST_TYPE_BUILD_FROM_INDEXED,
+    TEST_TYPE_COMPACT,
+    TEST_TYPE_COPY,
+    TEST_TYPE_DIRTY_NORMALS,
+    TEST_TYPE_PARALLEL_NORMALS,
+    TEST_TYPE_SNAPSHOT_NORMALS,
+    TEST_TYPE_SNAPSHOT_PATCH,
+    TEST_TYPE_COUNT,
+} TestType;
+
+typedef struct Test
+{
+    Heap heap;
+    Stack stack;
+    Log logger;
+    RandomGenerator generator;
+    TestType type;
+} Test;
+
+static const char* describe_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_BUILD_FROM_INDEXED: return "Build From Indexed";
+        case TEST_TYPE_COMPACT:            return "Compact";
+        case TEST_TYPE_COPY:               return "Copy";
+        case TEST_TYPE_DIRTY_NORMALS:      return "Dirty Normals";
+        case TEST_TYPE_PARALLEL_NORMALS:   return "Parallel Normals";
+        case TEST_TYPE_SNAPSHOT_NORMALS:   return "Snapshot Normals";
+        case TEST_TYPE_SNAPSHOT_PATCH:     return "Snapshot Patch";
+    }
+}
+
+#define GRID_SIDE 24
+#define NORMAL_TOLERANCE 1e-5f
+
+// An indexed grid has some quads left out, so that it has holes with borders
+// around them, and some split into triangles, so that it has a mix of sides.
+// The heights are bumpy, since a flat vertex would have no normal.
+typedef struct IndexedGrid
+{
+    Float3 positions[(GRID_SIDE + 1) * (GRID_SIDE + 1)];
+    int face_offsets[2 * GRID_SIDE * GRID_SIDE + 1];
+    uint32_t face_indices[6 * GRID_SIDE * GRID_SIDE];
+    int positions_count;
+    int faces_count;
+} IndexedGrid;
+
+static float random_bump(RandomGenerator* generator)
+{
+    return (float) (random_generate(generator) >> 40) / 67108864.0f;
+}
+
+static void make_indexed_grid(IndexedGrid* grid, RandomGenerator* generator)
+{
+    int side = GRID_SIDE + 1;
+    grid->positions_count = side * side;
+    for(int i = 0; i < side; i += 1)
+    {
+        for(int j = 0; j < side; j += 1)
+        {
+            Float3 position = {{(float) j, (float) i, random_bump(generator)}};
+            grid->positions[side * i + j] = position;
+        }
+    }
+
+    int faces_count = 0;
+    int index = 0;
+    for(int i = 0; i < GRID_SIDE; i += 1)
+    {
+        for(int j = 0; j < GRID_SIDE; j += 1)
+        {
+            if((7 * i + j) % 11 == 0)
+            {
+                continue;
+            }
+            uint32_t quad[4] =
+            {
+                (uint32_t) (side * i + j),
+                (uint32_t) (side * i + j + 1),
+                (uint32_t) (side * (i + 1) + j + 1),
+                (uint32_t) (side * (i + 1) + j),
+            };
+            if((i + j) % 3 == 0)
+            {
+                grid->face_offsets[faces_count] = index;
+                faces_count += 1;
+                for(int k = 0; k < 4; k += 1)
+                {
+                    grid->face_indices[index] = quad[k];
+                    index += 1;
+                }
+            }
+            else
+            {
+                uint32_t triangles[6] = {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]};
+                for(int k = 0; k < 6; k += 1)
+                {
+                    if(k % 3 == 0)
+                    {
+                        grid->face_offsets[faces_count] = index;
+                        faces_count += 1;
+                    }
+                    grid->face_indices[index] = triangles[k];
+                    index += 1;
+                }
+            }
+        }
+    }
+    grid->face_offsets[faces_count] = index;
+    grid->faces_count = faces_count;
+}
+
+// This is the way meshes were put together before building from indices, so
+// its elements are numbered in the same order.
+static void add_indexed_grid(JanMesh* mesh, IndexedGrid* grid, Stack* stack)
+{
+    jan_create_mesh(mesh);
+    JanVertex** vertices = STACK_ALLOCATE(stack, JanVertex*, grid->positions_count);
+    for(int i = 0; i < grid->positions_count; i += 1)
+    {
+        vertices[i] = jan_add_vertex(mesh, grid->positions[i]);
+    }
+    for(int i = 0; i < grid->faces_count; i += 1)
+    {
+        JanVertex* polygon[4];
+        int start = grid->face_offsets[i];
+        int sides = grid->face_offsets[i + 1] - start;
+        for(int j = 0; j < sides; j += 1)
+        {
+            polygon[j] = vertices[grid->face_indices[start + j]];
+        }
+        jan_connect_disconnected_vertices_and_add_face(mesh, polygon, sides, stack);
+    }
+    STACK_DEALLOCATE(stack, vertices);
+    jan_update_normals(mesh);
+}
+
+// Removing faces at random leaves holes all through the pools, which is what
+// compaction and copying have to cope with.
+static void remove_random_faces(JanMesh* mesh, RandomGenerator* generator, Stack* stack)
+{
+    int faces_count = mesh->faces_count;
+    JanFace** faces = STACK_ALLOCATE(stack, JanFace*, faces_count);
+    int i = 0;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        faces[i] = face;
+        i += 1;
+    }
+    for(i = 0; i < faces_count; i += 1)
+    {
+        if(random_generate(generator) % 3 == 0)
+        {
+            jan_remove_face_and_its_unlinked_edges_and_vertices(mesh, faces[i]);
+        }
+    }
+    STACK_DEALLOCATE(stack, faces);
+    jan_update_normals(mesh);
+}
+
+static bool close_to(Float3 a, Float3 b, float tolerance)
+{
+    return fabsf(a.x - b.x) <= tolerance
+        && fabsf(a.y - b.y) <= tolerance
+        && fabsf(a.z - b.z) <= tolerance;
+}
+
+static bool float3_equal(Float3 a, Float3 b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// Whatever path a mesh's normals came by, they should come out the same as
+// working every one of them out again from scratch.
+static bool normals_match_full_update(JanMesh* mesh, Heap* heap)
+{
+    int faces_count = mesh->faces_count;
+    int vertices_count = mesh->vertices_count;
+    Float3* face_normals = HEAP_ALLOCATE(heap, Float3, faces_count);
+    Float3* vertex_normals = HEAP_ALLOCATE(heap, Float3, vertices_count);
+
+    int i = 0;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        face_normals[i] = face->normal;
+        i += 1;
+    }
+    i = 0;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    {
+        vertex_normals[i] = vertex->normal;
+        i += 1;
+    }
+
+    jan_update_normals(mesh);
+
+    int mismatches = 0;
+    i = 0;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        mismatches += !close_to(face->normal, face_normals[i], NORMAL_TOLERANCE);
+        i += 1;
+    }
+    i = 0;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    {
+        mismatches += !close_to(vertex->normal, vertex_normals[i], NORMAL_TOLERANCE);
+        i += 1;
+    }
+
+    HEAP_DEALLOCATE(heap, face_normals);
+    HEAP_DEALLOCATE(heap, vertex_normals);
+
+    return mismatches == 0;
+}
+
+static bool test_build_from_indexed(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+
+    JanMesh built;
+    jan_build_mesh_from_indexed(&built, grid.positions, grid.positions_count, grid.face_offsets, grid.face_indices, grid.faces_count, &test->heap);
+    JanMesh added;
+    add_indexed_grid(&added, &grid, &test->stack);
+
+    bool valid = jan_validate_mesh(&built, &test->logger);
+
+    // Both meshes number their vertices and faces in the same order.
+    int mismatches = 0;
+    for(int i = 0; i < grid.positions_count; i += 1)
+    {
+        JanVertexId id = {(uint32_t) i + 1};
+        JanVertex* a = jan_get_vertex(&built, id);
+        JanVertex* b = jan_get_vertex(&added, id);
+        mismatches += !close_to(a->normal, b->normal, NORMAL_TOLERANCE);
+    }
+    for(int i = 0; i < grid.faces_count; i += 1)
+    {
+        JanFaceId id = {(uint32_t) i + 1};
+        JanFace* a = jan_get_face(&built, id);
+        JanFace* b = jan_get_face(&added, id);
+        mismatches += !close_to(a->normal, b->normal, NORMAL_TOLERANCE)
+            || fabsf(a->area - b->area) > NORMAL_TOLERANCE;
+    }
+
+    bool same_counts = built.faces_count == added.faces_count
+        && built.edges_count == added.edges_count
+        && built.vertices_count == added.vertices_count;
+    bool updated = normals_match_full_update(&built, &test->heap);
+
+    jan_destroy_mesh(&built);
+    jan_destroy_mesh(&added);
+
+    return valid
+        && same_counts
+        && mismatches == 0
+        && updated;
+}
+
+static bool test_compact(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+    JanMesh mesh;
+    add_indexed_grid(&mesh, &grid, &test->stack);
+    remove_random_faces(&mesh, &test->generator, &test->stack);
+
+    int vertices_count = mesh.vertices_count;
+    Float3* positions = HEAP_ALLOCATE(&test->heap, Float3, vertices_count);
+    Float3* normals = HEAP_ALLOCATE(&test->heap, Float3, vertices_count);
+    int i = 0;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh.vertex_pool)
+    {
+        positions[i] = vertex->position;
+        normals[i] = vertex->normal;
+        i += 1;
+    }
+
+    int faces_count = mesh.faces_count;
+    int edges_count = mesh.edges_count;
+    jan_compact_mesh(&mesh);
+
+    bool valid = jan_validate_mesh(&mesh, &test->logger);
+
+    // Elements are packed in the order they were in, with no gaps.
+    int mismatches = 0;
+    i = 0;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh.vertex_pool)
+    {
+        mismatches += !float3_equal(vertex->position, positions[i])
+            || !float3_equal(vertex->normal, normals[i])
+            || jan_get_vertex_id(&mesh, vertex).value != (uint32_t) i + 1;
+        i += 1;
+    }
+
+    bool same_counts = mesh.faces_count == faces_count
+        && mesh.edges_count == edges_count
+        && mesh.vertices_count == vertices_count
+        && i == vertices_count;
+    bool updated = normals_match_full_update(&mesh, &test->heap);
+
+    HEAP_DEALLOCATE(&test->heap, positions);
+    HEAP_DEALLOCATE(&test->heap, normals);
+    jan_destroy_mesh(&mesh);
+
+    return valid
+        && same_counts
+        && mismatches == 0
+        && updated;
+}
+
+static bool test_copy(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+    JanMesh original;
+    add_indexed_grid(&original, &grid, &test->stack);
+    remove_random_faces(&original, &test->generator, &test->stack);
+
+    JanMesh copy;
+    jan_copy_mesh(&copy, &original, &test->heap);
+
+    bool valid = jan_validate_mesh(&copy, &test->logger);
+    bool same_counts = copy.faces_count == original.faces_count
+        && copy.edges_count == original.edges_count
+        && copy.vertices_count == original.vertices_count;
+    bool updated = normals_match_full_update(&copy, &test->heap);
+
+    jan_destroy_mesh(&copy);
+    jan_destroy_mesh(&original);
+
+    return valid
+        && same_counts
+        && updated;
+}
+
+static void select_every_nth_face(JanSelection* selection, JanMesh* mesh, int n)
+{
+    selection->type = JAN_SELECTION_TYPE_FACE;
+    selection->parts = NULL;
+    int i = 0;
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        if(i % n == 0)
+        {
+            jan_toggle_face_in_selection(selection, face);
+        }
+        i += 1;
+    }
+}
+
+// Moving and extruding only update the normals around what changed, which
+// should leave the mesh the same as updating all of them.
+static bool test_dirty_normals(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+    JanMesh mesh;
+    add_indexed_grid(&mesh, &grid, &test->stack);
+
+    JanSelection selection;
+    jan_create_selection(&selection, &test->heap);
+    select_every_nth_face(&selection, &mesh, 17);
+
+    Float3 step = {{0.0f, 0.25f, 0.5f}};
+    jan_move_faces(&mesh, &selection, step);
+    bool moved = normals_match_full_update(&mesh, &test->heap);
+
+    jan_extrude(&mesh, &selection, 0.75f, &test->heap, &test->stack);
+    jan_update_dirty_normals(&mesh);
+    bool extruded = normals_match_full_update(&mesh, &test->heap);
+
+    // Act as if the lists ran out of memory partway through the edit, which
+    // leaves flagged elements that aren't listed.
+    jan_destroy_selection(&selection);
+    jan_create_selection(&selection, &test->heap);
+    select_every_nth_face(&selection, &mesh, 13);
+    jan_extrude(&mesh, &selection, 0.5f, &test->heap, &test->stack);
+    mesh.dirty_vertices.count /= 2;
+    mesh.dirty_vertices.overflowed = true;
+    jan_update_dirty_normals(&mesh);
+    bool overflowed = !mesh.dirty_vertices.overflowed;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh.vertex_pool)
+    {
+        overflowed = overflowed && !vertex->dirty;
+    }
+    FOR_EACH_IN_POOL(JanFace, face, mesh.face_pool)
+    {
+        overflowed = overflowed && !face->dirty;
+    }
+    overflowed = normals_match_full_update(&mesh, &test->heap) && overflowed;
+
+    bool valid = jan_validate_mesh(&mesh, &test->logger);
+
+    jan_destroy_selection(&selection);
+    jan_destroy_mesh(&mesh);
+
+    return moved
+        && extruded
+        && overflowed
+        && valid;
+}
+
+static void clear_normals(JanMesh* mesh)
+{
+    FOR_EACH_IN_POOL(JanFace, face, mesh->face_pool)
+    {
+        face->normal = float3_zero;
+    }
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh->vertex_pool)
+    {
+        vertex->normal = float3_zero;
+    }
+}
+
+// The jobs are run whatever the number of cores, so that the ranges and the
+// joining of their batches are tried even on one core. Removing
+// faces first leaves gaps in the pools for the ranges to skip over.
+static bool test_parallel_normals(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+    JanMesh mesh;
+    add_indexed_grid(&mesh, &grid, &test->stack);
+
+    bool matches = true;
+    int jobs_counts[3] = {2, 3, 7};
+    for(int i = 0; i < 3; i += 1)
+    {
+        clear_normals(&mesh);
+        jan_update_normals_with_jobs(&mesh, jobs_counts[i]);
+        matches = normals_match_full_update(&mesh, &test->heap) && matches;
+    }
+
+    remove_random_faces(&mesh, &test->generator, &test->stack);
+    clear_normals(&mesh);
+    jan_update_normals_with_jobs(&mesh, 4);
+    bool matches_with_gaps = normals_match_full_update(&mesh, &test->heap);
+
+    // Moving every face updates the whole mesh at once, rather than spreading
+    // out from each vertex.
+    JanSelection selection;
+    jan_create_selection(&selection, &test->heap);
+    select_every_nth_face(&selection, &mesh, 1);
+    Float3 step = {{0.0f, 0.0f, 1.0f}};
+    jan_move_faces(&mesh, &selection, step);
+    bool moved_all = normals_match_full_update(&mesh, &test->heap)
+        && mesh.dirty_vertices.count == 0
+        && mesh.dirty_faces.count == 0;
+    jan_destroy_selection(&selection);
+
+    jan_destroy_mesh(&mesh);
+
+    return matches
+        && matches_with_gaps
+        && moved_all;
+}
+
+// The mesh's own normals are area weighted, so the snapshot's area weighted
+// normals should only differ from them by rounding.
+static bool test_snapshot_normals(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+    JanMesh mesh;
+    add_indexed_grid(&mesh, &grid, &test->stack);
+
+    JanMeshSnapshot snapshot;
+    jan_create_snapshot(&snapshot);
+    jan_build_snapshot(&snapshot, &mesh, &test->heap);
+    jan_compute_snapshot_normals(&snapshot, NORMAL_WEIGHT_AREA, &test->heap);
+
+    int mismatches = 0;
+    for(int i = 0; i < snapshot.vertices_count; i += 1)
+    {
+        Float3 normal = jan_get_vertex(&mesh, snapshot.vertex_ids[i])->normal;
+        mismatches += !close_to(normal, snapshot.normals[i], NORMAL_TOLERANCE);
+    }
+    for(int i = 0; i < snapshot.faces_count; i += 1)
+    {
+        Float3 normal = jan_get_face(&mesh, snapshot.face_ids[i])->normal;
+        mismatches += !close_to(normal, snapshot.face_normals[i], NORMAL_TOLERANCE);
+    }
+
+    jan_destroy_snapshot(&snapshot, &test->heap);
+    jan_destroy_mesh(&mesh);
+
+    return mismatches == 0;
+}
+
+// Patching everything that moved should give the same snapshot as building
+// a new one.
+static bool test_snapshot_patch(Test* test)
+{
+    IndexedGrid grid;
+    make_indexed_grid(&grid, &test->generator);
+    JanMesh mesh;
+    add_indexed_grid(&mesh, &grid, &test->stack);
+
+    JanMeshSnapshot patched;
+    jan_create_snapshot(&patched);
+    jan_build_snapshot(&patched, &mesh, &test->heap);
+
+    JanSelection selection;
+    jan_create_selection(&selection, &test->heap);
+    select_every_nth_face(&selection, &mesh, 13);
+    Float3 step = {{0.5f, 0.0f, -0.25f}};
+    jan_move_faces(&mesh, &selection, step);
+    jan_destroy_selection(&selection);
+
+    bool all_patched = true;
+    FOR_EACH_IN_POOL(JanVertex, vertex, mesh.vertex_pool)
+    {
+        all_patched = jan_patch_snapshot_vertex(&patched, &mesh, vertex) && all_patched;
+    }
+    FOR_EACH_IN_POOL(JanFace, face, mesh.face_pool)
+    {
+        all_patched = jan_patch_snapshot_face(&patched, &mesh, face) && all_patched;
+    }
+
+    JanMeshSnapshot built;
+    jan_create_snapshot(&built);
+    jan_build_snapshot(&built, &mesh, &test->heap);
+
+    int mismatches = 0;
+    for(int i = 0; i < built.vertices_count; i += 1)
+    {
+        mismatches += !float3_equal(patched.positions[i], built.positions[i])
+            || !float3_equal(patched.normals[i], built.normals[i]);
+    }
+    for(int i = 0; i < built.faces_count; i += 1)
+    {
+        mismatches += !float3_equal(patched.face_normals[i], built.face_normals[i]);
+    }
+
+    bool same_counts = patched.vertices_count == built.vertices_count
+        && patched.faces_count == built.faces_count;
+
+    jan_destroy_snapshot(&patched, &test->heap);
+    jan_destroy_snapshot(&built, &test->heap);
+    jan_destroy_mesh(&mesh);
+
+    return all_patched
+        && same_counts
+        && mismatches == 0;
+}
+
+static bool run_test(Test* test)
+{
+    switch(test->type)
+    {
+        default:
+        case TEST_TYPE_BUILD_FROM_INDEXED: return test_build_from_indexed(test);
+        case TEST_TYPE_COMPACT:            return test_compact(test);
+        case TEST_TYPE_COPY:               return test_copy(test);
+        case TEST_TYPE_DIRTY_NORMALS:      return test_dirty_normals(test);
+        case TEST_TYPE_PARALLEL_NORMALS:   return test_parallel_normals(test);
+        case TEST_TYPE_SNAPSHOT_NORMALS:   return test_snapshot_normals(test);
+        case TEST_TYPE_SNAPSHOT_PATCH:     return test_snapshot_patch(test);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int failed = 0;
+    for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+    {
+        Test test = {0};
+        test.type = (TestType) test_index;
+        heap_create_growable(&test.heap, uptibytes(1));
+        stack_create_growable(&test.stack, uptibytes(1));
+        random_seed(&test.generator, 1729 + test_index);
+
+        if(!run_test(&test))
+        {
+            printf("test failed: %s\n", describe_test(test.type));
+            failed += 1;
+        }
+
+        stack_destroy(&test.stack);
+        heap_destroy(&test.heap);
+    }
+
+    if(failed == 0)
+    {
+        printf("All tests succeeded!\n\n");
+    }
+
+    return failed > 0;
+}
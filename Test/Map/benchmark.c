@@ -0,0 +1,319 @@
+#include "../../Source/map.h"
+#include "../../Source/random.h"
+#include "../../Source/swiss_map.h"
+#include "../Benchmark/benchmark.h"
+
+#include <stdio.h>
+
+// Both tables are driven through the same procedures, so that the cost of the
+// indirect calls is the same for each.
+typedef struct MapImplementation
+{
+    const char* name;
+    void (*create)(void* map, Heap* heap);
+    void (*destroy)(void* map, Heap* heap);
+    void (*add)(void* map, uint64_t key, uint64_t value, Heap* heap);
+    MaybeUint64 (*get)(void* map, uint64_t key);
+    void (*add_many)(void* map, uint64_t* keys, uint64_t* values, int count, Heap* heap);
+    void (*get_many)(void* map, uint64_t* keys, MaybePointer* results, int count);
+    void (*remove)(void* map, uint64_t key);
+    uint64_t (*sum_values)(void* map);
+} MapImplementation;
+
+static void create_map(void* map, Heap* heap)
+{
+    map_create((Map*) map, 0, heap);
+}
+
+static void destroy_map(void* map, Heap* heap)
+{
+    map_destroy((Map*) map, heap);
+}
+
+static void add_map(void* map, uint64_t key, uint64_t value, Heap* heap)
+{
+    map_add_uint64_from_uint64((Map*) map, key, value, heap);
+}
+
+static MaybeUint64 get_map(void* map, uint64_t key)
+{
+    return map_get_uint64_from_uint64((Map*) map, key);
+}
+
+static void add_many_map(void* map, uint64_t* keys, uint64_t* values, int count, Heap* heap)
+{
+    map_add_many((Map*) map, (void**) keys, (void**) values, count, heap);
+}
+
+static void get_many_map(void* map, uint64_t* keys, MaybePointer* results, int count)
+{
+    map_get_many((Map*) map, (void**) keys, results, count);
+}
+
+static void remove_map(void* map, uint64_t key)
+{
+    map_remove_uint64((Map*) map, key);
+}
+
+static uint64_t sum_values_map(void* map)
+{
+    uint64_t sum = 0;
+    ITERATE_MAP(it, (Map*) map)
+    {
+        sum += (uint64_t) (uintptr_t) map_iterator_get_value(it);
+    }
+    return sum;
+}
+
+static void create_swiss_map(void* map, Heap* heap)
+{
+    swiss_map_create((SwissMap*) map, 0, heap);
+}
+
+static void destroy_swiss_map(void* map, Heap* heap)
+{
+    swiss_map_destroy((SwissMap*) map, heap);
+}
+
+static void add_swiss_map(void* map, uint64_t key, uint64_t value, Heap* heap)
+{
+    swiss_map_add_uint64_from_uint64((SwissMap*) map, key, value, heap);
+}
+
+static MaybeUint64 get_swiss_map(void* map, uint64_t key)
+{
+    return swiss_map_get_uint64_from_uint64((SwissMap*) map, key);
+}
+
+static void add_many_swiss_map(void* map, uint64_t* keys, uint64_t* values, int count, Heap* heap)
+{
+    swiss_map_add_many((SwissMap*) map, (void**) keys, (void**) values, count, heap);
+}
+
+static void get_many_swiss_map(void* map, uint64_t* keys, MaybePointer* results, int count)
+{
+    swiss_map_get_many((SwissMap*) map, (void**) keys, results, count);
+}
+
+static void remove_swiss_map(void* map, uint64_t key)
+{
+    swiss_map_remove_uint64((SwissMap*) map, key);
+}
+
+static uint64_t sum_values_swiss_map(void* map)
+{
+    uint64_t sum = 0;
+    ITERATE_SWISS_MAP(it, (SwissMap*) map)
+    {
+        sum += (uint64_t) (uintptr_t) swiss_map_iterator_get_value(it);
+    }
+    return sum;
+}
+
+static const MapImplementation implementations[] =
+{
+    {
+#if ARBORETUM_SWISS_MAP
+        .name = "Map (swiss)",
+#else
+        .name = "Map (linear)",
+#endif
+        .create = create_map,
+        .destroy = destroy_map,
+        .add = add_map,
+        .get = get_map,
+        .add_many = add_many_map,
+        .get_many = get_many_map,
+        .remove = remove_map,
+        .sum_values = sum_values_map,
+    },
+    {
+        .name = "SwissMap",
+        .create = create_swiss_map,
+        .destroy = destroy_swiss_map,
+        .add = add_swiss_map,
+        .get = get_swiss_map,
+        .add_many = add_many_swiss_map,
+        .get_many = get_many_swiss_map,
+        .remove = remove_swiss_map,
+        .sum_values = sum_values_swiss_map,
+    },
+};
+
+// Big enough to hold either kind of map.
+typedef union AnyMap
+{
+    Map map;
+    SwissMap swiss_map;
+} AnyMap;
+
+typedef enum KeyPattern
+{
+    KEY_PATTERN_RANDOM,
+    KEY_PATTERN_POINTERS,
+    KEY_PATTERN_COUNT,
+} KeyPattern;
+
+static const char* describe_key_pattern(KeyPattern pattern)
+{
+    switch(pattern)
+    {
+        default:
+        case KEY_PATTERN_RANDOM:   return "random keys";
+        case KEY_PATTERN_POINTERS: return "pointer keys";
+    }
+}
+
+// Pointer keys are laid out the way objects from a pool would be, which are
+// close together and share most of their bits.
+static void make_keys(uint64_t* keys, uint64_t* missing, int count, KeyPattern pattern)
+{
+    RandomGenerator generator;
+    random_seed(&generator, 90210);
+
+    for(int i = 0; i < count; i += 1)
+    {
+        switch(pattern)
+        {
+            default:
+            case KEY_PATTERN_RANDOM:
+            {
+                // Random keys are made odd and missing keys even, so they never
+                // collide.
+                keys[i] = random_generate(&generator) | 1;
+                missing[i] = random_generate(&generator) & ~UINT64_C(1);
+                break;
+            }
+            case KEY_PATTERN_POINTERS:
+            {
+                keys[i] = UINT64_C(0x7f3a00000000) + 48 * (uint64_t) i;
+                missing[i] = UINT64_C(0x7f3a00000000) + 48 * (uint64_t) (count + i);
+                break;
+            }
+        }
+    }
+
+    // Shuffle, so that the lookups don't go in the order the keys were added.
+    for(int i = count - 1; i > 0; i -= 1)
+    {
+        int j = (int) (random_generate(&generator) % (uint64_t) (i + 1));
+        uint64_t key = keys[i];
+        keys[i] = keys[j];
+        keys[j] = key;
+    }
+}
+
+static double nanoseconds_per(Timer* timer, int count)
+{
+    return (1.0e6 * timer_milliseconds(timer)) / count;
+}
+
+static void benchmark_map(const MapImplementation* implementation, uint64_t* keys, uint64_t* missing, int count, Heap* heap)
+{
+    AnyMap any_map;
+    void* map = &any_map;
+    implementation->create(map, heap);
+
+    Timer timer;
+    timer_start(&timer);
+    for(int i = 0; i < count; i += 1)
+    {
+        implementation->add(map, keys[i], i, heap);
+    }
+    double add = nanoseconds_per(&timer, count);
+
+    uint64_t found = 0;
+    timer_start(&timer);
+    for(int i = count - 1; i >= 0; i -= 1)
+    {
+        MaybeUint64 result = implementation->get(map, keys[i]);
+        found += result.valid;
+    }
+    double hit = nanoseconds_per(&timer, count);
+
+    // The keys were shuffled, so a batch in order is as scattered as the single
+    // lookups were.
+    MaybePointer* results = HEAP_ALLOCATE(heap, MaybePointer, count);
+    timer_start(&timer);
+    implementation->get_many(map, keys, results, count);
+    double hit_many = nanoseconds_per(&timer, count);
+    for(int i = 0; i < count; i += 1)
+    {
+        found += results[i].valid;
+    }
+    HEAP_DEALLOCATE(heap, results);
+
+    timer_start(&timer);
+    for(int i = 0; i < count; i += 1)
+    {
+        MaybeUint64 result = implementation->get(map, missing[i]);
+        found += result.valid;
+    }
+    double miss = nanoseconds_per(&timer, count);
+
+    timer_start(&timer);
+    uint64_t sum = implementation->sum_values(map);
+    double iterate = nanoseconds_per(&timer, count);
+
+    // Remove half the keys and add them back, so that deleted slots are left
+    // behind for the lookups to step over.
+    timer_start(&timer);
+    for(int i = 0; i < count; i += 2)
+    {
+        implementation->remove(map, keys[i]);
+    }
+    for(int i = 0; i < count; i += 2)
+    {
+        implementation->add(map, keys[i], i, heap);
+    }
+    double churn = nanoseconds_per(&timer, count);
+
+    implementation->destroy(map, heap);
+
+    // Values are the same as the keys, which is enough to check they're found.
+    implementation->create(map, heap);
+    timer_start(&timer);
+    implementation->add_many(map, keys, keys, count, heap);
+    double add_many = nanoseconds_per(&timer, count);
+    implementation->destroy(map, heap);
+
+    printf("  %-14s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f  (%llu %llu)\n", implementation->name, add, add_many, hit, hit_many, miss, churn, iterate, (unsigned long long) found, (unsigned long long) sum);
+}
+
+int main(int argc, char** argv)
+{
+    Heap heap = {0};
+    heap_create_growable(&heap, uptibytes(64));
+
+    const int counts[] = {1000, 100000, 1000000};
+    int counts_count = sizeof(counts) / sizeof(*counts);
+    int largest = counts[counts_count - 1];
+
+    uint64_t* keys = (uint64_t*) virtual_allocate(sizeof(uint64_t) * largest);
+    uint64_t* missing = (uint64_t*) virtual_allocate(sizeof(uint64_t) * largest);
+
+    int implementations_count = sizeof(implementations) / sizeof(*implementations);
+
+    printf("Map throughput (ns per operation)\n");
+    for(int pattern = 0; pattern < KEY_PATTERN_COUNT; pattern += 1)
+    {
+        for(int i = 0; i < counts_count; i += 1)
+        {
+            int count = counts[i];
+            make_keys(keys, missing, count, (KeyPattern) pattern);
+
+            printf("%d %s\n", count, describe_key_pattern((KeyPattern) pattern));
+            printf("  %-14s %8s %8s %8s %8s %8s %8s %8s\n", "", "add", "add many", "hit", "hit many", "miss", "churn", "iterate");
+            for(int j = 0; j < implementations_count; j += 1)
+            {
+                benchmark_map(&implementations[j], keys, missing, count, &heap);
+            }
+        }
+    }
+
+    virtual_deallocate(keys);
+    virtual_deallocate(missing);
+    heap_destroy(&heap);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "../../Source/atomic.h"
+#include "../../Source/concurrent_map.h"
+#include "../../Source/thread.h"
+
+#include <stdio.h>
+
+// Each thread adds its own range of keys, removing every third one, while
+// reading back keys from the ranges of the other threads. The map starts out
+// small, so the shards have to grow while the others are reading them.
+#define THREADS_COUNT 4
+#define KEYS_PER_THREAD 50000
+
+typedef struct Shared
+{
+    ConcurrentMap map;
+    volatile int arrived;
+    volatile int mismatches;
+} Shared;
+
+typedef struct Worker
+{
+    Shared* shared;
+    int index;
+} Worker;
+
+static uint64_t get_key(int thread_index, int i)
+{
+    return ((uint64_t) thread_index << 32) | (uint64_t) i;
+}
+
+static void run_worker(void* argument)
+{
+    Worker* worker = (Worker*) argument;
+    Shared* shared = worker->shared;
+
+    atomic_int_add(&shared->arrived, 1);
+    while(atomic_int_load(&shared->arrived) < THREADS_COUNT)
+    {
+        thread_yield();
+    }
+
+    int mismatches = 0;
+    int other = (worker->index + 1) % THREADS_COUNT;
+
+    for(int i = 0; i < KEYS_PER_THREAD; i += 1)
+    {
+        uint64_t key = get_key(worker->index, i);
+        concurrent_map_add_from_uint64(&shared->map, key, (void*) (uintptr_t) (key + 1));
+        if(i % 3 == 0)
+        {
+            concurrent_map_remove_uint64(&shared->map, key);
+        }
+
+        // A key from the other thread may or may not be in yet, but if it's
+        // found it has to have the right value.
+        uint64_t other_key = get_key(other, i);
+        MaybePointer result = concurrent_map_get_from_uint64(&shared->map, other_key);
+        if(result.valid && (uint64_t) (uintptr_t) result.value != other_key + 1)
+        {
+            mismatches += 1;
+        }
+    }
+
+    atomic_int_add(&shared->mismatches, mismatches);
+}
+
+int main(int argc, char** argv)
+{
+    static Shared shared;
+    concurrent_map_create(&shared.map, 0);
+
+    Thread threads[THREADS_COUNT];
+    Worker workers[THREADS_COUNT];
+    for(int i = 0; i < THREADS_COUNT; i += 1)
+    {
+        workers[i].shared = &shared;
+        workers[i].index = i;
+        thread_create(&threads[i], run_worker, &workers[i]);
+    }
+    for(int i = 0; i < THREADS_COUNT; i += 1)
+    {
+        thread_join(&threads[i]);
+    }
+
+    int mismatches = shared.mismatches;
+    for(int thread_index = 0; thread_index < THREADS_COUNT; thread_index += 1)
+    {
+        for(int i = 0; i < KEYS_PER_THREAD; i += 1)
+        {
+            uint64_t key = get_key(thread_index, i);
+            MaybePointer result = concurrent_map_get_from_uint64(&shared.map, key);
+            bool should_be_in = i % 3 != 0;
+            bool matches = result.valid == should_be_in
+                && (!should_be_in || (uint64_t) (uintptr_t) result.value == key + 1);
+            mismatches += !matches;
+        }
+    }
+
+    int expected_count = THREADS_COUNT * (KEYS_PER_THREAD - (KEYS_PER_THREAD + 2) / 3);
+    bool count_matches = concurrent_map_count(&shared.map) == expected_count;
+
+    concurrent_map_reclaim(&shared.map);
+    concurrent_map_destroy(&shared.map);
+
+    if(mismatches > 0 || !count_matches)
+    {
+        printf("test failed: %d mismatches, count %s\n\n", mismatches, count_matches ? "matches" : "doesn't match");
+        return 1;
+    }
+
+    printf("All tests succeeded!\n\n");
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "../../Source/atomic.h"
+#include "../../Source/concurrent_map.h"
+#include "../../Source/map.h"
+#include "../../Source/random.h"
+#include "../../Source/thread.h"
+#include "../Benchmark/benchmark.h"
+
+#include <stdio.h>
+
+// The workload is read-mostly, like a table of vertex remaps or glyphs that
+// workers look up far more often than they add to. One operation in every
+// WRITE_PERIOD overwrites a key, and the rest look one up.
+#define THREAD_CAP 8
+#define KEYS_COUNT 1000000
+#define OPERATIONS_PER_THREAD 2000000
+#define WRITE_PERIOD 32
+
+typedef struct Shared
+{
+    ConcurrentMap concurrent_map;
+    Map locked_map;
+    SpinLock lock;
+    uint64_t* keys;
+    volatile int arrived;
+    int threads_count;
+    bool use_concurrent_map;
+} Shared;
+
+typedef struct Worker
+{
+    Shared* shared;
+    uint64_t found;
+    int index;
+} Worker;
+
+static void wait_for_all_threads(Shared* shared)
+{
+    atomic_int_add(&shared->arrived, 1);
+    while(atomic_int_load(&shared->arrived) < shared->threads_count)
+    {
+        thread_yield();
+    }
+}
+
+static void run_worker(void* argument)
+{
+    Worker* worker = (Worker*) argument;
+    Shared* shared = worker->shared;
+
+    RandomGenerator generator;
+    random_seed(&generator, 1021 + worker->index);
+
+    wait_for_all_threads(shared);
+
+    uint64_t found = 0;
+    for(int i = 0; i < OPERATIONS_PER_THREAD; i += 1)
+    {
+        uint64_t key = shared->keys[random_generate(&generator) % KEYS_COUNT];
+        bool write = i % WRITE_PERIOD == 0;
+
+        if(shared->use_concurrent_map)
+        {
+            if(write)
+            {
+                concurrent_map_add_from_uint64(&shared->concurrent_map, key, (void*) (uintptr_t) i);
+            }
+            else
+            {
+                found += concurrent_map_get_from_uint64(&shared->concurrent_map, key).valid;
+            }
+        }
+        else
+        {
+            // A Map can move its pairs while adding, so even lookups have to
+            // hold the lock.
+            spin_lock_acquire(&shared->lock);
+            if(write)
+            {
+                map_add_from_uint64(&shared->locked_map, key, (void*) (uintptr_t) i, NULL);
+            }
+            else
+            {
+                found += map_get_from_uint64(&shared->locked_map, key).valid;
+            }
+            spin_lock_release(&shared->lock);
+        }
+    }
+
+    worker->found = found;
+}
+
+static double run_workers(Shared* shared, int threads_count, uint64_t* found)
+{
+    shared->threads_count = threads_count;
+    shared->arrived = 0;
+
+    Thread threads[THREAD_CAP];
+    Worker workers[THREAD_CAP];
+
+    Timer timer;
+    timer_start(&timer);
+    for(int i = 0; i < threads_count; i += 1)
+    {
+        workers[i].shared = shared;
+        workers[i].index = i;
+        thread_create(&threads[i], run_worker, &workers[i]);
+    }
+    for(int i = 0; i < threads_count; i += 1)
+    {
+        thread_join(&threads[i]);
+        *found += workers[i].found;
+    }
+    return timer_milliseconds(&timer);
+}
+
+int main(int argc, char** argv)
+{
+    Heap heap = {0};
+    heap_create_growable(&heap, uptibytes(64));
+
+    static Shared shared;
+    shared.keys = (uint64_t*) virtual_allocate(sizeof(uint64_t) * KEYS_COUNT);
+
+    RandomGenerator generator;
+    random_seed(&generator, 1999);
+
+    concurrent_map_create(&shared.concurrent_map, KEYS_COUNT);
+    map_create(&shared.locked_map, 2 * KEYS_COUNT, &heap);
+    for(int i = 0; i < KEYS_COUNT; i += 1)
+    {
+        uint64_t key = random_generate(&generator) | 1;
+        shared.keys[i] = key;
+        concurrent_map_add_from_uint64(&shared.concurrent_map, key, (void*) (uintptr_t) i);
+        map_add_from_uint64(&shared.locked_map, key, (void*) (uintptr_t) i, &heap);
+    }
+
+    printf("Shared map, %d operations per thread over %d keys, 1 in %d a write (%d logical cores)\n", OPERATIONS_PER_THREAD, KEYS_COUNT, WRITE_PERIOD, get_logical_core_count());
+    printf("%8s  %18s  %18s  %8s\n", "threads", "locked Map (ms)", "ConcurrentMap (ms)", "speedup");
+    for(int threads_count = 1; threads_count <= THREAD_CAP; threads_count *= 2)
+    {
+        uint64_t found = 0;
+
+        shared.use_concurrent_map = false;
+        double locked = run_workers(&shared, threads_count, &found);
+
+        shared.use_concurrent_map = true;
+        double concurrent = run_workers(&shared, threads_count, &found);
+
+        printf("%8d  %18.2f  %18.2f  %7.2fx  (%llu)\n", threads_count, locked, concurrent, locked / concurrent, (unsigned long long) found);
+    }
+
+    concurrent_map_destroy(&shared.concurrent_map);
+    map_destroy(&shared.locked_map, &heap);
+    virtual_deallocate(shared.keys);
+    heap_destroy(&heap);
+
+    return 0;
+}
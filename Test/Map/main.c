@@ -6,11 +6,14 @@
 
 typedef enum TestType
 {
+    TEST_TYPE_ADD_MANY,
     TEST_TYPE_GET,
+    TEST_TYPE_GET_MANY,
     TEST_TYPE_GET_MISSING,
     TEST_TYPE_GET_OVERFLOW,
     TEST_TYPE_ITERATE,
     TEST_TYPE_REMOVE,
+    TEST_TYPE_REMOVE_MANY,
     TEST_TYPE_REMOVE_OVERFLOW,
     TEST_TYPE_RESERVE,
     TEST_TYPE_COUNT,
@@ -34,11 +37,14 @@ static const char* describe_test(TestType type)
     switch(type)
     {
         default:
+        case TEST_TYPE_ADD_MANY:        return "Add Many";
         case TEST_TYPE_GET:             return "Get";
+        case TEST_TYPE_GET_MANY:        return "Get Many";
         case TEST_TYPE_GET_MISSING:     return "Get Missing";
         case TEST_TYPE_GET_OVERFLOW:    return "Get Overflow";
         case TEST_TYPE_ITERATE:         return "Iterate";
         case TEST_TYPE_REMOVE:          return "Remove";
+        case TEST_TYPE_REMOVE_MANY:     return "Remove Many";
         case TEST_TYPE_REMOVE_OVERFLOW: return "Remove Overflow";
         case TEST_TYPE_RESERVE:         return "Reserve";
     }
@@ -129,6 +135,62 @@ static bool test_iterate(Test* test, Heap* heap)
     return mismatches == 0;
 }
 
+// A batch can have the same key more than once, including the overflow key,
+// and the last value given for it has to win.
+static bool test_add_many(Test* test, Heap* heap)
+{
+    Map* map = &test->map;
+
+    void* keys[PAIRS_COUNT];
+    void* values[PAIRS_COUNT];
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        keys[i] = (void*) (uintptr_t) (i % (PAIRS_COUNT / 2));
+        values[i] = (void*) (uintptr_t) (i + 1);
+    }
+    map_add_many(map, keys, values, PAIRS_COUNT, heap);
+
+    int mismatches = 0;
+    for(int i = PAIRS_COUNT / 2; i < PAIRS_COUNT; i += 1)
+    {
+        MaybePointer result = map_get(map, keys[i]);
+        mismatches += !result.valid || result.value != values[i];
+    }
+
+    return mismatches == 0 && map->count == PAIRS_COUNT / 2;
+}
+
+static bool test_get_many(Test* test, Heap* heap)
+{
+    Map* map = &test->map;
+
+    random_seed(&test->generator, 8675309);
+
+    void* keys[PAIRS_COUNT];
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        keys[i] = (void*) (uintptr_t) random_generate(&test->generator);
+        if(i % 2 == 0)
+        {
+            map_add(map, keys[i], (void*) (uintptr_t) (i + 1), heap);
+        }
+    }
+
+    MaybePointer results[PAIRS_COUNT];
+    map_get_many(map, keys, results, PAIRS_COUNT);
+
+    int mismatches = 0;
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        bool should_be_in = i % 2 == 0;
+        bool matches = results[i].valid == should_be_in
+            && (!should_be_in || results[i].value == (void*) (uintptr_t) (i + 1));
+        mismatches += !matches;
+    }
+
+    return mismatches == 0;
+}
+
 static bool test_remove(Test* test, Heap* heap)
 {
     Map* map = &test->map;
@@ -143,6 +205,34 @@ static bool test_remove(Test* test, Heap* heap)
     return was_in && !is_in;
 }
 
+// Removing half the keys has to leave every other key findable, even the ones
+// that had to probe past a removed key when they were added.
+static bool test_remove_many(Test* test, Heap* heap)
+{
+    Map* map = &test->map;
+
+    for(uint64_t key = 1; key <= PAIRS_COUNT; key += 1)
+    {
+        map_add_uint64_from_uint64(map, key, key + 1, heap);
+    }
+    for(uint64_t key = 1; key <= PAIRS_COUNT; key += 2)
+    {
+        map_remove_uint64(map, key);
+    }
+
+    int mismatches = 0;
+    for(uint64_t key = 1; key <= PAIRS_COUNT; key += 1)
+    {
+        MaybeUint64 result = map_get_uint64_from_uint64(map, key);
+        bool should_be_in = key % 2 == 0;
+        bool matches = result.valid == should_be_in
+            && (!should_be_in || result.value == key + 1);
+        mismatches += !matches;
+    }
+
+    return mismatches == 0 && map->count == PAIRS_COUNT / 2;
+}
+
 static bool test_remove_overflow(Test* test, Heap* heap)
 {
     Map* map = &test->map;
@@ -172,11 +262,14 @@ static bool run_test(Test* test, Heap* heap)
     switch(test->type)
     {
         default:
+        case TEST_TYPE_ADD_MANY:        return test_add_many(test, heap);
         case TEST_TYPE_GET:             return test_get(test, heap);
+        case TEST_TYPE_GET_MANY:        return test_get_many(test, heap);
         case TEST_TYPE_GET_MISSING:     return test_get_missing(test, heap);
         case TEST_TYPE_GET_OVERFLOW:    return test_get_overflow(test, heap);
         case TEST_TYPE_ITERATE:         return test_iterate(test, heap);
         case TEST_TYPE_REMOVE:          return test_remove(test, heap);
+        case TEST_TYPE_REMOVE_MANY:     return test_remove_many(test, heap);
         case TEST_TYPE_REMOVE_OVERFLOW: return test_remove_overflow(test, heap);
         case TEST_TYPE_RESERVE:         return test_reserve(test, heap);
     }
@@ -186,11 +279,14 @@ static bool run_tests(Heap* heap)
 {
     const TestType tests[TEST_TYPE_COUNT] =
     {
+        TEST_TYPE_ADD_MANY,
         TEST_TYPE_GET,
+        TEST_TYPE_GET_MANY,
         TEST_TYPE_GET_MISSING,
         TEST_TYPE_GET_OVERFLOW,
         TEST_TYPE_ITERATE,
         TEST_TYPE_REMOVE,
+        TEST_TYPE_REMOVE_MANY,
         TEST_TYPE_REMOVE_OVERFLOW,
         TEST_TYPE_RESERVE,
     };
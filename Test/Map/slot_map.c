@@ -0,0 +1,188 @@
+#include "../../Source/random.h"
+#include "../../Source/slot_map.h"
+
+#include <stdio.h>
+
+typedef struct Thing
+{
+    int number;
+    float weight;
+} Thing;
+
+typedef enum TestType
+{
+    TEST_TYPE_ADD,
+    TEST_TYPE_REMOVE_KEEPS_HANDLES,
+    TEST_TYPE_STALE_HANDLE,
+    TEST_TYPE_CHURN,
+    TEST_TYPE_COUNT,
+} TestType;
+
+static const char* describe_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_ADD:                  return "Add";
+        case TEST_TYPE_REMOVE_KEEPS_HANDLES: return "Remove Keeps Handles";
+        case TEST_TYPE_STALE_HANDLE:         return "Stale Handle";
+        case TEST_TYPE_CHURN:                return "Churn";
+    }
+}
+
+#define THINGS_COUNT 1000
+
+static bool test_add(SlotMap* map, Heap* heap)
+{
+    SlotMapHandle handles[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        handles[i] = slot_map_add(map, heap);
+        Thing* thing = SLOT_MAP_LOOK_UP(map, Thing, handles[i]);
+        thing->number = i;
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        Thing* thing = SLOT_MAP_LOOK_UP(map, Thing, handles[i]);
+        mismatches += !thing || thing->number != i;
+    }
+
+    return mismatches == 0 && map->count == THINGS_COUNT;
+}
+
+static bool test_remove_keeps_handles(SlotMap* map, Heap* heap)
+{
+    SlotMapHandle handles[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        handles[i] = slot_map_add(map, heap);
+        SLOT_MAP_LOOK_UP(map, Thing, handles[i])->number = i;
+    }
+    for(int i = 0; i < THINGS_COUNT; i += 3)
+    {
+        slot_map_remove(map, handles[i]);
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        bool should_be_in = i % 3 != 0;
+        bool is_in = slot_map_contains(map, handles[i]);
+        mismatches += is_in != should_be_in
+            || (is_in && SLOT_MAP_LOOK_UP(map, Thing, handles[i])->number != i);
+    }
+
+    // The elements should still be packed, with each one's handle beside it.
+    for(int i = 0; i < map->count; i += 1)
+    {
+        Thing* thing = (Thing*) slot_map_get_element(map, i);
+        SlotMapHandle handle = slot_map_get_handle(map, i);
+        mismatches += SLOT_MAP_LOOK_UP(map, Thing, handle) != thing;
+    }
+
+    return mismatches == 0 && map->count == THINGS_COUNT - (THINGS_COUNT + 2) / 3;
+}
+
+static bool test_stale_handle(SlotMap* map, Heap* heap)
+{
+    SlotMapHandle first = slot_map_add(map, heap);
+    slot_map_remove(map, first);
+
+    // The new element reuses the slot, but under a new generation.
+    SlotMapHandle second = slot_map_add(map, heap);
+    Thing* thing = SLOT_MAP_LOOK_UP(map, Thing, second);
+
+    return first != second
+        && thing
+        && thing->number == 0
+        && !slot_map_contains(map, first)
+        && slot_map_contains(map, second)
+        && !slot_map_contains(map, slot_map_handle_none);
+}
+
+static bool test_churn(SlotMap* map, Heap* heap)
+{
+    RandomGenerator generator;
+    random_seed(&generator, 1618);
+
+    SlotMapHandle handles[THINGS_COUNT] = {0};
+    int numbers[THINGS_COUNT];
+    int mismatches = 0;
+
+    for(int step = 0; step < 20 * THINGS_COUNT; step += 1)
+    {
+        int i = (int) (random_generate(&generator) % THINGS_COUNT);
+        if(handles[i])
+        {
+            Thing* thing = SLOT_MAP_LOOK_UP(map, Thing, handles[i]);
+            mismatches += !thing || thing->number != numbers[i];
+            slot_map_remove(map, handles[i]);
+            mismatches += slot_map_contains(map, handles[i]);
+            handles[i] = slot_map_handle_none;
+        }
+        else
+        {
+            handles[i] = slot_map_add(map, heap);
+            numbers[i] = step;
+            SLOT_MAP_LOOK_UP(map, Thing, handles[i])->number = step;
+        }
+    }
+
+    int live = 0;
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        if(handles[i])
+        {
+            Thing* thing = SLOT_MAP_LOOK_UP(map, Thing, handles[i]);
+            mismatches += !thing || thing->number != numbers[i];
+            live += 1;
+        }
+    }
+
+    return mismatches == 0 && map->count == live;
+}
+
+static bool run_test(TestType type, SlotMap* map, Heap* heap)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_ADD:                  return test_add(map, heap);
+        case TEST_TYPE_REMOVE_KEEPS_HANDLES: return test_remove_keeps_handles(map, heap);
+        case TEST_TYPE_STALE_HANDLE:         return test_stale_handle(map, heap);
+        case TEST_TYPE_CHURN:                return test_churn(map, heap);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Heap heap = {0};
+    heap_create(&heap, (uint32_t) capobytes(16));
+
+    int failed = 0;
+    for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+    {
+        SlotMap map;
+        slot_map_create(&map, sizeof(Thing), 0, &heap);
+
+        TestType type = (TestType) test_index;
+        if(!run_test(type, &map, &heap))
+        {
+            printf("test failed: %s\n", describe_test(type));
+            failed += 1;
+        }
+
+        slot_map_destroy(&map, &heap);
+    }
+
+    if(failed == 0)
+    {
+        printf("All tests succeeded!\n\n");
+    }
+
+    heap_destroy(&heap);
+
+    return failed > 0;
+}
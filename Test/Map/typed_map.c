@@ -0,0 +1,200 @@
+#include "../../Source/random.h"
+#include "../../Source/typed_map.h"
+
+#include <stdio.h>
+
+typedef struct Pair
+{
+    int first;
+    int second;
+} Pair;
+
+static uint32_t hash_pair(Pair pair)
+{
+    uint64_t key = ((uint64_t) (uint32_t) pair.first << 32) | (uint32_t) pair.second;
+    key ^= key >> 33;
+    key *= UINT64_C(0xff51afd7ed558ccd);
+    key ^= key >> 33;
+    return (uint32_t) key;
+}
+
+static bool pairs_equal(Pair a, Pair b)
+{
+    return a.first == b.first && a.second == b.second;
+}
+
+DEFINE_MAP(PairMap, Pair, double, hash_pair, pairs_equal, pair);
+
+// Every key hashes the same, so every lookup has to step over the others.
+static uint32_t hash_collide(int key)
+{
+    return 0;
+}
+
+static bool ints_equal(int a, int b)
+{
+    return a == b;
+}
+
+DEFINE_MAP(CollideMap, int, int, hash_collide, ints_equal, collide);
+
+typedef enum TestType
+{
+    TEST_TYPE_GET,
+    TEST_TYPE_GET_MISSING,
+    TEST_TYPE_OVERWRITE,
+    TEST_TYPE_REMOVE_MANY,
+    TEST_TYPE_COLLIDE,
+    TEST_TYPE_COUNT,
+} TestType;
+
+static const char* describe_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_GET:         return "Get";
+        case TEST_TYPE_GET_MISSING: return "Get Missing";
+        case TEST_TYPE_OVERWRITE:   return "Overwrite";
+        case TEST_TYPE_REMOVE_MANY: return "Remove Many";
+        case TEST_TYPE_COLLIDE:     return "Collide";
+    }
+}
+
+#define PAIRS_COUNT 1000
+
+static bool test_get(PairMap* map, Heap* heap)
+{
+    RandomGenerator generator;
+    random_seed(&generator, 2718);
+
+    Pair keys[PAIRS_COUNT];
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        keys[i].first = (int) (random_generate(&generator) % 100000);
+        keys[i].second = i;
+        map_add_pair(map, keys[i], i / 2.0, heap);
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        double* value = map_get_pair(map, keys[i]);
+        mismatches += !value || *value != i / 2.0;
+    }
+
+    return mismatches == 0 && map->count == PAIRS_COUNT;
+}
+
+static bool test_get_missing(PairMap* map, Heap* heap)
+{
+    Pair key = {3, 4};
+    Pair flipped = {4, 3};
+    map_add_pair(map, key, 1.0, heap);
+    return map_get_pair(map, key) && !map_get_pair(map, flipped);
+}
+
+static bool test_overwrite(PairMap* map, Heap* heap)
+{
+    Pair key = {-7, 12};
+    map_add_pair(map, key, 1.0, heap);
+    map_add_pair(map, key, 2.0, heap);
+    double* value = map_get_pair(map, key);
+    return value && *value == 2.0 && map->count == 1;
+}
+
+static bool test_remove_many(PairMap* map, Heap* heap)
+{
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        Pair key = {i, i + 1};
+        map_add_pair(map, key, i, heap);
+    }
+    for(int i = 0; i < PAIRS_COUNT; i += 2)
+    {
+        Pair key = {i, i + 1};
+        map_remove_pair(map, key);
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < PAIRS_COUNT; i += 1)
+    {
+        Pair key = {i, i + 1};
+        double* value = map_get_pair(map, key);
+        bool should_be_in = i % 2 == 1;
+        mismatches += (value != NULL) != should_be_in
+            || (should_be_in && *value != i);
+    }
+
+    return mismatches == 0 && map->count == PAIRS_COUNT / 2;
+}
+
+static bool test_collide(Heap* heap)
+{
+    CollideMap map;
+    map_create_collide(&map, 0, heap);
+
+    for(int i = 0; i < 64; i += 1)
+    {
+        map_add_collide(&map, i, i * i, heap);
+    }
+    map_remove_collide(&map, 0);
+    map_remove_collide(&map, 31);
+
+    int mismatches = 0;
+    for(int i = 0; i < 64; i += 1)
+    {
+        int* value = map_get_collide(&map, i);
+        bool should_be_in = i != 0 && i != 31;
+        mismatches += (value != NULL) != should_be_in
+            || (should_be_in && *value != i * i);
+    }
+
+    map_destroy_collide(&map, heap);
+
+    return mismatches == 0;
+}
+
+static bool run_test(TestType type, PairMap* map, Heap* heap)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_GET:         return test_get(map, heap);
+        case TEST_TYPE_GET_MISSING: return test_get_missing(map, heap);
+        case TEST_TYPE_OVERWRITE:   return test_overwrite(map, heap);
+        case TEST_TYPE_REMOVE_MANY: return test_remove_many(map, heap);
+        case TEST_TYPE_COLLIDE:     return test_collide(heap);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Heap heap = {0};
+    heap_create(&heap, (uint32_t) capobytes(16));
+
+    int failed = 0;
+    for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+    {
+        PairMap map;
+        map_create_pair(&map, 0, &heap);
+
+        TestType type = (TestType) test_index;
+        if(!run_test(type, &map, &heap))
+        {
+            printf("test failed: %s\n", describe_test(type));
+            failed += 1;
+        }
+
+        map_destroy_pair(&map, &heap);
+    }
+
+    if(failed == 0)
+    {
+        printf("All tests succeeded!\n\n");
+    }
+
+    heap_destroy(&heap);
+
+    return failed > 0;
+}
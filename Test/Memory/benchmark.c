@@ -0,0 +1,357 @@
+#include "../../Source/atomic.h"
+#include "../../Source/memory.h"
+#include "../../Source/random.h"
+#include "../../Source/thread.h"
+#include "../Benchmark/benchmark.h"
+
+#include <stdio.h>
+
+typedef struct Thing
+{
+    void* next;
+    uint64_t value;
+    float padding[4];
+} Thing;
+
+#define POOL_OBJECTS_COUNT 1000000
+#define ITERATIONS 20
+
+static void benchmark_pool_iterate(const char* label, int keep_one_in)
+{
+    Pool pool = {0};
+    pool_create(&pool, sizeof(Thing), 1024);
+
+    Thing** things = (Thing**) virtual_allocate(sizeof(Thing*) * POOL_OBJECTS_COUNT);
+    for(int i = 0; i < POOL_OBJECTS_COUNT; i += 1)
+    {
+        things[i] = POOL_ALLOCATE(&pool, Thing);
+        things[i]->value = i;
+    }
+
+    // Delete objects at random, so that only about one in every
+    // keep_one_in objects is left.
+    RandomGenerator generator;
+    random_seed(&generator, 72314);
+    int live = POOL_OBJECTS_COUNT;
+    if(keep_one_in > 1)
+    {
+        for(int i = 0; i < POOL_OBJECTS_COUNT; i += 1)
+        {
+            if(random_generate(&generator) % keep_one_in != 0)
+            {
+                pool_deallocate(&pool, things[i]);
+                live -= 1;
+            }
+        }
+    }
+
+    uint64_t sum = 0;
+    Timer timer;
+    timer_start(&timer);
+    for(int iteration = 0; iteration < ITERATIONS; iteration += 1)
+    {
+        FOR_EACH_IN_POOL(Thing, thing, pool)
+        {
+            sum += thing->value;
+        }
+    }
+    double milliseconds = timer_milliseconds(&timer) / ITERATIONS;
+    double per_live = (1.0e6 * milliseconds) / live;
+
+    printf("%-24s live %8d  %9.3f ms/pass  %7.2f ns/live object  (%llu)\n", label, live, milliseconds, per_live, (unsigned long long) sum);
+
+    virtual_deallocate(things);
+    pool_destroy(&pool);
+}
+
+static const char* describe_kernel_type(MemoryKernelType type)
+{
+    switch(type)
+    {
+        default:
+        case MEMORY_KERNEL_TYPE_BYTE: return "byte";
+        case MEMORY_KERNEL_TYPE_WORD: return "word";
+        case MEMORY_KERNEL_TYPE_SSE2: return "SSE2";
+        case MEMORY_KERNEL_TYPE_AVX2: return "AVX2";
+    }
+}
+
+#define LARGEST_COPY (64 * 1024 * 1024)
+#define BYTES_PER_MEASUREMENT (256 * 1024 * 1024)
+
+static void benchmark_copy_and_zero()
+{
+    MemoryKernelType best = get_memory_kernel_type();
+    printf("copy_memory and zero_memory (selected kernel: %s)\n", describe_kernel_type(best));
+    printf("%10s", "bytes");
+    for(int type = 0; type < MEMORY_KERNEL_TYPE_COUNT; type += 1)
+    {
+        if(set_memory_kernel_type((MemoryKernelType) type))
+        {
+            printf("  %6s copy  %6s zero", describe_kernel_type(type), describe_kernel_type(type));
+        }
+    }
+    printf("  (GB/s)\n");
+
+    uint8_t* from = (uint8_t*) virtual_allocate(LARGEST_COPY);
+    uint8_t* to = (uint8_t*) virtual_allocate(LARGEST_COPY);
+    for(int i = 0; i < LARGEST_COPY; i += 1)
+    {
+        from[i] = (uint8_t) i;
+    }
+
+    for(uint64_t size = 16; size <= LARGEST_COPY; size *= 4)
+    {
+        printf("%10llu", (unsigned long long) size);
+
+        uint64_t repeats = BYTES_PER_MEASUREMENT / size;
+        if(repeats > 1000000)
+        {
+            repeats = 1000000;
+        }
+
+        for(int type = 0; type < MEMORY_KERNEL_TYPE_COUNT; type += 1)
+        {
+            if(!set_memory_kernel_type((MemoryKernelType) type))
+            {
+                continue;
+            }
+
+            // The byte kernels are so slow on large sizes that it's enough to
+            // run them fewer times.
+            uint64_t kernel_repeats = repeats;
+            if(type == MEMORY_KERNEL_TYPE_BYTE && kernel_repeats > 4)
+            {
+                kernel_repeats /= 16;
+            }
+
+            Timer timer;
+            timer_start(&timer);
+            for(uint64_t i = 0; i < kernel_repeats; i += 1)
+            {
+                // Offset by one byte to include the cost of misalignment.
+                copy_memory(to + (i & 1), from, size - 1);
+            }
+            double copy_seconds = timer_milliseconds(&timer) / 1000.0;
+
+            timer_start(&timer);
+            for(uint64_t i = 0; i < kernel_repeats; i += 1)
+            {
+                zero_memory(to + (i & 1), size - 1);
+            }
+            double zero_seconds = timer_milliseconds(&timer) / 1000.0;
+
+            double total = (double) size * kernel_repeats / 1.0e9;
+            printf("  %11.2f  %11.2f", total / copy_seconds, total / zero_seconds);
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+    set_memory_kernel_type(best);
+
+    virtual_deallocate(from);
+    virtual_deallocate(to);
+}
+
+// Each thread allocates a batch of blocks, frees half of them itself and hands
+// the other half to its neighbour to free. So, a quarter of all frees come from
+// a thread other than the one that allocated.
+#define STRESS_THREAD_CAP 8
+#define STRESS_ROUNDS 2000
+#define STRESS_BATCH 64
+
+typedef struct Handoff
+{
+    struct Handoff* next;
+    Heap* heap;
+} Handoff;
+
+typedef struct StressShared
+{
+    Heap locked_heap;
+    SpinLock lock;
+    void* volatile inboxes[STRESS_THREAD_CAP];
+    volatile int arrived;
+    int threads_count;
+    bool use_thread_heaps;
+} StressShared;
+
+typedef struct StressThread
+{
+    StressShared* shared;
+    int index;
+} StressThread;
+
+static void* stress_allocate(StressShared* shared, uint32_t bytes)
+{
+    if(shared->use_thread_heaps)
+    {
+        Heap* heap = get_thread_heap();
+        Handoff* handoff = (Handoff*) heap_allocate(heap, bytes);
+        handoff->heap = heap;
+        return handoff;
+    }
+    else
+    {
+        spin_lock_acquire(&shared->lock);
+        Handoff* handoff = (Handoff*) heap_allocate(&shared->locked_heap, bytes);
+        spin_lock_release(&shared->lock);
+        handoff->heap = &shared->locked_heap;
+        return handoff;
+    }
+}
+
+static void stress_deallocate(StressShared* shared, Handoff* handoff)
+{
+    if(shared->use_thread_heaps)
+    {
+        heap_deallocate(handoff->heap, handoff);
+    }
+    else
+    {
+        spin_lock_acquire(&shared->lock);
+        heap_deallocate(handoff->heap, handoff);
+        spin_lock_release(&shared->lock);
+    }
+}
+
+static void hand_off(StressShared* shared, int index, Handoff* handoff)
+{
+    void* volatile* inbox = &shared->inboxes[index];
+    void* head = atomic_pointer_load(inbox);
+    do
+    {
+        handoff->next = (Handoff*) head;
+    } while(!atomic_pointer_compare_exchange(inbox, &head, handoff));
+}
+
+static void free_inbox(StressShared* shared, int index)
+{
+    Handoff* handoff = (Handoff*) atomic_pointer_exchange(&shared->inboxes[index], NULL);
+    while(handoff)
+    {
+        Handoff* next = handoff->next;
+        stress_deallocate(shared, handoff);
+        handoff = next;
+    }
+}
+
+static void wait_for_all_threads(StressShared* shared, int arrivals)
+{
+    atomic_int_add(&shared->arrived, 1);
+    while(atomic_int_load(&shared->arrived) < arrivals)
+    {
+        thread_yield();
+    }
+}
+
+static void run_stress_thread(void* argument)
+{
+    StressThread* stress = (StressThread*) argument;
+    StressShared* shared = stress->shared;
+    int neighbour = (stress->index + 1) % shared->threads_count;
+
+    RandomGenerator generator;
+    random_seed(&generator, 5381 + stress->index);
+
+    Handoff* batch[STRESS_BATCH];
+    for(int round = 0; round < STRESS_ROUNDS; round += 1)
+    {
+        for(int i = 0; i < STRESS_BATCH; i += 1)
+        {
+            uint32_t bytes = sizeof(Handoff) + (uint32_t) (random_generate(&generator) % 512);
+            batch[i] = (Handoff*) stress_allocate(shared, bytes);
+        }
+        for(int i = 0; i < STRESS_BATCH; i += 2)
+        {
+            stress_deallocate(shared, batch[i]);
+            hand_off(shared, neighbour, batch[i + 1]);
+        }
+        free_inbox(shared, stress->index);
+    }
+
+    // Whatever was handed off after the last round is freed once every thread
+    // is done handing off, and the heaps are only destroyed once every thread
+    // is done freeing into them.
+    wait_for_all_threads(shared, shared->threads_count);
+    free_inbox(shared, stress->index);
+    wait_for_all_threads(shared, 2 * shared->threads_count);
+
+    if(shared->use_thread_heaps)
+    {
+        destroy_thread_heap();
+    }
+}
+
+static double run_stress(int threads_count, bool use_thread_heaps)
+{
+    StressShared shared = {0};
+    shared.threads_count = threads_count;
+    shared.use_thread_heaps = use_thread_heaps;
+    if(!use_thread_heaps)
+    {
+        heap_create_growable(&shared.locked_heap, uptibytes(64));
+    }
+
+    Thread threads[STRESS_THREAD_CAP];
+    StressThread stress[STRESS_THREAD_CAP];
+
+    Timer timer;
+    timer_start(&timer);
+    for(int i = 0; i < threads_count; i += 1)
+    {
+        stress[i].shared = &shared;
+        stress[i].index = i;
+        thread_create(&threads[i], run_stress_thread, &stress[i]);
+    }
+    for(int i = 0; i < threads_count; i += 1)
+    {
+        thread_join(&threads[i]);
+    }
+    double milliseconds = timer_milliseconds(&timer);
+
+    if(!use_thread_heaps)
+    {
+        heap_destroy(&shared.locked_heap);
+    }
+
+    return milliseconds;
+}
+
+static void benchmark_thread_heaps()
+{
+    printf("Heap stress, %d rounds of %d allocations per thread (%d logical cores)\n", STRESS_ROUNDS, STRESS_BATCH, get_logical_core_count());
+    printf("%8s  %16s  %16s  %8s\n", "threads", "locked (ms)", "per-thread (ms)", "speedup");
+    for(int threads_count = 1; threads_count <= STRESS_THREAD_CAP; threads_count *= 2)
+    {
+        double locked = run_stress(threads_count, false);
+        double per_thread = run_stress(threads_count, true);
+        printf("%8d  %16.2f  %16.2f  %7.2fx\n", threads_count, locked, per_thread, locked / per_thread);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    benchmark_copy_and_zero();
+
+    printf("Pool iteration over %d slots\n", POOL_OBJECTS_COUNT);
+    benchmark_pool_iterate("dense", 1);
+    benchmark_pool_iterate("half deleted", 2);
+    benchmark_pool_iterate("15/16 deleted", 16);
+    benchmark_pool_iterate("255/256 deleted", 256);
+
+    HugePageMode mode = set_huge_page_mode(HUGE_PAGE_MODE_EXPLICIT, HUGE_PAGE_BYTES);
+    if(mode != HUGE_PAGE_MODE_OFF)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "dense, %s huge", describe_huge_page_mode(mode));
+        benchmark_pool_iterate(label, 1);
+        set_huge_page_mode(HUGE_PAGE_MODE_OFF, 0);
+    }
+    printf("\n");
+
+    benchmark_thread_heaps();
+    return 0;
+}
@@ -0,0 +1,1130 @@
+#include "../../Source/memory.h"
+#include "../../Source/random.h"
+#include "../../Source/thread.h"
+
+#include <stdio.h>
+
+typedef enum TestType
+{
+    TEST_TYPE_ALLOCATION_TRACE,
+    TEST_TYPE_ALLOCATION_TRACE_TRUNCATED,
+    TEST_TYPE_ARENA_ALLOCATE,
+    TEST_TYPE_ARENA_RESET_TO_MARK,
+    TEST_TYPE_COPY_MEMORY,
+    TEST_TYPE_COPY_MEMORY_OVERLAPPING,
+    TEST_TYPE_ZERO_MEMORY,
+    TEST_TYPE_HEAP_ALLOCATE,
+    TEST_TYPE_HEAP_GROW,
+    TEST_TYPE_HEAP_GROW_IN_PLACE,
+    TEST_TYPE_HEAP_REALLOCATE,
+    TEST_TYPE_HEAP_REMOTE_FREE,
+    TEST_TYPE_HUGE_PAGE_ALLOCATE,
+    TEST_TYPE_MEMORY_ACCOUNTING,
+    TEST_TYPE_POOL_ALLOCATE_RUN,
+    TEST_TYPE_POOL_GROW,
+    TEST_TYPE_POOL_INDEX,
+    TEST_TYPE_POOL_ITERATE,
+    TEST_TYPE_POOL_ITERATE_RANGE,
+    TEST_TYPE_POOL_ITERATE_SPARSE,
+    TEST_TYPE_POOL_REUSE,
+    TEST_TYPE_STACK_GROW,
+    TEST_TYPE_THREAD_HEAP_ACCOUNTING,
+    TEST_TYPE_COUNT,
+} TestType;
+
+typedef struct Thing
+{
+    void* next;
+    uint64_t value;
+} Thing;
+
+typedef struct Test
+{
+    Arena arena;
+    Heap heap;
+    Pool pool;
+    RandomGenerator generator;
+    TestType type;
+} Test;
+
+static const char* describe_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_ALLOCATION_TRACE:           return "Allocation Trace";
+        case TEST_TYPE_ALLOCATION_TRACE_TRUNCATED: return "Allocation Trace Truncated";
+        case TEST_TYPE_ARENA_ALLOCATE:             return "Arena Allocate";
+        case TEST_TYPE_ARENA_RESET_TO_MARK:        return "Arena Reset To Mark";
+        case TEST_TYPE_COPY_MEMORY:                return "Copy Memory";
+        case TEST_TYPE_COPY_MEMORY_OVERLAPPING:    return "Copy Memory Overlapping";
+        case TEST_TYPE_ZERO_MEMORY:                return "Zero Memory";
+        case TEST_TYPE_HEAP_ALLOCATE:              return "Heap Allocate";
+        case TEST_TYPE_HEAP_GROW:                  return "Heap Grow";
+        case TEST_TYPE_HEAP_GROW_IN_PLACE:         return "Heap Grow In Place";
+        case TEST_TYPE_HEAP_REALLOCATE:            return "Heap Reallocate";
+        case TEST_TYPE_HEAP_REMOTE_FREE:           return "Heap Remote Free";
+        case TEST_TYPE_HUGE_PAGE_ALLOCATE:         return "Huge Page Allocate";
+        case TEST_TYPE_MEMORY_ACCOUNTING:          return "Memory Accounting";
+        case TEST_TYPE_POOL_ALLOCATE_RUN:          return "Pool Allocate Run";
+        case TEST_TYPE_POOL_GROW:                  return "Pool Grow";
+        case TEST_TYPE_POOL_INDEX:                 return "Pool Index";
+        case TEST_TYPE_POOL_ITERATE:               return "Pool Iterate";
+        case TEST_TYPE_POOL_ITERATE_RANGE:         return "Pool Iterate Range";
+        case TEST_TYPE_POOL_ITERATE_SPARSE:        return "Pool Iterate Sparse";
+        case TEST_TYPE_POOL_REUSE:                 return "Pool Reuse";
+        case TEST_TYPE_STACK_GROW:                 return "Stack Grow";
+        case TEST_TYPE_THREAD_HEAP_ACCOUNTING:     return "Thread Heap Accounting";
+    }
+}
+
+#define BUFFER_SIZE 1024
+
+static void fill_pattern(uint8_t* memory, int bytes)
+{
+    for(int i = 0; i < bytes; i += 1)
+    {
+        memory[i] = (uint8_t) (i * 7 + 3);
+    }
+}
+
+static bool test_allocation_trace(Test* test)
+{
+    Heap* heap = &test->heap;
+    Pool* pool = &test->pool;
+
+    if(!allocation_trace_start(megabytes(1)))
+    {
+        return false;
+    }
+
+    uint8_t* a = HEAP_ALLOCATE(heap, uint8_t, 100);
+    uint8_t* fence = HEAP_ALLOCATE(heap, uint8_t, 16);
+    uint8_t* b = HEAP_REALLOCATE(heap, a, uint8_t, 50);
+    uint8_t* c = HEAP_REALLOCATE(heap, b, uint8_t, 4000);
+    HEAP_DEALLOCATE(heap, c);
+    HEAP_DEALLOCATE(heap, fence);
+    Thing* thing = POOL_ALLOCATE(pool, Thing);
+    pool_deallocate(pool, thing);
+
+    AllocationTrace trace = allocation_trace_stop();
+
+    // Nothing after stopping should be recorded.
+    uint8_t* after = HEAP_ALLOCATE(heap, uint8_t, 8);
+    HEAP_DEALLOCATE(heap, after);
+
+    // Shrinking happens in place, but growing past the fence has to move, so
+    // it shows up as an allocation and a deallocation instead.
+    const AllocationEventType expected[] =
+    {
+        ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE,
+        ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE,
+        ALLOCATION_EVENT_TYPE_HEAP_REALLOCATE,
+        ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE,
+        ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE,
+        ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE,
+        ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE,
+        ALLOCATION_EVENT_TYPE_POOL_ALLOCATE,
+        ALLOCATION_EVENT_TYPE_POOL_DEALLOCATE,
+    };
+    int expected_count = sizeof(expected) / sizeof(*expected);
+
+    bool matched = trace.header
+        && trace.header->magic == ALLOCATION_TRACE_MAGIC
+        && !trace.header->truncated
+        && trace.header->events_count == (uint64_t) expected_count
+        && trace.bytes == sizeof(AllocationTraceHeader) + sizeof(AllocationEvent) * expected_count;
+    for(int i = 0; matched && i < expected_count; i += 1)
+    {
+        matched = trace.events[i].type == expected[i];
+    }
+
+    bool addresses_matched = matched
+        && trace.events[0].result == (uintptr_t) a
+        && trace.events[2].address == (uintptr_t) a
+        && trace.events[3].result == (uintptr_t) c
+        && trace.events[4].address == (uintptr_t) a
+        && trace.events[0].allocator == trace.events[4].allocator
+        && trace.events[7].allocator != trace.events[0].allocator
+        && trace.events[7].bytes == sizeof(Thing);
+
+    allocation_trace_release();
+
+    return matched && addresses_matched && !allocation_trace_is_recording();
+}
+
+// Using one more allocator than a trace can tell apart should stop it at the
+// first event on that allocator, rather than merging it with another.
+static bool test_allocation_trace_truncated(Test* test)
+{
+    Heap* heap = &test->heap;
+
+    const int pools_count = ALLOCATION_TRACE_ALLOCATOR_CAP + 1;
+    Pool* pools = HEAP_ALLOCATE(heap, Pool, pools_count);
+    for(int i = 0; i < pools_count; i += 1)
+    {
+        pool_create(&pools[i], sizeof(Thing), 1);
+    }
+
+    if(!allocation_trace_start(megabytes(1)))
+    {
+        return false;
+    }
+
+    for(int i = 0; i < pools_count; i += 1)
+    {
+        POOL_ALLOCATE(&pools[i], Thing);
+    }
+    bool recording = allocation_trace_is_recording();
+
+    AllocationTrace trace = allocation_trace_stop();
+
+    bool truncated = trace.header
+        && trace.header->truncated
+        && trace.header->events_count == ALLOCATION_TRACE_ALLOCATOR_CAP;
+    for(int i = 0; truncated && i < ALLOCATION_TRACE_ALLOCATOR_CAP; i += 1)
+    {
+        truncated = trace.events[i].allocator == i;
+    }
+
+    allocation_trace_release();
+
+    for(int i = 0; i < pools_count; i += 1)
+    {
+        pool_destroy(&pools[i]);
+    }
+    HEAP_DEALLOCATE(heap, pools);
+
+    return recording && truncated;
+}
+
+static bool test_arena_allocate(Test* test)
+{
+    Arena* arena = &test->arena;
+
+    uint8_t* a = ARENA_ALLOCATE(arena, uint8_t, 3);
+    uint8_t* b = ARENA_ALLOCATE(arena, uint8_t, 100);
+    if(!a || !b)
+    {
+        return false;
+    }
+
+    bool zeroed = true;
+    for(int i = 0; i < 100; i += 1)
+    {
+        zeroed = zeroed && b[i] == 0;
+    }
+
+    // Anything that doesn't fit should fail without touching what's there.
+    uint32_t top = arena->top;
+    void* too_big = arena_allocate(arena, arena->bytes);
+
+    return zeroed
+        && ((uintptr_t) a & 31) == 0
+        && ((uintptr_t) b & 31) == 0
+        && b >= a + 3
+        && !too_big
+        && arena->top == top;
+}
+
+static bool test_arena_reset_to_mark(Test* test)
+{
+    Arena* arena = &test->arena;
+
+    ARENA_ALLOCATE(arena, uint64_t, 5);
+    ArenaMark mark = arena_mark(arena);
+    uint8_t* first = ARENA_ALLOCATE(arena, uint8_t, 64);
+    for(int i = 0; i < 64; i += 1)
+    {
+        first[i] = 0xff;
+    }
+    ARENA_ALLOCATE(arena, uint8_t, 1000);
+
+    arena_reset_to_mark(arena, mark);
+    uint8_t* second = ARENA_ALLOCATE(arena, uint8_t, 64);
+
+    bool zeroed = true;
+    for(int i = 0; i < 64; i += 1)
+    {
+        zeroed = zeroed && second[i] == 0;
+    }
+
+    arena_reset(arena);
+
+    return first == second
+        && zeroed
+        && arena->top == 0;
+}
+
+// Try every kernel the CPU supports over a spread of sizes and alignments.
+static bool test_copy_memory(Test* test)
+{
+    uint8_t from[BUFFER_SIZE];
+    uint8_t to[BUFFER_SIZE];
+    fill_pattern(from, BUFFER_SIZE);
+
+    int mismatches = 0;
+    for(int type = 0; type < MEMORY_KERNEL_TYPE_COUNT; type += 1)
+    {
+        if(!set_memory_kernel_type((MemoryKernelType) type))
+        {
+            continue;
+        }
+        for(int size = 0; size < 600; size += 1 + size / 8)
+        {
+            for(int offset = 0; offset < 40; offset += 3)
+            {
+                for(int i = 0; i < BUFFER_SIZE; i += 1)
+                {
+                    to[i] = 0xee;
+                }
+                copy_memory(&to[offset], &from[40 - offset], size);
+                for(int i = 0; i < BUFFER_SIZE; i += 1)
+                {
+                    bool inside = i >= offset && i < offset + size;
+                    uint8_t expected = inside ? from[40 - offset + i - offset] : 0xee;
+                    mismatches += to[i] != expected;
+                }
+            }
+        }
+    }
+
+    return mismatches == 0;
+}
+
+static bool test_copy_memory_overlapping(Test* test)
+{
+    uint8_t buffer[BUFFER_SIZE];
+    uint8_t pattern[BUFFER_SIZE];
+    fill_pattern(pattern, BUFFER_SIZE);
+
+    int mismatches = 0;
+    for(int type = 0; type < MEMORY_KERNEL_TYPE_COUNT; type += 1)
+    {
+        if(!set_memory_kernel_type((MemoryKernelType) type))
+        {
+            continue;
+        }
+        for(int size = 1; size < 500; size += 1 + size / 4)
+        {
+            for(int shift = -70; shift <= 70; shift += 7)
+            {
+                int from = 200;
+                int to = from + shift;
+                for(int i = 0; i < BUFFER_SIZE; i += 1)
+                {
+                    buffer[i] = pattern[i];
+                }
+                copy_memory(&buffer[to], &buffer[from], size);
+                for(int i = 0; i < size; i += 1)
+                {
+                    mismatches += buffer[to + i] != pattern[from + i];
+                }
+            }
+        }
+    }
+
+    return mismatches == 0;
+}
+
+static bool test_zero_memory(Test* test)
+{
+    uint8_t buffer[BUFFER_SIZE];
+
+    int mismatches = 0;
+    for(int type = 0; type < MEMORY_KERNEL_TYPE_COUNT; type += 1)
+    {
+        if(!set_memory_kernel_type((MemoryKernelType) type))
+        {
+            continue;
+        }
+        for(int size = 0; size < 600; size += 1 + size / 8)
+        {
+            for(int offset = 0; offset < 40; offset += 3)
+            {
+                fill_pattern(buffer, BUFFER_SIZE);
+                zero_memory(&buffer[offset], size);
+                for(int i = 0; i < BUFFER_SIZE; i += 1)
+                {
+                    bool inside = i >= offset && i < offset + size;
+                    uint8_t expected = inside ? 0 : (uint8_t) (i * 7 + 3);
+                    mismatches += buffer[i] != expected;
+                }
+            }
+        }
+    }
+
+    return mismatches == 0;
+}
+
+#define ALLOCATIONS_COUNT 512
+
+static bool is_filled(uint8_t* memory, uint32_t bytes, uint8_t value)
+{
+    for(uint32_t i = 0; i < bytes; i += 1)
+    {
+        if(memory[i] != value)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void fill(uint8_t* memory, uint32_t bytes, uint8_t value)
+{
+    for(uint32_t i = 0; i < bytes; i += 1)
+    {
+        memory[i] = value;
+    }
+}
+
+static bool test_heap_allocate(Test* test)
+{
+    Heap* heap = &test->heap;
+
+    uint8_t* allocations[ALLOCATIONS_COUNT] = {0};
+    uint32_t sizes[ALLOCATIONS_COUNT] = {0};
+
+    random_seed(&test->generator, 2251);
+
+    // Allocate and deallocate at random, checking that no allocation ever
+    // overwrites another.
+    int mismatches = 0;
+    for(int round = 0; round < 8 * ALLOCATIONS_COUNT; round += 1)
+    {
+        int index = random_generate(&test->generator) % ALLOCATIONS_COUNT;
+        if(allocations[index])
+        {
+            mismatches += !is_filled(allocations[index], sizes[index], (uint8_t) index);
+            HEAP_DEALLOCATE(heap, allocations[index]);
+            allocations[index] = NULL;
+        }
+        else
+        {
+            uint32_t size = 1 + (random_generate(&test->generator) % 2000);
+            allocations[index] = HEAP_ALLOCATE(heap, uint8_t, size);
+            if(!allocations[index])
+            {
+                return false;
+            }
+            mismatches += !is_filled(allocations[index], size, 0);
+            fill(allocations[index], size, (uint8_t) index);
+            sizes[index] = size;
+        }
+    }
+
+    for(int i = 0; i < ALLOCATIONS_COUNT; i += 1)
+    {
+        if(allocations[i])
+        {
+            mismatches += !is_filled(allocations[i], sizes[i], (uint8_t) i);
+            HEAP_DEALLOCATE(heap, allocations[i]);
+        }
+    }
+
+    // Everything should have merged back into one free block.
+    HeapInfo info = heap_get_info(heap);
+    return mismatches == 0
+        && info.used_entries == 0
+        && info.free_entries == 1;
+}
+
+#define GROW_ALLOCATIONS_COUNT 64
+#define GROW_ALLOCATION_BYTES 100000
+
+static bool test_heap_grow(Test* test)
+{
+    Heap heap = {0};
+    if(!heap_create_growable(&heap, capobytes(256)))
+    {
+        return false;
+    }
+    uint64_t initial_blocks = heap.total_blocks;
+
+    // Each allocation is bigger than everything the heap starts with.
+    uint8_t* allocations[GROW_ALLOCATIONS_COUNT];
+    bool all_allocated = true;
+    for(int i = 0; i < GROW_ALLOCATIONS_COUNT; i += 1)
+    {
+        allocations[i] = HEAP_ALLOCATE(&heap, uint8_t, GROW_ALLOCATION_BYTES);
+        all_allocated = all_allocated && allocations[i];
+        if(allocations[i])
+        {
+            allocations[i][0] = (uint8_t) i;
+            allocations[i][GROW_ALLOCATION_BYTES - 1] = (uint8_t) i;
+        }
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < GROW_ALLOCATIONS_COUNT && all_allocated; i += 1)
+    {
+        mismatches += allocations[i][0] != (uint8_t) i;
+        mismatches += allocations[i][GROW_ALLOCATION_BYTES - 1] != (uint8_t) i;
+    }
+    uint64_t grown_blocks = heap.total_blocks;
+
+    // It shouldn't be able to grow past what it reserved.
+    void* too_big = heap_allocate(&heap, (uint32_t) capobytes(256));
+
+    for(int i = 0; i < GROW_ALLOCATIONS_COUNT; i += 1)
+    {
+        HEAP_DEALLOCATE(&heap, allocations[i]);
+    }
+    HeapInfo info = heap_get_info(&heap);
+
+    heap_destroy(&heap);
+
+    return all_allocated
+        && mismatches == 0
+        && !too_big
+        && grown_blocks > initial_blocks
+        && info.used_entries == 0
+        && info.free_entries == 1;
+}
+
+static bool test_heap_grow_in_place(Test* test)
+{
+    Heap* heap = &test->heap;
+
+    uint8_t* a = HEAP_ALLOCATE(heap, uint8_t, 100);
+    uint8_t* b = HEAP_ALLOCATE(heap, uint8_t, 400);
+    uint8_t* c = HEAP_ALLOCATE(heap, uint8_t, 100);
+    fill(a, 100, 0xa1);
+    HEAP_DEALLOCATE(heap, b);
+
+    // The space b used to be in is free now, so a should grow into it.
+    uint8_t* grown = HEAP_REALLOCATE(heap, a, uint8_t, 300);
+    bool in_place = grown == a;
+    bool kept = is_filled(grown, 100, 0xa1);
+    bool cleared = is_filled(grown + 100, 200, 0);
+
+    HEAP_DEALLOCATE(heap, grown);
+    HEAP_DEALLOCATE(heap, c);
+
+    return in_place && kept && cleared;
+}
+
+static bool test_heap_reallocate(Test* test)
+{
+    Heap* heap = &test->heap;
+
+    uint8_t* a = HEAP_ALLOCATE(heap, uint8_t, 64);
+    uint8_t* fence = HEAP_ALLOCATE(heap, uint8_t, 16);
+    fill(a, 64, 0x5c);
+
+    // The next block is in use, so this has to move.
+    uint8_t* moved = HEAP_REALLOCATE(heap, a, uint8_t, 4096);
+    bool kept = is_filled(moved, 64, 0x5c);
+    bool cleared = is_filled(moved + 64, 4096 - 64, 0);
+
+    uint8_t* shrunk = HEAP_REALLOCATE(heap, moved, uint8_t, 32);
+    bool shrunk_in_place = shrunk == moved && is_filled(shrunk, 32, 0x5c);
+
+    HEAP_DEALLOCATE(heap, shrunk);
+    HEAP_DEALLOCATE(heap, fence);
+
+    HeapInfo info = heap_get_info(heap);
+    return kept && cleared && shrunk_in_place
+        && info.used_entries == 0
+        && info.free_entries == 1;
+}
+
+#define REMOTE_FREE_COUNT 100
+
+typedef struct RemoteFree
+{
+    Heap* heap;
+    void* allocations[REMOTE_FREE_COUNT];
+} RemoteFree;
+
+static void free_from_another_thread(void* argument)
+{
+    RemoteFree* remote = (RemoteFree*) argument;
+    for(int i = 0; i < REMOTE_FREE_COUNT; i += 1)
+    {
+        HEAP_DEALLOCATE(remote->heap, remote->allocations[i]);
+    }
+}
+
+static bool test_heap_remote_free(Test* test)
+{
+    RemoteFree remote;
+    remote.heap = get_thread_heap();
+    for(int i = 0; i < REMOTE_FREE_COUNT; i += 1)
+    {
+        remote.allocations[i] = heap_allocate(remote.heap, 16 * (i + 1));
+    }
+
+    Thread thread;
+    thread_create(&thread, free_from_another_thread, &remote);
+    thread_join(&thread);
+
+    // The frees are only queued, until the owning thread takes them back.
+    HeapInfo queued = heap_get_info(remote.heap);
+    heap_reclaim_remote_frees(remote.heap);
+    HeapInfo reclaimed = heap_get_info(remote.heap);
+
+    destroy_thread_heap();
+
+    return queued.used_entries == REMOTE_FREE_COUNT
+        && reclaimed.used_entries == 0
+        && reclaimed.free_entries == 1;
+}
+
+static bool test_huge_page_allocate(Test* test)
+{
+    // Whichever mode the system allows, large allocations should still work,
+    // falling back to regular pages if need be.
+    HugePageMode mode = set_huge_page_mode(HUGE_PAGE_MODE_EXPLICIT, HUGE_PAGE_BYTES);
+
+    uint64_t bytes = 2 * HUGE_PAGE_BYTES + 123;
+    uint8_t* large = (uint8_t*) virtual_allocate(bytes);
+    uint8_t* small = (uint8_t*) virtual_allocate(64);
+    bool allocated = large && small;
+    bool usable = false;
+    if(allocated)
+    {
+        fill(large, (uint32_t) bytes, 0x3c);
+        fill(small, 64, 0xc3);
+        usable = is_filled(large, (uint32_t) bytes, 0x3c) && is_filled(small, 64, 0xc3);
+    }
+
+    SAFE_VIRTUAL_DEALLOCATE(large);
+    SAFE_VIRTUAL_DEALLOCATE(small);
+    set_huge_page_mode(HUGE_PAGE_MODE_OFF, 0);
+
+    return allocated
+        && usable
+        && mode < HUGE_PAGE_MODE_COUNT
+        && get_huge_page_mode() == HUGE_PAGE_MODE_OFF;
+}
+
+static bool test_memory_accounting(Test* test)
+{
+    MemoryTag tag = MEMORY_TAG_EDITOR;
+    MemoryTagInfo before = get_memory_tag_info(tag);
+
+    Heap heap = {0};
+    heap_create(&heap, (uint32_t) capobytes(1));
+    heap_set_tag(&heap, tag);
+    pool_set_tag(&test->pool, tag);
+
+    // Free every other allocation, so the free space is split up.
+    void* allocations[8];
+    for(int i = 0; i < 8; i += 1)
+    {
+        allocations[i] = heap_allocate(&heap, 100);
+    }
+    Thing* thing = POOL_ALLOCATE(&test->pool, Thing);
+    for(int i = 0; i < 8; i += 2)
+    {
+        heap_deallocate(&heap, allocations[i]);
+    }
+    allocations[1] = heap_reallocate(&heap, allocations[1], 20);
+
+    MemoryTagInfo during = get_memory_tag_info(tag);
+
+    pool_deallocate(&test->pool, thing);
+    for(int i = 1; i < 8; i += 2)
+    {
+        heap_deallocate(&heap, allocations[i]);
+    }
+
+    MemoryTagInfo freed = get_memory_tag_info(tag);
+
+    heap_destroy(&heap);
+    pool_set_tag(&test->pool, MEMORY_TAG_UNTAGGED);
+
+    MemoryTagInfo after = get_memory_tag_info(tag);
+
+    return during.live_allocations == before.live_allocations + 5
+        && during.live_bytes > before.live_bytes + sizeof(Thing) + 3 * 100
+        && during.peak_bytes >= before.live_bytes + sizeof(Thing) + 8 * 100
+        && during.total_allocations == before.total_allocations + 9
+        && during.fragmentation > 0.0f
+        && freed.live_allocations == before.live_allocations
+        && freed.live_bytes == before.live_bytes
+        && freed.fragmentation == 0.0f
+        && after.reserved_bytes == before.reserved_bytes
+        && after.live_bytes == before.live_bytes;
+}
+
+#define THINGS_COUNT 1000
+
+// A run comes from the objects that have never been allocated, so it only
+// fits while the pool has that many left before it would need to grow.
+static bool test_pool_allocate_run(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    Thing* run = (Thing*) pool_allocate_run(pool, 40);
+    Thing* single = POOL_ALLOCATE(pool, Thing);
+    Thing* too_long = (Thing*) pool_allocate_run(pool, 24);
+    Thing* rest = (Thing*) pool_allocate_run(pool, 23);
+    if(!run || !single || too_long || !rest)
+    {
+        return false;
+    }
+
+    int mismatches = 0;
+    for(uint32_t i = 0; i < 40; i += 1)
+    {
+        mismatches += pool_get_index(pool, &run[i]) != i;
+        run[i].value = i;
+    }
+    mismatches += pool_get_index(pool, single) != 40;
+    single->value = 40;
+    for(uint32_t i = 0; i < 23; i += 1)
+    {
+        mismatches += pool_get_index(pool, &rest[i]) != 41 + i;
+        rest[i].value = 41 + i;
+    }
+
+    uint64_t sum = 0;
+    FOR_EACH_IN_POOL(Thing, thing, *pool)
+    {
+        sum += thing->value;
+    }
+
+    Thing* grown = POOL_ALLOCATE(pool, Thing);
+
+    return mismatches == 0
+        && sum == (63 * 64) / 2
+        && pool->used_count == 65
+        && grown && pool_get_index(pool, grown) == 64;
+}
+
+static bool test_pool_grow(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    Thing* things[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        things[i] = POOL_ALLOCATE(pool, Thing);
+        if(!things[i])
+        {
+            return false;
+        }
+        things[i]->value = i;
+    }
+
+    // Objects allocated before the pool grew should still hold their values.
+    int mismatches = 0;
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        mismatches += things[i]->value != (uint64_t) i;
+    }
+
+    return mismatches == 0
+        && pool->chunks_count > 1
+        && pool->object_count >= THINGS_COUNT;
+}
+
+// Indices should count up through every chunk, and lead back to the same
+// objects they were taken from.
+static bool test_pool_index(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    Thing* things[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        things[i] = POOL_ALLOCATE(pool, Thing);
+        if(!things[i])
+        {
+            return false;
+        }
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        uint32_t index = pool_get_index(pool, things[i]);
+        mismatches += index >= pool->object_count
+            || pool_get_object(pool, index) != things[i];
+    }
+
+    // The free list hands out new objects in address order, so the indices
+    // come out in order too.
+    for(int i = 1; i < THINGS_COUNT; i += 1)
+    {
+        mismatches += pool_get_index(pool, things[i]) != pool_get_index(pool, things[i - 1]) + 1;
+    }
+
+    return mismatches == 0 && pool->chunks_count > 1;
+}
+
+static bool test_pool_iterate(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        Thing* thing = POOL_ALLOCATE(pool, Thing);
+        thing->value = i;
+    }
+
+    int found = 0;
+    uint64_t sum = 0;
+    FOR_EACH_IN_POOL(Thing, thing, *pool)
+    {
+        found += 1;
+        sum += thing->value;
+    }
+
+    uint64_t expected_sum = (THINGS_COUNT * (THINGS_COUNT - 1)) / 2;
+    return found == THINGS_COUNT && sum == expected_sum;
+}
+
+static bool test_pool_iterate_range(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    Thing* things[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        things[i] = POOL_ALLOCATE(pool, Thing);
+        things[i]->value = i;
+    }
+    for(int i = 0; i < THINGS_COUNT; i += 7)
+    {
+        pool_deallocate(pool, things[i]);
+    }
+
+    // Split the pool into ranges of a few different sizes, some crossing from
+    // one chunk into the next, and check every object is visited exactly once.
+    int mismatches = 0;
+    const uint32_t range_sizes[3] = {64, 192, 512};
+    for(int size_index = 0; size_index < 3; size_index += 1)
+    {
+        int found = 0;
+        uint64_t sum = 0;
+        for(uint32_t start = 0; start < pool->object_count; start += range_sizes[size_index])
+        {
+            uint32_t end = start + range_sizes[size_index];
+            FOR_EACH_IN_POOL_RANGE(Thing, thing, *pool, start, end)
+            {
+                uint32_t index = pool_get_index(pool, thing);
+                mismatches += index < start || index >= end;
+                found += 1;
+                sum += thing->value;
+            }
+        }
+
+        int expected_found = 0;
+        uint64_t expected_sum = 0;
+        for(int i = 0; i < THINGS_COUNT; i += 1)
+        {
+            if(i % 7 != 0)
+            {
+                expected_found += 1;
+                expected_sum += i;
+            }
+        }
+        mismatches += found != expected_found || sum != expected_sum;
+    }
+
+    // A range starting past the end of the pool is empty.
+    int past_end = 0;
+    FOR_EACH_IN_POOL_RANGE(Thing, thing, *pool, 64 * pool->object_count, UINT32_MAX)
+    {
+        past_end += 1;
+    }
+
+    return mismatches == 0 && past_end == 0;
+}
+
+static bool test_pool_iterate_sparse(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    Thing* things[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        things[i] = POOL_ALLOCATE(pool, Thing);
+        things[i]->value = i;
+    }
+
+    // Leave whole runs of 64 or more free objects, as well as lone objects at
+    // either end of a run.
+    int kept = 0;
+    uint64_t expected_sum = 0;
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        bool keep = (i % 150) == 0 || (i % 150) == 63 || (i % 150) == 64;
+        if(keep)
+        {
+            kept += 1;
+            expected_sum += i;
+        }
+        else
+        {
+            pool_deallocate(pool, things[i]);
+        }
+    }
+
+    int found = 0;
+    uint64_t sum = 0;
+    FOR_EACH_IN_POOL(Thing, thing, *pool)
+    {
+        found += 1;
+        sum += thing->value;
+    }
+
+    return found == kept && sum == expected_sum;
+}
+
+static bool test_pool_reuse(Test* test)
+{
+    Pool* pool = &test->pool;
+
+    Thing* things[THINGS_COUNT];
+    for(int i = 0; i < THINGS_COUNT; i += 1)
+    {
+        things[i] = POOL_ALLOCATE(pool, Thing);
+    }
+    uint32_t cap = pool->object_count;
+
+    for(int i = 0; i < THINGS_COUNT; i += 2)
+    {
+        pool_deallocate(pool, things[i]);
+    }
+    for(int i = 0; i < THINGS_COUNT; i += 2)
+    {
+        things[i] = POOL_ALLOCATE(pool, Thing);
+    }
+
+    int found = 0;
+    FOR_EACH_IN_POOL(Thing, thing, *pool)
+    {
+        found += 1;
+    }
+
+    return found == THINGS_COUNT && pool->object_count == cap;
+}
+
+static bool test_stack_grow(Test* test)
+{
+    Stack stack = {0};
+    if(!stack_create_growable(&stack, capobytes(64)))
+    {
+        return false;
+    }
+    uint64_t initial_committed = stack.committed;
+
+    uint8_t* small = STACK_ALLOCATE(&stack, uint8_t, 16);
+    uint8_t* big = STACK_ALLOCATE(&stack, uint8_t, 3 * initial_committed);
+    bool allocated = small && big;
+    if(allocated)
+    {
+        big[3 * initial_committed - 1] = 1;
+    }
+
+    // Growing the top allocation should keep its contents.
+    big = STACK_REALLOCATE(&stack, big, uint8_t, 5 * initial_committed);
+    bool kept = big && big[3 * initial_committed - 1] == 1;
+
+    void* too_big = stack_allocate(&stack, (uint32_t) capobytes(64));
+
+    STACK_DEALLOCATE(&stack, big);
+    STACK_DEALLOCATE(&stack, small);
+    bool emptied = stack.top == 0;
+    uint64_t committed = stack.committed;
+
+    stack_destroy(&stack);
+
+    return allocated
+        && kept
+        && !too_big
+        && emptied
+        && committed > initial_committed;
+}
+
+#define THREAD_HEAP_ALLOCATION_COUNT 10
+
+static void allocate_in_thread_heap(void* argument)
+{
+    Heap* heap = get_thread_heap();
+    heap_set_tag(heap, MEMORY_TAG_EDITOR);
+    for(int i = 0; i < THREAD_HEAP_ALLOCATION_COUNT; i += 1)
+    {
+        heap_allocate(heap, 100);
+    }
+    destroy_thread_heap();
+}
+
+static bool test_thread_heap_accounting(Test* test)
+{
+    MemoryTag tag = MEMORY_TAG_EDITOR;
+    MemoryTagInfo before = get_memory_tag_info(tag);
+
+    // A thread heap's counts are its own, but should still show up in its tag.
+    Heap* heap = get_thread_heap();
+    heap_set_tag(heap, tag);
+    void* allocations[THREAD_HEAP_ALLOCATION_COUNT];
+    for(int i = 0; i < THREAD_HEAP_ALLOCATION_COUNT; i += 1)
+    {
+        allocations[i] = heap_allocate(heap, 100);
+    }
+    allocations[0] = heap_reallocate(heap, allocations[0], 1000);
+
+    MemoryTagInfo during = get_memory_tag_info(tag);
+
+    for(int i = 0; i < THREAD_HEAP_ALLOCATION_COUNT; i += 1)
+    {
+        heap_deallocate(heap, allocations[i]);
+    }
+
+    MemoryTagInfo freed = get_memory_tag_info(tag);
+
+    destroy_thread_heap();
+
+    // Another thread's heap is only gone once that thread's done with it, and
+    // the allocations it made should still be counted in the total.
+    Thread thread;
+    thread_create(&thread, allocate_in_thread_heap, NULL);
+    thread_join(&thread);
+
+    MemoryTagInfo after = get_memory_tag_info(tag);
+
+    uint64_t allocated = (uint64_t) (THREAD_HEAP_ALLOCATION_COUNT * 100 + 900);
+    return during.live_allocations == before.live_allocations + THREAD_HEAP_ALLOCATION_COUNT
+        && during.live_bytes >= before.live_bytes + allocated
+        && during.peak_bytes >= during.live_bytes
+        && during.total_allocations >= before.total_allocations + THREAD_HEAP_ALLOCATION_COUNT + 1
+        && freed.live_allocations == before.live_allocations
+        && freed.live_bytes == before.live_bytes
+        && freed.total_allocations == during.total_allocations
+        && after.live_bytes == before.live_bytes
+        && after.reserved_bytes == before.reserved_bytes
+        && after.total_allocations == freed.total_allocations + THREAD_HEAP_ALLOCATION_COUNT;
+}
+
+static bool run_test(Test* test)
+{
+    switch(test->type)
+    {
+        default:
+        case TEST_TYPE_ALLOCATION_TRACE:           return test_allocation_trace(test);
+        case TEST_TYPE_ALLOCATION_TRACE_TRUNCATED: return test_allocation_trace_truncated(test);
+        case TEST_TYPE_ARENA_ALLOCATE:             return test_arena_allocate(test);
+        case TEST_TYPE_ARENA_RESET_TO_MARK:        return test_arena_reset_to_mark(test);
+        case TEST_TYPE_COPY_MEMORY:                return test_copy_memory(test);
+        case TEST_TYPE_COPY_MEMORY_OVERLAPPING:    return test_copy_memory_overlapping(test);
+        case TEST_TYPE_ZERO_MEMORY:                return test_zero_memory(test);
+        case TEST_TYPE_HEAP_ALLOCATE:              return test_heap_allocate(test);
+        case TEST_TYPE_HEAP_GROW:                  return test_heap_grow(test);
+        case TEST_TYPE_HEAP_GROW_IN_PLACE:         return test_heap_grow_in_place(test);
+        case TEST_TYPE_HEAP_REALLOCATE:            return test_heap_reallocate(test);
+        case TEST_TYPE_HEAP_REMOTE_FREE:           return test_heap_remote_free(test);
+        case TEST_TYPE_HUGE_PAGE_ALLOCATE:         return test_huge_page_allocate(test);
+        case TEST_TYPE_MEMORY_ACCOUNTING:          return test_memory_accounting(test);
+        case TEST_TYPE_POOL_ALLOCATE_RUN:          return test_pool_allocate_run(test);
+        case TEST_TYPE_POOL_GROW:                  return test_pool_grow(test);
+        case TEST_TYPE_POOL_INDEX:                 return test_pool_index(test);
+        case TEST_TYPE_POOL_ITERATE:               return test_pool_iterate(test);
+        case TEST_TYPE_POOL_ITERATE_RANGE:         return test_pool_iterate_range(test);
+        case TEST_TYPE_POOL_ITERATE_SPARSE:        return test_pool_iterate_sparse(test);
+        case TEST_TYPE_POOL_REUSE:                 return test_pool_reuse(test);
+        case TEST_TYPE_STACK_GROW:                 return test_stack_grow(test);
+        case TEST_TYPE_THREAD_HEAP_ACCOUNTING:     return test_thread_heap_accounting(test);
+    }
+}
+
+static bool run_tests()
+{
+    const TestType tests[TEST_TYPE_COUNT] =
+    {
+        TEST_TYPE_ALLOCATION_TRACE,
+        TEST_TYPE_ALLOCATION_TRACE_TRUNCATED,
+        TEST_TYPE_ARENA_ALLOCATE,
+        TEST_TYPE_ARENA_RESET_TO_MARK,
+        TEST_TYPE_COPY_MEMORY,
+        TEST_TYPE_COPY_MEMORY_OVERLAPPING,
+        TEST_TYPE_ZERO_MEMORY,
+        TEST_TYPE_HEAP_ALLOCATE,
+        TEST_TYPE_HEAP_GROW,
+        TEST_TYPE_HEAP_GROW_IN_PLACE,
+        TEST_TYPE_HEAP_REALLOCATE,
+        TEST_TYPE_HEAP_REMOTE_FREE,
+        TEST_TYPE_HUGE_PAGE_ALLOCATE,
+        TEST_TYPE_MEMORY_ACCOUNTING,
+        TEST_TYPE_POOL_ALLOCATE_RUN,
+        TEST_TYPE_POOL_GROW,
+        TEST_TYPE_POOL_INDEX,
+        TEST_TYPE_POOL_ITERATE,
+        TEST_TYPE_POOL_ITERATE_RANGE,
+        TEST_TYPE_POOL_ITERATE_SPARSE,
+        TEST_TYPE_POOL_REUSE,
+        TEST_TYPE_STACK_GROW,
+        TEST_TYPE_THREAD_HEAP_ACCOUNTING,
+    };
+    bool which_failed[TEST_TYPE_COUNT] = {0};
+
+    int failed = 0;
+
+    for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+    {
+        Test test = {0};
+        test.type = tests[test_index];
+        arena_create(&test.arena, (uint32_t) capobytes(1));
+        heap_create(&test.heap, (uint32_t) capobytes(16));
+        pool_create(&test.pool, sizeof(Thing), 64);
+
+        bool fail = !run_test(&test);
+        failed += fail;
+        which_failed[test_index] = fail;
+
+        pool_destroy(&test.pool);
+        heap_destroy(&test.heap);
+        arena_destroy(&test.arena);
+    }
+
+    FILE* file = stdout;
+    if(failed > 0)
+    {
+        fprintf(file, "test failed: %d\n", failed);
+        int printed = 0;
+        for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+        {
+            const char* separator = "";
+            const char* also = "";
+            if(failed > 2 && printed > 0)
+            {
+                separator = ", ";
+            }
+            if(failed > 1 && printed == failed - 1)
+            {
+                if(failed == 2)
+                {
+                    also = " and ";
+                }
+                else
+                {
+                    also = "and ";
+                }
+            }
+            if(which_failed[test_index])
+            {
+                const char* test = describe_test(tests[test_index]);
+                fprintf(file, "%s%s%s", separator, also, test);
+                printed += 1;
+            }
+        }
+        fprintf(file, "\n\n");
+    }
+    else
+    {
+        fprintf(file, "All tests succeeded!\n\n");
+    }
+
+    return failed == 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool success = run_tests();
+    return !success;
+}
@@ -0,0 +1,486 @@
+#include "../../Source/filesystem.h"
+#include "../../Source/map.h"
+#include "../../Source/memory.h"
+#include "../Benchmark/benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Any heap can be compared by filling out one of these. Where something can't
+// be measured, the procedure is left NULL.
+typedef struct HeapImplementation
+{
+    const char* name;
+    void* (*create)();
+    void (*destroy)(void* heap);
+    void* (*allocate)(void* heap, uint32_t bytes);
+    void* (*reallocate)(void* heap, void* memory, uint32_t bytes);
+    void (*deallocate)(void* heap, void* memory);
+    uint64_t (*get_footprint)(void* heap);
+    uint64_t (*get_free_bytes)(void* heap);
+    uint64_t (*get_largest_free_bytes)(void* heap);
+} HeapImplementation;
+
+static void* create_tlsf_heap()
+{
+    Heap* heap = (Heap*) virtual_allocate(sizeof(Heap));
+    heap_create_growable(heap, uptibytes(64));
+    return heap;
+}
+
+static void destroy_tlsf_heap(void* heap)
+{
+    heap_destroy((Heap*) heap);
+    virtual_deallocate(heap);
+}
+
+static void* allocate_tlsf(void* heap, uint32_t bytes)
+{
+    return heap_allocate((Heap*) heap, bytes);
+}
+
+static void* reallocate_tlsf(void* heap, void* memory, uint32_t bytes)
+{
+    return heap_reallocate((Heap*) heap, memory, bytes);
+}
+
+static void deallocate_tlsf(void* heap, void* memory)
+{
+    heap_deallocate((Heap*) heap, memory);
+}
+
+static uint64_t get_tlsf_footprint(void* heap)
+{
+    return sizeof(HeapBlock) * ((Heap*) heap)->total_blocks;
+}
+
+static uint64_t get_tlsf_free_bytes(void* heap)
+{
+    return sizeof(HeapBlock) * ((Heap*) heap)->free_blocks;
+}
+
+static uint64_t get_tlsf_largest_free_bytes(void* heap)
+{
+    return heap_get_largest_free_size((Heap*) heap);
+}
+
+// The C library's allocator, for a point of reference.
+static void* create_malloc_heap()
+{
+    return NULL;
+}
+
+static void destroy_malloc_heap(void* heap)
+{
+    (void) heap;
+}
+
+static void* allocate_malloc(void* heap, uint32_t bytes)
+{
+    (void) heap;
+    return calloc(1, bytes);
+}
+
+static void* reallocate_malloc(void* heap, void* memory, uint32_t bytes)
+{
+    (void) heap;
+    return realloc(memory, bytes);
+}
+
+static void deallocate_malloc(void* heap, void* memory)
+{
+    (void) heap;
+    free(memory);
+}
+
+static const HeapImplementation heap_implementations[] =
+{
+    {
+        .name = "Heap (TLSF)",
+        .create = create_tlsf_heap,
+        .destroy = destroy_tlsf_heap,
+        .allocate = allocate_tlsf,
+        .reallocate = reallocate_tlsf,
+        .deallocate = deallocate_tlsf,
+        .get_footprint = get_tlsf_footprint,
+        .get_free_bytes = get_tlsf_free_bytes,
+        .get_largest_free_bytes = get_tlsf_largest_free_bytes,
+    },
+    {
+        .name = "C library malloc",
+        .create = create_malloc_heap,
+        .destroy = destroy_malloc_heap,
+        .allocate = allocate_malloc,
+        .reallocate = reallocate_malloc,
+        .deallocate = deallocate_malloc,
+    },
+};
+
+// Before replaying, each address is swapped for a dense id, so that the timed
+// pass only has to index an array. Events on memory that was allocated before
+// recording started can't be replayed, and are dropped.
+typedef struct ReplayEvent
+{
+    uint32_t id;
+    uint32_t bytes;
+    uint8_t type;
+    uint8_t allocator;
+} ReplayEvent;
+
+typedef struct Replay
+{
+    ReplayEvent* events;
+    uint32_t* sizes;
+    uint8_t* allocators;
+    void** memory;
+    uint64_t events_count;
+    uint32_t ids_count;
+    uint64_t dropped;
+} Replay;
+
+static bool is_heap_event(uint8_t type)
+{
+    return type == ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE
+        || type == ALLOCATION_EVENT_TYPE_HEAP_REALLOCATE
+        || type == ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE;
+}
+
+static bool is_allocate_event(uint8_t type)
+{
+    return type == ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE
+        || type == ALLOCATION_EVENT_TYPE_POOL_ALLOCATE
+        || type == ALLOCATION_EVENT_TYPE_STACK_ALLOCATE;
+}
+
+static bool is_deallocate_event(uint8_t type)
+{
+    return type == ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE
+        || type == ALLOCATION_EVENT_TYPE_POOL_DEALLOCATE
+        || type == ALLOCATION_EVENT_TYPE_STACK_DEALLOCATE;
+}
+
+static void prepare_replay(Replay* replay, AllocationTrace* trace, Heap* heap)
+{
+    uint64_t count = trace->header->events_count;
+    replay->events = (ReplayEvent*) virtual_allocate(sizeof(ReplayEvent) * count);
+    replay->events_count = 0;
+    replay->ids_count = 0;
+    replay->dropped = 0;
+
+    Map ids;
+    map_create(&ids, 1024, heap);
+
+    for(uint64_t i = 0; i < count; i += 1)
+    {
+        AllocationEvent* event = &trace->events[i];
+        uint32_t id;
+        if(is_allocate_event(event->type))
+        {
+            id = replay->ids_count;
+            replay->ids_count += 1;
+            map_add_uint64_from_uint64(&ids, event->result, id, heap);
+        }
+        else
+        {
+            MaybeUint64 found = map_get_uint64_from_uint64(&ids, event->address);
+            if(!found.valid)
+            {
+                replay->dropped += 1;
+                continue;
+            }
+            id = (uint32_t) found.value;
+            if(is_deallocate_event(event->type))
+            {
+                map_remove_uint64(&ids, event->address);
+            }
+        }
+
+        ReplayEvent* added = &replay->events[replay->events_count];
+        added->id = id;
+        added->bytes = event->bytes;
+        added->type = event->type;
+        added->allocator = event->allocator;
+        replay->events_count += 1;
+    }
+
+    map_destroy(&ids, heap);
+
+    replay->sizes = (uint32_t*) virtual_allocate(sizeof(uint32_t) * (replay->ids_count + 1));
+    replay->allocators = (uint8_t*) virtual_allocate(replay->ids_count + 1);
+    replay->memory = (void**) virtual_allocate(sizeof(void*) * (replay->ids_count + 1));
+}
+
+static void destroy_replay(Replay* replay)
+{
+    virtual_deallocate(replay->events);
+    virtual_deallocate(replay->sizes);
+    virtual_deallocate(replay->allocators);
+    virtual_deallocate(replay->memory);
+}
+
+static void replay_heaps(Replay* replay, const HeapImplementation* implementation)
+{
+    void* heaps[ALLOCATION_TRACE_ALLOCATOR_CAP] = {0};
+    bool created[ALLOCATION_TRACE_ALLOCATOR_CAP] = {0};
+    uint64_t footprints[ALLOCATION_TRACE_ALLOCATOR_CAP] = {0};
+    zero_memory(replay->memory, sizeof(void*) * (replay->ids_count + 1));
+
+    uint64_t live_bytes = 0;
+    uint64_t peak_live_bytes = 0;
+    uint64_t footprint = 0;
+    uint64_t peak_footprint = 0;
+    uint64_t events_count = 0;
+
+    Timer timer;
+    timer_start(&timer);
+
+    for(uint64_t i = 0; i < replay->events_count; i += 1)
+    {
+        ReplayEvent* event = &replay->events[i];
+        if(!is_heap_event(event->type))
+        {
+            continue;
+        }
+        events_count += 1;
+
+        int index = event->allocator;
+        if(!created[index])
+        {
+            heaps[index] = implementation->create();
+            created[index] = true;
+        }
+        void* heap = heaps[index];
+
+        switch(event->type)
+        {
+            case ALLOCATION_EVENT_TYPE_HEAP_ALLOCATE:
+            {
+                replay->memory[event->id] = implementation->allocate(heap, event->bytes);
+                replay->sizes[event->id] = event->bytes;
+                replay->allocators[event->id] = event->allocator;
+                live_bytes += event->bytes;
+                break;
+            }
+            case ALLOCATION_EVENT_TYPE_HEAP_REALLOCATE:
+            {
+                replay->memory[event->id] = implementation->reallocate(heap, replay->memory[event->id], event->bytes);
+                live_bytes = live_bytes - replay->sizes[event->id] + event->bytes;
+                replay->sizes[event->id] = event->bytes;
+                break;
+            }
+            case ALLOCATION_EVENT_TYPE_HEAP_DEALLOCATE:
+            {
+                implementation->deallocate(heap, replay->memory[event->id]);
+                replay->memory[event->id] = NULL;
+                live_bytes -= replay->sizes[event->id];
+                break;
+            }
+        }
+
+        if(live_bytes > peak_live_bytes)
+        {
+            peak_live_bytes = live_bytes;
+        }
+
+        // Only the heap that changed is measured, so keeping a running total
+        // costs the same no matter how many heaps there are.
+        if(implementation->get_footprint)
+        {
+            uint64_t heap_footprint = implementation->get_footprint(heap);
+            footprint = footprint - footprints[index] + heap_footprint;
+            footprints[index] = heap_footprint;
+            if(footprint > peak_footprint)
+            {
+                peak_footprint = footprint;
+            }
+        }
+    }
+
+    double milliseconds = timer_milliseconds(&timer);
+
+    // Fragmentation is measured once the replay ends, over whatever memory the
+    // session still had in use.
+    uint64_t free_bytes = 0;
+    uint64_t largest_free_bytes = 0;
+    if(implementation->get_free_bytes)
+    {
+        for(int i = 0; i < ALLOCATION_TRACE_ALLOCATOR_CAP; i += 1)
+        {
+            if(created[i])
+            {
+                free_bytes += implementation->get_free_bytes(heaps[i]);
+                uint64_t largest = implementation->get_largest_free_bytes(heaps[i]);
+                if(largest > largest_free_bytes)
+                {
+                    largest_free_bytes = largest;
+                }
+            }
+        }
+    }
+
+    // Only heap allocations are ever set in memory, so nothing that came from
+    // a stack or pool is freed here.
+    for(uint32_t id = 0; id < replay->ids_count; id += 1)
+    {
+        if(replay->memory[id])
+        {
+            implementation->deallocate(heaps[replay->allocators[id]], replay->memory[id]);
+        }
+    }
+    for(int i = 0; i < ALLOCATION_TRACE_ALLOCATOR_CAP; i += 1)
+    {
+        if(created[i])
+        {
+            implementation->destroy(heaps[i]);
+        }
+    }
+
+    printf("%-18s %10llu events  %10.3f ms  peak live %9.2f MB", implementation->name, (unsigned long long) events_count, milliseconds, peak_live_bytes / 1.0e6);
+    if(implementation->get_footprint)
+    {
+        printf("  peak footprint %9.2f MB", peak_footprint / 1.0e6);
+    }
+    if(free_bytes)
+    {
+        float fragmentation = 1.0f - ((float) largest_free_bytes / (float) free_bytes);
+        printf("  fragmentation %5.1f%%", 100.0f * fragmentation);
+    }
+    printf("\n");
+}
+
+// Stacks and pools have no alternative to compare against, but it's still
+// useful to know how long their share of the session took.
+static void replay_stacks_and_pools(Replay* replay)
+{
+    Stack* stacks[ALLOCATION_TRACE_ALLOCATOR_CAP] = {0};
+    Pool* pools[ALLOCATION_TRACE_ALLOCATOR_CAP] = {0};
+    zero_memory(replay->memory, sizeof(void*) * (replay->ids_count + 1));
+
+    uint64_t stack_events = 0;
+    uint64_t pool_events = 0;
+
+    Timer timer;
+    timer_start(&timer);
+
+    for(uint64_t i = 0; i < replay->events_count; i += 1)
+    {
+        ReplayEvent* event = &replay->events[i];
+        int index = event->allocator;
+        switch(event->type)
+        {
+            case ALLOCATION_EVENT_TYPE_POOL_ALLOCATE:
+            {
+                if(!pools[index])
+                {
+                    pools[index] = (Pool*) virtual_allocate(sizeof(Pool));
+                    pool_create(pools[index], event->bytes, 1024);
+                }
+                replay->memory[event->id] = pool_allocate(pools[index]);
+                pool_events += 1;
+                break;
+            }
+            case ALLOCATION_EVENT_TYPE_POOL_DEALLOCATE:
+            {
+                pool_deallocate(pools[index], replay->memory[event->id]);
+                pool_events += 1;
+                break;
+            }
+            case ALLOCATION_EVENT_TYPE_STACK_ALLOCATE:
+            {
+                if(!stacks[index])
+                {
+                    stacks[index] = (Stack*) virtual_allocate(sizeof(Stack));
+                    stack_create_growable(stacks[index], uptibytes(64));
+                }
+                replay->memory[event->id] = stack_allocate(stacks[index], event->bytes);
+                stack_events += 1;
+                break;
+            }
+            case ALLOCATION_EVENT_TYPE_STACK_REALLOCATE:
+            {
+                replay->memory[event->id] = stack_reallocate(stacks[index], replay->memory[event->id], event->bytes);
+                stack_events += 1;
+                break;
+            }
+            case ALLOCATION_EVENT_TYPE_STACK_DEALLOCATE:
+            {
+                stack_deallocate(stacks[index], replay->memory[event->id]);
+                stack_events += 1;
+                break;
+            }
+        }
+    }
+
+    double milliseconds = timer_milliseconds(&timer);
+
+    for(int i = 0; i < ALLOCATION_TRACE_ALLOCATOR_CAP; i += 1)
+    {
+        if(stacks[i])
+        {
+            stack_destroy(stacks[i]);
+            virtual_deallocate(stacks[i]);
+        }
+        if(pools[i])
+        {
+            pool_destroy(pools[i]);
+            virtual_deallocate(pools[i]);
+        }
+    }
+
+    printf("%-18s %10llu events  %10.3f ms\n", "Stacks and pools", (unsigned long long) (stack_events + pool_events), milliseconds);
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 2)
+    {
+        fprintf(stderr, "Usage: ReplayAllocationTrace <trace file>\n");
+        return 1;
+    }
+
+    Stack stack = {0};
+    stack_create_growable(&stack, uptibytes(64));
+
+    WholeFile file = load_whole_file(argv[1], &stack);
+    AllocationTrace trace;
+    trace.header = (AllocationTraceHeader*) file.contents;
+    trace.events = (AllocationEvent*) (trace.header + 1);
+    trace.bytes = file.bytes;
+
+    if(!file.loaded
+        || file.bytes < sizeof(AllocationTraceHeader)
+        || trace.header->magic != ALLOCATION_TRACE_MAGIC
+        || trace.header->version != ALLOCATION_TRACE_VERSION
+        || trace.header->events_count > (file.bytes - sizeof(AllocationTraceHeader)) / sizeof(AllocationEvent))
+    {
+        fprintf(stderr, "%s isn't an allocation trace this tool can read.\n", argv[1]);
+        stack_destroy(&stack);
+        return 1;
+    }
+
+    Heap heap = {0};
+    heap_create_growable(&heap, uptibytes(64));
+
+    Replay replay;
+    prepare_replay(&replay, &trace, &heap);
+
+    if(trace.header->truncated)
+    {
+        fprintf(stderr, "Warning: %s was truncated, so only the events up to where recording had to stop are replayed.\n", argv[1]);
+    }
+
+    printf("Replaying %llu events from %s (%llu dropped from before recording began)\n", (unsigned long long) replay.events_count, argv[1], (unsigned long long) replay.dropped);
+
+    int implementations_count = sizeof(heap_implementations) / sizeof(*heap_implementations);
+    for(int i = 0; i < implementations_count; i += 1)
+    {
+        replay_heaps(&replay, &heap_implementations[i]);
+    }
+    replay_stacks_and_pools(&replay);
+
+    destroy_replay(&replay);
+    heap_destroy(&heap);
+    stack_destroy(&stack);
+
+    return 0;
+}
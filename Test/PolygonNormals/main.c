@@ -0,0 +1,277 @@
+#include "../../Source/float_utilities.h"
+#include "../../Source/polygon_normals.h"
+#include "../../Source/random.h"
+
+#include <math.h>
+#include <stdio.h>
+
+typedef enum TestType
+{
+    TEST_TYPE_NEWELL_SQUARE,
+    TEST_TYPE_NEWELL_BATCH,
+    TEST_TYPE_AREA_WEIGHT,
+    TEST_TYPE_ANGLE_WEIGHT,
+    TEST_TYPE_CUBE_CORNER,
+    TEST_TYPE_NORMALISE,
+    TEST_TYPE_CORNER_ANGLE,
+    TEST_TYPE_COUNT,
+} TestType;
+
+static const char* describe_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_NEWELL_SQUARE: return "Newell Square";
+        case TEST_TYPE_NEWELL_BATCH:  return "Newell Batch";
+        case TEST_TYPE_AREA_WEIGHT:   return "Area Weight";
+        case TEST_TYPE_ANGLE_WEIGHT:  return "Angle Weight";
+        case TEST_TYPE_CUBE_CORNER:   return "Cube Corner";
+        case TEST_TYPE_NORMALISE:     return "Normalise";
+        case TEST_TYPE_CORNER_ANGLE:  return "Corner Angle";
+    }
+}
+
+#define BATCH_POLYGONS_COUNT 1001
+#define BATCH_SIDES_CAP 8
+#define BATCH_POSITIONS_COUNT 512
+#define NORMALS_COUNT 37
+
+static bool close_to(Float3 a, Float3 b, float tolerance)
+{
+    return fabsf(a.x - b.x) <= tolerance
+        && fabsf(a.y - b.y) <= tolerance
+        && fabsf(a.z - b.z) <= tolerance;
+}
+
+static float random_float(RandomGenerator* generator)
+{
+    return (float) (random_generate(generator) >> 40) / 16777216.0f;
+}
+
+static bool test_newell_square()
+{
+    // The square's area is 4, so its Newell normal is twice that long.
+    Float3 positions[4] =
+    {
+        {{0.0f, 0.0f, 1.0f}},
+        {{2.0f, 0.0f, 1.0f}},
+        {{2.0f, 2.0f, 1.0f}},
+        {{0.0f, 2.0f, 1.0f}},
+    };
+    uint32_t indices[7] = {0, 1, 2, 3, 0, 3, 2};
+    int offsets[3] = {0, 4, 7};
+    Float3 normals[2];
+    compute_newell_normals(normals, positions, indices, offsets, 2);
+
+    Float3 square = {{0.0f, 0.0f, 8.0f}};
+    Float3 triangle = {{0.0f, 0.0f, -4.0f}};
+    return close_to(normals[0], square, 1e-6f)
+        && close_to(normals[1], triangle, 1e-6f);
+}
+
+// Polygons with a mix of side counts don't fill the lanes evenly, and the
+// count leaves some over at the end, for the plain loop to finish.
+static bool test_newell_batch()
+{
+    RandomGenerator generator;
+    random_seed(&generator, 2718);
+
+    static Float3 positions[BATCH_POSITIONS_COUNT];
+    for(int i = 0; i < BATCH_POSITIONS_COUNT; i += 1)
+    {
+        positions[i] = (Float3){{random_float(&generator), random_float(&generator), random_float(&generator)}};
+    }
+
+    static uint32_t indices[BATCH_SIDES_CAP * BATCH_POLYGONS_COUNT];
+    static int offsets[BATCH_POLYGONS_COUNT + 1];
+    int index = 0;
+    for(int i = 0; i < BATCH_POLYGONS_COUNT; i += 1)
+    {
+        offsets[i] = index;
+        int sides = 3 + (int) (random_generate(&generator) % (BATCH_SIDES_CAP - 2));
+        for(int j = 0; j < sides; j += 1)
+        {
+            indices[index] = (uint32_t) (random_generate(&generator) % BATCH_POSITIONS_COUNT);
+            index += 1;
+        }
+    }
+    offsets[BATCH_POLYGONS_COUNT] = index;
+
+    static Float3 normals[BATCH_POLYGONS_COUNT];
+    compute_newell_normals(normals, positions, indices, offsets, BATCH_POLYGONS_COUNT);
+
+    int mismatches = 0;
+    for(int i = 0; i < BATCH_POLYGONS_COUNT; i += 1)
+    {
+        Float3 expected = float3_zero;
+        int start = offsets[i];
+        int end = offsets[i + 1];
+        for(int j = start; j < end; j += 1)
+        {
+            Float3 a = positions[indices[j]];
+            Float3 b = positions[indices[(j + 1 < end) ? j + 1 : start]];
+            expected.x += (a.y - b.y) * (a.z + b.z);
+            expected.y += (a.z - b.z) * (a.x + b.x);
+            expected.z += (a.x - b.x) * (a.y + b.y);
+        }
+        mismatches += !close_to(normals[i], expected, 1e-5f);
+    }
+
+    return mismatches == 0;
+}
+
+// A big square and a small one meet along the z axis at a right angle. Both
+// of their corners on the axis are right angles, so angle weighting splits
+// the difference, but area weighting leans towards the big one.
+static void add_folded_squares(Float3* vertex_normals, NormalWeight weight)
+{
+    Float3 positions[6] =
+    {
+        {{0.0f, 0.0f, 0.0f}},
+        {{0.0f, 0.0f, 1.0f}},
+        {{4.0f, 0.0f, 1.0f}},
+        {{4.0f, 0.0f, 0.0f}},
+        {{0.0f, 1.0f, 0.0f}},
+        {{0.0f, 1.0f, 1.0f}},
+    };
+    uint32_t indices[8] = {0, 1, 2, 3, 0, 4, 5, 1};
+    int offsets[3] = {0, 4, 8};
+    Float3 polygon_normals[2];
+    compute_newell_normals(polygon_normals, positions, indices, offsets, 2);
+
+    for(int i = 0; i < 6; i += 1)
+    {
+        vertex_normals[i] = float3_zero;
+    }
+    add_corner_normals(vertex_normals, polygon_normals, positions, indices, offsets, 2, weight);
+    normalise_normals(vertex_normals, 6);
+}
+
+static bool test_area_weight()
+{
+    Float3 vertex_normals[6];
+    add_folded_squares(vertex_normals, NORMAL_WEIGHT_AREA);
+
+    Float3 expected = float3_normalise((Float3){{1.0f, 4.0f, 0.0f}});
+    return close_to(vertex_normals[0], expected, 1e-6f)
+        && close_to(vertex_normals[1], expected, 1e-6f);
+}
+
+static bool test_angle_weight()
+{
+    Float3 vertex_normals[6];
+    add_folded_squares(vertex_normals, NORMAL_WEIGHT_ANGLE);
+
+    Float3 expected = float3_normalise((Float3){{1.0f, 1.0f, 0.0f}});
+    return close_to(vertex_normals[0], expected, 1e-6f)
+        && close_to(vertex_normals[1], expected, 1e-6f);
+}
+
+// Splitting one of the three faces at a cube's corner into two triangles
+// doubles its count at the corner. Angle weighting shouldn't notice.
+static bool test_cube_corner()
+{
+    Float3 positions[7] =
+    {
+        {{0.0f, 0.0f, 0.0f}},
+        {{1.0f, 0.0f, 0.0f}},
+        {{0.0f, 1.0f, 0.0f}},
+        {{0.0f, 0.0f, 1.0f}},
+        {{1.0f, 1.0f, 0.0f}},
+        {{0.0f, 1.0f, 1.0f}},
+        {{1.0f, 0.0f, 1.0f}},
+    };
+    uint32_t indices[14] = {0, 2, 4, 0, 4, 1, 0, 3, 5, 2, 0, 1, 6, 3};
+    int offsets[5] = {0, 3, 6, 10, 14};
+    Float3 polygon_normals[4];
+    compute_newell_normals(polygon_normals, positions, indices, offsets, 4);
+
+    Float3 vertex_normals[7] = {0};
+    add_corner_normals(vertex_normals, polygon_normals, positions, indices, offsets, 4, NORMAL_WEIGHT_ANGLE);
+    normalise_normals(vertex_normals, 7);
+
+    Float3 expected = float3_normalise((Float3){{-1.0f, -1.0f, -1.0f}});
+    return close_to(vertex_normals[0], expected, 1e-6f);
+}
+
+static bool test_normalise()
+{
+    RandomGenerator generator;
+    random_seed(&generator, 1414);
+
+    Float3 normals[NORMALS_COUNT];
+    Float3 expected[NORMALS_COUNT];
+    for(int i = 0; i < NORMALS_COUNT; i += 1)
+    {
+        if(i % 5 == 0)
+        {
+            normals[i] = float3_zero;
+            expected[i] = float3_zero;
+        }
+        else
+        {
+            normals[i] = (Float3){{random_float(&generator) - 0.5f, random_float(&generator), 100.0f * random_float(&generator)}};
+            expected[i] = float3_normalise(normals[i]);
+        }
+    }
+
+    normalise_normals(normals, NORMALS_COUNT);
+
+    int mismatches = 0;
+    for(int i = 0; i < NORMALS_COUNT; i += 1)
+    {
+        mismatches += !close_to(normals[i], expected[i], 1e-6f);
+    }
+
+    return mismatches == 0;
+}
+
+static bool test_corner_angle()
+{
+    Float3 corner = {{1.0f, 1.0f, 1.0f}};
+    Float3 x = {{2.0f, 1.0f, 1.0f}};
+    Float3 y = {{1.0f, 3.0f, 1.0f}};
+    Float3 back = {{-1.0f, 1.0f, 1.0f}};
+
+    return fabsf(get_corner_angle(x, corner, y) - pi_over_2) < 1e-6f
+        && fabsf(get_corner_angle(x, corner, back) - pi) < 1e-6f
+        && get_corner_angle(x, corner, x) == 0.0f
+        && get_corner_angle(corner, corner, y) == 0.0f;
+}
+
+static bool run_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_NEWELL_SQUARE: return test_newell_square();
+        case TEST_TYPE_NEWELL_BATCH:  return test_newell_batch();
+        case TEST_TYPE_AREA_WEIGHT:   return test_area_weight();
+        case TEST_TYPE_ANGLE_WEIGHT:  return test_angle_weight();
+        case TEST_TYPE_CUBE_CORNER:   return test_cube_corner();
+        case TEST_TYPE_NORMALISE:     return test_normalise();
+        case TEST_TYPE_CORNER_ANGLE:  return test_corner_angle();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int failed = 0;
+    for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+    {
+        TestType type = (TestType) test_index;
+        if(!run_test(type))
+        {
+            printf("test failed: %s\n", describe_test(type));
+            failed += 1;
+        }
+    }
+
+    if(failed == 0)
+    {
+        printf("All tests succeeded!\n\n");
+    }
+
+    return failed > 0;
+}
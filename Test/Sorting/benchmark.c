@@ -0,0 +1,206 @@
+#include "../../Source/random.h"
+#include "../../Source/sorting.h"
+#include "../Benchmark/benchmark.h"
+
+#include <stdio.h>
+
+// This is sized like a draw sorted back-to-front by depth.
+typedef struct Draw
+{
+    float depth;
+    uint32_t index;
+} Draw;
+
+typedef struct Code
+{
+    uint64_t code;
+    uint32_t index;
+} Code;
+
+static bool is_draw_before(Draw a, Draw b)
+{
+    return a.depth < b.depth;
+}
+
+static bool is_code_before(Code a, Code b)
+{
+    return a.code < b.code;
+}
+
+#define GET_DRAW_KEY(element) RADIX_KEY_FROM_FLOAT((element).depth)
+#define GET_CODE_KEY(element) ((element).code)
+
+DEFINE_PARALLEL_SORT(Draw, is_draw_before, by_depth);
+DEFINE_PARALLEL_SORT(Code, is_code_before, by_code);
+DEFINE_QUICK_SORT_BRANCHLESS(Draw, is_draw_before, branchless_by_depth);
+DEFINE_QUICK_SORT_BRANCHLESS(Code, is_code_before, branchless_by_code);
+DEFINE_RADIX_SORT(Draw, uint32_t, GET_DRAW_KEY, by_depth);
+DEFINE_RADIX_SORT(Code, uint64_t, GET_CODE_KEY, by_code);
+
+#define ITERATIONS 5
+
+static void make_draws(Draw* draws, int count, RandomGenerator* generator)
+{
+    for(int i = 0; i < count; i += 1)
+    {
+        draws[i].depth = random_float_range(generator, -100.0f, 100.0f);
+        draws[i].index = (uint32_t) i;
+    }
+}
+
+static void make_codes(Code* codes, int count, RandomGenerator* generator)
+{
+    for(int i = 0; i < count; i += 1)
+    {
+        codes[i].code = random_generate(generator);
+        codes[i].index = (uint32_t) i;
+    }
+}
+
+static void benchmark_draws(int count, Heap* heap)
+{
+    Draw* draws = HEAP_ALLOCATE(heap, Draw, count);
+    RandomGenerator generator;
+    double quick = 0.0;
+    double branchless = 0.0;
+    double parallel = 0.0;
+    double radix = 0.0;
+
+    for(int iteration = 0; iteration < ITERATIONS; iteration += 1)
+    {
+        Timer timer;
+
+        random_seed(&generator, 4451 + iteration);
+        make_draws(draws, count, &generator);
+        timer_start(&timer);
+        quick_sort_by_depth(draws, count);
+        quick += timer_milliseconds(&timer);
+
+        random_seed(&generator, 4451 + iteration);
+        make_draws(draws, count, &generator);
+        timer_start(&timer);
+        quick_sort_branchless_by_depth(draws, count);
+        branchless += timer_milliseconds(&timer);
+
+        random_seed(&generator, 4451 + iteration);
+        make_draws(draws, count, &generator);
+        timer_start(&timer);
+        parallel_sort_by_depth(draws, count, heap);
+        parallel += timer_milliseconds(&timer);
+
+        random_seed(&generator, 4451 + iteration);
+        make_draws(draws, count, &generator);
+        timer_start(&timer);
+        radix_sort_by_depth(draws, count, heap);
+        radix += timer_milliseconds(&timer);
+    }
+
+    printf("%8d float keys   quick %9.3f ms   branchless %9.3f ms   parallel %9.3f ms   radix %9.3f ms\n", count, quick / ITERATIONS, branchless / ITERATIONS, parallel / ITERATIONS, radix / ITERATIONS);
+
+    HEAP_DEALLOCATE(heap, draws);
+}
+
+static void benchmark_codes(int count, Heap* heap)
+{
+    Code* codes = HEAP_ALLOCATE(heap, Code, count);
+    RandomGenerator generator;
+    double quick = 0.0;
+    double branchless = 0.0;
+    double parallel = 0.0;
+    double radix = 0.0;
+
+    for(int iteration = 0; iteration < ITERATIONS; iteration += 1)
+    {
+        Timer timer;
+
+        random_seed(&generator, 9013 + iteration);
+        make_codes(codes, count, &generator);
+        timer_start(&timer);
+        quick_sort_by_code(codes, count);
+        quick += timer_milliseconds(&timer);
+
+        random_seed(&generator, 9013 + iteration);
+        make_codes(codes, count, &generator);
+        timer_start(&timer);
+        quick_sort_branchless_by_code(codes, count);
+        branchless += timer_milliseconds(&timer);
+
+        random_seed(&generator, 9013 + iteration);
+        make_codes(codes, count, &generator);
+        timer_start(&timer);
+        parallel_sort_by_code(codes, count, heap);
+        parallel += timer_milliseconds(&timer);
+
+        random_seed(&generator, 9013 + iteration);
+        make_codes(codes, count, &generator);
+        timer_start(&timer);
+        radix_sort_by_code(codes, count, heap);
+        radix += timer_milliseconds(&timer);
+    }
+
+    printf("%8d uint64 keys  quick %9.3f ms   branchless %9.3f ms   parallel %9.3f ms   radix %9.3f ms\n", count, quick / ITERATIONS, branchless / ITERATIONS, parallel / ITERATIONS, radix / ITERATIONS);
+
+    HEAP_DEALLOCATE(heap, codes);
+}
+
+// Presorted and reversed input, like a directory listing that's already in
+// order, which are the cases a plain quicksort handles worst.
+static void benchmark_presorted(int count, Heap* heap)
+{
+    Draw* draws = HEAP_ALLOCATE(heap, Draw, count);
+    double sorted = 0.0;
+    double reversed = 0.0;
+
+    for(int iteration = 0; iteration < ITERATIONS; iteration += 1)
+    {
+        Timer timer;
+
+        for(int i = 0; i < count; i += 1)
+        {
+            draws[i].depth = (float) i;
+            draws[i].index = (uint32_t) i;
+        }
+        timer_start(&timer);
+        quick_sort_by_depth(draws, count);
+        sorted += timer_milliseconds(&timer);
+
+        for(int i = 0; i < count; i += 1)
+        {
+            draws[i].depth = (float) (count - i);
+            draws[i].index = (uint32_t) i;
+        }
+        timer_start(&timer);
+        quick_sort_by_depth(draws, count);
+        reversed += timer_milliseconds(&timer);
+    }
+
+    printf("%8d presorted    sorted %9.3f ms   reversed %9.3f ms\n", count, sorted / ITERATIONS, reversed / ITERATIONS);
+
+    HEAP_DEALLOCATE(heap, draws);
+}
+
+int main(int argc, char** argv)
+{
+    Heap heap = {0};
+    heap_create_growable(&heap, uptibytes(64));
+
+    const int counts[] = {1000, 100000, 1000000};
+    int counts_count = sizeof(counts) / sizeof(*counts);
+
+    for(int i = 0; i < counts_count; i += 1)
+    {
+        benchmark_draws(counts[i], &heap);
+    }
+    for(int i = 0; i < counts_count; i += 1)
+    {
+        benchmark_codes(counts[i], &heap);
+    }
+    for(int i = 0; i < counts_count; i += 1)
+    {
+        benchmark_presorted(counts[i], &heap);
+    }
+
+    heap_destroy(&heap);
+
+    return 0;
+}
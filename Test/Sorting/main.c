@@ -0,0 +1,344 @@
+#include "../../Source/random.h"
+#include "../../Source/sorting.h"
+
+#include <math.h>
+#include <stdio.h>
+
+typedef struct Record
+{
+    uint32_t key;
+    int order;
+} Record;
+
+typedef struct Depth
+{
+    float depth;
+    int order;
+} Depth;
+
+typedef struct Signed
+{
+    int64_t value;
+} Signed;
+
+typedef enum TestType
+{
+    TEST_TYPE_RADIX_SORT_UINT32,
+    TEST_TYPE_RADIX_SORT_STABLE,
+    TEST_TYPE_RADIX_SORT_FLOAT,
+    TEST_TYPE_RADIX_SORT_INT64,
+    TEST_TYPE_PARALLEL_SORT,
+    TEST_TYPE_PARALLEL_SORT_SMALL,
+    TEST_TYPE_QUICK_SORT,
+    TEST_TYPE_QUICK_SORT_BRANCHLESS,
+    TEST_TYPE_COUNT,
+} TestType;
+
+static const char* describe_test(TestType type)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_RADIX_SORT_UINT32: return "Radix Sort uint32";
+        case TEST_TYPE_RADIX_SORT_STABLE: return "Radix Sort Stable";
+        case TEST_TYPE_RADIX_SORT_FLOAT:  return "Radix Sort Float";
+        case TEST_TYPE_RADIX_SORT_INT64:  return "Radix Sort int64";
+        case TEST_TYPE_PARALLEL_SORT:       return "Parallel Sort";
+        case TEST_TYPE_PARALLEL_SORT_SMALL: return "Parallel Sort Small";
+        case TEST_TYPE_QUICK_SORT:            return "Quick Sort";
+        case TEST_TYPE_QUICK_SORT_BRANCHLESS: return "Quick Sort Branchless";
+    }
+}
+
+#define GET_RECORD_KEY(record) ((record).key)
+#define GET_DEPTH_KEY(element) RADIX_KEY_FROM_FLOAT((element).depth)
+#define GET_SIGNED_KEY(element) RADIX_KEY_FROM_INT64((element).value)
+
+DEFINE_RADIX_SORT(Record, uint32_t, GET_RECORD_KEY, by_key);
+DEFINE_RADIX_SORT(Depth, uint32_t, GET_DEPTH_KEY, by_depth);
+DEFINE_RADIX_SORT(Signed, uint64_t, GET_SIGNED_KEY, by_value);
+
+static bool is_record_before(Record a, Record b)
+{
+    return a.key < b.key;
+}
+
+DEFINE_PARALLEL_SORT(Record, is_record_before, by_key);
+DEFINE_QUICK_SORT_BRANCHLESS(Record, is_record_before, branchless_by_key);
+
+#define ELEMENTS_COUNT 10000
+
+static bool test_radix_sort_uint32(Heap* heap, RandomGenerator* generator)
+{
+    Record* records = HEAP_ALLOCATE(heap, Record, ELEMENTS_COUNT);
+    uint64_t sum = 0;
+    for(int i = 0; i < ELEMENTS_COUNT; i += 1)
+    {
+        records[i].key = (uint32_t) random_generate(generator);
+        sum += records[i].key;
+    }
+
+    radix_sort_by_key(records, ELEMENTS_COUNT, heap);
+
+    int mismatches = 0;
+    uint64_t sorted_sum = records[0].key;
+    for(int i = 1; i < ELEMENTS_COUNT; i += 1)
+    {
+        mismatches += records[i - 1].key > records[i].key;
+        sorted_sum += records[i].key;
+    }
+
+    HEAP_DEALLOCATE(heap, records);
+
+    return mismatches == 0 && sum == sorted_sum;
+}
+
+static bool test_radix_sort_stable(Heap* heap, RandomGenerator* generator)
+{
+    // There are only a few keys, all sharing their upper bytes, so that most
+    // passes are skipped and every key is repeated many times over.
+    Record* records = HEAP_ALLOCATE(heap, Record, ELEMENTS_COUNT);
+    for(int i = 0; i < ELEMENTS_COUNT; i += 1)
+    {
+        records[i].key = 0xabcd0000 + (uint32_t) (random_generate(generator) % 7);
+        records[i].order = i;
+    }
+
+    radix_sort_by_key(records, ELEMENTS_COUNT, heap);
+
+    int mismatches = 0;
+    for(int i = 1; i < ELEMENTS_COUNT; i += 1)
+    {
+        Record prior = records[i - 1];
+        Record record = records[i];
+        mismatches += prior.key > record.key
+            || (prior.key == record.key && prior.order > record.order);
+    }
+
+    HEAP_DEALLOCATE(heap, records);
+
+    return mismatches == 0;
+}
+
+static bool test_radix_sort_float(Heap* heap, RandomGenerator* generator)
+{
+    Depth* depths = HEAP_ALLOCATE(heap, Depth, ELEMENTS_COUNT);
+    for(int i = 0; i < ELEMENTS_COUNT; i += 1)
+    {
+        depths[i].depth = random_float_range(generator, -1000.0f, 1000.0f);
+        depths[i].order = i;
+    }
+    depths[0].depth = -0.0f;
+    depths[1].depth = 0.0f;
+    depths[2].depth = -INFINITY;
+    depths[3].depth = INFINITY;
+    depths[4].depth = -1e-40f;
+    depths[5].depth = 1e-40f;
+
+    radix_sort_by_depth(depths, ELEMENTS_COUNT, heap);
+
+    int mismatches = 0;
+    for(int i = 1; i < ELEMENTS_COUNT; i += 1)
+    {
+        mismatches += depths[i - 1].depth > depths[i].depth;
+    }
+    mismatches += depths[0].depth != -INFINITY;
+    mismatches += depths[ELEMENTS_COUNT - 1].depth != INFINITY;
+
+    HEAP_DEALLOCATE(heap, depths);
+
+    return mismatches == 0;
+}
+
+static bool test_radix_sort_int64(Heap* heap, RandomGenerator* generator)
+{
+    Signed* values = HEAP_ALLOCATE(heap, Signed, ELEMENTS_COUNT);
+    for(int i = 0; i < ELEMENTS_COUNT; i += 1)
+    {
+        values[i].value = (int64_t) random_generate(generator);
+    }
+    values[0].value = INT64_MIN;
+    values[1].value = INT64_MAX;
+    values[2].value = -1;
+    values[3].value = 0;
+
+    radix_sort_by_value(values, ELEMENTS_COUNT, heap);
+
+    int mismatches = 0;
+    for(int i = 1; i < ELEMENTS_COUNT; i += 1)
+    {
+        mismatches += values[i - 1].value > values[i].value;
+    }
+    mismatches += values[0].value != INT64_MIN;
+    mismatches += values[ELEMENTS_COUNT - 1].value != INT64_MAX;
+
+    HEAP_DEALLOCATE(heap, values);
+
+    return mismatches == 0;
+}
+
+// The keys are drawn from a small range, so there are many equal elements to
+// be split across the runs and the slices.
+static bool test_parallel_sort(Heap* heap, RandomGenerator* generator, int count)
+{
+    Record* records = HEAP_ALLOCATE(heap, Record, count);
+    Record* again = HEAP_ALLOCATE(heap, Record, count);
+    for(int i = 0; i < count; i += 1)
+    {
+        records[i].key = (uint32_t) (random_generate(generator) % 1000);
+        records[i].order = i;
+    }
+    copy_memory(again, records, sizeof(Record) * count);
+
+    parallel_sort_by_key(records, count, heap);
+    parallel_sort_by_key(again, count, heap);
+
+    int mismatches = 0;
+    int64_t order_sum = records[0].order;
+    for(int i = 1; i < count; i += 1)
+    {
+        mismatches += records[i - 1].key > records[i].key;
+        order_sum += records[i].order;
+    }
+    for(int i = 0; i < count; i += 1)
+    {
+        mismatches += records[i].key != again[i].key || records[i].order != again[i].order;
+    }
+
+    HEAP_DEALLOCATE(heap, again);
+    HEAP_DEALLOCATE(heap, records);
+
+    return mismatches == 0 && order_sum == (int64_t) count * (count - 1) / 2;
+}
+
+typedef enum Pattern
+{
+    PATTERN_RANDOM,
+    PATTERN_SORTED,
+    PATTERN_REVERSED,
+    PATTERN_NEARLY_SORTED,
+    PATTERN_ALL_EQUAL,
+    PATTERN_FEW_UNIQUE,
+    PATTERN_ORGAN_PIPE,
+    PATTERN_SAWTOOTH,
+    PATTERN_COUNT,
+} Pattern;
+
+static void make_pattern(Record* records, int count, Pattern pattern, RandomGenerator* generator)
+{
+    for(int i = 0; i < count; i += 1)
+    {
+        uint32_t key;
+        switch(pattern)
+        {
+            default:
+            case PATTERN_RANDOM:        key = (uint32_t) random_generate(generator); break;
+            case PATTERN_SORTED:        key = (uint32_t) i;                          break;
+            case PATTERN_REVERSED:      key = (uint32_t) (count - i);                break;
+            case PATTERN_NEARLY_SORTED: key = (uint32_t) i;                          break;
+            case PATTERN_ALL_EQUAL:     key = 7;                                     break;
+            case PATTERN_FEW_UNIQUE:    key = (uint32_t) (random_generate(generator) % 4); break;
+            case PATTERN_ORGAN_PIPE:    key = (uint32_t) (i < count / 2 ? i : count - i); break;
+            case PATTERN_SAWTOOTH:      key = (uint32_t) (i % 97);                   break;
+        }
+        records[i].key = key;
+        records[i].order = i;
+    }
+
+    if(pattern == PATTERN_NEARLY_SORTED)
+    {
+        for(int i = 0; count > 0 && i < 5; i += 1)
+        {
+            int j = (int) (random_generate(generator) % count);
+            int k = (int) (random_generate(generator) % count);
+            SWAP(Record, records[j], records[k]);
+        }
+    }
+}
+
+// Each pattern is one that tends to trip up a plain median-of-three quicksort,
+// either by making its partitions lopsided or by being mostly done already. The
+// sizes straddle the thresholds for insertion sort and the pseudo median of nine.
+static bool test_quick_sort(Heap* heap, RandomGenerator* generator, bool branchless)
+{
+    const int counts[] = {0, 1, 2, 23, 24, 25, 128, 129, 1000, ELEMENTS_COUNT};
+    int counts_count = sizeof(counts) / sizeof(*counts);
+
+    Record* records = HEAP_ALLOCATE(heap, Record, ELEMENTS_COUNT);
+    int mismatches = 0;
+
+    for(int pattern = 0; pattern < PATTERN_COUNT; pattern += 1)
+    {
+        for(int i = 0; i < counts_count; i += 1)
+        {
+            int count = counts[i];
+            make_pattern(records, count, (Pattern) pattern, generator);
+
+            if(branchless)
+            {
+                quick_sort_branchless_by_key(records, count);
+            }
+            else
+            {
+                quick_sort_by_key(records, count);
+            }
+
+            int64_t order_sum = count > 0 ? records[0].order : 0;
+            for(int j = 1; j < count; j += 1)
+            {
+                mismatches += records[j - 1].key > records[j].key;
+                order_sum += records[j].order;
+            }
+            mismatches += order_sum != (int64_t) count * (count - 1) / 2;
+        }
+    }
+
+    HEAP_DEALLOCATE(heap, records);
+
+    return mismatches == 0;
+}
+
+static bool run_test(TestType type, Heap* heap, RandomGenerator* generator)
+{
+    switch(type)
+    {
+        default:
+        case TEST_TYPE_RADIX_SORT_UINT32: return test_radix_sort_uint32(heap, generator);
+        case TEST_TYPE_RADIX_SORT_STABLE: return test_radix_sort_stable(heap, generator);
+        case TEST_TYPE_RADIX_SORT_FLOAT:  return test_radix_sort_float(heap, generator);
+        case TEST_TYPE_RADIX_SORT_INT64:  return test_radix_sort_int64(heap, generator);
+        case TEST_TYPE_PARALLEL_SORT:       return test_parallel_sort(heap, generator, 300007);
+        case TEST_TYPE_PARALLEL_SORT_SMALL: return test_parallel_sort(heap, generator, ELEMENTS_COUNT);
+        case TEST_TYPE_QUICK_SORT:            return test_quick_sort(heap, generator, false);
+        case TEST_TYPE_QUICK_SORT_BRANCHLESS: return test_quick_sort(heap, generator, true);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Heap heap = {0};
+    heap_create(&heap, (uint32_t) uptibytes(1));
+
+    RandomGenerator generator;
+    random_seed(&generator, 8675309);
+
+    int failed = 0;
+    for(int test_index = 0; test_index < TEST_TYPE_COUNT; test_index += 1)
+    {
+        TestType type = (TestType) test_index;
+        if(!run_test(type, &heap, &generator))
+        {
+            printf("test failed: %s\n", describe_test(type));
+            failed += 1;
+        }
+    }
+
+    if(failed == 0)
+    {
+        printf("All tests succeeded!\n\n");
+    }
+
+    heap_destroy(&heap);
+
+    return failed > 0;
+}